@@ -127,7 +127,7 @@ int main(int argc, char **argv) {
     printf("Use ctrl-c to quit.\n");
     printf("***************************\n\n");
     
-    err = modipulate_global_init();
+    err = modipulate_global_init(NULL);
     if (!MODIPULATE_OK(err)) {
         printf("\nERROR: %s\n", modipulate_global_get_last_error_string());
         return err;
@@ -0,0 +1,90 @@
+// Times how fast libopenmpt can tell whether files are modules.
+//
+// Usage: probe-bench [-n iterations] file...
+//
+// Every file is read into memory once and then probed over and over with
+// onlyVerifyHeader, which is what a catalog scan does for each file it
+// comes across.  Files that aren't modules at all are worth including:
+// they have to be turned down by every loader that might take them.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <chrono>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <libopenmpt.hpp>
+
+using namespace std;
+
+struct ProbeFile {
+    string path;
+    string data;
+    double result;
+};
+
+
+static bool read_file(const char* path, string& data) {
+    ifstream in(path, ios::in | ios::binary);
+    if (!in) {
+        return false;
+    }
+    ostringstream contents;
+    contents << in.rdbuf();
+    data = contents.str();
+    return true;
+}
+
+
+static double probe(const string& data) {
+    istringstream stream(data, ios::in | ios::binary);
+    ostringstream log;
+    return openmpt::could_open_propability(stream, 0.5, log);
+}
+
+
+int main(int argc, char* argv[]) {
+    int iterations = 1000;
+    vector<ProbeFile> files;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+            iterations = atoi(argv[++i]);
+            continue;
+        }
+
+        ProbeFile file;
+        file.path = argv[i];
+        if (!read_file(argv[i], file.data)) {
+            fprintf(stderr, "Can't read %s\n", argv[i]);
+            return 1;
+        }
+        files.push_back(file);
+    }
+
+    if (files.empty() || iterations < 1) {
+        fprintf(stderr, "Usage: %s [-n iterations] file...\n", argv[0]);
+        return 1;
+    }
+
+    double total_seconds = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        for (int j = 0; j < iterations; j++) {
+            files[i].result = probe(files[i].data);
+        }
+        chrono::duration<double> elapsed = chrono::steady_clock::now() - start;
+        total_seconds += elapsed.count();
+
+        printf("%-40s %-8s %10.2f us/probe\n", files[i].path.c_str(),
+            files[i].result > 0 ? "module" : "rejected",
+            elapsed.count() * 1e6 / iterations);
+    }
+
+    printf("%d probes in %.3f s, %.0f probes/s\n", (int) files.size() * iterations,
+        total_seconds, files.size() * iterations / total_seconds);
+
+    return 0;
+}
@@ -29,6 +29,8 @@ typedef enum {
     ERR_AMPOUTOFRANGE,
     ERR_VALUEOUTOFRANGE,
     ERR_FULL,
+    ERR_LOADING,
+    ERR_CANCELLED,
 } MgmlError;
 
 #define CMD_VOL 0
@@ -39,6 +41,12 @@ typedef enum {
 static char errbuf[1024] = "";
 static ModipulateSong songs[MAX_SONGS] = {0};
 
+/* Token of the load filling each song ID, or 0 */
+static ModipulateLoadToken loads[MAX_SONGS] = {0};
+
+/* Why the last load of each song ID failed, or ERR_OK */
+static int load_errors[MAX_SONGS] = {0};
+
 /* Set song pointer. Return error if applicable.
  */
 static int get_song(double songid, ModipulateSong* song) {
@@ -49,7 +57,7 @@ static int get_song(double songid, ModipulateSong* song) {
     }
     id = songid;
     if (songs[id] == NOSONG) {
-        return ERR_INVALIDSONGID;
+        return (loads[id] != 0 ? ERR_LOADING : ERR_INVALIDSONGID);
     }
     *song = songs[id];
 
@@ -59,7 +67,7 @@ static int get_song(double songid, ModipulateSong* song) {
 /* ---- Global ------------------------------------------------------------ */
 
 double modipulategml_global_init(void) {
-    ModipulateErr err = modipulate_global_init();
+    ModipulateErr err = modipulate_global_init(NULL);
 
     return (err == MODIPULATE_ERROR_NONE ? LOADED_OK : ERR_FAIL);
 }
@@ -101,6 +109,10 @@ char* modipulategml_error_to_string(double errno) {
             return "Supplied value is outside of valid range";
         case ERR_FULL:
             return "No more capacity to load songs";
+        case ERR_LOADING:
+            return "Song is still loading";
+        case ERR_CANCELLED:
+            return "Song load was cancelled";
         default:
             assert(0);
             return "Unknown error";
@@ -134,7 +146,7 @@ double modipulategml_song_load(const char* filename) {
 
     /* Find next available song ID */
     for (id = 0; id < MAX_SONGS; id++) {
-        if (songs[id] == NOSONG) {
+        if (songs[id] == NOSONG && loads[id] == 0) {
             break;
         }
     }
@@ -143,6 +155,7 @@ double modipulategml_song_load(const char* filename) {
         return ERR_FULL;
     }
 
+    load_errors[id] = ERR_OK;
     if (modipulate_song_load(filename, &songs[id]) != MODIPULATE_ERROR_NONE) {
         return ERR_FAIL;
     }
@@ -150,6 +163,79 @@ double modipulategml_song_load(const char* filename) {
     return id;
 }
 
+/* Internal helper: fills in a song ID once its background load is over */
+static void on_song_loaded(ModipulateErr err, ModipulateSong song, void* user_data) {
+    unsigned int id = (unsigned int) (size_t) user_data;
+
+    loads[id] = 0;
+    if (err == MODIPULATE_ERROR_NONE) {
+        songs[id] = song;
+    } else {
+        load_errors[id] = (err == MODIPULATE_ERROR_CANCELLED ? ERR_CANCELLED : ERR_FAIL);
+    }
+}
+
+double modipulategml_song_load_async(const char* filename) {
+    unsigned int id = 0;
+
+    /* Find next available song ID */
+    for (id = 0; id < MAX_SONGS; id++) {
+        if (songs[id] == NOSONG && loads[id] == 0) {
+            break;
+        }
+    }
+    /* All song slots filled */
+    if (id == MAX_SONGS) {
+        return ERR_FULL;
+    }
+
+    load_errors[id] = ERR_OK;
+    if (modipulate_song_load_async(filename, on_song_loaded, (void*) (size_t) id,
+        &loads[id]) != MODIPULATE_ERROR_NONE) {
+        return ERR_FAIL;
+    }
+
+    return id;
+}
+
+double modipulategml_song_load_status(double songid) {
+    unsigned int id;
+
+    if (songid < 0.0 || songid >= MAX_SONGS) {
+        return ERR_SONGOUTOFRANGE;
+    }
+    id = songid;
+    if (songs[id] != NOSONG) {
+        return 1;
+    }
+    if (loads[id] != 0) {
+        return 0;
+    }
+    if (load_errors[id] != ERR_OK) {
+        return load_errors[id];
+    }
+
+    return ERR_INVALIDSONGID;
+}
+
+double modipulategml_song_load_cancel(double songid) {
+    unsigned int id;
+
+    if (songid < 0.0 || songid >= MAX_SONGS) {
+        return ERR_SONGOUTOFRANGE;
+    }
+    id = songid;
+    if (loads[id] == 0) {
+        return ERR_INVALIDSONGID;
+    }
+
+    if (modipulate_song_load_cancel(loads[id]) != MODIPULATE_ERROR_NONE) {
+        return ERR_FAIL;
+    }
+
+    return ERR_OK;
+}
+
 double modipulategml_song_unload(double songid) {
     ModipulateSong song;
 
@@ -161,6 +247,7 @@ double modipulategml_song_unload(double songid) {
     if (modipulate_song_unload(song) != MODIPULATE_ERROR_NONE) {
         return ERR_FAIL;
     }
+    songs[(unsigned int) songid] = NOSONG;
 
     return ERR_OK;
 }
@@ -377,4 +464,57 @@ double modipulategml_song_fade_channel(double songid, double msec,
     return ERR_OK;
 }
 
+/* ---- Song events ------------------------------------------------------- */
+
+static double song_event_polling(double songid, int enabled) {
+    ModipulateSong song;
+
+    int err = get_song(songid, &song);
+    if (err != ERR_OK) {
+        return err;
+    }
+
+    err = modipulate_song_enable_event_polling(song, enabled);
+    if (err != MODIPULATE_ERROR_NONE) {
+        return ERR_FAIL;
+    }
+
+    return ERR_OK;
+}
+
+double modipulategml_song_enable_event_polling(double songid) {
+
+    return song_event_polling(songid, 1);
+}
+
+double modipulategml_song_disable_event_polling(double songid) {
+
+    return song_event_polling(songid, 0);
+}
+
+double modipulategml_song_poll_events(double songid, char* buffer, double size) {
+    ModipulateSong song;
+    unsigned int capacity, count;
+
+    int err = get_song(songid, &song);
+    if (err != ERR_OK) {
+        return err;
+    }
+    if (size < 0.0) {
+        return ERR_VALUEOUTOFRANGE;
+    }
+    capacity = (unsigned int) (size / sizeof (ModipulateEvent));
+    if (buffer == NULL && capacity > 0) {
+        return ERR_VALUEOUTOFRANGE;
+    }
+
+    err = modipulate_song_poll_events(song, (ModipulateEvent*) buffer,
+        capacity, &count);
+    if (err != MODIPULATE_ERROR_NONE) {
+        return ERR_FAIL;
+    }
+
+    return count;
+}
+
 /* ------------------------------------------------------------------------ */
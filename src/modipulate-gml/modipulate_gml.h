@@ -47,6 +47,25 @@ double modipulategml_global_set_volume(double vol);
  */
 double modipulategml_song_load(const char* filename);
 
+/* Start loading a song file in the background
+ * Returns the song ID it will be loaded into, or negative number upon error.
+ * The song arrives during a later modipulategml_global_update(); until then
+ * song functions given the ID fail with "Song is still loading".
+ */
+double modipulategml_song_load_async(const char* filename);
+
+/* Check on a song started with modipulategml_song_load_async()
+ * Returns 1 once the song is loaded, 0 while it is still loading, or
+ * negative number if the load failed or was cancelled.
+ */
+double modipulategml_song_load_status(double songid);
+
+/* Cancel a song that is still loading
+ * The song ID is freed during the next modipulategml_global_update().
+ * Returns 0, or negative number upon error
+ */
+double modipulategml_song_load_cancel(double songid);
+
 /* Unload a song
  * Returns 0, or negative number upon error
  */
@@ -113,6 +132,21 @@ double modipulategml_song_play_sample(double songid, double sample,
 double modipulategml_song_fade_channel(double songid, double msec,
     double channel, double destination_amp);
 
+/* Start or stop keeping the song's events for
+ * modipulategml_song_poll_events()
+ * Enable it right after loading the song, before playing it
+ */
+double modipulategml_song_enable_event_polling(double songid);
+double modipulategml_song_disable_event_polling(double songid);
+
+/* Copy the song's pattern, row and note events since the last call into a
+ * buffer, as 48-byte records (see ModipulateEvent in modipulate.h)
+ * Pass buffer_get_address() of a GML buffer and its size in bytes; returns
+ * the number of records written. Fails unless event polling is enabled
+ */
+double modipulategml_song_poll_events(double songid, char* buffer,
+    double size);
+
 /* "C" */
 #ifdef __cplusplus
 }
@@ -672,7 +672,7 @@ int main(int argc, char *argv[])
 
     // Modipulate: set up
     std::cout << PFX_INFO << "Modipulate: Setting up\n";
-    err = modipulate_global_init();
+    err = modipulate_global_init(NULL);
     if (!MODIPULATE_OK(err))
     {
         std::cout << PFX_ERR << "Modipulate: " << modipulate_global_get_last_error_string() << "\n";
@@ -0,0 +1,155 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include <string.h>
+#include <assert.h>
+#include "command_queue.h"
+
+CommandQueue::CommandQueue() :
+    waiting(0),
+    num_pending(0),
+    row(0),
+    next_row(0),
+    num_filled(0)
+{
+    memset(&clock, 0, sizeof(clock));
+    memset(cells, 0, sizeof(cells));
+}
+
+
+bool CommandQueue::push(const QueuedCommand& command) {
+    if (command.channel >= MAX_CHANNELS) {
+        return false;
+    }
+
+    // Counted before it's in the ring, so the audio thread can never take
+    // more than the pending list holds.
+    if (waiting.fetch_add(1, std::memory_order_relaxed) >= MAX_QUEUED_COMMANDS) {
+        waiting.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    if (!incoming.push(command)) {
+        waiting.fetch_sub(1, std::memory_order_relaxed);
+        return false;
+    }
+    return true;
+}
+
+
+void CommandQueue::clear() {
+    incoming.clear();
+    waiting.store(0, std::memory_order_relaxed);
+    num_pending = 0;
+    num_filled = 0;
+    memset(cells, 0, sizeof(cells));
+}
+
+
+void CommandQueue::start_tick(const TickClock& clock) {
+    // Last tick's cells have had their chance.
+    for (unsigned i = 0; i < num_filled; i++) {
+        cells[filled[i]].volume = false;
+        cells[filled[i]].effect = false;
+    }
+    num_filled = 0;
+
+    this->clock = clock;
+    bring_in();
+    place_due(false);
+}
+
+
+void CommandQueue::start_row(unsigned long long row) {
+    this->row = row;
+    next_row = row + 1;
+    place_due(true);
+}
+
+
+void CommandQueue::bring_in() {
+    // Everything in the ring fits, see push().
+    QueuedCommand command;
+    while (num_pending < MAX_QUEUED_COMMANDS && incoming.pop(command)) {
+        if (command.when == MODIPULATE_WHEN_NEXT_ROW) {
+            command.when = MODIPULATE_WHEN_ROWS;
+            command.at = 0;
+        }
+        if (command.when == MODIPULATE_WHEN_ROWS) {
+            command.at += next_row;
+        }
+        pending[num_pending++] = command;
+    }
+}
+
+
+void CommandQueue::place_due(bool row_start) {
+    // Keep the ones that aren't placed in order.
+    unsigned kept = 0;
+    for (unsigned i = 0; i < num_pending; i++) {
+        const QueuedCommand& c = pending[i];
+
+        bool due = false;
+        switch (c.when) {
+        case MODIPULATE_WHEN_ROWS:
+            due = row_start && c.at <= row;
+            break;
+
+        case MODIPULATE_WHEN_TICK:
+            due = c.at <= clock.tick;
+            break;
+
+        case MODIPULATE_WHEN_FRAME:
+            // On the tick the frame falls in.
+            due = c.at < clock.frame + clock.tick_frames;
+            break;
+        }
+
+        if (due && place(c)) {
+            waiting.fetch_sub(1, std::memory_order_relaxed);
+        } else {
+            pending[kept++] = c;
+        }
+    }
+    num_pending = kept;
+}
+
+
+const QueuedCell* CommandQueue::take(unsigned channel) {
+    if (channel >= MAX_CHANNELS) {
+        return NULL;
+    }
+
+    const QueuedCell* cell = &cells[channel];
+    return (cell->volume || cell->effect) ? cell : NULL;
+}
+
+
+bool CommandQueue::place(const QueuedCommand& command) {
+    // push() turns away anything out of range.
+    assert(command.channel < MAX_CHANNELS);
+
+    QueuedCell& cell = cells[command.channel];
+    if (command.effect ? cell.effect : cell.volume) {
+        return false;
+    }
+
+    if (!cell.volume && !cell.effect) {
+        filled[num_filled++] = command.channel;
+    }
+
+    if (command.effect) {
+        cell.effect = true;
+        cell.effect_command = command.command;
+        cell.effect_value = command.value;
+    } else {
+        cell.volume = true;
+        cell.volume_command = command.command;
+        cell.volume_value = command.value;
+    }
+    return true;
+}
@@ -0,0 +1,130 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#ifndef COMMANDQUEUE_H
+#define COMMANDQUEUE_H
+
+#include <atomic>
+#include "modipulate.h"
+#include "event_ring.h"
+#include "libopenmpt-forked/soundlib/Snd_defs.h"
+
+// Max number of volume and effect commands waiting to be applied, per song.
+// Must be a power of two.
+#define MAX_QUEUED_COMMANDS 1024
+
+// A volume or effect command, see modipulate_song_queue_command().
+struct QueuedCommand {
+    unsigned channel;
+    bool effect;              // Effect column if true, volume column if false.
+    unsigned command;
+    unsigned value;
+    int when;                 // MODIPULATE_WHEN_*
+    unsigned long long at;    // Absolute row, tick or frame once it's queued.
+};
+
+// What the queue puts into a channel's pattern cell on a tick.
+struct QueuedCell {
+    bool volume;
+    unsigned volume_command;
+    unsigned volume_value;
+
+    bool effect;
+    unsigned effect_command;
+    unsigned effect_value;
+};
+
+// Where playback is at the start of a tick, counted from the start of
+// playback across loops and seeks.
+struct TickClock {
+    unsigned long long tick;
+    unsigned long long frame;
+
+    // Length of the tick before, which this one most likely shares.
+    unsigned long tick_frames;
+};
+
+// Applies volume and effect commands at the row, tick or frame they were
+// asked for, for one song.
+//
+// The game thread pushes commands into a fixed-size ring, and at the start
+// of every tick the audio thread moves them to a fixed-size pending list
+// and works out which are due.  Nothing is allocated once the queue exists.
+// push() turns commands away once MAX_QUEUED_COMMANDS are waiting, so the
+// pending list always has room, and far-off commands never hold up others.
+//
+// A pattern cell has one volume column and one effect column, so a channel
+// takes a volume command and an effect command at a time.  A command whose
+// column is already taken waits for the next tick (or row, for row
+// targets), so none are lost and those for the same column are applied in
+// the order they were queued.  Row targets are applied on the row's first
+// tick; tick and frame targets on their own tick, leaving the timing of
+// the row's note alone.
+
+class CommandQueue {
+
+public:
+    CommandQueue();
+
+    // Game thread: queues a command.  Returns false if MAX_QUEUED_COMMANDS
+    // are waiting already, or the channel is out of range.
+    bool push(const QueuedCommand& command);
+
+    // Game thread: drops every command.  The audio thread must not be
+    // using the queue.
+    void clear();
+
+    // Audio thread: a new tick has started.  Brings in the new commands and
+    // fills the cells of the tick and frame targets due now.
+    void start_tick(const TickClock& clock);
+
+    // Audio thread: the tick that just started is the first of a row,
+    // numbered from the start of playback.  Fills the cells of the row
+    // targets due now.
+    void start_row(unsigned long long row);
+
+    // Audio thread: the commands for a channel's cell this tick, or NULL.
+    const QueuedCell* take(unsigned channel);
+
+private:
+    // Audio thread: moves new commands to the pending list.  Row targets
+    // count from row next_row.
+    void bring_in();
+
+    // Audio thread: places the pending commands that are due, keeping the
+    // others in order.  Row targets only at the start of a row.
+    void place_due(bool row_start);
+
+    // Audio thread: puts a due command into its channel's cell.  Returns
+    // false if the column is already taken.
+    bool place(const QueuedCommand& command);
+
+    CommandQueue(const CommandQueue&);
+    CommandQueue& operator=(const CommandQueue&);
+
+    EventRing<QueuedCommand, MAX_QUEUED_COMMANDS> incoming;
+
+    // Commands pushed and not yet placed.
+    std::atomic<unsigned> waiting;
+
+    // Audio thread, oldest first.
+    QueuedCommand pending[MAX_QUEUED_COMMANDS];
+    unsigned num_pending;
+
+    // Where playback is (audio thread).
+    TickClock clock;
+    unsigned long long row;
+    unsigned long long next_row;
+
+    // Filled cells of the current tick.
+    QueuedCell cells[MAX_CHANNELS];
+    unsigned filled[MAX_CHANNELS];
+    unsigned num_filled;
+};
+
+#endif // COMMANDQUEUE_H
@@ -0,0 +1,95 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#ifndef EVENTRING_H
+#define EVENTRING_H
+
+#include <atomic>
+
+// Fixed-size single producer, single consumer ring buffer.
+//
+// One thread may call push(), one other thread may call pop() and peek().
+// All storage is allocated up front, so neither side ever allocates or
+// locks.  Size must be a power of two.
+
+template <class T, unsigned Size>
+class EventRing
+{
+public:
+
+    EventRing() :
+        head(0),
+        tail(0)
+    {}
+
+    // Producer: adds an item. Returns false (and drops the item) if full.
+    bool push(const T& item)
+    {
+        unsigned h = head.load(std::memory_order_relaxed);
+        if (h - tail.load(std::memory_order_acquire) >= Size)
+            return false;
+
+        items[h & (Size - 1)] = item;
+        head.store(h + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Consumer: returns the oldest item without removing it, or NULL if empty.
+    const T* peek()
+    {
+        unsigned t = tail.load(std::memory_order_relaxed);
+        if (t == head.load(std::memory_order_acquire))
+            return NULL;
+
+        return &items[t & (Size - 1)];
+    }
+
+    // Consumer: removes the oldest item. Returns false if empty.
+    bool pop(T& item)
+    {
+        const T* front = peek();
+        if (!front)
+            return false;
+
+        item = *front;
+        tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    // Consumer: throws away everything currently queued.
+    void clear()
+    {
+        tail.store(head.load(std::memory_order_acquire), std::memory_order_release);
+    }
+
+    // Number of queued items. Exact only when called from either end.
+    unsigned size()
+    {
+        return head.load(std::memory_order_acquire) - tail.load(std::memory_order_acquire);
+    }
+
+    static unsigned capacity()
+    {
+        return Size;
+    }
+
+private:
+    // Don't allow copies.
+    EventRing(const EventRing&);
+    EventRing& operator=(const EventRing&);
+
+    T items[Size];
+
+    // Written only by the producer / consumer respectively.
+    std::atomic<unsigned> head;
+    std::atomic<unsigned> tail;
+};
+
+#endif // EVENTRING_H
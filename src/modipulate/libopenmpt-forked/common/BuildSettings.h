@@ -75,6 +75,28 @@
 
 
 
+// Vectorized mixer kernels, written with compiler intrinsics instead of inline assembly.
+// SSE2 and NEON are part of the x86-64 and ARMv8 baselines and are used unconditionally.
+// AVX2 kernels are built when the build system defines ENABLE_AVX2_MIXER and are only used if the
+// CPU supports them. FastmixAVX2.cpp enables AVX2 code generation for the kernels by itself.
+#ifndef NO_SIMD_MIXER
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))
+#define ENABLE_SSE2_MIXER
+#endif
+
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define ENABLE_NEON_MIXER
+#endif
+
+#else // NO_SIMD_MIXER
+
+#undef ENABLE_AVX2_MIXER
+
+#endif // !NO_SIMD_MIXER
+
+
+
 #if defined(MODPLUG_TRACKER) && defined(LIBOPENMPT_BUILD)
 
 #error "either MODPLUG_TRACKER or LIBOPENMPT_BUILD has to be defined"
@@ -161,10 +183,10 @@
 //#define NO_LOGGING
 //#define NO_FILEREADER_STD_ISTREAM
 #define NO_ARCHIVE_SUPPORT
-#define NO_REVERB
-#define NO_DSP
-#define NO_EQ
-#define NO_AGC
+//#define NO_REVERB
+//#define NO_DSP
+//#define NO_EQ
+//#define NO_AGC
 #define NO_ASIO
 #define NO_VST
 #define NO_PORTAUDIO
@@ -198,14 +220,6 @@
 //#define NO_WINDOWS_H
 #endif
 
-#if !defined(ENABLE_MMX) && !defined(NO_REVERB)
-#define NO_REVERB // reverb requires mmx
-#endif
-
-#if !defined(ENABLE_X86) && !defined(NO_DSP)
-#define NO_DSP // DSP requires x86 inline asm
-#endif
-
 #if defined(ENABLE_TESTS) && defined(MODPLUG_NO_FILESAVE)
 #undef MODPLUG_NO_FILESAVE // tests recommend file saving
 #endif
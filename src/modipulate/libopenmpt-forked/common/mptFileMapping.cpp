@@ -0,0 +1,162 @@
+/*
+ * mptFileMapping.cpp
+ * ------------------
+ * Purpose: Read-only memory mapping of a whole file.
+ * Notes  : Empty files can't be mapped and fail to open.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+#include "mptFileMapping.h"
+
+#if defined(WIN32)
+#include <windows.h>
+#else
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+namespace mpt
+{
+
+
+FileMapping::FileMapping()
+//------------------------
+	: data(nullptr)
+	, size(0)
+#if defined(WIN32)
+	, file(INVALID_HANDLE_VALUE)
+	, mapping(NULL)
+#endif
+{
+}
+
+
+FileMapping::~FileMapping()
+//-------------------------
+{
+	Close();
+}
+
+
+#if defined(WIN32)
+
+
+bool FileMapping::Open(const char *filename)
+//------------------------------------------
+{
+	Close();
+
+	file = CreateFileA(filename, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if(!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart <= 0 || static_cast<unsigned long long>(fileSize.QuadPart) > static_cast<std::size_t>(-1))
+	{
+		Close();
+		return false;
+	}
+
+	mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(mapping == NULL)
+	{
+		Close();
+		return false;
+	}
+
+	data = static_cast<const char *>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	if(data == nullptr)
+	{
+		Close();
+		return false;
+	}
+	size = static_cast<std::size_t>(fileSize.QuadPart);
+	return true;
+}
+
+
+void FileMapping::Close()
+//-----------------------
+{
+	if(data != nullptr)
+	{
+		UnmapViewOfFile(data);
+		data = nullptr;
+	}
+	if(mapping != NULL)
+	{
+		CloseHandle(mapping);
+		mapping = NULL;
+	}
+	if(file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(file);
+		file = INVALID_HANDLE_VALUE;
+	}
+	size = 0;
+}
+
+
+#else // !WIN32
+
+
+bool FileMapping::Open(const char *filename)
+//------------------------------------------
+{
+	Close();
+
+	int fd = open(filename, O_RDONLY);
+	if(fd < 0)
+	{
+		return false;
+	}
+
+	struct stat st;
+	if(fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size <= 0 || static_cast<unsigned long long>(st.st_size) > static_cast<std::size_t>(-1))
+	{
+		close(fd);
+		return false;
+	}
+
+	void *p = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+	// The mapping stays valid after the descriptor is closed.
+	close(fd);
+	if(p == MAP_FAILED)
+	{
+		return false;
+	}
+
+	data = static_cast<const char *>(p);
+	size = static_cast<std::size_t>(st.st_size);
+#ifdef MADV_WILLNEED
+	madvise(p, size, MADV_WILLNEED);
+#endif
+	return true;
+}
+
+
+void FileMapping::Close()
+//-----------------------
+{
+	if(data != nullptr)
+	{
+		munmap(const_cast<char *>(data), size);
+		data = nullptr;
+	}
+	size = 0;
+}
+
+
+#endif // WIN32
+
+
+} // namespace mpt
@@ -0,0 +1,48 @@
+/*
+ * mptFileMapping.h
+ * ----------------
+ * Purpose: Read-only memory mapping of a whole file.
+ * Notes  : Uses mmap on POSIX systems and file mapping objects on Windows.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+
+namespace mpt
+{
+
+
+//===============
+class FileMapping
+//===============
+{
+private:
+	const char *data;
+	std::size_t size;
+#if defined(WIN32)
+	void *file;			// HANDLE
+	void *mapping;		// HANDLE
+#endif
+
+	// non-copyable
+	FileMapping(const FileMapping &);
+	void operator = (const FileMapping &);
+
+public:
+	FileMapping();
+	~FileMapping();
+
+	// Maps the whole file read-only. Returns false if the file can't be opened or mapped.
+	bool Open(const char *filename);
+	void Close();
+
+	const char *GetData() const { return data; }
+	std::size_t GetSize() const { return size; }
+};
+
+
+} // namespace mpt
@@ -12,7 +12,7 @@
 
 #include "libopenmpt_config.h"
 
-class ModStream; // modipulate!
+class ISoundHooks; // modipulate!
 
 #include <exception>
 #include <iostream>
@@ -285,6 +285,14 @@ public:
 	  \remarks The input data can be discarded after an openmpt::module has succesfullly been constructed.
 	*/
 	module( const void * data, std::size_t size, std::ostream & log = std::clog, const std::map< std::string, std::string > & ctls = detail::initial_ctls_map() );
+	/*!
+	  \param filename Path of the file to load the module from. The file is memory-mapped, not read into a buffer.
+	  \param log Log where any warnings or errors are printed to. The lifetime of the reference has to be as long as the lifetime of the module instance.
+	  \param ctls A map of initial ctl values, see openmpt::modules::get_ctls.
+	  \return Throw an exception derived from openmpt::exception in case the provided file cannot be opened.
+	  \remarks The file is unmapped once the module has been constructed. Added for Modipulate.
+	*/
+	module( const std::string & filename, std::ostream & log = std::clog, const std::map< std::string, std::string > & ctls = detail::initial_ctls_map() );
 	virtual ~module();
 public:
 
@@ -557,9 +565,62 @@ public:
 	/* MODIPULATE!!!!!!!!!!                                                 */
 	/************************************************************************/
 
-	void set_mod_stream(ModStream* modStream);
+	void set_sound_hooks(ISoundHooks* hooks);
     void fade_channel(std::uint32_t msec, std::int32_t channel, double destination_amp);
 
+	// Per-channel overrides. All channels start enabled, untransposed and with every command allowed.
+	void set_channel_enabled(std::int32_t channel, bool enabled);
+	bool get_channel_enabled(std::int32_t channel) const;
+	void set_channel_transposition(std::int32_t channel, std::int32_t semitones);
+	std::int32_t get_channel_transposition(std::int32_t channel) const;
+	void set_channel_effect_enabled(std::int32_t channel, int effect_command, bool enabled);
+	bool get_channel_effect_enabled(std::int32_t channel, int effect_command) const;
+	void set_channel_volume_command_enabled(std::int32_t channel, int volume_command, bool enabled);
+	bool get_channel_volume_command_enabled(std::int32_t channel, int volume_command) const;
+
+	// Live tempo and pitch multipliers, 1.0 being the song's own. A new factor
+	// glides in over ramp_frames rendered frames. Tempo takes effect tick by
+	// tick, pitch every few frames. The tempo factor doesn't affect song time: positions, seeking and
+	// the timeline still count in seconds of the unmodified song.
+	void set_tempo_factor(double factor, std::int32_t ramp_frames);
+	double get_tempo_factor() const;
+	void set_pitch_factor(double factor, std::int32_t ramp_frames);
+	double get_pitch_factor() const;
+
+	// Seconds spent rendering since the song was loaded: processing rows and
+	// effects, and mixing the voices.
+	void get_render_times(double & row_seconds, double & mix_seconds) const;
+
+	// Linear gain applied as the mix is written to the output buffer, the
+	// same one render.mastergain_millibel sets, so it can also be 0.
+	void set_gain(float gain);
+	float get_gain() const;
+
+	// Walks the whole song once and remembers where it was every few rows,
+	// so set_position_seconds() and set_position_order_row() can start from
+	// the nearest of those points instead of the beginning. samplerate must
+	// be the one the song is rendered at. Safe to call on another thread
+	// while the song plays.
+	void build_seek_cache(std::int32_t samplerate);
+
+	// A note, as found by build_seek_cache().
+	struct timeline_event {
+		double seconds;
+		std::int64_t frame; // At the samplerate given to build_seek_cache().
+		std::int32_t order;
+		std::int32_t row;
+		std::int32_t channel;
+		std::int32_t note;
+		std::int32_t instrument;
+		std::int32_t volume_command;
+		std::int32_t volume;
+		std::int32_t effect_command;
+		std::int32_t effect_param;
+	};
+	// Appends the notes that start in [start, end) seconds to events, in the
+	// order they play. Returns false if build_seek_cache() hasn't finished.
+	bool get_timeline(double start, double end, std::vector<timeline_event> & events) const;
+
 }; // class module
 
 } // namespace openmpt
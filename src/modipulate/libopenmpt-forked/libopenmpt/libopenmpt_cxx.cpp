@@ -128,6 +128,10 @@ module::module( const void * data, std::size_t size, std::ostream & log, const s
 	impl = new module_impl( data, size, std::make_shared<std_ostream_log>( log ), ctls );
 }
 
+module::module( const std::string & filename, std::ostream & log, const std::map< std::string, std::string > & ctls ) : impl(0) {
+	impl = new module_impl( filename, std::make_shared<std_ostream_log>( log ), ctls );
+}
+
 module::~module() {
 	delete impl;
 	impl = 0;
@@ -313,14 +317,66 @@ void module::ctl_set( const std::string & ctl, const std::string & value ) {
 }
 
 // MODIPULATE!!!11
-void module::set_mod_stream(ModStream* modStream) {
-	impl->set_mod_stream(modStream);
+void module::set_sound_hooks(ISoundHooks* hooks) {
+	impl->set_sound_hooks(hooks);
 }
 
 void module::fade_channel(std::uint32_t msec, std::int32_t channel, double destination_amp) {
     impl->fade_channel(msec, channel, destination_amp);
 }
 
+void module::set_channel_enabled(std::int32_t channel, bool enabled) {
+	impl->set_channel_enabled(channel, enabled);
+}
+bool module::get_channel_enabled(std::int32_t channel) const {
+	return impl->get_channel_enabled(channel);
+}
+void module::set_channel_transposition(std::int32_t channel, std::int32_t semitones) {
+	impl->set_channel_transposition(channel, semitones);
+}
+std::int32_t module::get_channel_transposition(std::int32_t channel) const {
+	return impl->get_channel_transposition(channel);
+}
+void module::set_channel_effect_enabled(std::int32_t channel, int effect_command, bool enabled) {
+	impl->set_channel_effect_enabled(channel, effect_command, enabled);
+}
+bool module::get_channel_effect_enabled(std::int32_t channel, int effect_command) const {
+	return impl->get_channel_effect_enabled(channel, effect_command);
+}
+void module::set_channel_volume_command_enabled(std::int32_t channel, int volume_command, bool enabled) {
+	impl->set_channel_volume_command_enabled(channel, volume_command, enabled);
+}
+bool module::get_channel_volume_command_enabled(std::int32_t channel, int volume_command) const {
+	return impl->get_channel_volume_command_enabled(channel, volume_command);
+}
+void module::set_tempo_factor(double factor, std::int32_t ramp_frames) {
+	impl->set_tempo_factor(factor, ramp_frames);
+}
+double module::get_tempo_factor() const {
+	return impl->get_tempo_factor();
+}
+void module::set_pitch_factor(double factor, std::int32_t ramp_frames) {
+	impl->set_pitch_factor(factor, ramp_frames);
+}
+double module::get_pitch_factor() const {
+	return impl->get_pitch_factor();
+}
+void module::get_render_times(double & row_seconds, double & mix_seconds) const {
+	impl->get_render_times(row_seconds, mix_seconds);
+}
+void module::set_gain(float gain) {
+	impl->set_gain(gain);
+}
+float module::get_gain() const {
+	return impl->get_gain();
+}
+void module::build_seek_cache(std::int32_t samplerate) {
+	impl->build_seek_cache(samplerate);
+}
+bool module::get_timeline(double start, double end, std::vector<timeline_event> & events) const {
+	return impl->get_timeline(start, end, events);
+}
+
 } // namespace openmpt
 
 #endif // NO_LIBOPENMPT_CXX
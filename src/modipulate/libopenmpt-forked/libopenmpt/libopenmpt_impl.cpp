@@ -326,6 +326,7 @@ void module_impl::load( const FileReader & file ) {
 }
 std::size_t module_impl::read_wrapper( std::size_t count, std::int16_t * left, std::int16_t * right, std::int16_t * rear_left, std::int16_t * rear_right ) {
 	m_sndFile->ResetMixStat();
+	const double song_time_start = m_sndFile->GetSongTimeRendered();
 	std::size_t count_read = 0;
 	while ( count > 0 ) {
 		std::int16_t * const buffers[4] = { left + count_read, right + count_read, rear_left + count_read, rear_right + count_read };
@@ -340,10 +341,13 @@ std::size_t module_impl::read_wrapper( std::size_t count, std::int16_t * left, s
 		count -= count_chunk;
 		count_read += count_chunk;
 	}
+	// In song time, so the position doesn't drift while the tempo factor is changed.
+	m_currentPositionSeconds += m_sndFile->GetSongTimeRendered() - song_time_start;
 	return count_read;
 }
 std::size_t module_impl::read_wrapper( std::size_t count, float * left, float * right, float * rear_left, float * rear_right ) {
 	m_sndFile->ResetMixStat();
+	const double song_time_start = m_sndFile->GetSongTimeRendered();
 	std::size_t count_read = 0;
 	while ( count > 0 ) {
 		float * const buffers[4] = { left + count_read, right + count_read, rear_left + count_read, rear_right + count_read };
@@ -358,10 +362,12 @@ std::size_t module_impl::read_wrapper( std::size_t count, float * left, float *
 		count -= count_chunk;
 		count_read += count_chunk;
 	}
+	m_currentPositionSeconds += m_sndFile->GetSongTimeRendered() - song_time_start;
 	return count_read;
 }
 std::size_t module_impl::read_interleaved_wrapper( std::size_t count, std::size_t channels, std::int16_t * interleaved ) {
 	m_sndFile->ResetMixStat();
+	const double song_time_start = m_sndFile->GetSongTimeRendered();
 	std::size_t count_read = 0;
 	while ( count > 0 ) {
 		AudioReadTargetGainBuffer<std::int16_t> target(*m_Dither, interleaved + count_read * channels, 0, m_Gain);
@@ -375,10 +381,12 @@ std::size_t module_impl::read_interleaved_wrapper( std::size_t count, std::size_
 		count -= count_chunk;
 		count_read += count_chunk;
 	}
+	m_currentPositionSeconds += m_sndFile->GetSongTimeRendered() - song_time_start;
 	return count_read;
 }
 std::size_t module_impl::read_interleaved_wrapper( std::size_t count, std::size_t channels, float * interleaved ) {
 	m_sndFile->ResetMixStat();
+	const double song_time_start = m_sndFile->GetSongTimeRendered();
 	std::size_t count_read = 0;
 	while ( count > 0 ) {
 		AudioReadTargetGainBuffer<float> target(*m_Dither, interleaved + count_read * channels, 0, m_Gain);
@@ -392,6 +400,7 @@ std::size_t module_impl::read_interleaved_wrapper( std::size_t count, std::size_
 		count -= count_chunk;
 		count_read += count_chunk;
 	}
+	m_currentPositionSeconds += m_sndFile->GetSongTimeRendered() - song_time_start;
 	return count_read;
 }
 
@@ -472,6 +481,15 @@ module_impl::module_impl( const void * data, std::size_t size, std::shared_ptr<l
 	load( FileReader( data, size ) );
 	apply_libopenmpt_defaults();
 }
+module_impl::module_impl( const std::string & filename, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls ) : m_Log(log) {
+	init( ctls );
+	MPT_SHARED_PTR<mpt::FileMapping> mapping( new mpt::FileMapping() );
+	if ( !mapping->Open( filename.c_str() ) ) {
+		throw openmpt::exception("error mapping file");
+	}
+	load( FileReader( mapping ) );
+	apply_libopenmpt_defaults();
+}
 module_impl::~module_impl() {
 	m_sndFile->Destroy();
 }
@@ -479,6 +497,9 @@ module_impl::~module_impl() {
 std::int32_t module_impl::get_render_param( int param ) const {
 	switch ( param ) {
 		case module::RENDER_MASTERGAIN_MILLIBEL: {
+			if ( m_Gain <= 0.0f ) {
+				return std::numeric_limits<std::int32_t>::min();
+			}
 			return static_cast<std::int32_t>( 1000.0f * 2.0f * std::log10( m_Gain ) );
 		} break;
 		case module::RENDER_STEREOSEPARATION_PERCENT: {
@@ -533,7 +554,6 @@ std::size_t module_impl::read( std::int32_t samplerate, std::size_t count, std::
 	}
 	apply_mixer_settings( samplerate, 1 );
 	count = read_wrapper( count, mono, 0, 0, 0 );
-	m_currentPositionSeconds += static_cast<double>( count ) / static_cast<double>( samplerate );
 	return count;
 }
 std::size_t module_impl::read( std::int32_t samplerate, std::size_t count, std::int16_t * left, std::int16_t * right ) {
@@ -542,7 +562,6 @@ std::size_t module_impl::read( std::int32_t samplerate, std::size_t count, std::
 	}
 	apply_mixer_settings( samplerate, 2 );
 	count = read_wrapper( count, left, right, 0, 0 );
-	m_currentPositionSeconds += static_cast<double>( count ) / static_cast<double>( samplerate );
 	return count;
 }
 std::size_t module_impl::read( std::int32_t samplerate, std::size_t count, std::int16_t * left, std::int16_t * right, std::int16_t * rear_left, std::int16_t * rear_right ) {
@@ -551,7 +570,6 @@ std::size_t module_impl::read( std::int32_t samplerate, std::size_t count, std::
 	}
 	apply_mixer_settings( samplerate, 4 );
 	count = read_wrapper( count, left, right, rear_left, rear_right );
-	m_currentPositionSeconds += static_cast<double>( count ) / static_cast<double>( samplerate );
 	return count;
 }
 std::size_t module_impl::read( std::int32_t samplerate, std::size_t count, float * mono ) {
@@ -560,7 +578,6 @@ std::size_t module_impl::read( std::int32_t samplerate, std::size_t count, float
 	}
 	apply_mixer_settings( samplerate, 1 );
 	count = read_wrapper( count, mono, 0, 0, 0 );
-	m_currentPositionSeconds += static_cast<double>( count ) / static_cast<double>( samplerate );
 	return count;
 }
 std::size_t module_impl::read( std::int32_t samplerate, std::size_t count, float * left, float * right ) {
@@ -569,7 +586,6 @@ std::size_t module_impl::read( std::int32_t samplerate, std::size_t count, float
 	}
 	apply_mixer_settings( samplerate, 2 );
 	count = read_wrapper( count, left, right, 0, 0 );
-	m_currentPositionSeconds += static_cast<double>( count ) / static_cast<double>( samplerate );
 	return count;
 }
 std::size_t module_impl::read( std::int32_t samplerate, std::size_t count, float * left, float * right, float * rear_left, float * rear_right ) {
@@ -578,7 +594,6 @@ std::size_t module_impl::read( std::int32_t samplerate, std::size_t count, float
 	}
 	apply_mixer_settings( samplerate, 4 );
 	count = read_wrapper( count, left, right, rear_left, rear_right );
-	m_currentPositionSeconds += static_cast<double>( count ) / static_cast<double>( samplerate );
 	return count;
 }
 std::size_t module_impl::read_interleaved_stereo( std::int32_t samplerate, std::size_t count, std::int16_t * interleaved_stereo ) {
@@ -587,7 +602,6 @@ std::size_t module_impl::read_interleaved_stereo( std::int32_t samplerate, std::
 	}
 	apply_mixer_settings( samplerate, 2 );
 	count = read_interleaved_wrapper( count, 2, interleaved_stereo );
-	m_currentPositionSeconds += static_cast<double>( count ) / static_cast<double>( samplerate );
 	return count;
 }
 std::size_t module_impl::read_interleaved_quad( std::int32_t samplerate, std::size_t count, std::int16_t * interleaved_quad ) {
@@ -596,7 +610,6 @@ std::size_t module_impl::read_interleaved_quad( std::int32_t samplerate, std::si
 	}
 	apply_mixer_settings( samplerate, 4 );
 	count = read_interleaved_wrapper( count, 4, interleaved_quad );
-	m_currentPositionSeconds += static_cast<double>( count ) / static_cast<double>( samplerate );
 	return count;
 }
 std::size_t module_impl::read_interleaved_stereo( std::int32_t samplerate, std::size_t count, float * interleaved_stereo ) {
@@ -605,7 +618,6 @@ std::size_t module_impl::read_interleaved_stereo( std::int32_t samplerate, std::
 	}
 	apply_mixer_settings( samplerate, 2 );
 	count = read_interleaved_wrapper( count, 2, interleaved_stereo );
-	m_currentPositionSeconds += static_cast<double>( count ) / static_cast<double>( samplerate );
 	return count;
 }
 std::size_t module_impl::read_interleaved_quad( std::int32_t samplerate, std::size_t count, float * interleaved_quad ) {
@@ -614,7 +626,6 @@ std::size_t module_impl::read_interleaved_quad( std::int32_t samplerate, std::si
 	}
 	apply_mixer_settings( samplerate, 4 );
 	count = read_interleaved_wrapper( count, 4, interleaved_quad );
-	m_currentPositionSeconds += static_cast<double>( count ) / static_cast<double>( samplerate );
 	return count;
 }
 
@@ -1066,9 +1077,48 @@ std::string module_impl::highlight_pattern_row_channel( std::int32_t p, std::int
 	return format_and_highlight_pattern_row_channel( p, r, c, width, pad ).second;
 }
 
+// Built-in DSP effects that can be switched on and off with a ctl, 0 if unknown.
+static DWORD ctl_to_dspflag( const std::string & ctl ) {
+	if ( ctl == "dsp.reverb" ) {
+		return SNDDSP_REVERB;
+	} else if ( ctl == "dsp.megabass" ) {
+		return SNDDSP_MEGABASS;
+	} else if ( ctl == "dsp.surround" ) {
+		return SNDDSP_SURROUND;
+	} else if ( ctl == "dsp.noisereduction" ) {
+		return SNDDSP_NOISEREDUCTION;
+	} else if ( ctl == "dsp.eq" ) {
+		return SNDDSP_EQ;
+	} else if ( ctl == "dsp.agc" ) {
+		return SNDDSP_AGC;
+	}
+	return 0;
+}
+
+// Band of a "dsp.eq.gain.N" ctl, -1 if it isn't one.
+static int ctl_to_eqband( const std::string & ctl ) {
+	const std::string prefix = "dsp.eq.gain.";
+	if ( ctl.size() != prefix.size() + 1 || ctl.compare( 0, prefix.size(), prefix ) != 0 ) {
+		return -1;
+	}
+	int band = ctl[prefix.size()] - '0';
+	return ( band >= 0 && band < MAX_EQ_BANDS ) ? band : -1;
+}
+
 std::vector<std::string> module_impl::get_ctls() const {
 	std::vector<std::string> retval;
 	retval.push_back( "dither" );
+	retval.push_back( "dsp.reverb" );
+	retval.push_back( "dsp.reverb.type" );
+	retval.push_back( "dsp.reverb.depth" );
+	retval.push_back( "dsp.megabass" );
+	retval.push_back( "dsp.surround" );
+	retval.push_back( "dsp.noisereduction" );
+	retval.push_back( "dsp.eq" );
+	for ( int band = 0; band < MAX_EQ_BANDS; band++ ) {
+		retval.push_back( "dsp.eq.gain." + mpt::ToString( band ) );
+	}
+	retval.push_back( "dsp.agc" );
 	return retval;
 }
 std::string module_impl::ctl_get( const std::string & ctl ) const {
@@ -1076,6 +1126,16 @@ std::string module_impl::ctl_get( const std::string & ctl ) const {
 		throw openmpt::exception("unknown ctl");
 	} else if ( ctl == "dither" ) {
 		return mpt::ToString( static_cast<int>( m_Dither->GetMode() ) );
+	} else if ( ctl == "dsp.reverb.type" ) {
+		return mpt::ToString( m_sndFile->m_Reverb.m_Settings.m_nReverbType );
+	} else if ( ctl == "dsp.reverb.depth" ) {
+		return mpt::ToString( m_sndFile->m_Reverb.m_Settings.m_nReverbDepth );
+	} else if ( ctl_to_eqband( ctl ) >= 0 ) {
+		UINT gains[MAX_EQ_BANDS];
+		m_sndFile->m_EQ.GetEQGains( gains );
+		return mpt::ToString( gains[ctl_to_eqband( ctl )] );
+	} else if ( ctl_to_dspflag( ctl ) ) {
+		return ( m_sndFile->m_MixerSettings.DSPMask & ctl_to_dspflag( ctl ) ) ? "1" : "0";
 	} else {
 		throw openmpt::exception("unknown ctl");
 	}
@@ -1085,14 +1145,42 @@ void module_impl::ctl_set( const std::string & ctl, const std::string & value )
 		throw openmpt::exception("unknown ctl: " + ctl + " := " + value);
 	} else if ( ctl == "dither" ) {
 		m_Dither->SetMode( static_cast<DitherMode>( ConvertStrTo<int>( value ) ) );
+	} else if ( ctl == "dsp.reverb.type" ) {
+		int type = ConvertStrTo<int>( value );
+		if ( type < 0 || type >= NUM_REVERBTYPES ) {
+			throw openmpt::exception("invalid reverb type: " + value);
+		}
+		m_sndFile->m_Reverb.m_Settings.m_nReverbType = type;
+	} else if ( ctl == "dsp.reverb.depth" ) {
+		int depth = ConvertStrTo<int>( value );
+		if ( depth < 0 || depth > 16 ) {
+			throw openmpt::exception("invalid reverb depth: " + value);
+		}
+		m_sndFile->m_Reverb.m_Settings.m_nReverbDepth = depth;
+	} else if ( ctl_to_eqband( ctl ) >= 0 ) {
+		int gain = ConvertStrTo<int>( value );
+		if ( gain < 0 || gain > EQ_GAIN_MAX ) {
+			throw openmpt::exception("invalid eq gain: " + value);
+		}
+		UINT gains[MAX_EQ_BANDS];
+		m_sndFile->m_EQ.GetEQGains( gains );
+		gains[ctl_to_eqband( ctl )] = gain;
+		m_sndFile->SetEQGains( gains, MAX_EQ_BANDS );
+	} else if ( ctl_to_dspflag( ctl ) ) {
+		DWORD mask = m_sndFile->m_MixerSettings.DSPMask;
+		if ( ConvertStrTo<int>( value ) ) {
+			mask |= ctl_to_dspflag( ctl );
+		} else {
+			mask &= ~ctl_to_dspflag( ctl );
+		}
+		m_sndFile->SetDspEffects( mask );
 	} else {
 		throw openmpt::exception("unknown ctl: " + ctl + " := " + value);
 	}
 }
 
-void module_impl::set_mod_stream(ModStream* modStream) {
-	this->modStream = modStream;
-	m_sndFile->modStream = modStream;
+void module_impl::set_sound_hooks(ISoundHooks* hooks) {
+	m_sndFile->SetSoundHooks(hooks);
 }
 
  void module_impl::fade_channel(std::uint32_t msec, std::int32_t channel, double destination_amp) {
@@ -1106,15 +1194,127 @@ void module_impl::set_mod_stream(ModStream* modStream) {
             continue;
         }
 
+        // The mixer takes it from here, starting with the next tick.
         ModChannel* c = &m_sndFile->Chn[i];
-        c->fade_total_samples = (msec / 1000.0) * m_sndFile->GetSampleRate();
-        c->fade_count = 0;
-        c->starting_amplitude = c->current_amplitude;
-        c->destination_amplitude = destination_amp;
-
-        // And awaaaaay we go!
-        c->fade_in_progress = true;
+        c->fadeTarget = destination_amp;
+        c->fadeSamplesLeft = static_cast<uint32>( (msec / 1000.0) * m_sndFile->GetSampleRate() );
+        if (c->fadeSamplesLeft == 0) {
+            c->fadeGain = destination_amp;
+        }
      }
  }
 
+static bool is_valid_override_channel( std::int32_t channel ) {
+	return channel >= 0 && channel < MAX_CHANNELS;
+}
+
+void module_impl::set_channel_enabled( std::int32_t channel, bool enabled ) {
+	if ( !is_valid_override_channel( channel ) ) {
+		throw openmpt::exception("invalid channel");
+	}
+	m_sndFile->SetChannelEnabled( static_cast<CHANNELINDEX>( channel ), enabled );
+}
+bool module_impl::get_channel_enabled( std::int32_t channel ) const {
+	if ( !is_valid_override_channel( channel ) ) {
+		return false;
+	}
+	return m_sndFile->IsChannelEnabled( static_cast<CHANNELINDEX>( channel ) );
+}
+void module_impl::set_channel_transposition( std::int32_t channel, std::int32_t semitones ) {
+	if ( !is_valid_override_channel( channel ) ) {
+		throw openmpt::exception("invalid channel");
+	}
+	m_sndFile->SetChannelTranspose( static_cast<CHANNELINDEX>( channel ), semitones );
+}
+std::int32_t module_impl::get_channel_transposition( std::int32_t channel ) const {
+	if ( !is_valid_override_channel( channel ) ) {
+		return 0;
+	}
+	return m_sndFile->GetChannelTranspose( static_cast<CHANNELINDEX>( channel ) );
+}
+void module_impl::set_channel_effect_enabled( std::int32_t channel, int effect_command, bool enabled ) {
+	if ( !is_valid_override_channel( channel ) || effect_command < 0 || effect_command >= MAX_EFFECTS ) {
+		throw openmpt::exception("invalid channel or effect command");
+	}
+	m_sndFile->SetChannelEffectEnabled( static_cast<CHANNELINDEX>( channel ), effect_command, enabled );
+}
+bool module_impl::get_channel_effect_enabled( std::int32_t channel, int effect_command ) const {
+	if ( !is_valid_override_channel( channel ) || effect_command < 0 || effect_command >= MAX_EFFECTS ) {
+		return false;
+	}
+	return m_sndFile->IsChannelEffectEnabled( static_cast<CHANNELINDEX>( channel ), effect_command );
+}
+void module_impl::set_channel_volume_command_enabled( std::int32_t channel, int volume_command, bool enabled ) {
+	if ( !is_valid_override_channel( channel ) || volume_command < 0 || volume_command >= MAX_VOLCMDS ) {
+		throw openmpt::exception("invalid channel or volume command");
+	}
+	m_sndFile->SetChannelVolCmdEnabled( static_cast<CHANNELINDEX>( channel ), volume_command, enabled );
+}
+bool module_impl::get_channel_volume_command_enabled( std::int32_t channel, int volume_command ) const {
+	if ( !is_valid_override_channel( channel ) || volume_command < 0 || volume_command >= MAX_VOLCMDS ) {
+		return false;
+	}
+	return m_sndFile->IsChannelVolCmdEnabled( static_cast<CHANNELINDEX>( channel ), volume_command );
+}
+
+void module_impl::set_tempo_factor( double factor, std::int32_t ramp_frames ) {
+	if ( !( factor > 0.0 ) || ramp_frames < 0 ) {
+		throw openmpt::exception("invalid tempo factor");
+	}
+	m_sndFile->SetTempoMultiplier( factor, static_cast<uint32>( ramp_frames ) );
+}
+double module_impl::get_tempo_factor() const {
+	return m_sndFile->GetTempoMultiplier();
+}
+void module_impl::set_pitch_factor( double factor, std::int32_t ramp_frames ) {
+	if ( !( factor > 0.0 ) || ramp_frames < 0 ) {
+		throw openmpt::exception("invalid pitch factor");
+	}
+	m_sndFile->SetPitchMultiplier( factor, static_cast<uint32>( ramp_frames ) );
+}
+double module_impl::get_pitch_factor() const {
+	return m_sndFile->GetPitchMultiplier();
+}
+void module_impl::get_render_times( double & row_seconds, double & mix_seconds ) const {
+	m_sndFile->GetRenderTimes( row_seconds, mix_seconds );
+}
+void module_impl::set_gain( float gain ) {
+	m_Gain = gain;
+}
+float module_impl::get_gain() const {
+	return m_Gain;
+}
+
+void module_impl::build_seek_cache( std::int32_t samplerate ) {
+	if ( samplerate <= 0 ) {
+		throw openmpt::exception("invalid samplerate");
+	}
+	m_sndFile->BuildSeekSnapshots( static_cast<uint32>( samplerate ) );
+}
+
+bool module_impl::get_timeline( double start, double end, std::vector<module::timeline_event> & events ) const {
+	std::vector<NoteTimelineEvent> notes;
+	const uint32 samplerate = m_sndFile->GetNoteTimeline( start, end, notes );
+	if ( samplerate == 0 ) {
+		return false;
+	}
+	events.reserve( events.size() + notes.size() );
+	for ( std::vector<NoteTimelineEvent>::const_iterator note = notes.begin(); note != notes.end(); ++note ) {
+		module::timeline_event event;
+		event.seconds = static_cast<double>( note->samplePos ) / samplerate;
+		event.frame = note->samplePos;
+		event.order = note->order;
+		event.row = note->row;
+		event.channel = note->channel;
+		event.note = note->note;
+		event.instrument = note->instr;
+		event.volume_command = note->volcmd;
+		event.volume = note->vol;
+		event.effect_command = note->command;
+		event.effect_param = note->param;
+		events.push_back( event );
+	}
+	return true;
+}
+
 } // namespace openmpt
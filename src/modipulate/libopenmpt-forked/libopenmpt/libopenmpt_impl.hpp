@@ -85,6 +85,7 @@ public:
 	module_impl( const std::uint8_t * data, std::size_t size, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
 	module_impl( const char * data, std::size_t size, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
 	module_impl( const void * data, std::size_t size, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
+	module_impl( const std::string & filename, std::shared_ptr<log_interface> log, const std::map< std::string, std::string > & ctls );
 	~module_impl();
 public:
 	void select_subsong( std::int32_t subsong );
@@ -146,10 +147,25 @@ public:
 	// YEAH, MODIPULATE BITCH! </jessePinkman>
 	//
 public:
-	void set_mod_stream(ModStream* modStream);
+	void set_sound_hooks(ISoundHooks* hooks);
     void fade_channel(std::uint32_t msec, std::int32_t channel, double destination_amp);
-private:
-	ModStream* modStream;
+	void set_channel_enabled(std::int32_t channel, bool enabled);
+	bool get_channel_enabled(std::int32_t channel) const;
+	void set_channel_transposition(std::int32_t channel, std::int32_t semitones);
+	std::int32_t get_channel_transposition(std::int32_t channel) const;
+	void set_channel_effect_enabled(std::int32_t channel, int effect_command, bool enabled);
+	bool get_channel_effect_enabled(std::int32_t channel, int effect_command) const;
+	void set_channel_volume_command_enabled(std::int32_t channel, int volume_command, bool enabled);
+	bool get_channel_volume_command_enabled(std::int32_t channel, int volume_command) const;
+	void set_tempo_factor(double factor, std::int32_t ramp_frames);
+	double get_tempo_factor() const;
+	void set_pitch_factor(double factor, std::int32_t ramp_frames);
+	double get_pitch_factor() const;
+	void get_render_times( double & row_seconds, double & mix_seconds ) const;
+	void set_gain( float gain );
+	float get_gain() const;
+	void build_seek_cache(std::int32_t samplerate);
+	bool get_timeline(double start, double end, std::vector<module::timeline_event> & events) const;
 
 
 
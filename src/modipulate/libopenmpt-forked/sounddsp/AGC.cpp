@@ -0,0 +1,108 @@
+/*
+ * AGC.cpp
+ * -------
+ * Purpose: Automatic Gain Control
+ * Notes  : The gain is lowered immediately when the mix would clip, and recovers slowly
+ *          (one step every few milliseconds) while it doesn't.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+
+#ifndef NO_AGC
+#include "AGC.h"
+
+
+#define AGC_PRECISION		10
+#define AGC_UNITY			(1 << AGC_PRECISION)
+
+// Peak level the gain is brought down to
+#ifdef MPT_INTMIXER
+static const mixsample_t AGC_CLIPMAX = MIXING_CLIPMAX;
+#else
+static const mixsample_t AGC_CLIPMAX = 1.0f;
+#endif
+
+
+// Applies the gain to a buffer and returns its new peak value.
+static mixsample_t ApplyAGC(mixsample_t *pBuffer, UINT nSamples, UINT nAGC)
+//--------------------------------------------------------------------------
+{
+	mixsample_t peak = 0;
+	for(UINT i = 0; i < nSamples; i++)
+	{
+#ifdef MPT_INTMIXER
+		const mixsample_t v = static_cast<mixsample_t>((static_cast<int64>(pBuffer[i]) * nAGC) >> AGC_PRECISION);
+#else
+		const mixsample_t v = pBuffer[i] * (nAGC * (1.0f / AGC_UNITY));
+#endif
+		pBuffer[i] = v;
+		const mixsample_t a = (v < 0) ? -v : v;
+		if(a > peak) peak = a;
+	}
+	return peak;
+}
+
+
+CAGC::CAGC()
+//----------
+{
+	Initialize(TRUE, 44100);
+}
+
+
+void CAGC::Initialize(BOOL bReset, DWORD MixingFreq)
+//--------------------------------------------------
+{
+	if(bReset)
+	{
+		m_nAGC = AGC_UNITY;
+		m_nAGCRecoverCount = 0;
+	}
+	// Recovering from half gain takes about two seconds.
+	m_Timeout = std::max<UINT>(MixingFreq >> (AGC_PRECISION - 2), 1);
+}
+
+
+void CAGC::Process(mixsample_t *MixSoundBuffer, mixsample_t *RearSoundBuffer, UINT count, UINT nChannels)
+//-------------------------------------------------------------------------------------------------------
+{
+	mixsample_t peak = ApplyAGC(MixSoundBuffer, count * std::min<UINT>(nChannels, 2), m_nAGC);
+	if(nChannels >= 4)
+	{
+		peak = std::max(peak, ApplyAGC(RearSoundBuffer, count * 2, m_nAGC));
+	}
+
+	if(peak > AGC_CLIPMAX)
+	{
+		// Bring the gain down so that this buffer's peak would have been just below clipping.
+#ifdef MPT_INTMIXER
+		const UINT newAGC = static_cast<UINT>((static_cast<uint64>(m_nAGC) * AGC_CLIPMAX) / static_cast<uint64>(peak));
+#else
+		const UINT newAGC = static_cast<UINT>(m_nAGC * AGC_CLIPMAX / peak);
+#endif
+		m_nAGC = std::max<UINT>(newAGC, 1);
+		m_nAGCRecoverCount = 0;
+	} else if(m_nAGC < AGC_UNITY)
+	{
+		m_nAGCRecoverCount += count;
+		if(m_nAGCRecoverCount >= m_Timeout)
+		{
+			m_nAGC += static_cast<UINT>(m_nAGCRecoverCount / m_Timeout);
+			m_nAGCRecoverCount %= m_Timeout;
+			if(m_nAGC > AGC_UNITY) m_nAGC = AGC_UNITY;
+		}
+	}
+}
+
+
+void CAGC::Adjust(UINT oldVol, UINT newVol)
+//-----------------------------------------
+{
+	if(!oldVol || !newVol) return;
+	m_nAGC = std::min<UINT>(static_cast<UINT>((static_cast<uint64>(m_nAGC) * oldVol) / newVol), AGC_UNITY);
+}
+
+#endif // NO_AGC
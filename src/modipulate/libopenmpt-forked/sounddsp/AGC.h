@@ -0,0 +1,35 @@
+/*
+ * AGC.h
+ * -----
+ * Purpose: Automatic Gain Control
+ * Notes  : Portable C++ implementation, does not need x86 inline assembly.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#ifndef NO_AGC
+
+#include "../soundlib/Mixer.h"
+
+
+//========
+class CAGC
+//========
+{
+private:
+	UINT m_nAGC;				// Current gain, AGC_UNITY = 0dB
+	std::size_t m_nAGCRecoverCount;
+	UINT m_Timeout;				// Samples between two gain recovery steps
+public:
+	CAGC();
+	void Initialize(BOOL bReset, DWORD MixingFreq);
+public:
+	void Process(mixsample_t *MixSoundBuffer, mixsample_t *RearSoundBuffer, UINT count, UINT nChannels);
+	// Keep the output level when the pre-amp is lowered from oldVol to newVol.
+	void Adjust(UINT oldVol, UINT newVol);
+};
+
+#endif // NO_AGC
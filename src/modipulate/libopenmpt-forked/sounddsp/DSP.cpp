@@ -0,0 +1,249 @@
+/*
+ * DSP.cpp
+ * -------
+ * Purpose: Mixing code for various DSPs (EQ, Mega-Bass, ...)
+ * Notes  : Mega-Bass adds a band-limited copy of the bass to both channels.
+ *          Surround feeds a delayed, band-limited copy of the side (L-R) signal to the
+ *          rear channels, or out of phase to the front channels in stereo mode.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+
+#ifndef NO_DSP
+#include "DSP.h"
+#include "../soundlib/Sndfile.h"
+#include <cmath>
+
+
+// Feedback coefficient of a one-pole low-pass with the given cutoff frequency.
+static float OnePoleLowpass(float cutoff, DWORD MixingFreq)
+//---------------------------------------------------------
+{
+	return std::exp(-2.0f * 3.14159265358979f * cutoff / MixingFreq);
+}
+
+
+// Surround band limits
+#define SURROUND_LOWCUT		100.0f
+#define SURROUND_HIGHCUT	7000.0f
+// Mega-Bass DC blocker
+#define XBASS_LOWCUT		20.0f
+
+
+CDSPSettings::CDSPSettings()
+//--------------------------
+{
+	m_nXBassDepth = 50;
+	m_nXBassRange = 100;
+	m_nProLogicDepth = 12;
+	m_nProLogicDelay = 20;
+}
+
+
+CDSP::CDSP()
+//----------
+{
+	m_nMixingFreq = 0;
+	nDspNoiseReductionL = nDspNoiseReductionR = 0;
+	m_fXBassCoef = m_fXBassDCCoef = m_fXBassGain = 0.0f;
+	m_fXBassState[0] = m_fXBassState[1] = m_fXBassDCState = 0.0f;
+	m_nSurroundPos = m_nSurroundDelay = 0;
+	m_fSurroundLPCoef = m_fSurroundHPCoef = m_fSurroundGain = 0.0f;
+	m_fSurroundLPState = m_fSurroundHPState = 0.0f;
+}
+
+
+void CDSP::Initialize(BOOL bReset, DWORD MixingFreq, DWORD DSPMask)
+//-----------------------------------------------------------------
+{
+	MPT_UNREFERENCED_PARAMETER(DSPMask);
+	if(!MixingFreq) return;
+
+	Limit(m_Settings.m_nXBassDepth, 0u, 100u);
+	Limit(m_Settings.m_nXBassRange, 10u, 200u);
+	Limit(m_Settings.m_nProLogicDepth, 0u, 16u);
+	Limit(m_Settings.m_nProLogicDelay, 5u, 50u);
+
+	// Buffer for the longest possible delay, so changing the settings never reallocates during playback.
+	if(MixingFreq != m_nMixingFreq)
+	{
+		m_nMixingFreq = MixingFreq;
+		m_SurroundBuffer.assign(Util::muldiv(50, MixingFreq, 1000) + 1, 0.0f);
+		m_nSurroundPos = 0;
+	}
+	m_nSurroundDelay = std::max<uint32>(Util::muldiv(m_Settings.m_nProLogicDelay, MixingFreq, 1000), 1);
+	m_fSurroundLPCoef = OnePoleLowpass(SURROUND_HIGHCUT, MixingFreq);
+	m_fSurroundHPCoef = OnePoleLowpass(SURROUND_LOWCUT, MixingFreq);
+	m_fSurroundGain = m_Settings.m_nProLogicDepth / 16.0f;
+
+	m_fXBassCoef = OnePoleLowpass(static_cast<float>(m_Settings.m_nXBassRange), MixingFreq);
+	m_fXBassDCCoef = OnePoleLowpass(XBASS_LOWCUT, MixingFreq);
+	// Up to +9.5dB at full depth
+	m_fXBassGain = m_Settings.m_nXBassDepth / 50.0f;
+
+	if(bReset)
+	{
+		nDspNoiseReductionL = nDspNoiseReductionR = 0;
+		m_fXBassState[0] = m_fXBassState[1] = m_fXBassDCState = 0.0f;
+		std::fill(m_SurroundBuffer.begin(), m_SurroundBuffer.end(), 0.0f);
+		m_nSurroundPos = 0;
+		m_fSurroundLPState = m_fSurroundHPState = 0.0f;
+	}
+}
+
+
+// Writes a side sampling point into the delay line, and returns the delayed, band-limited side sampling point.
+forceinline float CDSP::SurroundSample(float side)
+//------------------------------------------------
+{
+	const uint32 size = static_cast<uint32>(m_SurroundBuffer.size());
+	uint32 readPos = m_nSurroundPos + size - m_nSurroundDelay;
+	if(readPos >= size) readPos -= size;
+	const float delayed = m_SurroundBuffer[readPos];
+	m_SurroundBuffer[m_nSurroundPos] = side;
+	if(++m_nSurroundPos >= size) m_nSurroundPos = 0;
+
+	m_fSurroundLPState = delayed + m_fSurroundLPCoef * (m_fSurroundLPState - delayed);
+	m_fSurroundHPState = m_fSurroundLPState + m_fSurroundHPCoef * (m_fSurroundHPState - m_fSurroundLPState);
+	return (m_fSurroundLPState - m_fSurroundHPState) * m_fSurroundGain;
+}
+
+
+void CDSP::ProcessStereoSurround(mixsample_t *MixSoundBuffer, int count)
+//----------------------------------------------------------------------
+{
+	for(int i = 0; i < count; i++, MixSoundBuffer += 2)
+	{
+		const float side = (static_cast<float>(MixSoundBuffer[0]) - static_cast<float>(MixSoundBuffer[1])) * 0.5f;
+		const mixsample_t v = static_cast<mixsample_t>(SurroundSample(side));
+		MixSoundBuffer[0] += v;
+		MixSoundBuffer[1] -= v;
+	}
+}
+
+
+void CDSP::ProcessQuadSurround(mixsample_t *MixSoundBuffer, mixsample_t *MixRearBuffer, int count)
+//------------------------------------------------------------------------------------------------
+{
+	for(int i = 0; i < count; i++, MixSoundBuffer += 2, MixRearBuffer += 2)
+	{
+		const float side = (static_cast<float>(MixSoundBuffer[0]) - static_cast<float>(MixSoundBuffer[1])) * 0.5f;
+		const mixsample_t v = static_cast<mixsample_t>(SurroundSample(side));
+		MixRearBuffer[0] += v;
+		MixRearBuffer[1] -= v;
+	}
+}
+
+
+// Returns the boosted bass of a mono sampling point.
+forceinline mixsample_t CDSP::MegaBassSample(float mono)
+//------------------------------------------------------
+{
+	// Two-pole low-pass for the bass, minus a one-pole low-pass so that DC isn't boosted.
+	m_fXBassState[0] = mono + m_fXBassCoef * (m_fXBassState[0] - mono);
+	m_fXBassState[1] = m_fXBassState[0] + m_fXBassCoef * (m_fXBassState[1] - m_fXBassState[0]);
+	m_fXBassDCState = m_fXBassState[1] + m_fXBassDCCoef * (m_fXBassDCState - m_fXBassState[1]);
+	return static_cast<mixsample_t>((m_fXBassState[1] - m_fXBassDCState) * m_fXBassGain);
+}
+
+
+void CDSP::ProcessMonoMegaBass(mixsample_t *MixSoundBuffer, int count)
+//--------------------------------------------------------------------
+{
+	for(int i = 0; i < count; i++)
+	{
+		MixSoundBuffer[i] += MegaBassSample(static_cast<float>(MixSoundBuffer[i]));
+	}
+}
+
+
+void CDSP::ProcessStereoMegaBass(mixsample_t *MixSoundBuffer, int count)
+//----------------------------------------------------------------------
+{
+	for(int i = 0; i < count; i++, MixSoundBuffer += 2)
+	{
+		const mixsample_t bass = MegaBassSample((static_cast<float>(MixSoundBuffer[0]) + static_cast<float>(MixSoundBuffer[1])) * 0.5f);
+		MixSoundBuffer[0] += bass;
+		MixSoundBuffer[1] += bass;
+	}
+}
+
+
+// Halves a mix sampling point.
+static forceinline mixsample_t HalfSample(mixsample_t v)
+//------------------------------------------------------
+{
+#ifdef MPT_INTMIXER
+	return v >> 1;
+#else
+	return v * 0.5f;
+#endif
+}
+
+
+void CDSP::ProcessMonoNoiseReduction(mixsample_t *MixSoundBuffer, int count)
+//--------------------------------------------------------------------------
+{
+	mixsample_t n1 = nDspNoiseReductionL;
+	for(int i = 0; i < count; i++)
+	{
+		const mixsample_t v = MixSoundBuffer[i];
+		MixSoundBuffer[i] = HalfSample(v) + HalfSample(n1);
+		n1 = v;
+	}
+	nDspNoiseReductionL = n1;
+}
+
+
+void CDSP::ProcessStereoNoiseReduction(mixsample_t *MixSoundBuffer, int count)
+//----------------------------------------------------------------------------
+{
+	mixsample_t n1 = nDspNoiseReductionL, n2 = nDspNoiseReductionR;
+	for(int i = 0; i < count; i++, MixSoundBuffer += 2)
+	{
+		const mixsample_t l = MixSoundBuffer[0], r = MixSoundBuffer[1];
+		MixSoundBuffer[0] = HalfSample(l) + HalfSample(n1);
+		MixSoundBuffer[1] = HalfSample(r) + HalfSample(n2);
+		n1 = l;
+		n2 = r;
+	}
+	nDspNoiseReductionL = n1;
+	nDspNoiseReductionR = n2;
+}
+
+
+void CDSP::Process(mixsample_t *MixSoundBuffer, mixsample_t *MixRearBuffer, int count, UINT nChannels, UINT DSPMask)
+//------------------------------------------------------------------------------------------------------------------
+{
+	if(!m_nMixingFreq || count <= 0) return;
+
+	if(DSPMask & SNDDSP_SURROUND)
+	{
+		if(nChannels >= 4)
+			ProcessQuadSurround(MixSoundBuffer, MixRearBuffer, count);
+		else if(nChannels == 2)
+			ProcessStereoSurround(MixSoundBuffer, count);
+	}
+
+	// In quad mode, the rear channels are still in a separate buffer at this point.
+	if(DSPMask & SNDDSP_MEGABASS)
+	{
+		if(nChannels == 1)
+			ProcessMonoMegaBass(MixSoundBuffer, count);
+		else
+			ProcessStereoMegaBass(MixSoundBuffer, count);
+	}
+
+	if(DSPMask & SNDDSP_NOISEREDUCTION)
+	{
+		if(nChannels == 1)
+			ProcessMonoNoiseReduction(MixSoundBuffer, count);
+		else
+			ProcessStereoNoiseReduction(MixSoundBuffer, count);
+	}
+}
+
+#endif // NO_DSP
@@ -0,0 +1,72 @@
+/*
+ * DSP.h
+ * -----
+ * Purpose: Mixing code for various DSPs (EQ, Mega-Bass, ...)
+ * Notes  : Portable C++ implementation, does not need x86 inline assembly.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#ifndef NO_DSP
+
+#include "../soundlib/Mixer.h"
+#include <vector>
+
+
+//==============
+class CDSPSettings
+//==============
+{
+public:
+	UINT m_nXBassDepth;		// Mega-Bass amount, 0...100 %
+	UINT m_nXBassRange;		// Mega-Bass cutoff, 10...200 Hz
+	UINT m_nProLogicDepth;	// Surround level, 0...16
+	UINT m_nProLogicDelay;	// Surround delay, 5...50 ms
+public:
+	CDSPSettings();
+};
+
+
+//========
+class CDSP
+//========
+{
+public:
+	CDSPSettings m_Settings;
+
+private:
+	DWORD m_nMixingFreq;
+
+	// Noise reduction: previous sampling point of each channel
+	mixsample_t nDspNoiseReductionL, nDspNoiseReductionR;
+
+	// Mega-Bass: low-pass at the bass range minus a low-pass at DC blocker frequency
+	float m_fXBassCoef, m_fXBassDCCoef, m_fXBassGain;
+	float m_fXBassState[2], m_fXBassDCState;
+
+	// Surround: delayed side signal, band-limited
+	std::vector<float> m_SurroundBuffer;
+	uint32 m_nSurroundPos, m_nSurroundDelay;
+	float m_fSurroundLPCoef, m_fSurroundHPCoef, m_fSurroundGain;
+	float m_fSurroundLPState, m_fSurroundHPState;
+
+public:
+	CDSP();
+	void Initialize(BOOL bReset, DWORD MixingFreq, DWORD DSPMask);
+	void Process(mixsample_t *MixSoundBuffer, mixsample_t *MixRearBuffer, int count, UINT nChannels, UINT DSPMask);
+
+private:
+	void ProcessStereoSurround(mixsample_t *MixSoundBuffer, int count);
+	void ProcessQuadSurround(mixsample_t *MixSoundBuffer, mixsample_t *MixRearBuffer, int count);
+	void ProcessMonoMegaBass(mixsample_t *MixSoundBuffer, int count);
+	void ProcessStereoMegaBass(mixsample_t *MixSoundBuffer, int count);
+	void ProcessMonoNoiseReduction(mixsample_t *MixSoundBuffer, int count);
+	void ProcessStereoNoiseReduction(mixsample_t *MixSoundBuffer, int count);
+	forceinline mixsample_t MegaBassSample(float mono);
+	forceinline float SurroundSample(float side);
+};
+
+#endif // NO_DSP
@@ -0,0 +1,166 @@
+/*
+ * EQ.cpp
+ * ------
+ * Purpose: Mixing code for equalizer.
+ * Notes  : Each band is a peaking biquad (see the RBJ audio EQ cookbook).
+ *          Bands at unity gain are skipped.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+
+#ifndef NO_EQ
+#include "EQ.h"
+#include "../common/misc_util.h"
+#include <cmath>
+
+
+// Bandwidth of each band
+#define EQ_Q	1.2f
+
+static const UINT gEQDefaultFreqs[MAX_EQ_BANDS] = { 120, 500, 1200, 3000, 6000, 10000 };
+
+
+CQuadEQ::CQuadEQ()
+//----------------
+{
+	m_nMixingFreq = 0;
+	for(UINT b = 0; b < MAX_EQ_BANDS; b++)
+	{
+		EQBand &band = m_Bands[b];
+		band.b0 = 1.0f;
+		band.b1 = band.b2 = band.a1 = band.a2 = 0.0f;
+		band.Gain = 1.0f;
+		band.CenterFrequency = static_cast<float>(gEQDefaultFreqs[b]);
+		band.Enabled = false;
+		m_Gains[b] = EQ_GAIN_UNITY;
+	}
+	MemsetZero(m_State);
+}
+
+
+void CQuadEQ::UpdateCoefficients()
+//--------------------------------
+{
+	if(!m_nMixingFreq) return;
+	for(UINT b = 0; b < MAX_EQ_BANDS; b++)
+	{
+		EQBand &band = m_Bands[b];
+		const float freq = std::min(band.CenterFrequency, m_nMixingFreq * 0.45f);
+		const float A = std::sqrt(band.Gain);
+		const float w0 = 2.0f * 3.14159265358979f * freq / m_nMixingFreq;
+		const float alpha = std::sin(w0) / (2.0f * EQ_Q);
+		const float cosw0 = std::cos(w0);
+		const float a0 = 1.0f + alpha / A;
+		band.b0 = (1.0f + alpha * A) / a0;
+		band.b1 = (-2.0f * cosw0) / a0;
+		band.b2 = (1.0f - alpha * A) / a0;
+		band.a1 = (-2.0f * cosw0) / a0;
+		band.a2 = (1.0f - alpha / A) / a0;
+	}
+}
+
+
+void CQuadEQ::Initialize(BOOL bReset, DWORD MixingFreq)
+//-----------------------------------------------------
+{
+	if(MixingFreq != m_nMixingFreq)
+	{
+		m_nMixingFreq = MixingFreq;
+		UpdateCoefficients();
+	}
+	if(bReset)
+	{
+		MemsetZero(m_State);
+	}
+}
+
+
+void CQuadEQ::SetEQGains(const UINT *pGains, UINT nBands, const UINT *pFreqs, BOOL bReset, DWORD MixingFreq)
+//----------------------------------------------------------------------------------------------------------
+{
+	if(nBands > MAX_EQ_BANDS) nBands = MAX_EQ_BANDS;
+	for(UINT b = 0; b < nBands; b++)
+	{
+		EQBand &band = m_Bands[b];
+		const UINT gain = std::min<UINT>(pGains[b], EQ_GAIN_MAX);
+		m_Gains[b] = gain;
+		// 0.75dB per step
+		band.Gain = std::pow(10.0f, (static_cast<int>(gain) - EQ_GAIN_UNITY) * 0.75f / 20.0f);
+		band.Enabled = (gain != EQ_GAIN_UNITY);
+		if(pFreqs != nullptr && pFreqs[b] > 0)
+		{
+			band.CenterFrequency = static_cast<float>(pFreqs[b]);
+		}
+	}
+	m_nMixingFreq = MixingFreq;
+	UpdateCoefficients();
+	if(bReset)
+	{
+		MemsetZero(m_State);
+	}
+}
+
+
+void CQuadEQ::GetEQGains(UINT *pGains) const
+//-------------------------------------------
+{
+	for(UINT b = 0; b < MAX_EQ_BANDS; b++)
+	{
+		pGains[b] = m_Gains[b];
+	}
+}
+
+
+void CQuadEQ::ProcessChannel(mixsample_t *buffer, UINT nCount, UINT stride, EQBandState *state)
+//---------------------------------------------------------------------------------------------
+{
+	for(UINT b = 0; b < MAX_EQ_BANDS; b++)
+	{
+		const EQBand &band = m_Bands[b];
+		if(!band.Enabled) continue;
+
+		EQBandState s = state[b];
+		mixsample_t *p = buffer;
+		for(UINT i = 0; i < nCount; i++, p += stride)
+		{
+			const float x = static_cast<float>(*p);
+			const float y = band.b0 * x + band.b1 * s.x1 + band.b2 * s.x2 - band.a1 * s.y1 - band.a2 * s.y2;
+			s.x2 = s.x1;
+			s.x1 = x;
+			s.y2 = s.y1;
+			s.y1 = y;
+#ifdef MPT_INTMIXER
+			*p = static_cast<mixsample_t>(Clamp(y, static_cast<float>(MIXING_CLIPMIN), static_cast<float>(MIXING_CLIPMAX)));
+#else
+			*p = y;
+#endif
+		}
+		state[b] = s;
+	}
+}
+
+
+void CQuadEQ::Process(mixsample_t *frontBuffer, mixsample_t *rearBuffer, UINT nCount, UINT nChannels)
+//---------------------------------------------------------------------------------------------------
+{
+	if(!m_nMixingFreq) return;
+
+	if(nChannels == 1)
+	{
+		ProcessChannel(frontBuffer, nCount, 1, m_State[0]);
+		return;
+	}
+
+	ProcessChannel(frontBuffer, nCount, 2, m_State[0]);
+	ProcessChannel(frontBuffer + 1, nCount, 2, m_State[1]);
+	if(nChannels >= 4)
+	{
+		ProcessChannel(rearBuffer, nCount, 2, m_State[2]);
+		ProcessChannel(rearBuffer + 1, nCount, 2, m_State[3]);
+	}
+}
+
+#endif // NO_EQ
@@ -0,0 +1,62 @@
+/*
+ * EQ.h
+ * ----
+ * Purpose: Mixing code for equalizer.
+ * Notes  : Portable C++ implementation, does not need x86 inline assembly.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#ifndef NO_EQ
+
+#include "../soundlib/Mixer.h"
+
+
+#define MAX_EQ_BANDS	6
+
+// Band gains go from 0 (-12dB) to 32 (+12dB), 16 is unity gain.
+#define EQ_GAIN_UNITY	16
+#define EQ_GAIN_MAX		32
+
+
+//===========
+class CQuadEQ
+//===========
+{
+private:
+	// Peaking filter, normalized biquad coefficients
+	struct EQBand
+	{
+		float b0, b1, b2, a1, a2;
+		float Gain;		// Linear gain at the center frequency
+		float CenterFrequency;
+		bool Enabled;	// False at unity gain
+	};
+
+	// Direct form I state of one band and one channel
+	struct EQBandState
+	{
+		float x1, x2, y1, y2;
+	};
+
+	EQBand m_Bands[MAX_EQ_BANDS];
+	UINT m_Gains[MAX_EQ_BANDS];	// As passed to SetEQGains()
+	EQBandState m_State[4][MAX_EQ_BANDS];	// Front left, front right, rear left, rear right
+	DWORD m_nMixingFreq;
+
+public:
+	CQuadEQ();
+	void Initialize(BOOL bReset, DWORD MixingFreq);
+	void Process(mixsample_t *frontBuffer, mixsample_t *rearBuffer, UINT nCount, UINT nChannels);
+	void SetEQGains(const UINT *pGains, UINT nBands, const UINT *pFreqs, BOOL bReset, DWORD MixingFreq);
+	void GetEQGains(UINT *pGains) const;
+
+private:
+	void UpdateCoefficients();
+	void ProcessChannel(mixsample_t *buffer, UINT nCount, UINT stride, EQBandState *state);
+};
+
+#endif // NO_EQ
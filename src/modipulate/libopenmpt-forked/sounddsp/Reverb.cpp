@@ -0,0 +1,362 @@
+/*
+ * Reverb.cpp
+ * ----------
+ * Purpose: Mixing code for the built-in reverb effect.
+ * Notes  : Early reflections are taken from a tapped pre-delay line, the late reverb is a
+ *          four line feedback delay network with frequency dependent decay.
+ *          Everything is done in floating point; the result is added to the integer mix.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+
+#ifndef NO_REVERB
+#include "Reverb.h"
+#include "../soundlib/Sndfile.h"
+#include "../soundlib/MixerLoops.h"
+#include <cmath>
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Presets
+
+static const SNDMIX_RVBPRESET gRvbPresets[NUM_REVERBTYPES] =
+{
+	{{ -1000,  -100, 1.49f, 0.83f, -2602, 0.007f,   200, 0.011f, 100.0f, 100.0f }, "Generic"},
+	{{ -1000, -6000, 0.17f, 0.10f, -1204, 0.001f,   207, 0.002f, 100.0f, 100.0f }, "Padded Cell"},
+	{{ -1000,  -454, 0.40f, 0.83f, -1646, 0.002f,    53, 0.003f, 100.0f, 100.0f }, "Room"},
+	{{ -1000, -1200, 1.49f, 0.54f,  -370, 0.007f,  1030, 0.011f, 100.0f,  60.0f }, "Bathroom"},
+	{{ -1000, -6000, 0.50f, 0.10f, -1376, 0.003f, -1104, 0.004f, 100.0f, 100.0f }, "Living Room"},
+	{{ -1000,  -300, 2.31f, 0.64f,  -711, 0.012f,    83, 0.017f, 100.0f, 100.0f }, "Stone Room"},
+	{{ -1000,  -476, 4.32f, 0.59f,  -789, 0.020f,  -289, 0.030f, 100.0f, 100.0f }, "Auditorium"},
+	{{ -1000,  -500, 3.92f, 0.70f, -1230, 0.020f,    -2, 0.029f, 100.0f, 100.0f }, "Concert Hall"},
+	{{ -1000,     0, 2.91f, 1.30f,  -602, 0.015f,  -302, 0.022f, 100.0f, 100.0f }, "Cave"},
+	{{ -1000,  -698, 7.24f, 0.33f, -1166, 0.020f,    16, 0.030f, 100.0f, 100.0f }, "Arena"},
+	{{ -1000, -1000,10.05f, 0.23f,  -602, 0.020f,   198, 0.030f, 100.0f, 100.0f }, "Hangar"},
+	{{ -1000, -4000, 0.30f, 0.10f, -1831, 0.002f, -1630, 0.030f, 100.0f, 100.0f }, "Carpeted Hallway"},
+	{{ -1000,  -300, 1.49f, 0.59f, -1219, 0.007f,   441, 0.011f, 100.0f, 100.0f }, "Hallway"},
+	{{ -1000,  -237, 2.70f, 0.79f, -1214, 0.013f,   395, 0.020f, 100.0f, 100.0f }, "Stone Corridor"},
+	{{ -1000,  -270, 1.49f, 0.86f, -1204, 0.007f,    -4, 0.011f, 100.0f, 100.0f }, "Alley"},
+	{{ -1000, -3300, 1.49f, 0.54f, -2560, 0.162f,  -613, 0.088f,  79.0f, 100.0f }, "Forest"},
+	{{ -1000,  -800, 1.49f, 0.67f, -2273, 0.007f, -2217, 0.011f,  50.0f, 100.0f }, "City"},
+	{{ -1000, -2500, 1.49f, 0.21f, -2780, 0.300f, -2014, 0.100f,  27.0f, 100.0f }, "Mountains"},
+	{{ -1000, -1000, 1.49f, 0.83f,-10000, 0.061f,   500, 0.025f, 100.0f, 100.0f }, "Quarry"},
+	{{ -1000, -2000, 1.49f, 0.50f, -2466, 0.179f, -2514, 0.100f,  21.0f, 100.0f }, "Plain"},
+	{{ -1000,     0, 1.65f, 1.50f, -1363, 0.008f, -1153, 0.012f, 100.0f, 100.0f }, "Parking Lot"},
+	{{ -1000, -1000, 2.81f, 0.14f,   429, 0.014f,   648, 0.021f,  80.0f,  60.0f }, "Sewer Pipe"},
+	{{ -1000, -4000, 1.49f, 0.10f,  -449, 0.007f,  1700, 0.011f, 100.0f, 100.0f }, "Underwater"},
+	{{ -1000,  -600, 1.10f, 0.83f,  -400, 0.005f,   500, 0.010f, 100.0f, 100.0f }, "Small Room"},
+	{{ -1000,  -600, 1.30f, 0.83f, -1000, 0.010f,  -200, 0.020f, 100.0f, 100.0f }, "Medium Room"},
+	{{ -1000,  -600, 1.50f, 0.83f, -1600, 0.020f, -1000, 0.040f, 100.0f, 100.0f }, "Large Room"},
+	{{ -1000,  -600, 1.80f, 0.70f, -1300, 0.015f,  -800, 0.030f, 100.0f, 100.0f }, "Medium Hall"},
+	{{ -1000,  -600, 1.80f, 0.70f, -2000, 0.030f, -1400, 0.060f, 100.0f, 100.0f }, "Large Hall"},
+	{{ -1000,  -200, 1.30f, 0.90f,     0, 0.002f,     0, 0.010f, 100.0f,  75.0f }, "Plate"},
+};
+
+
+const SNDMIX_RVBPRESET *GetReverbPreset(UINT nPreset)
+//---------------------------------------------------
+{
+	return (nPreset < NUM_REVERBTYPES) ? &gRvbPresets[nPreset] : nullptr;
+}
+
+
+const char *GetReverbPresetName(UINT nPreset)
+//-------------------------------------------
+{
+	return (nPreset < NUM_REVERBTYPES) ? gRvbPresets[nPreset].lpszName : nullptr;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// Helpers
+
+// Reference frequency of the high frequency parameters, as in I3DL2
+#define RVB_HF_REFERENCE 5000.0f
+
+// Longest possible pre-delay: flReflectionsDelay + flReverbDelay
+#define RVB_MAX_PREDELAY 0.4f
+
+static float MillibelToGain(int32 mB)
+//-----------------------------------
+{
+	return std::pow(10.0f, mB / 2000.0f);
+}
+
+
+// Feedback coefficient b of the one-pole lowpass y = (1 - b) * x + b * y,
+// so that the filter's gain at the given frequency equals gain.
+static float OnePoleCoefficient(float gain, float freq, float mixingFreq)
+//----------------------------------------------------------------------
+{
+	if(gain >= 0.9999f) return 0.0f;
+	if(gain < 0.0001f) gain = 0.0001f;
+	const float w = 2.0f * 3.14159265358979f * std::min(freq, mixingFreq * 0.49f) / mixingFreq;
+	const float g2 = gain * gain;
+	const float a = 1.0f - g2 * std::cos(w);
+	const float b = (a - std::sqrt(std::max(0.0f, a * a - (1.0f - g2) * (1.0f - g2)))) / (1.0f - g2);
+	return Clamp(b, 0.0f, 0.999f);
+}
+
+
+void CReverb::DelayLine::Resize(uint32 minLength)
+//-----------------------------------------------
+{
+	uint32 length = 1;
+	while(length < minLength + 1) length <<= 1;
+	if(length != buffer.size())
+	{
+		buffer.assign(length, 0.0f);
+		mask = length - 1;
+		pos = 0;
+	}
+}
+
+
+void CReverb::DelayLine::Clear()
+//------------------------------
+{
+	std::fill(buffer.begin(), buffer.end(), 0.0f);
+	pos = 0;
+}
+
+
+/////////////////////////////////////////////////////////////////////////////
+// CReverb
+
+CReverbSettings::CReverbSettings()
+//--------------------------------
+{
+	m_nReverbType = 0;
+	m_nReverbDepth = 8;
+}
+
+
+CReverb::CReverb()
+//----------------
+{
+	gnRvbROfsVol = gnRvbLOfsVol = 0;
+	m_nLastPreset = m_nLastMixingFreq = m_nLastDepth = 0;
+	m_nReverbSamples = 0;
+	m_nReverbSend = 0;
+	m_nTailLength = 0;
+	m_fInputState = 0.0f;
+	for(int i = 0; i < NUM_LATE_DELAYS; i++) m_fDampingState[i] = 0.0f;
+	InitMixBuffer(MixReverbBuffer, MIXBUFFERSIZE * 2);
+}
+
+
+void CReverb::Initialize(bool bReset, DWORD MixingFreq)
+//-----------------------------------------------------
+{
+	UpdateParameters(MixingFreq);
+	if(bReset)
+	{
+		Shutdown();
+	}
+}
+
+
+void CReverb::Shutdown()
+//----------------------
+{
+	gnRvbROfsVol = gnRvbLOfsVol = 0;
+	m_nReverbSamples = 0;
+	m_nReverbSend = 0;
+	m_fInputState = 0.0f;
+	m_PreDelay.Clear();
+	for(int i = 0; i < NUM_DIFFUSERS; i++) m_Diffuser[i].Clear();
+	for(int i = 0; i < NUM_LATE_DELAYS; i++)
+	{
+		m_Feedback[i].Clear();
+		m_fDampingState[i] = 0.0f;
+	}
+}
+
+
+void CReverb::UpdateParameters(DWORD MixingFreq)
+//----------------------------------------------
+{
+	if(!MixingFreq) return;
+	if(m_Settings.m_nReverbType >= NUM_REVERBTYPES) m_Settings.m_nReverbType = 0;
+	if(m_Settings.m_nReverbDepth > 16) m_Settings.m_nReverbDepth = 16;
+	m_nLastPreset = m_Settings.m_nReverbType;
+	m_nLastDepth = m_Settings.m_nReverbDepth;
+
+	const SNDMIX_REVERB_PROPERTIES &p = gRvbPresets[m_nLastPreset].Preset;
+	const float freq = static_cast<float>(MixingFreq);
+
+	static const float DiffuserTimes[NUM_DIFFUSERS] = { 0.0032f, 0.0024f };
+	static const float FeedbackTimes[NUM_LATE_DELAYS] = { 0.0297f, 0.0371f, 0.0411f, 0.0437f };
+
+	// Delay lines are sized for the longest delays of any preset, so that switching presets doesn't reallocate anything.
+	if(MixingFreq != m_nLastMixingFreq)
+	{
+		m_nLastMixingFreq = MixingFreq;
+		m_PreDelay.Resize(static_cast<uint32>(RVB_MAX_PREDELAY * freq) + 1);
+		for(int i = 0; i < NUM_DIFFUSERS; i++) m_Diffuser[i].Resize(static_cast<uint32>(DiffuserTimes[i] * freq) + 2);
+		for(int i = 0; i < NUM_LATE_DELAYS; i++) m_Feedback[i].Resize(static_cast<uint32>(FeedbackTimes[i] * freq) + 2);
+	}
+
+	const float room = MillibelToGain(p.lRoom);
+	m_fInputLowpass = OnePoleCoefficient(MillibelToGain(p.lRoomHF), RVB_HF_REFERENCE, freq);
+	// Full depth plays the preset at its nominal level.
+	m_fWetGain = m_nLastDepth / 16.0f;
+
+	// Early reflections: spread between the first reflection and the start of the late reverb,
+	// alternating between the left and right side and getting quieter over time.
+	const float reflections = room * MillibelToGain(p.lReflections) / std::sqrt(static_cast<float>(NUM_REFLECTIONS));
+	const float spread = std::max(p.flReverbDelay, 0.005f);
+	for(int i = 0; i < NUM_REFLECTIONS; i++)
+	{
+		const float t = p.flReflectionsDelay + spread * i / NUM_REFLECTIONS;
+		const float gain = reflections / (1.0f + 0.25f * i) * ((i & 2) ? -1.0f : 1.0f);
+		m_nReflectionDelay[i] = std::max(static_cast<uint32>(t * freq), 1u);
+		m_fReflectionGain[i][0] = gain * ((i & 1) ? 0.5f : 1.0f);
+		m_fReflectionGain[i][1] = gain * ((i & 1) ? 1.0f : 0.5f);
+	}
+	m_nLateDelay = std::max(static_cast<uint32>((p.flReflectionsDelay + p.flReverbDelay) * freq), 1u);
+
+	// Diffusion: allpass filters smear the input before it enters the feedback network.
+	m_fDiffusion = 0.7f * Clamp(p.flDiffusion, 0.0f, 100.0f) / 100.0f;
+	for(int i = 0; i < NUM_DIFFUSERS; i++)
+	{
+		m_nDiffuserDelay[i] = std::max(static_cast<uint32>(DiffuserTimes[i] * freq), 2u);
+	}
+
+	// Late reverb: mutually prime-ish delay lengths, shortened for lower modal densities.
+	// Each line's feedback gain is chosen so that the network decays by 60dB in flDecayTime,
+	// the damping filters make high frequencies decay in flDecayTime * flDecayHFRatio instead.
+	const float densityScale = 0.5f + Clamp(p.flDensity, 0.0f, 100.0f) / 200.0f;
+	const float decayTime = std::max(p.flDecayTime, 0.1f);
+	const float hfRatio = Clamp(p.flDecayHFRatio, 0.1f, 2.0f);
+	float feedbackEnergy = 0.0f;
+	for(int i = 0; i < NUM_LATE_DELAYS; i++)
+	{
+		const uint32 delay = std::max(static_cast<uint32>(FeedbackTimes[i] * densityScale * freq), 2u);
+		const float length = delay / freq;
+		const float gainLF = std::pow(10.0f, -3.0f * length / decayTime);
+		const float gainHF = std::pow(10.0f, -3.0f * length / (decayTime * hfRatio));
+		m_nFeedbackDelay[i] = delay;
+		m_fFeedbackGain[i] = gainLF;
+		feedbackEnergy += gainLF * gainLF / NUM_LATE_DELAYS;
+		m_fFeedbackDamping[i] = OnePoleCoefficient(gainHF / gainLF, RVB_HF_REFERENCE, freq);
+	}
+	// Normalize the network's steady-state gain, or long decays would be much louder than short ones.
+	m_fLateGain = room * MillibelToGain(p.lReverb) * 0.5f * std::sqrt(1.0f - feedbackEnergy);
+
+	m_nTailLength = static_cast<uint32>((decayTime * std::max(hfRatio, 1.0f) + RVB_MAX_PREDELAY) * freq);
+}
+
+
+mixsample_t *CReverb::GetReverbSendBuffer(UINT nSamples)
+//------------------------------------------------------
+{
+	if(!m_nReverbSend)
+	{
+		StereoFill(MixReverbBuffer, nSamples, gnRvbROfsVol, gnRvbLOfsVol);
+		m_nReverbSend = nSamples;
+	}
+	return MixReverbBuffer;
+}
+
+
+void CReverb::Process(mixsample_t *MixSoundBuffer, UINT nSamples)
+//---------------------------------------------------------------
+{
+	if(m_Settings.m_nReverbType != m_nLastPreset || m_Settings.m_nReverbDepth != m_nLastDepth)
+	{
+		UpdateParameters(m_nLastMixingFreq);
+	}
+
+	// Let the click removal offsets of the send buffer decay even if nothing is sent anymore.
+	if(!m_nReverbSend && (gnRvbROfsVol || gnRvbLOfsVol))
+	{
+		GetReverbSendBuffer(nSamples);
+	}
+
+	if(m_nReverbSend)
+	{
+		// The dry signal of the reverb channels goes straight to the main mix.
+		for(UINT i = 0; i < nSamples * 2; i++)
+		{
+			MixSoundBuffer[i] += MixReverbBuffer[i];
+		}
+		m_nReverbSamples = m_nTailLength;
+	}
+
+	if(m_nReverbSamples)
+	{
+		ProcessReverb(m_nReverbSend ? MixReverbBuffer : nullptr, MixSoundBuffer, nSamples);
+		if(m_nReverbSamples > nSamples)
+		{
+			m_nReverbSamples -= nSamples;
+		} else
+		{
+			// Fully decayed, start from silence next time.
+			Shutdown();
+		}
+	}
+	m_nReverbSend = 0;
+}
+
+
+void CReverb::ProcessReverb(const mixsample_t *input, mixsample_t *output, UINT nSamples)
+//---------------------------------------------------------------------------------------
+{
+	const float inputLowpass = m_fInputLowpass;
+	const float wetGain = m_fWetGain;
+	float inputState = m_fInputState;
+
+	for(UINT n = 0; n < nSamples; n++)
+	{
+		// Mono input, with high frequency attenuation
+		float x = input ? (static_cast<float>(input[n * 2]) + static_cast<float>(input[n * 2 + 1])) * 0.5f : 0.0f;
+		inputState = x + inputLowpass * (inputState - x);
+		m_PreDelay.Write(inputState);
+
+		// Early reflections
+		float outL = 0.0f, outR = 0.0f;
+		for(int i = 0; i < NUM_REFLECTIONS; i++)
+		{
+			const float r = m_PreDelay.Read(m_nReflectionDelay[i]);
+			outL += r * m_fReflectionGain[i][0];
+			outR += r * m_fReflectionGain[i][1];
+		}
+
+		// Diffusion allpasses
+		float late = m_PreDelay.Read(m_nLateDelay);
+		for(int i = 0; i < NUM_DIFFUSERS; i++)
+		{
+			const float delayed = m_Diffuser[i].Read(m_nDiffuserDelay[i] - 1);
+			const float w = late + m_fDiffusion * delayed;
+			late = delayed - m_fDiffusion * w;
+			m_Diffuser[i].Write(w);
+		}
+
+		// Feedback delay network with a Householder-style (Hadamard) mixing matrix
+		float tap[NUM_LATE_DELAYS], fb[NUM_LATE_DELAYS];
+		for(int i = 0; i < NUM_LATE_DELAYS; i++)
+		{
+			tap[i] = m_Feedback[i].Read(m_nFeedbackDelay[i] - 1);
+			m_fDampingState[i] = tap[i] + m_fFeedbackDamping[i] * (m_fDampingState[i] - tap[i]);
+			fb[i] = m_fDampingState[i] * m_fFeedbackGain[i];
+		}
+		m_Feedback[0].Write(late + 0.5f * (fb[0] + fb[1] + fb[2] + fb[3]));
+		m_Feedback[1].Write(late + 0.5f * (fb[0] - fb[1] + fb[2] - fb[3]));
+		m_Feedback[2].Write(late + 0.5f * (fb[0] + fb[1] - fb[2] - fb[3]));
+		m_Feedback[3].Write(late + 0.5f * (fb[0] - fb[1] - fb[2] + fb[3]));
+
+		outL += (tap[0] + tap[2]) * m_fLateGain;
+		outR += (tap[1] + tap[3]) * m_fLateGain;
+
+		output[n * 2] += static_cast<mixsample_t>(outL * wetGain);
+		output[n * 2 + 1] += static_cast<mixsample_t>(outR * wetGain);
+	}
+
+	m_fInputState = inputState;
+}
+
+#endif // NO_REVERB
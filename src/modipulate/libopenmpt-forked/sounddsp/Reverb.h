@@ -0,0 +1,131 @@
+/*
+ * Reverb.h
+ * --------
+ * Purpose: Mixing code for the built-in reverb effect.
+ * Notes  : Portable C++ implementation, does not need MMX.
+ *          The presets are the standard I3DL2 environments.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#ifndef NO_REVERB
+
+#include "../soundlib/Mixer.h"
+#include <vector>
+
+
+// I3DL2 environment parameters (millibels, seconds, percent)
+struct SNDMIX_REVERB_PROPERTIES
+{
+	int32 lRoom;				// [-10000, 0] master volume of the reverb
+	int32 lRoomHF;				// [-10000, 0] high frequency attenuation of the reverb
+	float flDecayTime;			// [0.1, 20.0] late reverb decay time at low frequencies
+	float flDecayHFRatio;		// [0.1, 2.0] high frequency to low frequency decay time ratio
+	int32 lReflections;			// [-10000, 1000] early reflections level relative to room
+	float flReflectionsDelay;	// [0.0, 0.3] delay of the first reflection
+	int32 lReverb;				// [-10000, 2000] late reverb level relative to room
+	float flReverbDelay;		// [0.0, 0.1] late reverb delay relative to the first reflection
+	float flDiffusion;			// [0.0, 100.0] echo density in the late reverb decay
+	float flDensity;			// [0.0, 100.0] modal density in the late reverb decay
+};
+
+struct SNDMIX_RVBPRESET
+{
+	SNDMIX_REVERB_PROPERTIES Preset;
+	const char *lpszName;
+};
+
+
+//=================
+class CReverbSettings
+//=================
+{
+public:
+	UINT m_nReverbDepth;	// Wet level, 0...16 (16 = preset level)
+	UINT m_nReverbType;		// Preset index, 0...NUM_REVERBTYPES-1
+public:
+	CReverbSettings();
+};
+
+
+//=========
+class CReverb
+//=========
+{
+public:
+	CReverbSettings m_Settings;
+
+	// Channels with reverb enabled are mixed into this buffer instead of the main mix.
+	mixsample_t MixReverbBuffer[MIXBUFFERSIZE * 2];
+	// Click removal offsets of the send buffer, see StereoFill.
+	mixsample_t gnRvbROfsVol, gnRvbLOfsVol;
+
+private:
+	enum
+	{
+		NUM_REFLECTIONS = 8,		// Early reflection taps
+		NUM_LATE_DELAYS = 4,		// Feedback delay lines of the late reverb
+		NUM_DIFFUSERS = 2,			// Allpass filters in front of the late reverb
+	};
+
+	// Simple power-of-two sized delay line
+	struct DelayLine
+	{
+		std::vector<float> buffer;
+		uint32 mask;
+		uint32 pos;
+
+		DelayLine() : mask(0), pos(0) { }
+		void Resize(uint32 minLength);
+		void Clear();
+		forceinline void Write(float x) { pos = (pos + 1) & mask; buffer[pos] = x; }
+		forceinline float Read(uint32 delay) const { return buffer[(pos - delay) & mask]; }
+	};
+
+	// Parameters calculated from the current preset and mixing frequency
+	uint32 m_nLastPreset;
+	uint32 m_nLastMixingFreq;
+	uint32 m_nLastDepth;
+	float m_fInputLowpass;							// One-pole coefficient for lRoomHF
+	float m_fReflectionGain[NUM_REFLECTIONS][2];	// Per tap, per output channel
+	uint32 m_nReflectionDelay[NUM_REFLECTIONS];
+	uint32 m_nLateDelay;							// Offset of the late reverb input
+	uint32 m_nDiffuserDelay[NUM_DIFFUSERS];
+	float m_fDiffusion;
+	uint32 m_nFeedbackDelay[NUM_LATE_DELAYS];
+	float m_fFeedbackGain[NUM_LATE_DELAYS];
+	float m_fFeedbackDamping[NUM_LATE_DELAYS];		// One-pole coefficient for flDecayHFRatio
+	float m_fLateGain;
+	float m_fWetGain;
+	uint32 m_nTailLength;							// Samples until the reverb has decayed after the last input
+
+	// Processing state
+	DelayLine m_PreDelay;
+	DelayLine m_Diffuser[NUM_DIFFUSERS];
+	DelayLine m_Feedback[NUM_LATE_DELAYS];
+	float m_fInputState;
+	float m_fDampingState[NUM_LATE_DELAYS];
+	uint32 m_nReverbSamples;						// Remaining tail, 0 = reverb is silent
+	uint32 m_nReverbSend;							// Samples sent during the current chunk
+
+public:
+	CReverb();
+	void Initialize(bool bReset, DWORD MixingFreq);
+	// can be called multiple times or never (if no data is sent to reverb)
+	mixsample_t *GetReverbSendBuffer(UINT nSamples);
+	// call once after all data has been sent.
+	void Process(mixsample_t *MixSoundBuffer, UINT nSamples);
+
+private:
+	void Shutdown();
+	void UpdateParameters(DWORD MixingFreq);
+	void ProcessReverb(const mixsample_t *input, mixsample_t *output, UINT nSamples);
+};
+
+
+const SNDMIX_RVBPRESET *GetReverbPreset(UINT nPreset);
+
+#endif // NO_REVERB
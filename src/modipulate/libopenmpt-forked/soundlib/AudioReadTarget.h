@@ -16,6 +16,73 @@
 #include "Mixer.h"
 
 
+// Floating point output: the mix is scaled straight into the output buffer,
+// final output gain included, in a single pass.
+template<bool clipOutput>
+void ConvertMixToOutput(float *outputBuffer, float * const *outputBuffers, mixsample_t *mixBuffer, std::size_t channels, std::size_t countChunk, float gainFactor, Dither & /*dither*/)
+{
+#ifdef MPT_INTMIXER
+	const float factor = gainFactor / MIXING_SCALEF;
+#else
+	const float factor = gainFactor;
+#endif
+	if(outputBuffer)
+	{
+		float * MPT_RESTRICT out = outputBuffer;
+		const mixsample_t * MPT_RESTRICT in = mixBuffer;
+		for(std::size_t i = 0; i < channels * countChunk; ++i)
+		{
+			out[i] = static_cast<float>(in[i]) * factor;
+			if(clipOutput) out[i] = Clamp(out[i], -1.0f, 1.0f);
+		}
+	}
+	if(outputBuffers)
+	{
+		for(std::size_t channel = 0; channel < channels; ++channel)
+		{
+			float * MPT_RESTRICT out = outputBuffers[channel];
+			const mixsample_t * MPT_RESTRICT in = mixBuffer + channel;
+			for(std::size_t i = 0; i < countChunk; ++i)
+			{
+				out[i] = static_cast<float>(in[i * channels]) * factor;
+				if(clipOutput) out[i] = Clamp(out[i], -1.0f, 1.0f);
+			}
+		}
+	}
+}
+
+
+// Integer output: the mix is dithered and converted from fixed point.
+template<bool clipOutput, typename Tsample>
+void ConvertMixToOutput(Tsample *outputBuffer, Tsample * const *outputBuffers, mixsample_t *mixBuffer, std::size_t channels, std::size_t countChunk, float gainFactor, Dither &dither)
+{
+#ifdef MPT_INTMIXER
+	int32 *fixedBuffer = mixBuffer;
+#ifndef MODPLUG_TRACKER
+	ApplyGain(fixedBuffer, channels, countChunk, Util::Round<int32>(gainFactor * (1<<16)));
+#endif // !MODPLUG_TRACKER
+#else
+	int32 fixedBuffer[MIXBUFFERSIZE * 4];
+	const float factor = gainFactor * MIXING_SCALEF;
+	for(std::size_t i = 0; i < channels * countChunk; ++i)
+	{
+		fixedBuffer[i] = Util::Round<int32>(Clamp(mixBuffer[i] * factor, static_cast<float>(MIXING_CLIPMIN), static_cast<float>(MIXING_CLIPMAX)));
+	}
+#endif
+
+	dither.Process(fixedBuffer, countChunk, channels, SampleFormat(SampleFormatTraits<Tsample>::sampleFormat).GetBitsPerSample());
+
+	if(outputBuffer)
+	{
+		ConvertInterleavedFixedPointToInterleaved<MIXING_FRACTIONAL_BITS, clipOutput>(outputBuffer, fixedBuffer, channels, countChunk);
+	}
+	if(outputBuffers)
+	{
+		ConvertInterleavedFixedPointToNonInterleaved<MIXING_FRACTIONAL_BITS, clipOutput>(outputBuffers, fixedBuffer, channels, countChunk);
+	}
+}
+
+
 template<typename Tsample, bool clipOutput = false>
 class AudioReadTargetBuffer
 	: public IAudioReadTarget
@@ -23,13 +90,15 @@ class AudioReadTargetBuffer
 private:
 	std::size_t countRendered;
 	Dither &dither;
+	const float gainFactor;
 protected:
 	Tsample *outputBuffer;
 	Tsample * const *outputBuffers;
 public:
-	AudioReadTargetBuffer(Dither &dither_, Tsample *buffer, Tsample * const *buffers)
+	AudioReadTargetBuffer(Dither &dither_, Tsample *buffer, Tsample * const *buffers, float gainFactor_ = 1.0f)
 		: countRendered(0)
 		, dither(dither_)
+		, gainFactor(gainFactor_)
 		, outputBuffer(buffer)
 		, outputBuffers(buffers)
 	{
@@ -38,30 +107,24 @@ public:
 	virtual ~AudioReadTargetBuffer() { }
 	std::size_t GetRenderedCount() const { return countRendered; }
 public:
-	virtual void DataCallback(int *MixSoundBuffer, std::size_t channels, std::size_t countChunk)
+	virtual void DataCallback(mixsample_t *MixSoundBuffer, std::size_t channels, std::size_t countChunk)
 	{
-		// Convert to output sample format and optionally perform dithering and clipping if needed
-
-		const SampleFormat sampleFormat = SampleFormatTraits<Tsample>::sampleFormat;
-
-		if(sampleFormat.IsInt())
-		{
-			dither.Process(MixSoundBuffer, countChunk, channels, sampleFormat.GetBitsPerSample());
-		}
+		// Convert to output sample format, applying the final output gain and optionally dithering and clipping on the way
 
+		Tsample *buffer = nullptr;
 		if(outputBuffer)
 		{
-			ConvertInterleavedFixedPointToInterleaved<MIXING_FRACTIONAL_BITS, clipOutput>(outputBuffer + (channels * countRendered), MixSoundBuffer, channels, countChunk);
+			buffer = outputBuffer + (channels * countRendered);
 		}
+		Tsample *buffers[4] = { nullptr, nullptr, nullptr, nullptr };
 		if(outputBuffers)
 		{
-			Tsample *buffers[4] = { nullptr, nullptr, nullptr, nullptr };
 			for(std::size_t channel = 0; channel < channels; ++channel)
 			{
 				buffers[channel] = outputBuffers[channel] + countRendered;
 			}
-			ConvertInterleavedFixedPointToNonInterleaved<MIXING_FRACTIONAL_BITS, clipOutput>(buffers, MixSoundBuffer, channels, countChunk);
 		}
+		ConvertMixToOutput<clipOutput>(buffer, outputBuffers ? buffers : nullptr, MixSoundBuffer, channels, countChunk, gainFactor, dither);
 
 		countRendered += countChunk;
 	}
@@ -70,58 +133,19 @@ public:
 
 #ifndef MODPLUG_TRACKER
 
-template<typename Tsample>
-void ApplyGainBeforeConversionIfAppropriate(int *MixSoundBuffer, std::size_t channels, std::size_t countChunk, float gainFactor)
-{
-	// Apply final output gain for non floating point output
-	ApplyGain(MixSoundBuffer, channels, countChunk, Util::Round<int32>(gainFactor * (1<<16)));
-}
-template<>
-void ApplyGainBeforeConversionIfAppropriate<float>(int * /*MixSoundBuffer*/, std::size_t /*channels*/, std::size_t /*countChunk*/, float /*gainFactor*/)
-{
-	// nothing
-}
-
-template<typename Tsample>
-void ApplyGainAfterConversionIfAppropriate(Tsample * /*buffer*/, Tsample * const * /*buffers*/, std::size_t /*countRendered*/, std::size_t /*channels*/, std::size_t /*countChunk*/, float /*gainFactor*/)
-{
-	// nothing
-}
-template<>
-void ApplyGainAfterConversionIfAppropriate<float>(float *buffer, float * const *buffers, std::size_t countRendered, std::size_t channels, std::size_t countChunk, float gainFactor)
-{
-	// Apply final output gain for floating point output after conversion so we do not suffer underflow or clipping
-	ApplyGain(buffer, buffers, countRendered, channels, countChunk, gainFactor);
-}
-
 template<typename Tsample>
 class AudioReadTargetGainBuffer
 	: public AudioReadTargetBuffer<Tsample>
 {
 private:
 	typedef AudioReadTargetBuffer<Tsample> Tbase;
-private:
-	const float gainFactor;
 public:
-	AudioReadTargetGainBuffer(Dither &dither, Tsample *buffer, Tsample * const *buffers, float gainFactor_)
-		: Tbase(dither, buffer, buffers)
-		, gainFactor(gainFactor_)
+	AudioReadTargetGainBuffer(Dither &dither, Tsample *buffer, Tsample * const *buffers, float gainFactor)
+		: Tbase(dither, buffer, buffers, gainFactor)
 	{
 		return;
 	}
 	virtual ~AudioReadTargetGainBuffer() { }
-public:
-	virtual void DataCallback(int *MixSoundBuffer, std::size_t channels, std::size_t countChunk)
-	{
-		const std::size_t countRendered = Tbase::GetRenderedCount();
-
-		ApplyGainBeforeConversionIfAppropriate<Tsample>(MixSoundBuffer, channels, countChunk, gainFactor);
-
-		Tbase::DataCallback(MixSoundBuffer, channels, countChunk);
-
-		ApplyGainAfterConversionIfAppropriate<Tsample>(Tbase::outputBuffer, Tbase::outputBuffers, countRendered, channels, countChunk, gainFactor);
-
-	}
 };
 
 #endif // !MODPLUG_TRACKER
@@ -23,83 +23,100 @@
 #include "stdafx.h"
 #include "Sndfile.h"
 #include "MixerLoops.h"
+#include "MixFuncTable.h"
 #ifdef MPT_INTMIXER
-#include "IntMixer.h"
-#else
-#include "FloatMixer.h"
+#include "IntMixerSSE2.h"
+#include "IntMixerNEON.h"
 #endif // MPT_INTMIXER
+#if defined(ENABLE_AVX2_MIXER) && MPT_COMPILER_MSVC
+#include <intrin.h>
+#endif
 
 
 namespace MixFuncTable
 {
-#ifdef MPT_INTMIXER
-	typedef Int8MToIntS I8M;
-	typedef Int16MToIntS I16M;
-	typedef Int8SToIntS I8S;
-	typedef Int16SToIntS I16S;
-#else
-	typedef Int8MToFloatS I8M;
-	typedef Int16MToFloatS I16M;
-	typedef Int8SToFloatS I8S;
-	typedef Int16SToFloatS I16S;
-#endif // MPT_INTMIXER
-
-// Table index:
-//	[b1-b0]	format (8-bit-mono, 16-bit-mono, 8-bit-stereo, 16-bit-stereo)
-//	[b2]	ramp
-//	[b3]	filter
-//	[b6-b4]	src type
 
-// Sample type / processing type index
-enum FunctionIndex
+static const MixFuncInterface FunctionsScalar[MIXFUNCTABLE_SIZE] =
 {
-	ndx16Bit		= 0x01,
-	ndxStereo		= 0x02,
-	ndxRamp			= 0x04,
-	ndxFilter		= 0x08,
+	BuildMixFuncTable(SampleLoop, NoInterpolation, ),			// No SRC
+	BuildMixFuncTable(SampleLoop, LinearInterpolation, ),		// Linear SRC
+	BuildMixFuncTable(SampleLoop, FastSincInterpolation, ),	// Fast Sinc (Cubic Spline) SRC
+	BuildMixFuncTable(SampleLoop, PolyphaseInterpolation, ),	// Kaiser SRC
+	BuildMixFuncTable(SampleLoop, FIRFilterInterpolation, ),	// FIR SRC
 };
 
-// SRC index
-enum ResamplingIndex
+// The vectorized tables keep the scalar interpolation for the two-tap modes; there is not enough work
+// per sampling point to make up for the shuffling, but they still benefit from the vectorized mixing.
+#if defined(MPT_INTMIXER) && defined(ENABLE_SSE2_MIXER)
+static const MixFuncInterface FunctionsSSE2[MIXFUNCTABLE_SIZE] =
 {
-	ndxNoInterpolation	= 0x00,
-	ndxLinear			= 0x10,
-	ndxFastSinc			= 0x20,
-	ndxKaiser			= 0x30,
-	ndxFIRFilter		= 0x40,
+	BuildMixFuncTable(SampleLoopBlock, NoInterpolation, SSE2),
+	BuildMixFuncTable(SampleLoopBlock, LinearInterpolation, SSE2),
+	BuildMixFuncTable(SampleLoopBlock, FastSincInterpolationSSE2, SSE2),
+	BuildMixFuncTable(SampleLoopBlock, PolyphaseInterpolationSSE2, SSE2),
+	BuildMixFuncTable(SampleLoopBlock, FIRFilterInterpolationSSE2, SSE2),
 };
+#endif // MPT_INTMIXER && ENABLE_SSE2_MIXER
 
-// Build mix function table for given resampling, filter and ramping settings: One function each for 8-Bit / 16-Bit Mono / Stereo
-#define BuildMixFuncTableRamp(resampling, filter, ramp) \
-	SampleLoop<I8M, resampling<I8M>, filter<I8M>, MixMono ## ramp<I8M> >, \
-	SampleLoop<I16M, resampling<I16M>, filter<I16M>, MixMono ## ramp<I16M> >, \
-	SampleLoop<I8S, resampling<I8S>, filter<I8S>, MixStereo ## ramp<I8S> >, \
-	SampleLoop<I16S, resampling<I16S>, filter<I16S>, MixStereo ## ramp<I16S> >
-
-// Build mix function table for given resampling, filter settings: With and without ramping
-#define BuildMixFuncTableFilter(resampling, filter) \
-	BuildMixFuncTableRamp(resampling, filter, NoRamp), \
-	BuildMixFuncTableRamp(resampling, filter, Ramp)
-
-// Build mix function table for given resampling settings: With and without filter
-#define BuildMixFuncTable(resampling) \
-	BuildMixFuncTableFilter(resampling, NoFilter), \
-	BuildMixFuncTableFilter(resampling, ResonantFilter)
-
-const MixFuncInterface Functions[5 * 16] =
+#if defined(MPT_INTMIXER) && defined(ENABLE_NEON_MIXER)
+static const MixFuncInterface FunctionsNEON[MIXFUNCTABLE_SIZE] =
 {
-	BuildMixFuncTable(NoInterpolation),			// No SRC
-	BuildMixFuncTable(LinearInterpolation),		// Linear SRC
-	BuildMixFuncTable(FastSincInterpolation),	// Fast Sinc (Cubic Spline) SRC
-	BuildMixFuncTable(PolyphaseInterpolation),	// Kaiser SRC
-	BuildMixFuncTable(FIRFilterInterpolation),	// FIR SRC
+	BuildMixFuncTable(SampleLoopBlock, NoInterpolation, NEON),
+	BuildMixFuncTable(SampleLoopBlock, LinearInterpolation, NEON),
+	BuildMixFuncTable(SampleLoopBlock, FastSincInterpolationNEON, NEON),
+	BuildMixFuncTable(SampleLoopBlock, PolyphaseInterpolationNEON, NEON),
+	BuildMixFuncTable(SampleLoopBlock, FIRFilterInterpolationNEON, NEON),
 };
+#endif // MPT_INTMIXER && ENABLE_NEON_MIXER
 
 #undef BuildMixFuncTableRamp
 #undef BuildMixFuncTableFilter
 #undef BuildMixFuncTable
 
 
+#if defined(MPT_INTMIXER) && defined(ENABLE_AVX2_MIXER)
+static bool CPUSupportsAVX2()
+//---------------------------
+{
+#if MPT_COMPILER_MSVC
+	int info[4];
+	__cpuid(info, 0);
+	if(info[0] < 7) return false;
+	__cpuid(info, 1);
+	const bool osxsave = (info[2] & (1 << 27)) != 0, avx = (info[2] & (1 << 28)) != 0;
+	// The OS has to save the YMM registers on context switches.
+	if(!osxsave || !avx || (_xgetbv(0) & 0x06) != 0x06) return false;
+	__cpuidex(info, 7, 0);
+	return (info[1] & (1 << 5)) != 0;
+#else
+	// Also checks for OS support.
+	__builtin_cpu_init();
+	return __builtin_cpu_supports("avx2") != 0;
+#endif
+}
+#endif // MPT_INTMIXER && ENABLE_AVX2_MIXER
+
+
+static const MixFuncInterface *SelectFunctions()
+//----------------------------------------------
+{
+#ifdef MPT_INTMIXER
+#ifdef ENABLE_AVX2_MIXER
+	if(CPUSupportsAVX2()) return FunctionsAVX2;
+#endif
+#ifdef ENABLE_SSE2_MIXER
+	return FunctionsSSE2;
+#endif
+#ifdef ENABLE_NEON_MIXER
+	return FunctionsNEON;
+#endif
+#endif // MPT_INTMIXER
+	return FunctionsScalar;
+}
+
+const MixFuncInterface * const Functions = SelectFunctions();
+
+
 static forceinline ResamplingIndex ResamplingModeToMixFlags(uint8 resamplingMode)
 //-------------------------------------------------------------------------------
 {
@@ -284,24 +301,6 @@ void CSoundFile::CreateStereoMix(int count)
 	const bool ITPingPongMode = IsITPingPongMode();
 	const bool realtimeMix = !IsRenderingToDisc();
 
-    // MODIPULATE
-    // (This handles channel fading.)
-    for(uint32 i = 0; i < MAX_CHANNELS; i++) {
-        ModChannel &chn = Chn[i];
-       
-        if (chn.fade_in_progress) {
-            // Recalculate amplitude.
-            chn.current_amplitude = (chn.fade_count / chn.fade_total_samples) *
-                (chn.destination_amplitude - chn.starting_amplitude) + chn.starting_amplitude;
-
-            chn.fade_count += count;
-            if (chn.fade_count >= chn.fade_total_samples) {
-                chn.fade_in_progress = false;
-                chn.current_amplitude = chn.destination_amplitude;
-            }
-        }
-    }
-
 	for(uint32 nChn = 0; nChn < m_nMixChannels; nChn++)
 	{
 		ModChannel &chn = Chn[ChnMix[nChn]];
@@ -322,17 +321,12 @@ void CSoundFile::CreateStereoMix(int count)
 
 		mixsample_t *pbuffer = MixSoundBuffer;
 #ifndef NO_REVERB
-#ifdef ENABLE_MMX
-		if(GetProcSupport() & PROCSUPPORT_MMX)
+		if(((m_MixerSettings.DSPMask & SNDDSP_REVERB) && !chn.dwFlags[CHN_NOREVERB]) || chn.dwFlags[CHN_REVERB])
 		{
-			if(((m_MixerSettings.DSPMask & SNDDSP_REVERB) && !chn.dwFlags[CHN_NOREVERB]) || chn.dwFlags[CHN_REVERB])
-			{
-				pbuffer = m_Reverb.GetReverbSendBuffer(count);
-				pOfsR = &m_Reverb.gnRvbROfsVol;
-				pOfsL = &m_Reverb.gnRvbLOfsVol;
-			}
+			pbuffer = m_Reverb.GetReverbSendBuffer(count);
+			pOfsR = &m_Reverb.gnRvbROfsVol;
+			pOfsL = &m_Reverb.gnRvbLOfsVol;
 		}
-#endif
 #endif
 		if(chn.dwFlags[CHN_SURROUND] && m_MixerSettings.gnChannels > 2)
 			pbuffer = MixRearBuffer;
@@ -495,8 +489,10 @@ void CSoundFile::CreateStereoMix(int count)
 void CSoundFile::ProcessPlugins(UINT nCount)
 //------------------------------------------
 {
+#ifdef MPT_INTMIXER
 	const float IntToFloat = m_PlayConfig.getIntToFloat();
 	const float FloatToInt = m_PlayConfig.getFloatToInt();
+#endif // MPT_INTMIXER
 	// Setup float inputs
 	for(PLUGINDEX plug = 0; plug < MAX_MIXPLUGINS; plug++)
 	{
@@ -0,0 +1,75 @@
+/*
+ * FastmixAVX2.cpp
+ * ---------------
+ * Purpose: Mix function table using the AVX2 mixer kernels.
+ * Notes  : The file is compiled with the same code generation as everything else. Only the mixer
+ *          templates are put under an AVX2 target pragma, so every inline function that other files
+ *          may share (from the soundlib headers or the standard library) is emitted as plain code,
+ *          and the AVX2 code stays in the mixing loops, which are static.
+ *          Only the headers the kernels need are included; in particular not Sndfile.h.
+ *          Fastmix.cpp only uses this table if the CPU supports AVX2.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#include "stdafx.h"
+#include "Mixer.h"
+
+#if defined(MPT_INTMIXER) && defined(ENABLE_AVX2_MIXER)
+
+// Everything below the mixer templates, with the normal code generation.
+#include "../common/misc_util.h"
+#include "Snd_defs.h"
+#include "modcommand.h"
+#include "ModSample.h"
+#include "ModInstrument.h"
+#include "ModChannel.h"
+#include "Resampler.h"
+#include <immintrin.h>
+#include <cstring>
+
+#if MPT_COMPILER_CLANG
+#define BEGIN_AVX2_CODE _Pragma("clang attribute push (__attribute__((target(\"avx2\"))), apply_to = function)")
+#define END_AVX2_CODE _Pragma("clang attribute pop")
+#elif MPT_COMPILER_GCC
+#define BEGIN_AVX2_CODE _Pragma("GCC push_options") _Pragma("GCC target(\"avx2\")")
+#define END_AVX2_CODE _Pragma("GCC pop_options")
+#else
+// MSVC allows AVX2 intrinsics in any function.
+#define BEGIN_AVX2_CODE
+#define END_AVX2_CODE
+#endif
+
+// SampleLoopBlock has to be AVX2 code to inline the AVX2 functors. The scalar and SSE2 functors are
+// shared with Fastmix.cpp, so they keep the normal code generation; they are inlined all the same.
+BEGIN_AVX2_CODE
+#include "MixerInterface.h"
+END_AVX2_CODE
+
+#include "IntMixerSSE2.h"
+
+BEGIN_AVX2_CODE
+#include "IntMixerAVX2.h"
+END_AVX2_CODE
+
+#include "MixFuncTable.h"
+
+
+namespace MixFuncTable
+{
+
+// Same layout as the tables in Fastmix.cpp.
+// There is no AVX2 kernel for the four-tap cubic spline, as its taps only fill half of an SSE2 register.
+const MixFuncInterface FunctionsAVX2[MIXFUNCTABLE_SIZE] =
+{
+	BuildMixFuncTable(SampleLoopBlock, NoInterpolation, AVX2),
+	BuildMixFuncTable(SampleLoopBlock, LinearInterpolation, AVX2),
+	BuildMixFuncTable(SampleLoopBlock, FastSincInterpolationSSE2, AVX2),
+	BuildMixFuncTable(SampleLoopBlock, PolyphaseInterpolationAVX2, AVX2),
+	BuildMixFuncTable(SampleLoopBlock, FIRFilterInterpolationAVX2, AVX2),
+};
+
+} // namespace MixFuncTable
+
+#endif // MPT_INTMIXER && ENABLE_AVX2_MIXER
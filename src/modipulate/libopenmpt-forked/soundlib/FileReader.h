@@ -19,6 +19,7 @@
 #ifndef NO_FILEREADER_STD_ISTREAM
 #include <ios>
 #include <istream>
+#include "../common/mptFileMapping.h"
 #endif
 #include <limits>
 #include <vector>
@@ -363,6 +364,24 @@ public:
 };
 
 
+#ifndef NO_FILEREADER_STD_ISTREAM
+
+// A memory-mapped file. Reads are served straight from the mapping, nothing is cached.
+// The mapping stays alive for as long as any FileReader refers to it.
+class FileDataContainerMapped : public FileDataContainerMemory {
+
+private:
+	MPT_SHARED_PTR<mpt::FileMapping> mapping;
+
+public:
+	FileDataContainerMapped(MPT_SHARED_PTR<mpt::FileMapping> mapping) : FileDataContainerMemory(mapping->GetData(), mapping->GetSize()), mapping(mapping) { }
+	virtual ~FileDataContainerMapped() { }
+
+};
+
+#endif
+
+
 //==============
 class FileReader
 //==============
@@ -405,6 +424,9 @@ public:
 	// Initialize file reader object with a std::istream.
 	FileReader(std::istream *s) : data(new FileDataContainerStdStream(s)), streamPos(0) { }
 
+	// Initialize file reader object with a memory-mapped file.
+	FileReader(MPT_SHARED_PTR<mpt::FileMapping> mapping) : data(new FileDataContainerMapped(mapping)), streamPos(0) { }
+
 	// Initialize file reader object based on an existing file reader object window.
 	FileReader(MPT_SHARED_PTR<IFileDataContainer> other) : data(other), streamPos(0) { }
 
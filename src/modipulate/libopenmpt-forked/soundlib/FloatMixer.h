@@ -17,6 +17,10 @@
 template<int channelsOut, int channelsIn, typename out, typename in, int int2float>
 struct IntToFloatTraits : public MixerTraits<channelsOut, channelsIn, out, in>
 {
+	typedef MixerTraits<channelsOut, channelsIn, out, in> base_t;
+	typedef typename base_t::input_t input_t;
+	typedef typename base_t::output_t output_t;
+
 	static_assert(std::numeric_limits<input_t>::is_integer, "Input must be integer");
 	static_assert(!std::numeric_limits<output_t>::is_integer, "Output must be floating point");
 
@@ -45,12 +49,12 @@ struct LinearInterpolation
 	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
 	{
 		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
-		const Traits::output_t fract = CResampler::LinearTablef[posLo >> 8];
+		const typename Traits::output_t fract = CResampler::LinearTablef[posLo >> 8];
 
 		for(int i = 0; i < Traits::numChannelsIn; i++)
 		{
-			Traits::output_t srcVol = Traits::Convert(inBuffer[i]);
-			Traits::output_t destVol = Traits::Convert(inBuffer[i + Traits::numChannelsIn]);
+			typename Traits::output_t srcVol = Traits::Convert(inBuffer[i]);
+			typename Traits::output_t destVol = Traits::Convert(inBuffer[i + Traits::numChannelsIn]);
 
 			outSample[i] = srcVol + fract * (destVol - srcVol);
 		}
@@ -67,7 +71,7 @@ struct FastSincInterpolation
 	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
 	{
 		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
-		const Traits::output_t *lut = CResampler::FastSincTablef + ((posLo >> 6) & 0x3FC);
+		const typename Traits::output_t *lut = CResampler::FastSincTablef + ((posLo >> 6) & 0x3FC);
 
 		for(int i = 0; i < Traits::numChannelsIn; i++)
 		{
@@ -89,7 +93,7 @@ struct PolyphaseInterpolation
 	forceinline void Start(const ModChannel &chn, const CResampler &resampler)
 	{
 		sinc = (((chn.nInc > 0x13000) || (chn.nInc < -0x13000)) ?
-			(((chn.nInc > 0x18000) || (chn.nInc < -0x18000)) ? resampler.gDownsample2x : resampler.gDownsample13x) : resampler.gKaiserSinc);
+			(((chn.nInc > 0x18000) || (chn.nInc < -0x18000)) ? resampler.gDownsample2x : resampler.gDownsample13x) : resampler.m_Tables->gKaiserSinc);
 	}
 
 	forceinline void End(const ModChannel &) { }
@@ -97,7 +101,7 @@ struct PolyphaseInterpolation
 	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
 	{
 		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
-		const Traits::output_t *lut = sinc + ((posLo >> (16 - SINC_PHASES_BITS)) & SINC_MASK) * SINC_WIDTH;
+		const typename Traits::output_t *lut = sinc + ((posLo >> (16 - SINC_PHASES_BITS)) & SINC_MASK) * SINC_WIDTH;
 
 		for(int i = 0; i < Traits::numChannelsIn; i++)
 		{
@@ -122,7 +126,7 @@ struct FIRFilterInterpolation
 
 	forceinline void Start(const ModChannel &, const CResampler &resampler)
 	{
-		WFIRlut = resampler.m_WindowedFIR.lut;
+		WFIRlut = resampler.m_Tables->m_WindowedFIR.lut;
 	}
 
 	forceinline void End(const ModChannel &) { }
@@ -130,7 +134,7 @@ struct FIRFilterInterpolation
 	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
 	{
 		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
-		const Traits::output_t * const lut = WFIRlut + (((posLo + WFIR_FRACHALVE) >> WFIR_FRACSHIFT) & WFIR_FRACMASK);
+		const typename Traits::output_t * const lut = WFIRlut + (((posLo + WFIR_FRACHALVE) >> WFIR_FRACSHIFT) & WFIR_FRACMASK);
 
 		for(int i = 0; i < Traits::numChannelsIn; i++)
 		{
@@ -158,8 +162,8 @@ struct NoRamp
 
 	forceinline void Start(const ModChannel &chn)
 	{
-		lVol = static_cast<Traits::output_t>(chn.leftVol) * (1.0f / 4096.0f);
-		rVol = static_cast<Traits::output_t>(chn.rightVol) * (1.0f / 4096.0f);
+		lVol = static_cast<typename Traits::output_t>(chn.leftVol) * (1.0f / 4096.0f);
+		rVol = static_cast<typename Traits::output_t>(chn.rightVol) * (1.0f / 4096.0f);
 	}
 
 	forceinline void End(const ModChannel &) { }
@@ -190,7 +194,7 @@ struct MixMonoFastNoRamp : public NoRamp<Traits>
 {
 	forceinline void operator() (const typename Traits::outbuf_t &outSample, const ModChannel &chn, typename Traits::output_t * const outBuffer)
 	{
-		Traits::output_t vol = outSample[0] * lVol;
+		typename Traits::output_t vol = outSample[0] * this->lVol;
 		for(int i = 0; i < Traits::numChannelsOut; i++)
 		{
 			outBuffer[i] += vol;
@@ -204,8 +208,8 @@ struct MixMonoNoRamp : public NoRamp<Traits>
 {
 	forceinline void operator() (const typename Traits::outbuf_t &outSample, const ModChannel &, typename Traits::output_t * const outBuffer)
 	{
-		outBuffer[0] += outSample[0] * lVol;
-		outBuffer[1] += outSample[0] * rVol;
+		outBuffer[0] += outSample[0] * this->lVol;
+		outBuffer[1] += outSample[0] * this->rVol;
 	}
 };
 
@@ -229,8 +233,8 @@ struct MixStereoNoRamp : public NoRamp<Traits>
 {
 	forceinline void operator() (const typename Traits::outbuf_t &outSample, const ModChannel &, typename Traits::output_t * const outBuffer)
 	{
-		outBuffer[0] += outSample[0] * lVol;
-		outBuffer[1] += outSample[1] * rVol;
+		outBuffer[0] += outSample[0] * this->lVol;
+		outBuffer[1] += outSample[1] * this->rVol;
 	}
 };
 
@@ -289,7 +293,7 @@ struct ResonantFilter
 	}
 
 	// Filter values are clipped to double the input range
-#define ClipFilter(x) Clamp(x, static_cast<Traits::output_t>(-2.0f), static_cast<Traits::output_t>(2.0f))
+#define ClipFilter(x) Clamp(x, static_cast<typename Traits::output_t>(-2.0f), static_cast<typename Traits::output_t>(2.0f))
 
 	forceinline void operator() (typename Traits::outbuf_t &outSample, const ModChannel &chn)
 	{
@@ -297,7 +301,7 @@ struct ResonantFilter
 
 		for(int i = 0; i < Traits::numChannelsIn; i++)
 		{
-			Traits::output_t val = outSample[i] * chn.nFilter_A0 + ClipFilter(fy[i][0]) * chn.nFilter_B0 + ClipFilter(fy[i][1]) * chn.nFilter_B1;
+			typename Traits::output_t val = outSample[i] * chn.nFilter_A0 + ClipFilter(fy[i][0]) * chn.nFilter_B0 + ClipFilter(fy[i][1]) * chn.nFilter_B1;
 			fy[i][1] = fy[i][0];
 			fy[i][0] = val - (outSample[i] * chn.nFilter_HP);
 			outSample[i] = val;
@@ -94,7 +94,7 @@ struct PolyphaseInterpolation
 	forceinline void Start(const ModChannel &chn, const CResampler &resampler)
 	{
 		sinc = (((chn.nInc > 0x13000) || (chn.nInc < -0x13000)) ?
-			(((chn.nInc > 0x18000) || (chn.nInc < -0x18000)) ? resampler.gDownsample2x : resampler.gDownsample13x) : resampler.gKaiserSinc);
+			(((chn.nInc > 0x18000) || (chn.nInc < -0x18000)) ? resampler.gDownsample2x : resampler.gDownsample13x) : resampler.m_Tables->gKaiserSinc);
 	}
 
 	forceinline void End(const ModChannel &) { }
@@ -127,7 +127,7 @@ struct FIRFilterInterpolation
 
 	forceinline void Start(const ModChannel &, const CResampler &resampler)
 	{
-		WFIRlut = resampler.m_WindowedFIR.lut;
+		WFIRlut = resampler.m_Tables->m_WindowedFIR.lut;
 	}
 
 	forceinline void End(const ModChannel &) { }
@@ -0,0 +1,205 @@
+/*
+ * IntMixerAVX2.h
+ * --------------
+ * Purpose: AVX2 versions of the fixed point interpolation and mixing functors from IntMixer.h
+ * Notes  : Only the eight-tap stereo interpolators and the mixing functors gain anything from the
+ *          wider registers; everything else is taken from IntMixerSSE2.h.
+ *          Results are bit-identical to the scalar functors.
+ *          Must only be included from FastmixAVX2.cpp, which compiles it with AVX2 code generation.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#include "IntMixerSSE2.h"
+
+#ifdef ENABLE_AVX2_MIXER
+
+#include <immintrin.h>
+
+
+namespace AVX2
+{
+
+// Load sixteen sampling values, converted to 16-bit mixer precision (see IntToIntTraits::Convert).
+static forceinline __m256i LoadWide16(const int16 *p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p)); }
+static forceinline __m256i LoadWide16(const int8 *p) { return _mm256_slli_epi16(_mm256_cvtepi8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p))), 8); }
+
+// Dot products of eight interleaved stereo sampling points with an eight-tap LUT.
+// l and r receive the per-tap-pair products of the left and right channel.
+template<typename input_t>
+static forceinline void StereoDot8(const input_t *inBuffer, __m128i lut, __m256i &l, __m256i &r)
+{
+	// Zero-extending the LUT interleaves it with zeroes, so that vpmaddwd only picks up one channel.
+	const __m256i lutL = _mm256_cvtepu16_epi32(lut);
+	const __m256i lutR = _mm256_slli_epi32(lutL, 16);
+	const __m256i v = LoadWide16(inBuffer);
+	l = _mm256_madd_epi16(v, lutL);
+	r = _mm256_madd_epi16(v, lutR);
+}
+
+} // namespace AVX2
+
+
+//////////////////////////////////////////////////////////////////////////
+// Interpolation templates
+
+template<class Traits>
+struct PolyphaseInterpolationAVX2 : public PolyphaseInterpolationSSE2<Traits>
+{
+	typedef PolyphaseInterpolation<Traits> base_t;
+
+	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
+	{
+		if(Traits::numChannelsIn == 1)
+		{
+			PolyphaseInterpolationSSE2<Traits>::operator() (outSample, inBuffer, posLo);
+			return;
+		}
+
+		const __m128i lut = _mm_loadu_si128(reinterpret_cast<const __m128i *>(base_t::sinc + ((posLo >> (16 - SINC_PHASES_BITS)) & SINC_MASK) * SINC_WIDTH));
+		__m256i l, r;
+		AVX2::StereoDot8(inBuffer - 6, lut, l, r);
+		const __m128i sum = SSE2::HorizontalSumPair(
+			_mm_add_epi32(_mm256_castsi256_si128(l), _mm256_extracti128_si256(l, 1)),
+			_mm_add_epi32(_mm256_castsi256_si128(r), _mm256_extracti128_si256(r, 1)));
+		SSE2::StoreStereo(outSample, _mm_srai_epi32(sum, SINC_QUANTSHIFT));
+	}
+};
+
+
+template<class Traits>
+struct FIRFilterInterpolationAVX2 : public FIRFilterInterpolationSSE2<Traits>
+{
+	typedef FIRFilterInterpolation<Traits> base_t;
+
+	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
+	{
+		if(Traits::numChannelsIn == 1)
+		{
+			FIRFilterInterpolationSSE2<Traits>::operator() (outSample, inBuffer, posLo);
+			return;
+		}
+
+		const __m128i lut = _mm_loadu_si128(reinterpret_cast<const __m128i *>(base_t::WFIRlut + (((posLo + WFIR_FRACHALVE) >> WFIR_FRACSHIFT) & WFIR_FRACMASK)));
+		__m256i l, r;
+		AVX2::StereoDot8(inBuffer - 6, lut, l, r);
+		// The lower and upper halves hold the first and last four taps, which the scalar version halves separately.
+		const __m128i vol1 = SSE2::HorizontalSumPair(_mm256_castsi256_si128(l), _mm256_castsi256_si128(r));
+		const __m128i vol2 = SSE2::HorizontalSumPair(_mm256_extracti128_si256(l, 1), _mm256_extracti128_si256(r, 1));
+		SSE2::StoreStereo(outSample, _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(vol1, 1), _mm_srai_epi32(vol2, 1)), WFIR_16BITSHIFT - 1));
+	}
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// Mixing templates (add a block of samples to the stereo mix)
+// Block() handles four sampling points at a time, the scalar operator() of the base class mops up the rest.
+
+template<class Traits, bool stereo>
+static forceinline __m256i LoadMixSamplesAVX2(const typename Traits::outbuf_t *inBuffer)
+{
+	const __m256i smp = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(inBuffer));
+	// Mono sampling points only have a valid left channel.
+	return stereo ? smp : _mm256_shuffle_epi32(smp, _MM_SHUFFLE(2, 2, 0, 0));
+}
+
+
+template<class Traits, bool stereo>
+static forceinline void MixNoRampBlockAVX2(int32 lVol, int32 rVol, const typename Traits::outbuf_t *inBuffer, int numSamples, typename Traits::output_t * MPT_RESTRICT outBuffer)
+{
+	const __m256i vol = _mm256_set_epi32(rVol, lVol, rVol, lVol, rVol, lVol, rVol, lVol);
+	for(int i = 0; i + 4 <= numSamples; i += 4, outBuffer += 8)
+	{
+		const __m256i out = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(outBuffer));
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(outBuffer), _mm256_add_epi32(out, _mm256_mullo_epi32(LoadMixSamplesAVX2<Traits, stereo>(inBuffer + i), vol)));
+	}
+}
+
+
+template<class Traits>
+struct MixMonoNoRampAVX2 : public MixMonoNoRamp<Traits>
+{
+	typedef MixMonoNoRamp<Traits> base_t;
+
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		MixNoRampBlockAVX2<Traits, false>(base_t::lVol, base_t::rVol, inBuffer, numSamples, outBuffer);
+		for(int i = numSamples & ~3; i < numSamples; i++)
+		{
+			(*this)(inBuffer[i], chn, outBuffer + i * 2);
+		}
+	}
+};
+
+
+template<class Traits>
+struct MixStereoNoRampAVX2 : public MixStereoNoRamp<Traits>
+{
+	typedef MixStereoNoRamp<Traits> base_t;
+
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		MixNoRampBlockAVX2<Traits, true>(base_t::lVol, base_t::rVol, inBuffer, numSamples, outBuffer);
+		for(int i = numSamples & ~3; i < numSamples; i++)
+		{
+			(*this)(inBuffer[i], chn, outBuffer + i * 2);
+		}
+	}
+};
+
+
+// Volume ramps advance by one step per sampling point, so four points are four steps apart.
+template<class Traits, bool stereo>
+static forceinline void MixRampBlockAVX2(int32 &lRamp, int32 &rRamp, const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+{
+	const int quads = numSamples / 4;
+	if(!quads) return;
+
+	const int32 l = chn.leftRamp, r = chn.rightRamp;
+	__m256i ramp = _mm256_set_epi32(rRamp + 4 * r, lRamp + 4 * l, rRamp + 3 * r, lRamp + 3 * l, rRamp + 2 * r, lRamp + 2 * l, rRamp + r, lRamp + l);
+	const __m256i step = _mm256_set_epi32(4 * r, 4 * l, 4 * r, 4 * l, 4 * r, 4 * l, 4 * r, 4 * l);
+	for(int i = 0; i < quads; i++, outBuffer += 8)
+	{
+		const __m256i out = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(outBuffer));
+		const __m256i smp = LoadMixSamplesAVX2<Traits, stereo>(inBuffer + i * 4);
+		_mm256_storeu_si256(reinterpret_cast<__m256i *>(outBuffer), _mm256_add_epi32(out, _mm256_mullo_epi32(smp, _mm256_srai_epi32(ramp, VOLUMERAMPPRECISION))));
+		ramp = _mm256_add_epi32(ramp, step);
+	}
+	// Last values written are the new ramp state.
+	const __m128i last = _mm256_extracti128_si256(_mm256_sub_epi32(ramp, step), 1);
+	lRamp = _mm_cvtsi128_si32(_mm_srli_si128(last, 8));
+	rRamp = _mm_cvtsi128_si32(_mm_srli_si128(last, 12));
+}
+
+
+template<class Traits>
+struct MixMonoRampAVX2 : public MixMonoRamp<Traits>
+{
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		MixRampBlockAVX2<Traits, false>(this->lRamp, this->rRamp, inBuffer, numSamples, chn, outBuffer);
+		for(int i = numSamples & ~3; i < numSamples; i++)
+		{
+			(*this)(inBuffer[i], chn, outBuffer + i * 2);
+		}
+	}
+};
+
+
+template<class Traits>
+struct MixStereoRampAVX2 : public MixStereoRamp<Traits>
+{
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		MixRampBlockAVX2<Traits, true>(this->lRamp, this->rRamp, inBuffer, numSamples, chn, outBuffer);
+		for(int i = numSamples & ~3; i < numSamples; i++)
+		{
+			(*this)(inBuffer[i], chn, outBuffer + i * 2);
+		}
+	}
+};
+
+#endif // ENABLE_AVX2_MIXER
@@ -0,0 +1,260 @@
+/*
+ * IntMixerNEON.h
+ * --------------
+ * Purpose: NEON versions of the fixed point interpolation and mixing functors from IntMixer.h
+ * Notes  : Same approach as IntMixerSSE2.h: sampling points are widened to 16 bits and the taps are
+ *          evaluated with widening multiply-accumulates. Stereo samples are split into left and
+ *          right with de-interleaving loads. Results are bit-identical to the scalar functors.
+ *          Only uses ARMv7 NEON instructions, so this also works on 32-bit ARM.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#include "IntMixer.h"
+
+#ifdef ENABLE_NEON_MIXER
+
+#include <arm_neon.h>
+#include <cstring>
+
+
+namespace NEON
+{
+
+// Load four or eight sampling values, converted to 16-bit mixer precision (see IntToIntTraits::Convert).
+static forceinline int16x8_t LoadWide8(const int16 *p) { return vld1q_s16(p); }
+static forceinline int16x8_t LoadWide8(const int8 *p) { return vshll_n_s8(vld1_s8(p), 8); }
+static forceinline int16x4_t LoadWide4(const int16 *p) { return vld1_s16(p); }
+static forceinline int16x4_t LoadWide4(const int8 *p)
+{
+	uint32 v;
+	std::memcpy(&v, p, sizeof(v));
+	return vget_low_s16(vshll_n_s8(vcreate_s8(v), 8));
+}
+
+// Load eight stereo sampling points, split into left (val[0]) and right (val[1]) channel.
+static forceinline int16x8x2_t LoadStereoWide8(const int16 *p) { return vld2q_s16(p); }
+static forceinline int16x8x2_t LoadStereoWide8(const int8 *p)
+{
+	const int8x8x2_t v = vld2_s8(p);
+	int16x8x2_t result;
+	result.val[0] = vshll_n_s8(v.val[0], 8);
+	result.val[1] = vshll_n_s8(v.val[1], 8);
+	return result;
+}
+
+// Load four stereo sampling points, split into left (val[0]) and right (val[1]) channel.
+static forceinline int16x4x2_t LoadStereoWide4(const int16 *p) { return vld2_s16(p); }
+static forceinline int16x4x2_t LoadStereoWide4(const int8 *p)
+{
+	const int16x8_t v = vshll_n_s8(vld1_s8(p), 8);
+	return vuzp_s16(vget_low_s16(v), vget_high_s16(v));
+}
+
+static forceinline int32x4_t Dot8(int16x8_t v, int16x8_t lut)
+{
+	return vmlal_s16(vmull_s16(vget_low_s16(v), vget_low_s16(lut)), vget_high_s16(v), vget_high_s16(lut));
+}
+
+// Sums the lanes of l and r into lanes 0 and 1 of the result.
+static forceinline int32x2_t HorizontalSumPair(int32x4_t l, int32x4_t r)
+{
+	return vpadd_s32(vpadd_s32(vget_low_s32(l), vget_high_s32(l)), vpadd_s32(vget_low_s32(r), vget_high_s32(r)));
+}
+
+static forceinline int32 HorizontalSum(int32x4_t v)
+{
+	const int32x2_t s = vpadd_s32(vget_low_s32(v), vget_high_s32(v));
+	return vget_lane_s32(vpadd_s32(s, s), 0);
+}
+
+} // namespace NEON
+
+
+//////////////////////////////////////////////////////////////////////////
+// Interpolation templates
+
+template<class Traits>
+struct FastSincInterpolationNEON : public FastSincInterpolation<Traits>
+{
+	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
+	{
+		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
+		const int16x4_t lut = vld1_s16(CResampler::FastSincTable + ((posLo >> 6) & 0x3FC));
+
+		if(Traits::numChannelsIn == 1)
+		{
+			const int32x4_t v = vmull_s16(NEON::LoadWide4(inBuffer - 1), lut);
+			outSample[0] = NEON::HorizontalSum(v) >> 14;
+		} else
+		{
+			const int16x4x2_t v = NEON::LoadStereoWide4(inBuffer - 2);
+			vst1_s32(outSample, vshr_n_s32(NEON::HorizontalSumPair(vmull_s16(v.val[0], lut), vmull_s16(v.val[1], lut)), 14));
+		}
+	}
+};
+
+
+template<class Traits>
+struct PolyphaseInterpolationNEON : public PolyphaseInterpolation<Traits>
+{
+	typedef PolyphaseInterpolation<Traits> base_t;
+
+	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
+	{
+		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
+		const int16x8_t lut = vld1q_s16(base_t::sinc + ((posLo >> (16 - SINC_PHASES_BITS)) & SINC_MASK) * SINC_WIDTH);
+
+		if(Traits::numChannelsIn == 1)
+		{
+			outSample[0] = NEON::HorizontalSum(NEON::Dot8(NEON::LoadWide8(inBuffer - 3), lut)) >> SINC_QUANTSHIFT;
+		} else
+		{
+			const int16x8x2_t v = NEON::LoadStereoWide8(inBuffer - 6);
+			vst1_s32(outSample, vshr_n_s32(NEON::HorizontalSumPair(NEON::Dot8(v.val[0], lut), NEON::Dot8(v.val[1], lut)), SINC_QUANTSHIFT));
+		}
+	}
+};
+
+
+template<class Traits>
+struct FIRFilterInterpolationNEON : public FIRFilterInterpolation<Traits>
+{
+	typedef FIRFilterInterpolation<Traits> base_t;
+
+	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
+	{
+		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
+		const int16x8_t lut = vld1q_s16(base_t::WFIRlut + (((posLo + WFIR_FRACHALVE) >> WFIR_FRACSHIFT) & WFIR_FRACMASK));
+
+		// The scalar version sums the first and last four taps separately and halves them before adding.
+		int32x2_t vol1, vol2;
+		if(Traits::numChannelsIn == 1)
+		{
+			const int16x8_t v = NEON::LoadWide8(inBuffer - 3);
+			const int32x4_t lo = vmull_s16(vget_low_s16(v), vget_low_s16(lut));
+			const int32x4_t hi = vmull_s16(vget_high_s16(v), vget_high_s16(lut));
+			vol1 = vdup_n_s32(NEON::HorizontalSum(lo));
+			vol2 = vdup_n_s32(NEON::HorizontalSum(hi));
+		} else
+		{
+			const int16x8x2_t v = NEON::LoadStereoWide8(inBuffer - 6);
+			vol1 = NEON::HorizontalSumPair(vmull_s16(vget_low_s16(v.val[0]), vget_low_s16(lut)), vmull_s16(vget_low_s16(v.val[1]), vget_low_s16(lut)));
+			vol2 = NEON::HorizontalSumPair(vmull_s16(vget_high_s16(v.val[0]), vget_high_s16(lut)), vmull_s16(vget_high_s16(v.val[1]), vget_high_s16(lut)));
+		}
+		const int32x2_t result = vshr_n_s32(vadd_s32(vshr_n_s32(vol1, 1), vshr_n_s32(vol2, 1)), WFIR_16BITSHIFT - 1);
+
+		if(Traits::numChannelsIn == 1)
+			outSample[0] = vget_lane_s32(result, 0);
+		else
+			vst1_s32(outSample, result);
+	}
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// Mixing templates (add a block of samples to the stereo mix)
+// Block() handles pairs of sampling points, the scalar operator() of the base class mops up the rest.
+
+template<class Traits>
+struct MixMonoNoRampNEON : public MixMonoNoRamp<Traits>
+{
+	typedef MixMonoNoRamp<Traits> base_t;
+
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		const int32 volValues[4] = { base_t::lVol, base_t::rVol, base_t::lVol, base_t::rVol };
+		const int32x4_t vol = vld1q_s32(volValues);
+		int i = 0;
+		for(; i + 2 <= numSamples; i += 2, outBuffer += 4)
+		{
+			int32x4_t smp = vld1q_s32(inBuffer[i]);
+			smp = vtrnq_s32(smp, smp).val[0];	// Only the left channel is valid
+			vst1q_s32(outBuffer, vmlaq_s32(vld1q_s32(outBuffer), smp, vol));
+		}
+		for(; i < numSamples; i++, outBuffer += 2)
+		{
+			(*this)(inBuffer[i], chn, outBuffer);
+		}
+	}
+};
+
+
+template<class Traits>
+struct MixStereoNoRampNEON : public MixStereoNoRamp<Traits>
+{
+	typedef MixStereoNoRamp<Traits> base_t;
+
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		const int32 volValues[4] = { base_t::lVol, base_t::rVol, base_t::lVol, base_t::rVol };
+		const int32x4_t vol = vld1q_s32(volValues);
+		int i = 0;
+		for(; i + 2 <= numSamples; i += 2, outBuffer += 4)
+		{
+			vst1q_s32(outBuffer, vmlaq_s32(vld1q_s32(outBuffer), vld1q_s32(inBuffer[i]), vol));
+		}
+		for(; i < numSamples; i++, outBuffer += 2)
+		{
+			(*this)(inBuffer[i], chn, outBuffer);
+		}
+	}
+};
+
+
+// Volume ramps advance by one step per sampling point, so two points are two steps apart.
+template<class Traits, bool stereo>
+static forceinline void MixRampBlockNEON(int32 &lRamp, int32 &rRamp, const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+{
+	const int pairs = numSamples / 2;
+	if(!pairs) return;
+
+	const int32 rampValues[4] = { lRamp + chn.leftRamp, rRamp + chn.rightRamp, lRamp + 2 * chn.leftRamp, rRamp + 2 * chn.rightRamp };
+	const int32 stepValues[4] = { 2 * chn.leftRamp, 2 * chn.rightRamp, 2 * chn.leftRamp, 2 * chn.rightRamp };
+	int32x4_t ramp = vld1q_s32(rampValues);
+	const int32x4_t step = vld1q_s32(stepValues);
+	for(int i = 0; i < pairs; i++, outBuffer += 4)
+	{
+		int32x4_t smp = vld1q_s32(inBuffer[i * 2]);
+		if(!stereo) smp = vtrnq_s32(smp, smp).val[0];
+		vst1q_s32(outBuffer, vmlaq_s32(vld1q_s32(outBuffer), smp, vshrq_n_s32(ramp, VOLUMERAMPPRECISION)));
+		ramp = vaddq_s32(ramp, step);
+	}
+	// Last values written are the new ramp state.
+	ramp = vsubq_s32(ramp, step);
+	lRamp = vgetq_lane_s32(ramp, 2);
+	rRamp = vgetq_lane_s32(ramp, 3);
+}
+
+
+template<class Traits>
+struct MixMonoRampNEON : public MixMonoRamp<Traits>
+{
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		MixRampBlockNEON<Traits, false>(this->lRamp, this->rRamp, inBuffer, numSamples, chn, outBuffer);
+		if(numSamples & 1)
+		{
+			(*this)(inBuffer[numSamples - 1], chn, outBuffer + (numSamples - 1) * 2);
+		}
+	}
+};
+
+
+template<class Traits>
+struct MixStereoRampNEON : public MixStereoRamp<Traits>
+{
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		MixRampBlockNEON<Traits, true>(this->lRamp, this->rRamp, inBuffer, numSamples, chn, outBuffer);
+		if(numSamples & 1)
+		{
+			(*this)(inBuffer[numSamples - 1], chn, outBuffer + (numSamples - 1) * 2);
+		}
+	}
+};
+
+#endif // ENABLE_NEON_MIXER
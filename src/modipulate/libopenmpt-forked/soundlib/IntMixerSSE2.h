@@ -0,0 +1,266 @@
+/*
+ * IntMixerSSE2.h
+ * --------------
+ * Purpose: SSE2 versions of the fixed point interpolation and mixing functors from IntMixer.h
+ * Notes  : All sampling points are widened to 16 bits (which is what Traits::Convert does for the
+ *          integer mixer anyway), so every interpolation tap fits into a single pmaddwd.
+ *          Results are bit-identical to the scalar functors.
+ *          The mixing functors are meant to be used with SampleLoopBlock.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#include "IntMixer.h"
+
+#ifdef ENABLE_SSE2_MIXER
+
+#include <emmintrin.h>
+#include <cstring>
+
+
+namespace SSE2
+{
+
+// Load four or eight sampling values, converted to 16-bit mixer precision (see IntToIntTraits::Convert).
+// Four values fill the low 64 bits of the register, eight values fill all of it.
+static forceinline __m128i LoadWide8(const int16 *p) { return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p)); }
+static forceinline __m128i LoadWide8(const int8 *p) { return _mm_unpacklo_epi8(_mm_setzero_si128(), _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p))); }
+static forceinline __m128i LoadWide4(const int16 *p) { return _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)); }
+static forceinline __m128i LoadWide4(const int8 *p)
+{
+	int32 v;
+	std::memcpy(&v, p, sizeof(v));
+	return _mm_unpacklo_epi8(_mm_setzero_si128(), _mm_cvtsi32_si128(v));
+}
+
+// Sum of all four 32-bit lanes.
+static forceinline int32 HorizontalSum(__m128i v)
+{
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(1, 0, 3, 2)));
+	v = _mm_add_epi32(v, _mm_shuffle_epi32(v, _MM_SHUFFLE(2, 3, 0, 1)));
+	return _mm_cvtsi128_si32(v);
+}
+
+// Sums the lanes of l and r into lanes 0 and 1 of the result.
+static forceinline __m128i HorizontalSumPair(__m128i l, __m128i r)
+{
+	__m128i v = _mm_add_epi32(_mm_unpacklo_epi32(l, r), _mm_unpackhi_epi32(l, r));
+	return _mm_add_epi32(v, _mm_srli_si128(v, 8));
+}
+
+// Low 32 bits of a 32x32 bit multiplication (pmulld is SSE4.1).
+static forceinline __m128i MulLo32(__m128i a, __m128i b)
+{
+	const __m128i even = _mm_mul_epu32(a, b);
+	const __m128i odd = _mm_mul_epu32(_mm_srli_epi64(a, 32), _mm_srli_epi64(b, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+// Dot product of eight interleaved stereo sampling points with an eight-tap LUT.
+// Returns the left and right results in lanes 0 and 1.
+template<typename input_t>
+static forceinline __m128i StereoDot8(const input_t *inBuffer, __m128i lut)
+{
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i first = LoadWide8(inBuffer), second = LoadWide8(inBuffer + 8);
+	// Interleave the LUT with zeroes so that pmaddwd only picks up one channel.
+	const __m128i l = _mm_add_epi32(_mm_madd_epi16(first, _mm_unpacklo_epi16(lut, zero)), _mm_madd_epi16(second, _mm_unpackhi_epi16(lut, zero)));
+	const __m128i r = _mm_add_epi32(_mm_madd_epi16(first, _mm_unpacklo_epi16(zero, lut)), _mm_madd_epi16(second, _mm_unpackhi_epi16(zero, lut)));
+	return HorizontalSumPair(l, r);
+}
+
+static forceinline void StoreStereo(int32 (&outSample)[2], __m128i v)
+{
+	_mm_storel_epi64(reinterpret_cast<__m128i *>(outSample), v);
+}
+
+} // namespace SSE2
+
+
+//////////////////////////////////////////////////////////////////////////
+// Interpolation templates
+
+template<class Traits>
+struct FastSincInterpolationSSE2 : public FastSincInterpolation<Traits>
+{
+	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
+	{
+		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
+		const __m128i lut = _mm_loadl_epi64(reinterpret_cast<const __m128i *>(CResampler::FastSincTable + ((posLo >> 6) & 0x3FC)));
+
+		if(Traits::numChannelsIn == 1)
+		{
+			const __m128i v = _mm_madd_epi16(SSE2::LoadWide4(inBuffer - 1), lut);
+			outSample[0] = _mm_cvtsi128_si32(_mm_add_epi32(v, _mm_srli_si128(v, 4))) >> 14;
+		} else
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i v = SSE2::LoadWide8(inBuffer - 2);
+			const __m128i sum = SSE2::HorizontalSumPair(_mm_madd_epi16(v, _mm_unpacklo_epi16(lut, zero)), _mm_madd_epi16(v, _mm_unpacklo_epi16(zero, lut)));
+			SSE2::StoreStereo(outSample, _mm_srai_epi32(sum, 14));
+		}
+	}
+};
+
+
+template<class Traits>
+struct PolyphaseInterpolationSSE2 : public PolyphaseInterpolation<Traits>
+{
+	typedef PolyphaseInterpolation<Traits> base_t;
+
+	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
+	{
+		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
+		const __m128i lut = _mm_loadu_si128(reinterpret_cast<const __m128i *>(base_t::sinc + ((posLo >> (16 - SINC_PHASES_BITS)) & SINC_MASK) * SINC_WIDTH));
+
+		if(Traits::numChannelsIn == 1)
+		{
+			outSample[0] = SSE2::HorizontalSum(_mm_madd_epi16(SSE2::LoadWide8(inBuffer - 3), lut)) >> SINC_QUANTSHIFT;
+		} else
+		{
+			SSE2::StoreStereo(outSample, _mm_srai_epi32(SSE2::StereoDot8(inBuffer - 6, lut), SINC_QUANTSHIFT));
+		}
+	}
+};
+
+
+template<class Traits>
+struct FIRFilterInterpolationSSE2 : public FIRFilterInterpolation<Traits>
+{
+	typedef FIRFilterInterpolation<Traits> base_t;
+
+	forceinline void operator() (typename Traits::outbuf_t &outSample, const typename Traits::input_t * const inBuffer, const int32 posLo)
+	{
+		static_assert(Traits::numChannelsIn <= Traits::numChannelsOut, "Too many input channels");
+		const __m128i lut = _mm_loadu_si128(reinterpret_cast<const __m128i *>(base_t::WFIRlut + (((posLo + WFIR_FRACHALVE) >> WFIR_FRACSHIFT) & WFIR_FRACMASK)));
+
+		// The scalar version sums the first and last four taps separately and halves them before adding.
+		__m128i vol1, vol2;
+		if(Traits::numChannelsIn == 1)
+		{
+			__m128i v = _mm_madd_epi16(SSE2::LoadWide8(inBuffer - 3), lut);
+			v = _mm_add_epi32(v, _mm_srli_si128(v, 4));
+			vol1 = v;
+			vol2 = _mm_srli_si128(v, 8);
+		} else
+		{
+			const __m128i zero = _mm_setzero_si128();
+			const __m128i first = SSE2::LoadWide8(inBuffer - 6), second = SSE2::LoadWide8(inBuffer + 2);
+			vol1 = SSE2::HorizontalSumPair(_mm_madd_epi16(first, _mm_unpacklo_epi16(lut, zero)), _mm_madd_epi16(first, _mm_unpacklo_epi16(zero, lut)));
+			vol2 = SSE2::HorizontalSumPair(_mm_madd_epi16(second, _mm_unpackhi_epi16(lut, zero)), _mm_madd_epi16(second, _mm_unpackhi_epi16(zero, lut)));
+		}
+		const __m128i result = _mm_srai_epi32(_mm_add_epi32(_mm_srai_epi32(vol1, 1), _mm_srai_epi32(vol2, 1)), WFIR_16BITSHIFT - 1);
+
+		if(Traits::numChannelsIn == 1)
+			outSample[0] = _mm_cvtsi128_si32(result);
+		else
+			SSE2::StoreStereo(outSample, result);
+	}
+};
+
+
+//////////////////////////////////////////////////////////////////////////
+// Mixing templates (add a block of samples to the stereo mix)
+// Block() handles pairs of sampling points, the scalar operator() of the base class mops up the rest.
+
+template<class Traits>
+struct MixMonoNoRampSSE2 : public MixMonoNoRamp<Traits>
+{
+	typedef MixMonoNoRamp<Traits> base_t;
+
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		const __m128i vol = _mm_set_epi32(base_t::rVol, base_t::lVol, base_t::rVol, base_t::lVol);
+		int i = 0;
+		for(; i + 2 <= numSamples; i += 2, outBuffer += 4)
+		{
+			const __m128i smp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i *>(inBuffer + i)), _MM_SHUFFLE(2, 2, 0, 0));
+			const __m128i out = _mm_loadu_si128(reinterpret_cast<const __m128i *>(outBuffer));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(outBuffer), _mm_add_epi32(out, SSE2::MulLo32(smp, vol)));
+		}
+		for(; i < numSamples; i++, outBuffer += 2)
+		{
+			(*this)(inBuffer[i], chn, outBuffer);
+		}
+	}
+};
+
+
+template<class Traits>
+struct MixStereoNoRampSSE2 : public MixStereoNoRamp<Traits>
+{
+	typedef MixStereoNoRamp<Traits> base_t;
+
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		const __m128i vol = _mm_set_epi32(base_t::rVol, base_t::lVol, base_t::rVol, base_t::lVol);
+		int i = 0;
+		for(; i + 2 <= numSamples; i += 2, outBuffer += 4)
+		{
+			const __m128i smp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inBuffer + i));
+			const __m128i out = _mm_loadu_si128(reinterpret_cast<const __m128i *>(outBuffer));
+			_mm_storeu_si128(reinterpret_cast<__m128i *>(outBuffer), _mm_add_epi32(out, SSE2::MulLo32(smp, vol)));
+		}
+		for(; i < numSamples; i++, outBuffer += 2)
+		{
+			(*this)(inBuffer[i], chn, outBuffer);
+		}
+	}
+};
+
+
+// Volume ramps advance by one step per sampling point, so two points are two steps apart.
+template<class Traits, bool stereo>
+static forceinline void MixRampBlockSSE2(int32 &lRamp, int32 &rRamp, const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+{
+	const int pairs = numSamples / 2;
+	if(!pairs) return;
+
+	__m128i ramp = _mm_set_epi32(rRamp + 2 * chn.rightRamp, lRamp + 2 * chn.leftRamp, rRamp + chn.rightRamp, lRamp + chn.leftRamp);
+	const __m128i step = _mm_set_epi32(2 * chn.rightRamp, 2 * chn.leftRamp, 2 * chn.rightRamp, 2 * chn.leftRamp);
+	for(int i = 0; i < pairs; i++, outBuffer += 4)
+	{
+		__m128i smp = _mm_loadu_si128(reinterpret_cast<const __m128i *>(inBuffer + i * 2));
+		if(!stereo) smp = _mm_shuffle_epi32(smp, _MM_SHUFFLE(2, 2, 0, 0));
+		const __m128i out = _mm_loadu_si128(reinterpret_cast<const __m128i *>(outBuffer));
+		_mm_storeu_si128(reinterpret_cast<__m128i *>(outBuffer), _mm_add_epi32(out, SSE2::MulLo32(smp, _mm_srai_epi32(ramp, VOLUMERAMPPRECISION))));
+		ramp = _mm_add_epi32(ramp, step);
+	}
+	// Last values written are the new ramp state.
+	ramp = _mm_sub_epi32(ramp, step);
+	lRamp = _mm_cvtsi128_si32(_mm_srli_si128(ramp, 8));
+	rRamp = _mm_cvtsi128_si32(_mm_srli_si128(ramp, 12));
+}
+
+
+template<class Traits>
+struct MixMonoRampSSE2 : public MixMonoRamp<Traits>
+{
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		MixRampBlockSSE2<Traits, false>(this->lRamp, this->rRamp, inBuffer, numSamples, chn, outBuffer);
+		if(numSamples & 1)
+		{
+			(*this)(inBuffer[numSamples - 1], chn, outBuffer + (numSamples - 1) * 2);
+		}
+	}
+};
+
+
+template<class Traits>
+struct MixStereoRampSSE2 : public MixStereoRamp<Traits>
+{
+	forceinline void Block(const typename Traits::outbuf_t *inBuffer, int numSamples, const ModChannel &chn, typename Traits::output_t * MPT_RESTRICT outBuffer)
+	{
+		MixRampBlockSSE2<Traits, true>(this->lRamp, this->rRamp, inBuffer, numSamples, chn, outBuffer);
+		if(numSamples & 1)
+		{
+			(*this)(inBuffer[numSamples - 1], chn, outBuffer + (numSamples - 1) * 2);
+		}
+	}
+};
+
+#endif // ENABLE_SSE2_MIXER
@@ -24,6 +24,7 @@
 #include <list>
 #include "../common/version.h"
 #include "ITTools.h"
+#include "decode_vorbis.h"
 #include <time.h>
 #if MPT_COMPILER_GCC
 #include <ext/stdio_sync_filebuf.h>
@@ -502,6 +503,9 @@ bool CSoundFile::ReadITQ(FileReader &file, ModLoadingFlags loadFlags)
 	m_nSamples = std::min(fileHeader.smpnum, SAMPLEINDEX(MAX_SAMPLES - 1));
 	size_t nbytes = 0; // size of sample data in file
 
+	// The Vorbis data is decoded in one go once all headers have been read.
+	VorbisDecodeQueue vorbisQueue;
+
 	for(SAMPLEINDEX i = 0; i < GetNumSamples(); i++)
 	{
 		ITQSample sampleHeader;
@@ -516,12 +520,13 @@ bool CSoundFile::ReadITQ(FileReader &file, ModLoadingFlags loadFlags)
 				if((loadFlags & loadSampleData) && file.Seek(sampleOffset))
 				{
 					Samples[i+1].originalSize = sampleHeader.nbytes;
-					sampleHeader.GetSampleFormatITQ(fileHeader.cwtv).ReadSample(Samples[i + 1], file);
+					sampleHeader.GetSampleFormatITQ(fileHeader.cwtv).ReadSample(Samples[i + 1], file, &vorbisQueue);
 					lastSampleOffset = std::max(lastSampleOffset, file.GetPosition());
 				}
 			}
 		}
 	}
+	vorbisQueue.Run();
 	m_nSamples = std::max(SAMPLEINDEX(1), GetNumSamples());
 
 	m_nMinPeriod = 8;
@@ -0,0 +1,89 @@
+/*
+ * MixFuncTable.h
+ * --------------
+ * Purpose: Table layout of the mixer functions, shared by all instruction set specific mixer tables.
+ * Notes  : Fastmix.cpp picks one of the tables at startup, depending on what the CPU supports.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#include "MixerInterface.h"
+#ifdef MPT_INTMIXER
+#include "IntMixer.h"
+#else
+#include "FloatMixer.h"
+#endif // MPT_INTMIXER
+
+
+namespace MixFuncTable
+{
+#ifdef MPT_INTMIXER
+	typedef Int8MToIntS I8M;
+	typedef Int16MToIntS I16M;
+	typedef Int8SToIntS I8S;
+	typedef Int16SToIntS I16S;
+#else
+	typedef Int8MToFloatS I8M;
+	typedef Int16MToFloatS I16M;
+	typedef Int8SToFloatS I8S;
+	typedef Int16SToFloatS I16S;
+#endif // MPT_INTMIXER
+
+// Table index:
+//	[b1-b0]	format (8-bit-mono, 16-bit-mono, 8-bit-stereo, 16-bit-stereo)
+//	[b2]	ramp
+//	[b3]	filter
+//	[b6-b4]	src type
+
+// Sample type / processing type index
+enum FunctionIndex
+{
+	ndx16Bit		= 0x01,
+	ndxStereo		= 0x02,
+	ndxRamp			= 0x04,
+	ndxFilter		= 0x08,
+};
+
+// SRC index
+enum ResamplingIndex
+{
+	ndxNoInterpolation	= 0x00,
+	ndxLinear			= 0x10,
+	ndxFastSinc			= 0x20,
+	ndxKaiser			= 0x30,
+	ndxFIRFilter		= 0x40,
+};
+
+// Number of entries in a mix function table
+#define MIXFUNCTABLE_SIZE (5 * 16)
+
+// Build mix function table for given sample loop, resampling, filter and ramping settings: One function each for 8-Bit / 16-Bit Mono / Stereo
+// isa is appended to the mixing functor names (e.g. MixMonoRamp ## SSE2), and left empty for the scalar functors.
+#define BuildMixFuncTableRamp(loop, resampling, filter, ramp, isa) \
+	loop<I8M, resampling<I8M>, filter<I8M>, MixMono ## ramp ## isa<I8M> >, \
+	loop<I16M, resampling<I16M>, filter<I16M>, MixMono ## ramp ## isa<I16M> >, \
+	loop<I8S, resampling<I8S>, filter<I8S>, MixStereo ## ramp ## isa<I8S> >, \
+	loop<I16S, resampling<I16S>, filter<I16S>, MixStereo ## ramp ## isa<I16S> >
+
+// Build mix function table for given resampling, filter settings: With and without ramping
+#define BuildMixFuncTableFilter(loop, resampling, filter, isa) \
+	BuildMixFuncTableRamp(loop, resampling, filter, NoRamp, isa), \
+	BuildMixFuncTableRamp(loop, resampling, filter, Ramp, isa)
+
+// Build mix function table for given resampling settings: With and without filter
+#define BuildMixFuncTable(loop, resampling, isa) \
+	BuildMixFuncTableFilter(loop, resampling, NoFilter, isa), \
+	BuildMixFuncTableFilter(loop, resampling, ResonantFilter, isa)
+
+#ifdef ENABLE_AVX2_MIXER
+// Defined in FastmixAVX2.cpp, which is the only file with AVX2 code.
+extern const MixFuncInterface FunctionsAVX2[MIXFUNCTABLE_SIZE];
+#endif // ENABLE_AVX2_MIXER
+
+// Mix function table that is used for the current CPU.
+extern const MixFuncInterface * const Functions;
+
+} // namespace MixFuncTable
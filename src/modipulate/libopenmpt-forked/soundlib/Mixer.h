@@ -10,7 +10,10 @@
 
 #pragma once
 
+// Fixed point mixing, unless the build asks for the floating point mixer
+#ifndef MPT_FLOATMIXER
 #define MPT_INTMIXER
+#endif
 
 #ifdef MPT_INTMIXER
 typedef int32 mixsample_t;
@@ -86,10 +86,6 @@ static void SampleLoop(ModChannel &chn, const CResampler &resampler, typename Tr
 
 		interpolate(outSample, inSample + (smpPos >> 16) * Traits::numChannelsIn, (smpPos & 0xFFFF));
 
-        // /MODIPULATE
-        outSample[0] *= chn.current_amplitude;
-        outSample[1] *= chn.current_amplitude;
-
 		filter(outSample, c);
 		mix(outSample, c, outBuffer);
 		outBuffer += Traits::numChannelsOut;
@@ -105,5 +101,52 @@ static void SampleLoop(ModChannel &chn, const CResampler &resampler, typename Tr
 	c.nPosLo = smpPos & 0xFFFF;
 };
 
+// Block-wise variant of SampleLoop for vectorized mixing functors.
+// Sampling points are interpolated and filtered into a small buffer first, which is then
+// handed to MixFunc::Block() in one go. The result is identical to SampleLoop.
+#define MIXER_BLOCK_SIZE 64
+
+template<class Traits, class InterpolationFunc, class FilterFunc, class MixFunc>
+static void SampleLoopBlock(ModChannel &chn, const CResampler &resampler, typename Traits::output_t * MPT_RESTRICT outBuffer, int numSamples)
+{
+	ModChannel &c = chn;
+	const typename Traits::input_t * MPT_RESTRICT inSample = static_cast<const typename Traits::input_t *>(c.pCurrentSample) + c.nPos * Traits::numChannelsIn;
+
+	int32 smpPos = c.nPosLo;	// 16.16 sample position relative to c.nPos
+
+	InterpolationFunc interpolate;
+	FilterFunc filter;
+	MixFunc mix;
+
+	// Do initialisation if necessary
+	interpolate.Start(c, resampler);
+	filter.Start(c);
+	mix.Start(c);
+
+	typename Traits::outbuf_t block[MIXER_BLOCK_SIZE];
+	while(numSamples > 0)
+	{
+		const int count = (numSamples < MIXER_BLOCK_SIZE) ? numSamples : MIXER_BLOCK_SIZE;
+		for(int i = 0; i < count; i++)
+		{
+			interpolate(block[i], inSample + (smpPos >> 16) * Traits::numChannelsIn, (smpPos & 0xFFFF));
+
+			filter(block[i], c);
+			smpPos += c.nInc;
+		}
+
+		mix.Block(block, count, c, outBuffer);
+		outBuffer += count * Traits::numChannelsOut;
+		numSamples -= count;
+	}
+
+	mix.End(c);
+	filter.End(c);
+	interpolate.End(c);
+
+	c.nPos += smpPos >> 16;
+	c.nPosLo = smpPos & 0xFFFF;
+};
+
 // Type of the SampleLoop function above
 typedef void (*MixFuncInterface)(ModChannel &, const CResampler &, mixsample_t *, int);
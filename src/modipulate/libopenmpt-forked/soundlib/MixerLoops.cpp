@@ -903,40 +903,4 @@ void ApplyGain(int32 *soundBuffer, std::size_t channels, std::size_t countChunk,
 	}
 }
 
-static void ApplyGain(float *beg, float *end, float factor)
-//---------------------------------------------------------
-{
-	for(float *it = beg; it != end; ++it)
-	{
-		*it *= factor;
-	}
-}
-
-void ApplyGain(float * outputBuffer, float * const *outputBuffers, std::size_t offset, std::size_t channels, std::size_t countChunk, float gainFactor)
-//----------------------------------------------------------------------------------------------------------------------------------------------------
-{
-	if(gainFactor == 1.0f)
-	{
-		// nothing to do, gain == +/- 0dB
-		return;
-	}
-	if(outputBuffer)
-	{
-		ApplyGain(
-			outputBuffer + (channels * offset),
-			outputBuffer + (channels * (offset + countChunk)),
-			gainFactor);
-	}
-	if(outputBuffers)
-	{
-		for(std::size_t channel = 0; channel < channels; ++channel)
-		{
-			ApplyGain(
-				outputBuffers[channel] + offset,
-				outputBuffers[channel] + offset + countChunk,
-				gainFactor);
-		}
-	}
-}
-
 #endif // !MODPLUG_TRACKER
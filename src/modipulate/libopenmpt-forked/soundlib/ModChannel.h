@@ -132,12 +132,13 @@ struct ALIGN(32) ModChannel
 	//<----
 
     // MODIPULATE!!
-    double fade_total_samples;      // Total number of samples in the fade.
-    double fade_count;              // Current position in those samples (starts at max, then decreases to 0)
-    bool fade_in_progress;          // Whether we have a fade in progress or not?
-    double starting_amplitude;      // Amplitude start
-    double destination_amplitude;   // Amplitude destination
-    double current_amplitude;       // What's the amplitude right now?
+    // Fade set by module::fade_channel(). ReadNote() moves fadeGain towards
+    // fadeTarget once per tick and folds it into the channel's volume ramp.
+    double fadeGain;                // Gain reached at the end of the current tick's ramp
+    double fadeTarget;              // Gain at the end of the fade
+    uint32 fadeSamplesLeft;         // Samples until fadeTarget is reached, 0 if not fading
+    UINT hookStartTick;             // Note delay requested by ISoundHooks::OnRowCommand(), or tick ISoundHooks::OnTickCommand() started the row's commands on, 0 if none
+    UINT rowStartTick;              // Tick the row's note plays on, as of the last tick processed
     // /MODIPULATE
 
 	void ClearRowCmd() { rowCommand = ModCommand::Empty(); }
@@ -193,9 +194,7 @@ struct ALIGN(32) ModChannel
 	{
 		memset(this, 0, sizeof(*this));
 
-        starting_amplitude = 0.0;
-        destination_amplitude = 0.0;
-        current_amplitude = 1.0;
+        fadeGain = fadeTarget = 1.0;
 	}
 
 };
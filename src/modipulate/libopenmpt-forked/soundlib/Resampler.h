@@ -54,37 +54,39 @@ public:
 };
 
 
+//====================
+struct CResamplerTables
+//====================
+{
+	// Tables that depend on the cutoff and window type. They never change
+	// once built, so all resamplers with the same settings share one copy.
+	CWindowedFIR m_WindowedFIR;
+	SINC_TYPE gKaiserSinc[SINC_PHASES * 8];				// Upsampling
+};
+
+
 //==============
 class CResampler
 //==============
 {
 public:
 	CResamplerSettings m_Settings;
-	CWindowedFIR m_WindowedFIR;
+	MPT_SHARED_PTR<const CResamplerTables> m_Tables;
 	static const int16 FastSincTable[256 * 4];
 
-	SINC_TYPE gKaiserSinc[SINC_PHASES * 8];				// Upsampling
-
-#ifdef MODPLUG_TRACKER
-	static bool StaticTablesInitialized;
-	#define RESAMPLER_TABLE static
-#else
-	// no global data which has to be initialized by hand in the library
-	#define RESAMPLER_TABLE 
-#endif // MODPLUG_TRACKER
-
-	RESAMPLER_TABLE SINC_TYPE gDownsample13x[SINC_PHASES * 8];	// Downsample 1.333x
-	RESAMPLER_TABLE SINC_TYPE gDownsample2x[SINC_PHASES * 8];	// Downsample 2x
+	// The remaining tables don't depend on any settings and are filled in
+	// once, by the first resampler that is created.
+	static SINC_TYPE gDownsample13x[SINC_PHASES * 8];	// Downsample 1.333x
+	static SINC_TYPE gDownsample2x[SINC_PHASES * 8];	// Downsample 2x
 
 #ifndef MPT_INTMIXER
-	RESAMPLER_TABLE mixsample_t FastSincTablef[256 * 4];	// Cubic spline LUT
-	RESAMPLER_TABLE mixsample_t LinearTablef[256];		// Linear interpolation LUT
+	static mixsample_t FastSincTablef[256 * 4];	// Cubic spline LUT
+	static mixsample_t LinearTablef[256];		// Linear interpolation LUT
 #endif // !defined(MPT_INTMIXER)
 
-#undef RESAMPLER_TABLE
-
 private:
 	CResamplerSettings m_OldSettings;
+	static void InitializeStaticTables();
 public:
 	CResampler() { InitializeTables(true); }
 	~CResampler() {}
@@ -33,8 +33,8 @@
 #endif
 
 // Read a sample from memory
-size_t SampleIO::ReadSample(ModSample &sample, FileReader &file) const
-//--------------------------------------------------------------------
+size_t SampleIO::ReadSample(ModSample &sample, FileReader &file, VorbisDecodeQueue *vorbisQueue) const
+//---------------------------------------------------------------------------------------------------
 {
 	if(sample.nLength < 1 || !file.IsValid())
 	{
@@ -63,7 +63,15 @@ size_t SampleIO::ReadSample(ModSample &sample, FileReader &file) const
 	// Ogg Vorbis
 	if(GetEncoding() == vorbis)
 	{
-		decode_vorbis(sourceBuf, sample.originalSize, (int16_t*)sample.pSample);
+		const size_t inSize = std::min<size_t>(sample.originalSize, fileSize);
+		const size_t outCount = sample.GetSampleSizeInBytes() / sizeof(int16_t);
+		if(vorbisQueue != nullptr)
+		{
+			vorbisQueue->Add(sourceBuf, inSize, (int16_t*)sample.pSample, outCount);
+		} else
+		{
+			decode_vorbis(sourceBuf, inSize, (int16_t*)sample.pSample, outCount);
+		}
 	}
 
 	//////////////////////////////////////////////////////
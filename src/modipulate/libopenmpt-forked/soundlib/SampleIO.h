@@ -14,6 +14,7 @@
 
 struct ModSample;
 class FileReader;
+class VorbisDecodeQueue;
 
 // Sample import / export formats
 //============
@@ -163,8 +164,9 @@ public:
 		return static_cast<Encoding>((format & encodingMask) >> encodingOffset);
 	}
 
-	// Read a sample from memory
-	size_t ReadSample(ModSample &sample, FileReader &file) const;
+	// Read a sample from memory. Vorbis samples are allocated right away but only decoded
+	// once vorbisQueue is run, if one is given.
+	size_t ReadSample(ModSample &sample, FileReader &file, VorbisDecodeQueue *vorbisQueue = nullptr) const;
 
 #ifndef MODPLUG_NO_FILESAVE
 	// Write a sample to file
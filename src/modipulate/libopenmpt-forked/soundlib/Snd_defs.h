@@ -61,6 +61,8 @@ const CHANNELINDEX MAX_CHANNELS			= 256;	//200 // Maximum number of mixing chann
 
 #define FREQ_FRACBITS		4		// Number of fractional bits in return value of CSoundFile::GetFreqFromPeriod()
 
+#define PLAYBACK_FACTOR_UNITY	65536	// CSoundFile::m_nTempoFactor / m_nFreqFactor that doesn't change anything
+
 // String lengths (including trailing null char)
 #define MAX_SAMPLENAME			32	// also affects module name!
 #define MAX_SAMPLEFILENAME		22
@@ -27,8 +27,6 @@
 #pragma warning(disable:4244)
 #endif
 
-#include "../mod_stream.h"
-
 
 // Formats which have 7-bit (0...128) instead of 6-bit (0...64) global volume commands, or which are imported to this range (mostly formats which are converted to IT internally)
 #ifdef MODPLUG_TRACKER
@@ -74,11 +72,40 @@ public:
 		}
 	};
 
+	// Channel memory that is written back to the player in eAdjust mode.
+	// Unlike ChnSettings it isn't cleared by Reset(), just like the player's
+	// own channels aren't. A zero parameter means it wasn't set.
+	struct ChnAdjust
+	{
+		ModCommand::PARAM oldTempo;
+		ModCommand::PARAM oldPortaUpDown;
+		ModCommand::PARAM portamentoSlide;
+		ModCommand::PARAM oldOffset;
+		ModCommand::PARAM oldVolumeSlide;
+		ModCommand::PARAM oldChnVolSlide;
+		bool chnVolSlideSet;
+		bool resetPatternLoop;
+
+		ChnAdjust()
+		{
+			oldTempo = 0;
+			oldPortaUpDown = 0;
+			portamentoSlide = 0;
+			oldOffset = 0;
+			oldVolumeSlide = 0;
+			oldChnVolSlide = 0;
+			chnVolSlideSet = false;
+			resetPatternLoop = false;
+		}
+	};
+
 	double elapsedTime;
 	CSoundFile::samplecount_t renderedSamples;
+	double bufferDiff;	// Rounding error carried from tick to tick in modern tempo mode
 	UINT musicSpeed, musicTempo;
 	LONG glbVol;
 	std::vector<ChnSettings> chnSettings;
+	std::vector<ChnAdjust> chnAdjust;
 
 protected:
 	const CSoundFile &sndFile;
@@ -88,12 +115,14 @@ public:
 	GetLengthMemory(const CSoundFile &sf) : sndFile(sf)
 	{
 		Reset();
+		chnAdjust.assign(sndFile.GetNumChannels(), ChnAdjust());
 	};
 
 	void Reset()
 	{
 		elapsedTime = 0.0;
 		renderedSamples = 0;
+		bufferDiff = 0.0;
 		musicSpeed = sndFile.m_nDefaultSpeed;
 		musicTempo = sndFile.m_nDefaultTempo;
 		glbVol = sndFile.m_nDefaultGlobalVolume;
@@ -106,6 +135,211 @@ public:
 };
 
 
+// Rows between two seek snapshots.
+#define SEEK_SNAPSHOT_ROWS 32
+
+// State of GetLength() at the top of one pass through its main loop.
+struct SeekSnapshot
+{
+	uint32 iteration;
+	ROWINDEX nextRow, nextPatStartRow, endRow;
+	ORDERINDEX nextOrder, endOrder;
+	GetLengthMemory memory;
+	RowVisitor visitedRows;
+
+	SeekSnapshot(const GetLengthMemory &m, const RowVisitor &v) : memory(m), visitedRows(v) { }
+};
+
+
+// Snapshots and note timeline taken by CSoundFile::BuildSeekSnapshots().
+//
+// Continuing from a snapshot gives the same result as simulating from the
+// start, as long as the simulation from the start wouldn't have reached the
+// target before the snapshot. So for every row, this remembers in which
+// iteration of the GetLength() loop the target check first got there.
+class SeekSnapshots
+{
+public:
+	// What the simulation depends on besides the song itself.
+	uint32 mixingFreq;
+	SEQUENCEINDEX sequence;
+
+	std::vector<SeekSnapshot> snapshots;
+	// Every note, sorted by samplePos.
+	std::vector<NoteTimelineEvent> timeline;
+
+	SeekSnapshots(const CSoundFile &sndFile, uint32 freq) : mixingFreq(freq), sequence(sndFile.Order.GetCurrentSequenceIndex()) { }
+
+	// The timeline doesn't depend on the mixing rate, apart from rounding.
+	bool MatchesSong(const CSoundFile &sndFile) const
+	{
+		return sequence == sndFile.Order.GetCurrentSequenceIndex();
+	}
+
+	bool Matches(const CSoundFile &sndFile) const
+	{
+		return MatchesSong(sndFile) && mixingFreq == sndFile.m_MixerSettings.gdwMixingFreq;
+	}
+
+	void Reached(ORDERINDEX order, ROWINDEX row, uint32 iteration) { Stamp(reachedAt, order, row, iteration); }
+	void ReachedIgnoredOrder(ORDERINDEX order, uint32 iteration) { Stamp(ignoredOrderReachedAt, order, 0, iteration); }
+
+	// Adds the notes of a row that starts at rowStart seconds.
+	void AddRow(const CSoundFile &sndFile, ORDERINDEX order, ROWINDEX row, const ModCommand *m, double rowStart, uint32 tickDuration, UINT speed)
+	{
+		const size_t first = timeline.size();
+		const uint32 rowStartPos = ToSamples(rowStart);
+		for(CHANNELINDEX chn = 0; chn < sndFile.GetNumChannels(); chn++, m++)
+		{
+			if(m->note == NOTE_NONE || sndFile.ChnSettings[chn].dwFlags[CHN_MUTE])
+				continue;
+
+			UINT delay = 0;
+			if((m->command == CMD_S3MCMDEX || m->command == CMD_MODCMDEX) && (m->param & 0xF0) == 0xD0)
+			{
+				delay = m->param & 0x0F;
+				if(delay >= speed)
+					continue;	// never triggered
+			}
+
+			NoteTimelineEvent event;
+			event.samplePos = rowStartPos + delay * tickDuration;
+			event.row = row;
+			event.order = order;
+			event.channel = chn;
+			event.note = m->note;
+			event.instr = m->instr;
+			event.volcmd = m->volcmd;
+			event.vol = m->vol;
+			event.command = m->command;
+			event.param = m->param;
+			timeline.push_back(event);
+		}
+		// Note delays can put channels out of order.
+		std::stable_sort(timeline.begin() + first, timeline.end(), EarlierEvent);
+	}
+
+	// GetLength() doesn't play pattern loops again, it only adds their
+	// duration. So this repeats the notes between loopStart and loopEnd.
+	void RepeatLoop(double loopStart, double loopEnd, UINT count)
+	{
+		const uint32 startPos = ToSamples(loopStart), endPos = ToSamples(loopEnd);
+		if(endPos <= startPos) return;
+
+		const size_t first = FindEvent(startPos), last = timeline.size();
+		for(UINT repeat = 1; repeat <= count; repeat++)
+		{
+			for(size_t i = first; i < last; i++)
+			{
+				NoteTimelineEvent event = timeline[i];
+				event.samplePos += repeat * (endPos - startPos);
+				timeline.push_back(event);
+			}
+		}
+	}
+
+	void GetTimeline(double start, double end, std::vector<NoteTimelineEvent> &events) const
+	{
+		if(end <= start) return;
+		std::vector<NoteTimelineEvent>::const_iterator first = timeline.begin() + FindEvent(start * mixingFreq);
+		std::vector<NoteTimelineEvent>::const_iterator last = timeline.begin() + FindEvent(end * mixingFreq);
+		events.insert(events.end(), first, last);
+	}
+
+	// Returns the latest snapshot that comes before target, or nullptr.
+	const SeekSnapshot *Find(const GetLengthTarget &target) const
+	{
+		uint32 lastIteration = NOT_STAMPED;
+		if(target.mode == GetLengthTarget::SeekPosition)
+		{
+			lastIteration = std::min(Lookup(reachedAt, target.pos.order, target.pos.row), Lookup(ignoredOrderReachedAt, target.pos.order, 0));
+		}
+		for(std::vector<SeekSnapshot>::const_reverse_iterator snapshot = snapshots.rbegin(); snapshot != snapshots.rend(); snapshot++)
+		{
+			if(target.mode == GetLengthTarget::SeekSeconds ? (snapshot->memory.elapsedTime < target.time) : (snapshot->iteration <= lastIteration))
+			{
+				return &*snapshot;
+			}
+		}
+		return nullptr;
+	}
+
+private:
+	enum { NOT_STAMPED = uint32_max };
+
+	uint32 ToSamples(double seconds) const
+	{
+		return static_cast<uint32>(seconds * mixingFreq + 0.5);
+	}
+
+	static bool EarlierEvent(const NoteTimelineEvent &a, const NoteTimelineEvent &b)
+	{
+		return a.samplePos < b.samplePos;
+	}
+
+	static bool EventBefore(const NoteTimelineEvent &event, double pos)
+	{
+		return event.samplePos < pos;
+	}
+
+	// Index of the first event at or after pos.
+	size_t FindEvent(double pos) const
+	{
+		return std::lower_bound(timeline.begin(), timeline.end(), pos, EventBefore) - timeline.begin();
+	}
+
+	typedef std::vector<std::vector<uint32> > IterationTable;
+
+	// Only the first time counts.
+	static void Stamp(IterationTable &table, ORDERINDEX order, ROWINDEX row, uint32 iteration)
+	{
+		if(order >= table.size()) table.resize(order + 1);
+		if(row >= table[order].size()) table[order].resize(row + 1, NOT_STAMPED);
+		if(table[order][row] == NOT_STAMPED) table[order][row] = iteration;
+	}
+
+	static uint32 Lookup(const IterationTable &table, ORDERINDEX order, ROWINDEX row)
+	{
+		if(order >= table.size() || row >= table[order].size()) return NOT_STAMPED;
+		return table[order][row];
+	}
+
+	IterationTable reachedAt, ignoredOrderReachedAt;
+};
+
+
+void CSoundFile::BuildSeekSnapshots(uint32 mixingFreq)
+//-----------------------------------------------------
+{
+	MPT_SHARED_PTR<SeekSnapshots> snapshots(new SeekSnapshots(*this, mixingFreq));
+	GetLength(eAdjust, GetLengthTarget(), snapshots.get());
+
+	std::lock_guard<std::mutex> guard(m_SeekSnapshotsMutex);
+	m_SeekSnapshots = snapshots;
+}
+
+
+MPT_SHARED_PTR<const SeekSnapshots> CSoundFile::GetSeekSnapshots() const
+//-----------------------------------------------------------------------
+{
+	std::lock_guard<std::mutex> guard(m_SeekSnapshotsMutex);
+	return m_SeekSnapshots;
+}
+
+
+uint32 CSoundFile::GetNoteTimeline(double start, double end, std::vector<NoteTimelineEvent> &events) const
+//--------------------------------------------------------------------------------------------------------
+{
+	MPT_SHARED_PTR<const SeekSnapshots> snapshots = GetSeekSnapshots();
+	if(!snapshots || !snapshots->MatchesSong(*this))
+	{
+		return 0;
+	}
+	snapshots->GetTimeline(start, end, events);
+	return snapshots->mixingFreq;
+}
+
+
 // Get mod length in various cases. Parameters:
 // [in]  adjustMode: See enmGetLengthResetMode for possible adjust modes.
 // [in]  target: Time or position target which should be reached, or no target to get length of the first sub song.
@@ -117,6 +351,15 @@ public:
 // [out] endRow: last row before module loops (dito)
 GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthTarget target)
 //-------------------------------------------------------------------------------------------
+{
+	return GetLength(adjustMode, target, nullptr);
+}
+
+
+// If record is set, the song is simulated with record's mixing rate and
+// snapshots are added to it. Nothing in the playback state is changed then.
+GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthTarget target, SeekSnapshots *record)
+//-----------------------------------------------------------------------------------------------------------------
 {
 	GetLengthType retval;
 	retval.duration = 0.0;
@@ -127,18 +370,56 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 	// Are we trying to reach a certain pattern position?
 	const bool hasSearchTarget = target.mode != GetLengthTarget::NoTarget;
 
+	const uint32 mixingFreq = record ? record->mixingFreq : m_MixerSettings.gdwMixingFreq;
+
+	// Skip ahead to the latest snapshot before the target, if there is one.
+	MPT_SHARED_PTR<const SeekSnapshots> snapshots;
+	const SeekSnapshot *snapshot = nullptr;
+	if(hasSearchTarget && !record)
+	{
+		snapshots = GetSeekSnapshots();
+		if(snapshots && snapshots->Matches(*this)) snapshot = snapshots->Find(target);
+	}
+
 	ROWINDEX nRow = 0, nNextRow = 0;
 	ROWINDEX nNextPatStartRow = 0; // FT2 E60 bug
 	ORDERINDEX nCurrentOrder = 0, nNextOrder = 0;
 	PATTERNINDEX nPattern = Order[0];
+	uint32 iteration = 0;
+	ROWINDEX rowsSinceSnapshot = 0;
 
-	GetLengthMemory memory(*this);
+	GetLengthMemory memory = snapshot ? snapshot->memory : GetLengthMemory(*this);
 	// Temporary visited rows vector (so that GetLength() won't interfere with the player code if the module is playing at the same time)
-	RowVisitor visitedRows(*this);
+	RowVisitor visitedRows = snapshot ? snapshot->visitedRows : RowVisitor(*this);
+
+	if(snapshot)
+	{
+		iteration = snapshot->iteration;
+		nNextRow = snapshot->nextRow;
+		nNextPatStartRow = snapshot->nextPatStartRow;
+		nNextOrder = snapshot->nextOrder;
+		retval.endOrder = snapshot->endOrder;
+		retval.endRow = snapshot->endRow;
+	}
 
 	for (;;)
 	{
+		if(record && rowsSinceSnapshot >= SEEK_SNAPSHOT_ROWS)
+		{
+			SeekSnapshot newSnapshot(memory, visitedRows);
+			newSnapshot.iteration = iteration;
+			newSnapshot.nextRow = nNextRow;
+			newSnapshot.nextPatStartRow = nNextPatStartRow;
+			newSnapshot.nextOrder = nNextOrder;
+			newSnapshot.endOrder = retval.endOrder;
+			newSnapshot.endRow = retval.endRow;
+			record->snapshots.push_back(newSnapshot);
+			rowsSinceSnapshot = 0;
+		}
+		const uint32 thisIteration = iteration++;
+
 		UINT rowDelay = 0, tickDelay = 0;
+		int tempoSlide = 0;	// per tick, from the second tick on
 		nRow = nNextRow;
 		nCurrentOrder = nNextOrder;
 
@@ -151,6 +432,10 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 		bool patternBreakOnThisRow = false;
 		bool patternLoopEndedOnThisRow = false;
 
+		if(record && nPattern == Order.GetIgnoreIndex())
+		{
+			record->ReachedIgnoredOrder(nCurrentOrder, thisIteration);
+		}
 		if(nPattern == Order.GetIgnoreIndex() && target.mode == GetLengthTarget::SeekPosition && nCurrentOrder == target.pos.order)
 		{
 			// Early test: Target is inside +++ pattern
@@ -215,6 +500,10 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 			nRow = 0;
 
 		// Check whether target was reached.
+		if(record)
+		{
+			record->Reached(nCurrentOrder, nRow, thisIteration);
+		}
 		if((target.mode == GetLengthTarget::SeekPosition && nCurrentOrder == target.pos.order && nRow == target.pos.row)
 			|| (target.mode == GetLengthTarget::SeekSeconds && memory.elapsedTime >= target.time))
 		{
@@ -238,6 +527,7 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 
 		retval.endOrder = nCurrentOrder;
 		retval.endRow = nRow;
+		rowsSinceSnapshot++;
 
 		// Update next position
 		nNextRow = nRow + 1;
@@ -248,11 +538,11 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 				memory.chnSettings[chn].patLoop = memory.elapsedTime;
 		}
 
-		ModChannel *pChn = Chn;
 		ModCommand *p = Patterns[nPattern].GetRow(nRow);
 		ModCommand *nextRow = nullptr;
-		for(CHANNELINDEX nChn = 0; nChn < GetNumChannels(); p++, pChn++, nChn++) if(!p->IsEmpty())
+		for(CHANNELINDEX nChn = 0; nChn < GetNumChannels(); p++, nChn++) if(!p->IsEmpty())
 		{
+			GetLengthMemory::ChnAdjust &chnAdjust = memory.chnAdjust[nChn];
 			if((GetType() == MOD_TYPE_S3M) && ChnSettings[nChn].dwFlags[CHN_MUTE])	// not even effects are processed on muted S3M channels
 				continue;
 			ModCommand::COMMAND command = p->command;
@@ -275,8 +565,7 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 
 				if ((adjustMode & eAdjust))
 				{
-					pChn->nPatternLoopCount = 0;
-					pChn->nPatternLoop = 0;
+					chnAdjust.resetPatternLoop = true;
 				}
 				break;
 			// Pattern Break
@@ -308,8 +597,7 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 				}
 				if ((adjustMode & eAdjust))
 				{
-					pChn->nPatternLoopCount = 0;
-					pChn->nPatternLoop = 0;
+					chnAdjust.resetPatternLoop = true;
 				}
 				break;
 			// Set Speed
@@ -333,22 +621,18 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 			case CMD_TEMPO:
 				if ((adjustMode & eAdjust) && (GetType() & (MOD_TYPE_S3M | MOD_TYPE_IT | MOD_TYPE_MPT)))
 				{
-					if (param) pChn->nOldTempo = (BYTE)param; else param = pChn->nOldTempo;
+					if (param) chnAdjust.oldTempo = (BYTE)param;
+					else if (chnAdjust.oldTempo) param = chnAdjust.oldTempo;
+					else if (record) param = 0;	// no tempo yet, as on a freshly loaded song
+					else param = Chn[nChn].nOldTempo;
 				}
 				if (param >= 0x20) memory.musicTempo = param; else
 				{
-					// Tempo Slide
-					uint32 tempoDiff = (param & 0x0F)  * (memory.musicSpeed - 1);
+					// Tempo Slide, applied tick by tick below just like the player does
 					if ((param & 0xF0) == 0x10)
-					{
-						memory.musicTempo += tempoDiff;
-					} else
-					{
-						if(tempoDiff < memory.musicTempo)
-							memory.musicTempo -= tempoDiff;
-						else
-							memory.musicTempo = 32;
-					}
+						tempoSlide += (param & 0x0F);
+					else
+						tempoSlide -= (param & 0x0F);
 				}
 // -> CODE#0010
 // -> DESC="add extended parameter mechanism to pattern effects"
@@ -432,21 +716,21 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 			// Portamento Up/Down
 			case CMD_PORTAMENTOUP:
 			case CMD_PORTAMENTODOWN:
-				if (param) pChn->nOldPortaUpDown = param;
+				if (param) chnAdjust.oldPortaUpDown = param;
 				break;
 			// Tone-Portamento
 			case CMD_TONEPORTAMENTO:
-				if (param) pChn->nPortamentoSlide = param << 2;
+				if (param) chnAdjust.portamentoSlide = param;
 				break;
 			// Offset
 			case CMD_OFFSET:
-				if (param) pChn->nOldOffset = param;
+				if (param) chnAdjust.oldOffset = param;
 				break;
 			// Volume Slide
 			case CMD_VOLUMESLIDE:
 			case CMD_TONEPORTAVOL:
 			case CMD_VIBRATOVOL:
-				if (param) pChn->nOldVolumeSlide = param;
+				if (param) chnAdjust.oldVolumeSlide = param;
 				break;
 			// Set Volume
 			case CMD_VOLUME:
@@ -508,7 +792,8 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 				break;
 			case CMD_CHANNELVOLSLIDE:
 				if (param) memory.chnSettings[nChn].oldParam = param; else param = memory.chnSettings[nChn].oldParam;
-				pChn->nOldChnVolSlide = param;
+				chnAdjust.oldChnVolSlide = param;
+				chnAdjust.chnVolSlideSet = true;
 				if (((param & 0x0F) == 0x0F) && (param & 0xF0))
 				{
 					param = (param >> 4) + memory.chnSettings[nChn].chnVol;
@@ -549,9 +834,32 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 			rowsPerBeat = Patterns[nPattern].GetRowsPerBeat();
 		}
 
-		const uint32 tickDuration = GetTickDuration(memory.musicTempo, memory.musicSpeed, rowsPerBeat);
-		const uint32 rowDuration = tickDuration * (memory.musicSpeed + tickDelay) * MAX(rowDelay, 1);
-		memory.elapsedTime += static_cast<double>(rowDuration) / static_cast<double>(m_MixerSettings.gdwMixingFreq);
+		const uint32 tickDuration = GetTickDuration(memory.musicTempo, memory.musicSpeed, rowsPerBeat, mixingFreq, memory.bufferDiff);
+		const UINT numTicks = (memory.musicSpeed + tickDelay) * MAX(rowDelay, 1);
+		uint32 rowDuration = tickDuration * numTicks;
+		// In modern tempo mode, ticks of the same tempo differ by the rounding error carried over.
+		if(tempoSlide || m_nTempoMode == tempo_mode_modern)
+		{
+			rowDuration = tickDuration;
+			for(UINT tick = 1; tick < numTicks; tick++)
+			{
+				if(tempoSlide)
+				{
+					int tempo = static_cast<int>(memory.musicTempo) + tempoSlide;
+					if(IsCompatibleMode(TRK_ALLTRACKERS))
+						tempo = CLAMP(tempo, 32, 255);
+					else
+						tempo = CLAMP(tempo, static_cast<int>(GetModSpecifications().tempoMin), static_cast<int>(GetModSpecifications().tempoMax));
+					memory.musicTempo = tempo;
+				}
+				rowDuration += GetTickDuration(memory.musicTempo, memory.musicSpeed, rowsPerBeat, mixingFreq, memory.bufferDiff);
+			}
+		}
+		if(record)
+		{
+			record->AddRow(*this, nCurrentOrder, nRow, Patterns[nPattern].GetRow(nRow), memory.elapsedTime, tickDuration, memory.musicSpeed);
+		}
+		memory.elapsedTime += static_cast<double>(rowDuration) / static_cast<double>(mixingFreq);
 		memory.renderedSamples += rowDuration;
 
 		if(patternLoopEndedOnThisRow)
@@ -562,6 +870,7 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 				if((p->command == CMD_S3MCMDEX && p->param >= 0xB1 && p->param <= 0xBF)
 					|| (p->command == CMD_MODCMDEX && p->param >= 0x61 && p->param <= 0x6F))
 				{
+					if(record) record->RepeatLoop(memory.chnSettings[nChn].patLoop, memory.elapsedTime, p->param & 0x0F);
 					memory.elapsedTime += (memory.elapsedTime - memory.chnSettings[nChn].patLoop) * (double)(p->param & 0x0F);
 				}
 			}
@@ -588,8 +897,24 @@ GetLengthType CSoundFile::GetLength(enmGetLengthResetMode adjustMode, GetLengthT
 	retval.duration = memory.elapsedTime;
 
 	// Store final variables
-	if((adjustMode & eAdjust))
+	if((adjustMode & eAdjust) && !record)
 	{
+		for(CHANNELINDEX n = 0; n < GetNumChannels(); n++)
+		{
+			const GetLengthMemory::ChnAdjust &chnAdjust = memory.chnAdjust[n];
+			if(chnAdjust.resetPatternLoop)
+			{
+				Chn[n].nPatternLoopCount = 0;
+				Chn[n].nPatternLoop = 0;
+			}
+			if(chnAdjust.oldTempo) Chn[n].nOldTempo = chnAdjust.oldTempo;
+			if(chnAdjust.oldPortaUpDown) Chn[n].nOldPortaUpDown = chnAdjust.oldPortaUpDown;
+			if(chnAdjust.portamentoSlide) Chn[n].nPortamentoSlide = chnAdjust.portamentoSlide << 2;
+			if(chnAdjust.oldOffset) Chn[n].nOldOffset = chnAdjust.oldOffset;
+			if(chnAdjust.oldVolumeSlide) Chn[n].nOldVolumeSlide = chnAdjust.oldVolumeSlide;
+			if(chnAdjust.chnVolSlideSet) Chn[n].nOldChnVolSlide = chnAdjust.oldChnVolSlide;
+		}
+
 		if(retval.targetReached || target.mode == GetLengthTarget::NoTarget)
 		{
 			// Target found, or there is no target (i.e. play whole song)...
@@ -1110,7 +1435,7 @@ void CSoundFile::NoteChange(CHANNELINDEX nChn, int note, bool bPorta, bool bRese
 	if ((!bPorta) || (GetType() & (MOD_TYPE_S3M|MOD_TYPE_IT|MOD_TYPE_MPT)))
 		pChn->nNewIns = 0;
 
-	UINT period = GetPeriodFromNote(note + modStream->get_transposition(nChn), pChn->nFineTune, pChn->nC5Speed);
+	UINT period = GetPeriodFromNote(note + GetChannelTranspose(nChn), pChn->nFineTune, pChn->nC5Speed);
 
 	if(!pSmp) return;
 	if(period)
@@ -1324,13 +1649,20 @@ void CSoundFile::NoteChange(CHANNELINDEX nChn, int note, bool bPorta, bool bRese
 	////////////////////////////////////////////////////////
 	// Modipulate
 	////////////////////////////////////////////////////////
-	modStream->on_note_change(
-		nChn,	// Channel #
-		note,   // Note ID
-		pChn->pModInstrument ? pChn->pModInstrument->index : -1, // Instrument pointer
-		pChn->pModSample ? pChn->pModSample->index : -1,     // Sample pointer
-		pChn->nVolume         // Volume
-		);
+	if(m_pSoundHooks != nullptr)
+	{
+		m_pSoundHooks->OnNoteChange(
+			nChn,	// Channel #
+			note,   // Note ID
+			pChn->pModInstrument ? pChn->pModInstrument->index : -1, // Instrument pointer
+			pChn->pModSample ? pChn->pModSample->index : -1,     // Sample pointer
+			pChn->nVolume,        // Volume
+			pChn->rowCommand.volcmd,
+			pChn->rowCommand.vol,
+			pChn->rowCommand.command,
+			pChn->rowCommand.param
+			);
+	}
 }
 
 
@@ -1379,7 +1711,7 @@ void CSoundFile::CheckNNA(CHANNELINDEX nChn, UINT instr, int note, bool forceCut
 	// Always NNA cut - using
 	if(!(GetType() & (MOD_TYPE_IT | MOD_TYPE_MPT | MOD_TYPE_MT2)) || !m_nInstruments || forceCut)
 	{
-        if(!pChn->nLength || pChn->dwFlags[CHN_MUTE] || !(pChn->rightVol | pChn->leftVol) || !modStream->get_channel_enabled(nChn)) // MODIPULATE
+        if(!pChn->nLength || pChn->dwFlags[CHN_MUTE] || !(pChn->rightVol | pChn->leftVol) || !IsChannelEnabled(nChn)) // MODIPULATE
 		{
 			return;
 		}
@@ -1429,7 +1761,7 @@ void CSoundFile::CheckNNA(CHANNELINDEX nChn, UINT instr, int note, bool forceCut
 	}
 	ModChannel *p = pChn;
 	//if (!pIns) return;
-	if (pChn->dwFlags[CHN_MUTE] || !modStream->get_channel_enabled(nChn)) return; // MODIPULATE
+	if (pChn->dwFlags[CHN_MUTE] || !IsChannelEnabled(nChn)) return; // MODIPULATE
 
 	bool applyDNAtoPlug;	//rewbs.VSTiNNA
 
@@ -1624,7 +1956,7 @@ BOOL CSoundFile::ProcessEffects()
 // -! NEW_FEATURE#0010
 	for(CHANNELINDEX nChn = 0; nChn < GetNumChannels(); nChn++, pChn++)
 	{
-        if (!modStream->get_channel_enabled(nChn)) continue; // MODIPULATE
+        if (!IsChannelEnabled(nChn)) continue; // MODIPULATE
 
 		UINT instr = pChn->rowCommand.instr;
 		UINT volcmd = pChn->rowCommand.volcmd;
@@ -1640,41 +1972,50 @@ BOOL CSoundFile::ProcessEffects()
 		pChn->dwFlags.reset(CHN_FASTVOLRAMP);
 
         // MODIPULATE
-        if (!modStream->is_effect_command_enabled(nChn, cmd)) {
+        if (!IsChannelEffectEnabled(nChn, cmd)) {
             cmd = 0; // Suppress effect command.
         }
 
-        if (!modStream->is_volume_command_enabled(nChn, volcmd)) {
+        if (!IsChannelVolCmdEnabled(nChn, volcmd)) {
             volcmd = 0; // Suppress volume command.
         }
 
-		if (!m_nTickCount) {
-			if (modStream->is_effect_command_pending(nChn)) {
-				// Overwrite effect command.
-				cmd = modStream->pop_effect_command(nChn);
-				param = modStream->pop_effect_parameter(nChn);
-			}
-
-			if (modStream->is_volume_command_pending(nChn)) {
-				// Overwrite volume command.
-				volcmd = modStream->pop_volume_command(nChn);
-				vol = modStream->pop_volume_parameter(nChn);
-			}
-
-			// Check for pending samples.
-			ModStreamPendingSample* pending_sample = modStream->get_pending_for(nChn, m_nRow);
-			if (pending_sample) {
-				instr = pending_sample->sample;
-				volcmd = pending_sample->volume_command;
-				vol = pending_sample->volume_value;
-				cmd = pending_sample->effect_command;
-				param = pending_sample->effect_value;
-				note = pending_sample->note;
-
-				// TODO:
-				// int velocity;
-
-                pending_sample->used = true;
+		if (!m_nTickCount && m_pSoundHooks != nullptr) {
+			// Let the application inject commands or trigger samples.
+			UINT delay = 0;
+			m_pSoundHooks->OnRowCommand(nChn, m_nRow, note, instr, volcmd, vol, cmd, param, delay);
+
+			pChn->hookStartTick = 0;
+			pChn->rowStartTick = 0;
+			if (delay) {
+				// The later ticks of the row read the row command again, so that's where a
+				// delayed note has to go.
+				pChn->rowCommand.note = static_cast<ModCommand::NOTE>(note);
+				pChn->rowCommand.instr = static_cast<ModCommand::INSTR>(instr);
+				pChn->rowCommand.volcmd = static_cast<ModCommand::VOLCMD>(volcmd);
+				pChn->rowCommand.vol = static_cast<ModCommand::VOL>(vol);
+				pChn->rowCommand.command = static_cast<ModCommand::COMMAND>(cmd);
+				pChn->rowCommand.param = static_cast<ModCommand::PARAM>(param);
+				pChn->hookStartTick = std::min<UINT>(delay, GetNumTicksOnCurrentRow() - 1);
+			}
+		} else if (m_nTickCount && m_pSoundHooks != nullptr) {
+			if (m_pSoundHooks->OnTickCommand(nChn, volcmd, vol, cmd, param)) {
+				pChn->rowCommand.volcmd = static_cast<ModCommand::VOLCMD>(volcmd);
+				pChn->rowCommand.vol = static_cast<ModCommand::VOL>(vol);
+				pChn->rowCommand.command = static_cast<ModCommand::COMMAND>(cmd);
+				pChn->rowCommand.param = static_cast<ModCommand::PARAM>(param);
+				if (m_nTickCount > pChn->rowStartTick) {
+					// The note has played, so the commands start here on their own.
+					pChn->rowCommand.note = NOTE_NONE;
+					pChn->rowCommand.instr = 0;
+					note = NOTE_NONE;
+					instr = 0;
+					pChn->hookStartTick = m_nTickCount;
+				} else {
+					// The note is still to come, held back by a note delay the
+					// commands may just have replaced; they go along with it.
+					pChn->hookStartTick = pChn->rowStartTick;
+				}
 			}
 		}
 		
@@ -1790,7 +2131,7 @@ BOOL CSoundFile::ProcessEffects()
 				// Pattern Loop ?
 				if((((param & 0xF0) == 0x60 && cmd == CMD_MODCMDEX)
 					|| ((param & 0xF0) == 0xB0 && cmd == CMD_S3MCMDEX))
-                    && !(GetType() == MOD_TYPE_S3M && (ChnSettings[nChn].dwFlags[CHN_MUTE] || !modStream->get_channel_enabled(nChn))))	// not even effects are processed on muted S3M channels
+                    && !(GetType() == MOD_TYPE_S3M && (ChnSettings[nChn].dwFlags[CHN_MUTE] || !IsChannelEnabled(nChn))))	// not even effects are processed on muted S3M channels
 				{
 					ROWINDEX nloop = PatternLoop(pChn, param & 0x0F);
 					if (nloop != ROWINDEX_INVALID)
@@ -1833,6 +2174,13 @@ BOOL CSoundFile::ProcessEffects()
 			}
 		}
 
+		// MODIPULATE: Note delayed by the sound hooks
+		if(pChn->hookStartTick)
+		{
+			nStartTick = pChn->hookStartTick;
+		}
+		pChn->rowStartTick = nStartTick;
+
 		if(nStartTick != 0 && note == NOTE_KEYOFF && pChn->rowCommand.volcmd == VOLCMD_PANNING && IsCompatibleMode(TRK_FASTTRACKER2))
 		{
 			// FT2 compatibility: If there's a delayed note off, panning commands are ignored. WTF!
@@ -2150,7 +2498,7 @@ BOOL CSoundFile::ProcessEffects()
 #endif // MODPLUG_TRACKER
 		}
 
-		if((GetType() == MOD_TYPE_S3M) && (ChnSettings[nChn].dwFlags[CHN_MUTE] || !modStream->get_channel_enabled(nChn)))	// not even effects are processed on muted S3M channels
+		if((GetType() == MOD_TYPE_S3M) && (ChnSettings[nChn].dwFlags[CHN_MUTE] || !IsChannelEnabled(nChn)))	// not even effects are processed on muted S3M channels
 			continue;
 
 		// Volume Column Effect (except volume & panning)
@@ -3136,7 +3484,7 @@ void CSoundFile::NoteSlide(ModChannel *pChn, UINT param, bool slideUp, bool retr
 			pChn->nNoteSlideCounter = pChn->nNoteSlideSpeed;
 			// update it
 			pChn->nPeriod = GetPeriodFromNote
-				((slideUp ? 1 : -1)  * pChn->nNoteSlideStep + GetNoteFromPeriod(pChn->nPeriod) + modStream->get_transposition(nChn), 8363, 0);
+				((slideUp ? 1 : -1)  * pChn->nNoteSlideStep + GetNoteFromPeriod(pChn->nPeriod) + GetChannelTranspose(nChn), 8363, 0);
 
 			if(retrig)
 			{
@@ -3546,11 +3894,11 @@ void CSoundFile::ExtendedMODCommands(CHANNELINDEX nChn, UINT param)
 				if(GetType() & (MOD_TYPE_MOD | MOD_TYPE_DIGI | MOD_TYPE_AMF0 | MOD_TYPE_MED))
 				{
 					pChn->nFineTune = MOD2XMFineTune(param);
-					if(pChn->nPeriod && pChn->rowCommand.IsNote()) pChn->nPeriod = GetPeriodFromNote(pChn->nNote + modStream->get_transposition(nChn), pChn->nFineTune, pChn->nC5Speed);
+					if(pChn->nPeriod && pChn->rowCommand.IsNote()) pChn->nPeriod = GetPeriodFromNote(pChn->nNote + GetChannelTranspose(nChn), pChn->nFineTune, pChn->nC5Speed);
 				} else if(pChn->rowCommand.IsNote())
 				{
 					pChn->nFineTune = MOD2XMFineTune(param - 8);
-					if(pChn->nPeriod) pChn->nPeriod = GetPeriodFromNote(pChn->nNote + modStream->get_transposition(nChn), pChn->nFineTune, pChn->nC5Speed);
+					if(pChn->nPeriod) pChn->nPeriod = GetPeriodFromNote(pChn->nNote + GetChannelTranspose(nChn), pChn->nFineTune, pChn->nC5Speed);
 
 				}
 				break;
@@ -3609,7 +3957,7 @@ void CSoundFile::ExtendedS3MCommands(CHANNELINDEX nChn, UINT param)
 	case 0x20:	if(!m_SongFlags[SONG_FIRSTTICK]) break;
 				pChn->nC5Speed = S3MFineTuneTable[param];
 				pChn->nFineTune = MOD2XMFineTune(param);
-				if (pChn->nPeriod) pChn->nPeriod = GetPeriodFromNote(pChn->nNote + modStream->get_transposition(nChn), pChn->nFineTune, pChn->nC5Speed);
+				if (pChn->nPeriod) pChn->nPeriod = GetPeriodFromNote(pChn->nNote + GetChannelTranspose(nChn), pChn->nFineTune, pChn->nC5Speed);
 				break;
 	// S3x: Set Vibrato Waveform
 	case 0x30:	if(GetType() == MOD_TYPE_S3M)
@@ -4939,7 +5287,7 @@ PLUGINDEX CSoundFile::GetChannelPlugin(CHANNELINDEX nChn, PluginMutePriority res
 	const ModChannel &channel = Chn[nChn];
 
 	PLUGINDEX nPlugin;
-	if((respectMutes == RespectMutes && channel.dwFlags[CHN_MUTE]) || channel.dwFlags[CHN_NOFX] || !modStream->get_channel_enabled(nChn))
+	if((respectMutes == RespectMutes && channel.dwFlags[CHN_MUTE]) || channel.dwFlags[CHN_NOFX] || !IsChannelEnabled(nChn))
 	{
 		nPlugin = 0;
 	} else
@@ -4967,7 +5315,7 @@ PLUGINDEX CSoundFile::GetActiveInstrumentPlugin(CHANNELINDEX nChn, PluginMutePri
 	PLUGINDEX plug = 0;
 	if(Chn[nChn].pModInstrument != nullptr)
 	{
-		if((respectMutes == RespectMutes && Chn[nChn].pModSample && Chn[nChn].pModSample->uFlags[CHN_MUTE]) || !modStream->get_channel_enabled(nChn))
+		if((respectMutes == RespectMutes && Chn[nChn].pModSample && Chn[nChn].pModSample->uFlags[CHN_MUTE]) || !IsChannelEnabled(nChn))
 		{
 			plug = 0;
 		} else
@@ -30,7 +30,6 @@
 #include "../unarchiver/unarchiver.h"
 #endif // NO_ARCHIVE_SUPPORT
 
-#include "../mod_stream.h"
 
 // -> CODE#0027
 // -> DESC="per-instrument volume ramping setup (refered as attack)"
@@ -573,7 +572,8 @@ CSoundFile::CSoundFile() :
 	m_MIDIMapper(*this),
 #endif
 	visitedSongRows(*this),
-	m_pCustomLog(nullptr)
+	m_pCustomLog(nullptr),
+	m_pSoundHooks(nullptr)
 #if MPT_COMPILER_MSVC
 #pragma warning(default : 4355) // "'this' : used in base member initializer list"
 #endif
@@ -591,8 +591,10 @@ CSoundFile::CSoundFile() :
 	m_nSamples = 0;
 	m_nInstruments = 0;
 #ifndef MODPLUG_TRACKER
-	m_nFreqFactor = m_nTempoFactor = 128;
+	m_nFreqFactor = m_nTempoFactor = PLAYBACK_FACTOR_UNITY;
+	m_dRowSeconds = m_dMixSeconds = 0.0;
 #endif
+	m_dSongTimeRendered = 0.0;
 	m_nMinPeriod = MIN_PERIOD;
 	m_nMaxPeriod = 0x7FFF;
 	m_nRepeatCount = 0;
@@ -628,8 +630,10 @@ CSoundFile::CSoundFile() :
 	m_bPositionChanged = true;
 
     for (int i = 0; i < MAX_CHANNELS; i++) {
-        Chn[i].current_amplitude = 1.0;
+        Chn[i].fadeGain = Chn[i].fadeTarget = 1.0;
+        Chn[i].fadeSamplesLeft = 0;
     }
+	ResetChannelOverrides();
 
 #ifndef MODPLUG_TRACKER
 	m_pTuningsBuiltIn = new CTuningCollection();
@@ -709,6 +713,154 @@ void CSoundFile::InitializeChannels()
 }
 
 
+// Magic bytes that a format's header has to contain.
+struct ModFormatSignature
+{
+	uint16 offset;
+	uint8 length;
+	bool ignoreCase;
+	const char *magic;
+};
+
+// One entry of the loader chain.
+struct ModFormatLoader
+{
+	bool (CSoundFile::*readFile)(FileReader &file, CSoundFile::ModLoadingFlags loadFlags);
+	bool (CSoundFile::*readMemory)(const LPCBYTE lpStream, const DWORD dwMemLength, CSoundFile::ModLoadingFlags loadFlags);
+	// The loader rejects any file that doesn't have one of these.
+	// Headerless formats have none and are always tried.
+	ModFormatSignature signatures[2];
+};
+
+// Longest header that is looked at to pick the loaders (IMF keeps its magic at 60).
+#define MOD_SIGNATURE_BYTES 64
+
+#define FILE_LOADER(fn) &CSoundFile::fn, nullptr
+#define MEMORY_LOADER(fn) nullptr, &CSoundFile::fn
+#define SIGNATURE(offset, magic) { offset, sizeof(magic) - 1, false, magic }
+#define SIGNATURE_NOCASE(offset, magic) { offset, sizeof(magic) - 1, true, magic }
+#define NO_SIGNATURE { 0, 0, false, nullptr }
+
+// All loaders, in the order they get to look at a file. Formats that share a
+// magic (or have none) stay in their original order, so every file still ends
+// up with the same loader as when each one was tried in turn.
+static const ModFormatLoader ModFormatLoaders[] =
+{
+	{ FILE_LOADER(ReadXM),           { SIGNATURE_NOCASE(0, "Extended Module: "), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadITProject),    { NO_SIGNATURE, NO_SIGNATURE } },
+	{ FILE_LOADER(ReadITQ),          { SIGNATURE(0, "ITQM"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadIT),           { SIGNATURE(0, "IMPM"), SIGNATURE(0, "tpm.") } },
+	{ FILE_LOADER(ReadS3M),          { SIGNATURE(44, "SCRM"), NO_SIGNATURE } },
+#ifdef MODPLUG_TRACKER
+	// this makes little sense for a module player library
+	{ FILE_LOADER(ReadWav),          { NO_SIGNATURE, NO_SIGNATURE } },
+#endif // MODPLUG_TRACKER
+	{ FILE_LOADER(ReadSTM),          { SIGNATURE_NOCASE(20, "!SCREAM!"), SIGNATURE_NOCASE(20, "BMOD2STM") } },
+	{ MEMORY_LOADER(ReadMed),        { SIGNATURE(0, "MMD"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadMTM),          { SIGNATURE(0, "MTM"), NO_SIGNATURE } },
+	{ MEMORY_LOADER(ReadMDL),        { SIGNATURE(0, "DMDL"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadDBM),          { SIGNATURE(0, "DBM0"), NO_SIGNATURE } },
+	{ FILE_LOADER(Read669),          { SIGNATURE(0, "if"), SIGNATURE(0, "JN") } },
+	{ FILE_LOADER(ReadFAR),          { SIGNATURE(0, "FAR\xFE"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadAMS),          { SIGNATURE(0, "Extreme"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadAMS2),         { SIGNATURE(0, "AMShdr\x1A"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadOKT),          { SIGNATURE(0, "OKTASONG"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadPTM),          { SIGNATURE(44, "PTMF"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadUlt),          { SIGNATURE(0, "MAS_UTrack_V00"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadDMF),          { SIGNATURE(0, "DDMF"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadDSM),          { SIGNATURE(0, "RIFF"), SIGNATURE(0, "DSMF") } },
+	{ FILE_LOADER(ReadUMX),          { SIGNATURE(0, "\xC1\x83\x2A\x9E"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadAMF_Asylum),   { SIGNATURE(0, "ASYLUM Music Format V1.0\0"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadAMF_DSMI),     { SIGNATURE(0, "AMF"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadPSM),          { SIGNATURE(0, "PSM "), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadPSM16),        { SIGNATURE(0, "PSM\xFE"), NO_SIGNATURE } },
+	{ MEMORY_LOADER(ReadMT2),        { SIGNATURE(0, "MT20"), NO_SIGNATURE } },
+#ifdef MODPLUG_TRACKER
+	{ MEMORY_LOADER(ReadMID),        { NO_SIGNATURE, NO_SIGNATURE } },
+#endif // MODPLUG_TRACKER
+	{ FILE_LOADER(ReadGDM),          { SIGNATURE(0, "GDM\xFE"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadIMF),          { SIGNATURE(60, "IM10"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadDIGI),         { SIGNATURE(0, "DIGI Booster module\0"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadAM),           { SIGNATURE(0, "RIFF"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadJ2B),          { SIGNATURE(0, "MUSE"), NO_SIGNATURE } },
+	{ FILE_LOADER(ReadMO3),          { SIGNATURE(0, "MO3"), NO_SIGNATURE } },
+	// The MOD magic sits at 1080 and comes in too many variations, M15 has none.
+	{ FILE_LOADER(ReadMod),          { NO_SIGNATURE, NO_SIGNATURE } },
+	{ FILE_LOADER(ReadM15),          { NO_SIGNATURE, NO_SIGNATURE } },
+};
+
+#undef FILE_LOADER
+#undef MEMORY_LOADER
+#undef SIGNATURE
+#undef SIGNATURE_NOCASE
+#undef NO_SIGNATURE
+
+
+static bool MatchesSignature(const ModFormatSignature &signature, const char *header, size_t headerSize)
+//----------------------------------------------------------------------------------------------------
+{
+	if(signature.offset + signature.length > headerSize)
+	{
+		return false;
+	}
+	if(signature.ignoreCase)
+	{
+		return mpt::strnicmp(header + signature.offset, signature.magic, signature.length) == 0;
+	}
+	return memcmp(header + signature.offset, signature.magic, signature.length) == 0;
+}
+
+
+// Can this loader possibly accept a file that starts with header?
+static bool MayAccept(const ModFormatLoader &loader, const char *header, size_t headerSize)
+//-----------------------------------------------------------------------------------------
+{
+	if(loader.signatures[0].magic == nullptr)
+	{
+		return true;
+	}
+	for(size_t i = 0; i < CountOf(loader.signatures); i++)
+	{
+		if(loader.signatures[i].magic != nullptr && MatchesSignature(loader.signatures[i], header, headerSize))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+bool CSoundFile::ReadAnyFormat(FileReader &file, ModLoadingFlags loadFlags)
+//-------------------------------------------------------------------------
+{
+	char header[MOD_SIGNATURE_BYTES];
+	file.Rewind();
+	const size_t headerSize = file.ReadRaw(header, sizeof(header));
+
+	file.Rewind();
+	LPCBYTE lpStream = reinterpret_cast<const unsigned char*>(file.GetRawData());
+	DWORD dwMemLength = file.GetLength();
+
+	for(size_t i = 0; i < CountOf(ModFormatLoaders); i++)
+	{
+		const ModFormatLoader &loader = ModFormatLoaders[i];
+		if(!MayAccept(loader, header, headerSize))
+		{
+			continue;
+		}
+
+		const bool success = (loader.readFile != nullptr)
+			? (this->*loader.readFile)(file, loadFlags)
+			: (this->*loader.readMemory)(lpStream, dwMemLength, loadFlags);
+		if(success)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
 #ifdef MODPLUG_TRACKER
 BOOL CSoundFile::Create(FileReader file, ModLoadingFlags loadFlags, CModDoc *pModDoc)
 //-----------------------------------------------------------------------------------
@@ -722,8 +874,10 @@ BOOL CSoundFile::Create(FileReader file, ModLoadingFlags loadFlags)
 
 	m_nMixChannels = 0;
 #ifndef MODPLUG_TRACKER
-	m_nFreqFactor = m_nTempoFactor = 128;
+	m_nFreqFactor = m_nTempoFactor = PLAYBACK_FACTOR_UNITY;
+	m_TempoRamp = m_PitchRamp = PlaybackFactorRamp();
 #endif
+	m_dSongTimeRendered = 0.0;
 	m_nGlobalVolume = MAX_GLOBAL_VOLUME;
 	m_nOldGlbVolSlide = 0;
 
@@ -757,63 +911,29 @@ BOOL CSoundFile::Create(FileReader file, ModLoadingFlags loadFlags)
 		}
 #endif
 
+		// Only hand the file to the unpacker its magic bytes point at.
 		MODCONTAINERTYPE packedContainerType = MOD_CONTAINERTYPE_NONE;
 		std::vector<char> unpackedData;
-		if(packedContainerType == MOD_CONTAINERTYPE_NONE && UnpackXPK(unpackedData, file)) packedContainerType = MOD_CONTAINERTYPE_XPK;
-		if(packedContainerType == MOD_CONTAINERTYPE_NONE && UnpackPP20(unpackedData, file)) packedContainerType = MOD_CONTAINERTYPE_PP20;
-		if(packedContainerType == MOD_CONTAINERTYPE_NONE && UnpackMMCMP(unpackedData, file)) packedContainerType = MOD_CONTAINERTYPE_MMCMP;
+		char packMagic[8];
+		file.Rewind();
+		if(file.ReadArray(packMagic))
+		{
+			if(!memcmp(packMagic, "XPKF", 4) && UnpackXPK(unpackedData, file)) packedContainerType = MOD_CONTAINERTYPE_XPK;
+			else if(!memcmp(packMagic, "PP20", 4) && UnpackPP20(unpackedData, file)) packedContainerType = MOD_CONTAINERTYPE_PP20;
+			else if(!memcmp(packMagic, "ziRCONia", 8) && UnpackMMCMP(unpackedData, file)) packedContainerType = MOD_CONTAINERTYPE_MMCMP;
+		}
 		if(packedContainerType != MOD_CONTAINERTYPE_NONE)
 		{
 			file = FileReader(&(unpackedData[0]), unpackedData.size());
 		}
 
-		file.Rewind();
-		LPCBYTE lpStream = reinterpret_cast<const unsigned char*>(file.GetRawData());
-		DWORD dwMemLength = file.GetLength();
-
-		if(!ReadXM(file, loadFlags)
-// -> CODE#0023
-// -> DESC="IT project files (.itp)"
-		 && !ReadITProject(file, loadFlags)
-// -! NEW_FEATURE#0023
-		 && !ReadITQ(file, loadFlags)
-		 && !ReadIT(file, loadFlags)
-		 && !ReadS3M(file, loadFlags)
-#ifdef MODPLUG_TRACKER
-		// this makes little sense for a module player library
-		 && !ReadWav(file, loadFlags)
-#endif // MODPLUG_TRACKER
-		 && !ReadSTM(file, loadFlags)
-		 && !ReadMed(lpStream, dwMemLength, loadFlags)
-		 && !ReadMTM(file, loadFlags)
-		 && !ReadMDL(lpStream, dwMemLength, loadFlags)
-		 && !ReadDBM(file, loadFlags)
-		 && !Read669(file, loadFlags)
-		 && !ReadFAR(file, loadFlags)
-		 && !ReadAMS(file, loadFlags)
-		 && !ReadAMS2(file, loadFlags)
-		 && !ReadOKT(file, loadFlags)
-		 && !ReadPTM(file, loadFlags)
-		 && !ReadUlt(file, loadFlags)
-		 && !ReadDMF(file, loadFlags)
-		 && !ReadDSM(file, loadFlags)
-		 && !ReadUMX(file, loadFlags)
-		 && !ReadAMF_Asylum(file, loadFlags)
-		 && !ReadAMF_DSMI(file, loadFlags)
-		 && !ReadPSM(file, loadFlags)
-		 && !ReadPSM16(file, loadFlags)
-		 && !ReadMT2(lpStream, dwMemLength, loadFlags)
-#ifdef MODPLUG_TRACKER
-		 && !ReadMID(lpStream, dwMemLength, loadFlags)
-#endif // MODPLUG_TRACKER
-		 && !ReadGDM(file, loadFlags)
-		 && !ReadIMF(file, loadFlags)
-		 && !ReadDIGI(file, loadFlags)
-		 && !ReadAM(file, loadFlags)
-		 && !ReadJ2B(file, loadFlags)
-		 && !ReadMO3(file, loadFlags)
-		 && !ReadMod(file, loadFlags)
-		 && !ReadM15(file, loadFlags))
+		const bool recognized = ReadAnyFormat(file, loadFlags);
+		if(loadFlags == onlyVerifyHeader)
+		{
+			// The loaders stop before setting the module type, so their answer is all there is.
+			return recognized;
+		}
+		if(!recognized)
 		{
 			m_nType = MOD_TYPE_NONE;
 			m_ContainerType = MOD_CONTAINERTYPE_NONE;
@@ -1018,6 +1138,10 @@ BOOL CSoundFile::Destroy()
 	}
 
 	Patterns.DestroyPatterns();
+	{
+		std::lock_guard<std::mutex> guard(m_SeekSnapshotsMutex);
+		m_SeekSnapshots.reset();
+	}
 
 	songName.clear();
 	songArtist.clear();
@@ -1053,11 +1177,6 @@ BOOL CSoundFile::Destroy()
 void CSoundFile::SetDspEffects(DWORD DSPMask)
 //-------------------------------------------
 {
-#ifdef ENABLE_ASM
-#ifndef NO_REVERB
-	if(!(GetProcSupport() & PROCSUPPORT_MMX)) DSPMask &= ~SNDDSP_REVERB;
-#endif
-#endif
 	m_MixerSettings.DSPMask = DSPMask;
 	InitPlayer(FALSE);
 }
@@ -1900,7 +2019,7 @@ void CSoundFile::RecalculateSamplesPerTick()
 		break;
 	}
 #ifndef MODPLUG_TRACKER
-	m_nSamplesPerTick = Util::muldivr(m_nSamplesPerTick, m_nTempoFactor, 128);
+	m_nSamplesPerTick = Util::muldivr(m_nSamplesPerTick, m_nTempoFactor, PLAYBACK_FACTOR_UNITY);
 #endif // !MODPLUG_TRACKER
 }
 
@@ -1910,44 +2029,54 @@ void CSoundFile::RecalculateSamplesPerTick()
 // goes wrong.
 UINT CSoundFile::GetTickDuration(UINT tempo, UINT speed, ROWINDEX rowsPerBeat)
 //----------------------------------------------------------------------------
+{
+	UINT retval = GetTickDuration(tempo, speed, rowsPerBeat, m_MixerSettings.gdwMixingFreq, m_dBufferDiff);
+#ifndef MODPLUG_TRACKER
+	// when the user modifies the tempo, we do not really care about accurate tempo error accumulation
+	retval = Util::muldivr(retval, m_nTempoFactor, PLAYBACK_FACTOR_UNITY);
+#endif // !MODPLUG_TRACKER
+	return retval;
+}
+
+
+// Same in song time, i.e. without the tempo multiplier. Used by GetLength(),
+// which keeps its own bufferDiff so it doesn't upset the player's.
+UINT CSoundFile::GetTickDuration(UINT tempo, UINT speed, ROWINDEX rowsPerBeat, uint32 mixingFreq, double &bufferDiff) const
+//-------------------------------------------------------------------------------------------------------------------------
 {
 	UINT retval = 0;
 	switch(m_nTempoMode)
 	{
 	case tempo_mode_classic:
 	default:
-		retval = (m_MixerSettings.gdwMixingFreq * 5) / (tempo << 1);
+		retval = (mixingFreq * 5) / (tempo << 1);
 		break;
 
 	case tempo_mode_alternative:
-		retval = m_MixerSettings.gdwMixingFreq / tempo;
+		retval = mixingFreq / tempo;
 		break;
 
 	case tempo_mode_modern:
 		{
-			double accurateBufferCount = static_cast<double>(m_MixerSettings.gdwMixingFreq) * (60.0 / static_cast<double>(tempo) / (static_cast<double>(speed * rowsPerBeat)));
+			double accurateBufferCount = static_cast<double>(mixingFreq) * (60.0 / static_cast<double>(tempo) / (static_cast<double>(speed * rowsPerBeat)));
 			UINT bufferCount = static_cast<int>(accurateBufferCount);
-			m_dBufferDiff += accurateBufferCount - bufferCount;
+			bufferDiff += accurateBufferCount - bufferCount;
 
 			//tick-to-tick tempo correction:
-			if(m_dBufferDiff >= 1)
+			if(bufferDiff >= 1)
 			{
 				bufferCount++;
-				m_dBufferDiff--;
-			} else if(m_dBufferDiff <= -1)
+				bufferDiff--;
+			} else if(bufferDiff <= -1)
 			{
 				bufferCount--;
-				m_dBufferDiff++;
+				bufferDiff++;
 			}
-			ASSERT(abs(m_dBufferDiff) < 1);
+			ASSERT(abs(bufferDiff) < 1);
 			retval = bufferCount;
 		}
 		break;
 	}
-#ifndef MODPLUG_TRACKER
-	// when the user modifies the tempo, we do not really care about accurate tempo error accumulation
-	retval = Util::muldivr(retval, m_nTempoFactor, 128);
-#endif // !MODPLUG_TRACKER
 	return retval;
 }
 
@@ -2399,4 +2528,38 @@ void CSoundFile::UpgradeSong()
 	}
 
 	Patterns.ForEachModCommand(UpgradePatternData(*this));
-}
\ No newline at end of file
+}
+
+// Modipulate
+
+void CSoundFile::ResetChannelOverrides()
+//--------------------------------------
+{
+	for(CHANNELINDEX nChn = 0; nChn < MAX_CHANNELS; nChn++)
+	{
+		m_bChannelEnabled[nChn] = true;
+		m_nChannelTranspose[nChn] = 0;
+		m_ChannelEffectMask[nChn] = ~uint64(0);
+		m_ChannelVolCmdMask[nChn] = ~uint32(0);
+	}
+}
+
+
+void CSoundFile::SetChannelEffectEnabled(CHANNELINDEX nChn, UINT cmd, bool enabled)
+//---------------------------------------------------------------------------------
+{
+	if(enabled)
+		m_ChannelEffectMask[nChn] |= (uint64(1) << cmd);
+	else
+		m_ChannelEffectMask[nChn] &= ~(uint64(1) << cmd);
+}
+
+
+void CSoundFile::SetChannelVolCmdEnabled(CHANNELINDEX nChn, UINT volcmd, bool enabled)
+//------------------------------------------------------------------------------------
+{
+	if(enabled)
+		m_ChannelVolCmdMask[nChn] |= (uint32(1) << volcmd);
+	else
+		m_ChannelVolCmdMask[nChn] &= ~(uint32(1) << volcmd);
+}
@@ -18,6 +18,7 @@
 #include <vector>
 #include <bitset>
 #include <set>
+#include <mutex>
 #include "Snd_defs.h"
 #include "tuning.h"
 #include "MIDIMacros.h"
@@ -47,10 +48,9 @@
 #include "plugins/PlugInterface.h"
 #include "RowVisitor.h"
 #include "Message.h"
+#include "SoundHooks.h"
 
 
-class ModStream; // modipulate!
-
 class FileReader;
 // -----------------------------------------------------------------------------------------
 // MODULAR ModInstrument FIELD ACCESS : body content at the (near) top of Sndfile.cpp !!!
@@ -165,6 +165,54 @@ struct GetLengthTarget
 };
 
 
+// A note in the song, as found by CSoundFile::BuildSeekSnapshots()
+struct NoteTimelineEvent
+{
+	uint32 samplePos;		// when the note starts, at the mixing rate the timeline was built for
+	ROWINDEX row;
+	ORDERINDEX order;
+	CHANNELINDEX channel;
+	ModCommand::NOTE note;	// note, or one of the NOTE_KEYOFF / NOTE_NOTECUT / NOTE_FADE / ... specials
+	ModCommand::INSTR instr;
+	ModCommand::VOLCMD volcmd;
+	ModCommand::VOL vol;
+	ModCommand::COMMAND command;
+	ModCommand::PARAM param;
+};
+
+
+// A tempo or pitch multiplier that glides linearly to a new value over a
+// number of rendered samples.
+struct PlaybackFactorRamp
+{
+	double start, target;
+	uint32 length, position;
+
+	PlaybackFactorRamp() : start(1.0), target(1.0), length(0), position(0) { }
+
+	void Set(double value, uint32 rampSamples)
+	{
+		start = Get();
+		target = value;
+		length = rampSamples;
+		position = 0;
+	}
+
+	double Get() const
+	{
+		if(position >= length) return target;
+		return start + (target - start) * position / length;
+	}
+
+	void Advance(uint32 samples)
+	{
+		position = (length - position > samples) ? position + samples : length;
+	}
+
+	bool IsRamping() const { return position < length; }
+};
+
+
 // Reset mode for GetLength()
 enum enmGetLengthResetMode
 {
@@ -199,6 +247,7 @@ DECLARE_FLAGSET(ModSpecificFlag)
 
 
 class CTuningCollection;
+class SeekSnapshots;
 #ifdef MODPLUG_TRACKER
 class CModDoc;
 #endif // MODPLUG_TRACKER
@@ -244,7 +293,7 @@ struct TimingInfo
 class IAudioReadTarget
 {
 public:
-	virtual void DataCallback(int *MixSoundBuffer, std::size_t channels, std::size_t countChunk) = 0;
+	virtual void DataCallback(mixsample_t *MixSoundBuffer, std::size_t channels, std::size_t countChunk) = 0;
 };
 
 
@@ -415,9 +464,13 @@ public:
 	long m_lHighResRampingGlobalVolume;
 	bool IsGlobalVolumeUnset() const { return IsFirstTick(); }
 #ifndef MODPLUG_TRACKER
-	UINT m_nFreqFactor; // Pitch shift factor (128 = no pitch shifting). Interesting ModPlug Player relict, but unused in OpenMPT.
-	UINT m_nTempoFactor; // Tempo factor (128 = no tempo adjustment). Interesting ModPlug Player relict, but unused in OpenMPT.
+	UINT m_nFreqFactor; // Pitch shift factor (PLAYBACK_FACTOR_UNITY = no pitch shifting), follows m_PitchRamp.
+	UINT m_nTempoFactor; // Tick duration factor (PLAYBACK_FACTOR_UNITY = no tempo adjustment), follows m_TempoRamp.
+	PlaybackFactorRamp m_TempoRamp, m_PitchRamp;
+	double m_dRowSeconds;	// Time Read() has spent in ReadNote(): rows, effects and channel setup
+	double m_dMixSeconds;	// Time Read() has spent in CreateStereoMix()
 #endif
+	double m_dSongTimeRendered;	// Seconds of song time rendered so far, see GetSongTimeRendered()
 	UINT m_nOldGlbVolSlide;
 	LONG m_nMinPeriod, m_nMaxPeriod;	// min period = highest possible frequency, max period = lowest possible frequency
 	LONG m_nRepeatCount;	// -1 means repeat infinitely.
@@ -453,6 +506,10 @@ protected:
 	// For handling backwards jumps and stuff to prevent infinite loops when counting the mod length or rendering to wav.
 	RowVisitor visitedSongRows;
 
+	// Playback state snapshots for seeking, see BuildSeekSnapshots().
+	MPT_SHARED_PTR<const SeekSnapshots> m_SeekSnapshots;
+	mutable std::mutex m_SeekSnapshotsMutex;
+
 public:
 
 	std::string songName;
@@ -567,6 +624,47 @@ public:
 	//specific order&row etc. Return value is in seconds.
 	GetLengthType GetLength(enmGetLengthResetMode adjustMode, GetLengthTarget target = GetLengthTarget());
 
+	// Simulates the current sequence once at the given mixing rate and keeps
+	// a snapshot of the playback state every few rows. Seeking with
+	// GetLength() then only simulates the rows after the nearest snapshot.
+	// The snapshots are ignored once the mixing rate or sequence change.
+	// They are in song time, so the live tempo multiplier doesn't matter. Doesn't touch the playback state, so it may run on
+	// another thread while the song is playing.
+	// The same pass records every note of the song for GetNoteTimeline().
+	void BuildSeekSnapshots(uint32 mixingFreq);
+#ifndef MODPLUG_TRACKER
+	// Live tempo and pitch multipliers, 1.0 being the song's own. They glide
+	// to the new value over rampSamples rendered samples. The player picks
+	// up the tempo at the start of every tick, and the pitch every few
+	// samples while it glides.
+	void SetTempoMultiplier(double multiplier, uint32 rampSamples) { m_TempoRamp.Set(multiplier, rampSamples); }
+	double GetTempoMultiplier() const { return m_TempoRamp.Get(); }
+	void SetPitchMultiplier(double multiplier, uint32 rampSamples) { m_PitchRamp.Set(multiplier, rampSamples); }
+	double GetPitchMultiplier() const { return m_PitchRamp.Get(); }
+
+	// Wall clock time Read() has spent processing rows and mixing since the
+	// song was loaded, to tell which one a slow render is down to.
+	void GetRenderTimes(double &rowSeconds, double &mixSeconds) const { rowSeconds = m_dRowSeconds; mixSeconds = m_dMixSeconds; }
+
+	// Brings m_nFreqFactor up to date with m_PitchRamp in the middle of a
+	// tick, rescaling the sample speed of the voices being mixed.
+	void UpdatePitchFactor();
+#endif // MODPLUG_TRACKER
+	// Song time in seconds that Read() has rendered since the song was
+	// loaded. Unlike the number of rendered samples it follows the tempo
+	// multiplier, so it stays in step with GetLength().
+	double GetSongTimeRendered() const { return m_dSongTimeRendered; }
+
+	// Appends the notes starting in [start, end) seconds to events, sorted by
+	// time, and returns the mixing rate their sample positions are at.
+	// Returns 0 if BuildSeekSnapshots() hasn't been run for the current
+	// sequence.
+	uint32 GetNoteTimeline(double start, double end, std::vector<NoteTimelineEvent> &events) const;
+protected:
+	GetLengthType GetLength(enmGetLengthResetMode adjustMode, GetLengthTarget target, SeekSnapshots *record);
+	MPT_SHARED_PTR<const SeekSnapshots> GetSeekSnapshots() const;
+public:
+
 	void InitializeVisitedRows() { visitedSongRows.Initialize(true); }
 
 public:
@@ -576,6 +674,7 @@ public:
 	void RecalculateSamplesPerTick();
 	double GetRowDuration(UINT tempo, UINT speed) const;
 	UINT GetTickDuration(UINT tempo, UINT speed, ROWINDEX rowsPerBeat);
+	UINT GetTickDuration(UINT tempo, UINT speed, ROWINDEX rowsPerBeat, uint32 mixingFreq, double &bufferDiff) const;
 
 	// A repeat count value of -1 means infinite loop
 	void SetRepeatCount(int n) { m_nRepeatCount = n; }
@@ -589,6 +688,9 @@ public:
 	void InitializeGlobals();
 	void InitializeChannels();
 
+	// Tries every loader that may accept the file, in the usual order, until one does.
+	bool ReadAnyFormat(FileReader &file, ModLoadingFlags loadFlags);
+
 	// Module Loaders
 	bool ReadXM(FileReader &file, ModLoadingFlags loadFlags = loadCompleteModule);
 	bool ReadS3M(FileReader &file, ModLoadingFlags loadFlags = loadCompleteModule);
@@ -742,7 +844,7 @@ protected:
 	void ProcessVibrato(CHANNELINDEX nChn, int &period, CTuning::RATIOTYPE &vibratoFactor);
 	void ProcessSampleAutoVibrato(ModChannel *pChn, int &period, CTuning::RATIOTYPE &vibratoFactor, int &nPeriodFrac);
 
-	void ProcessRamping(ModChannel *pChn);
+	void ProcessRamping(ModChannel *pChn, uint32 fadeRampLength = 0);
 
 protected:
 	// Channel Effects
@@ -860,7 +962,7 @@ public:
 #ifdef MODPLUG_TRACKER
 	void ProcessMidiOut(CHANNELINDEX nChn);
 #endif // MODPLUG_TRACKER
-	void ApplyGlobalVolume(int *SoundBuffer, int *RearBuffer, long countChunk);
+	void ApplyGlobalVolume(mixsample_t *SoundBuffer, mixsample_t *RearBuffer, long countChunk);
 
 private:
 	PLUGINDEX GetChannelPlugin(CHANNELINDEX nChn, PluginMutePriority respectMutes) const;
@@ -874,9 +976,37 @@ public:
 	uint8 GetBestMidiChannel(CHANNELINDEX nChn) const;
 
 
+// Modipulate
 public:
-	ModStream* modStream;
+	// Installs playback hooks, or removes them if hooks is nullptr.
+	void SetSoundHooks(ISoundHooks *hooks) { m_pSoundHooks = hooks; }
+
+	// Resets every per-channel override to "play as written".
+	void ResetChannelOverrides();
+
+	void SetChannelEnabled(CHANNELINDEX nChn, bool enabled) { m_bChannelEnabled[nChn] = enabled; }
+	bool IsChannelEnabled(CHANNELINDEX nChn) const { return m_bChannelEnabled[nChn]; }
+
+	void SetChannelTranspose(CHANNELINDEX nChn, int semitones) { m_nChannelTranspose[nChn] = semitones; }
+	int GetChannelTranspose(CHANNELINDEX nChn) const { return m_nChannelTranspose[nChn]; }
+
+	void SetChannelEffectEnabled(CHANNELINDEX nChn, UINT cmd, bool enabled);
+	bool IsChannelEffectEnabled(CHANNELINDEX nChn, UINT cmd) const { return (m_ChannelEffectMask[nChn] & (uint64(1) << cmd)) != 0; }
+
+	void SetChannelVolCmdEnabled(CHANNELINDEX nChn, UINT volcmd, bool enabled);
+	bool IsChannelVolCmdEnabled(CHANNELINDEX nChn, UINT volcmd) const { return (m_ChannelVolCmdMask[nChn] & (uint32(1) << volcmd)) != 0; }
+
+private:
+	ISoundHooks *m_pSoundHooks;
+
+	// Per-channel overrides, indexed by channel. One bit per effect / volume command.
+	bool m_bChannelEnabled[MAX_CHANNELS];
+	int m_nChannelTranspose[MAX_CHANNELS];
+	uint64 m_ChannelEffectMask[MAX_CHANNELS];
+	uint32 m_ChannelVolCmdMask[MAX_CHANNELS];
 
+	STATIC_ASSERT(MAX_EFFECTS <= 64);
+	STATIC_ASSERT(MAX_VOLCMDS <= 32);
 };
 
 #if MPT_COMPILER_MSVC
@@ -16,16 +16,19 @@
 #include "MIDIEvents.h"
 #include "tuning.h"
 #include "Tables.h"
+#include <chrono>
 #ifdef MODPLUG_TRACKER
 #include "../mptrack/TrackerSettings.h"
 #endif
 
 
-#include "../mod_stream.h" // modipulate
 
 // VU-Meter
 #define VUMETER_DECAY		4
 
+// Longest stretch mixed at one pitch while a pitch multiplier glides
+#define PITCH_RAMP_CHUNK	64
+
 #ifndef NO_VST
 PMIXPLUGINCREATEPROC CSoundFile::gpMixPluginCreateProc = NULL;
 #endif
@@ -144,6 +147,30 @@ BOOL CSoundFile::FadeSong(UINT msec)
 }
 
 
+#ifndef MODPLUG_TRACKER
+void CSoundFile::UpdatePitchFactor()
+//----------------------------------
+{
+	const UINT freqFactor = Util::Round<UINT>(PLAYBACK_FACTOR_UNITY * m_PitchRamp.Get());
+	if(freqFactor == m_nFreqFactor)
+	{
+		return;
+	}
+
+	for(CHANNELINDEX i = 0; i < m_nMixChannels; i++)
+	{
+		ModChannel &chn = Chn[ChnMix[i]];
+		if(chn.nInc != 0)
+		{
+			const int32 inc = Util::muldivr(chn.nInc, freqFactor, m_nFreqFactor);
+			chn.nInc = (inc != 0) ? inc : (chn.nInc > 0 ? 1 : -1);
+		}
+	}
+	m_nFreqFactor = freqFactor;
+}
+#endif // !MODPLUG_TRACKER
+
+
 CSoundFile::samplecount_t CSoundFile::Read(samplecount_t count, IAudioReadTarget &target)
 //---------------------------------------------------------------------------------------
 {
@@ -170,12 +197,26 @@ CSoundFile::samplecount_t CSoundFile::Read(samplecount_t count, IAudioReadTarget
 		if(!m_nBufferCount)
 		{ // last tick or fade completely processed, find out what to do next
 
+#ifndef MODPLUG_TRACKER
+			// Ticks take the tempo and pitch multipliers as they are when they
+			// start. A gliding pitch is followed within the tick, too.
+			m_nTempoFactor = Util::Round<UINT>(PLAYBACK_FACTOR_UNITY / m_TempoRamp.Get());
+			m_nFreqFactor = Util::Round<UINT>(PLAYBACK_FACTOR_UNITY * m_PitchRamp.Get());
+#endif // !MODPLUG_TRACKER
+
             /*
 			if(m_SongFlags[SONG_FADINGSONG])
 			{ // song was faded out
 				//m_SongFlags.set(SONG_ENDREACHED);
 			} else if(ReadNote())*/
-            if (ReadNote())
+#ifndef MODPLUG_TRACKER
+			const std::chrono::steady_clock::time_point rowStart = std::chrono::steady_clock::now();
+			const BOOL noteRead = ReadNote();
+			m_dRowSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - rowStart).count();
+#else
+			const BOOL noteRead = ReadNote();
+#endif // !MODPLUG_TRACKER
+			if(noteRead)
 			{ // render next tick (normal progress)
 				ASSERT(m_nBufferCount > 0);
 				#ifdef MODPLUG_TRACKER
@@ -222,12 +263,24 @@ CSoundFile::samplecount_t CSoundFile::Read(samplecount_t count, IAudioReadTarget
 
 		ASSERT(m_nBufferCount > 0); // assert that we have actually something to do
 
-		const samplecount_t countChunk = std::min<samplecount_t>(MIXBUFFERSIZE, std::min<samplecount_t>(m_nBufferCount, countToRender));
+#ifndef MODPLUG_TRACKER
+		UpdatePitchFactor();
+		const samplecount_t chunkSize = m_PitchRamp.IsRamping() ? PITCH_RAMP_CHUNK : MIXBUFFERSIZE;
+#else
+		const samplecount_t chunkSize = MIXBUFFERSIZE;
+#endif // !MODPLUG_TRACKER
+		const samplecount_t countChunk = std::min<samplecount_t>(chunkSize, std::min<samplecount_t>(m_nBufferCount, countToRender));
 
+#ifndef MODPLUG_TRACKER
+		const std::chrono::steady_clock::time_point mixStart = std::chrono::steady_clock::now();
 		CreateStereoMix(countChunk);
+		m_dMixSeconds += std::chrono::duration<double>(std::chrono::steady_clock::now() - mixStart).count();
+#else
+		CreateStereoMix(countChunk);
+#endif // !MODPLUG_TRACKER
 
 		// MODIPULATE
-		modStream->increase_sample_count(countChunk);
+		if(m_pSoundHooks != nullptr) m_pSoundHooks->OnSamplesRendered(countChunk);
 		// MODIPULATE
 
 		#ifndef NO_REVERB
@@ -266,6 +319,13 @@ CSoundFile::samplecount_t CSoundFile::Read(samplecount_t count, IAudioReadTarget
 		countToRender -= countChunk;
 		m_nBufferCount -= countChunk;
 		m_lTotalSampleCount += countChunk;		// increase sample count for VSTTimeInfo.
+#ifndef MODPLUG_TRACKER
+		m_dSongTimeRendered += static_cast<double>(countChunk) * PLAYBACK_FACTOR_UNITY / m_nTempoFactor / m_MixerSettings.gdwMixingFreq;
+		m_TempoRamp.Advance(countChunk);
+		m_PitchRamp.Advance(countChunk);
+#else
+		m_dSongTimeRendered += static_cast<double>(countChunk) / m_MixerSettings.gdwMixingFreq;
+#endif // !MODPLUG_TRACKER
 
 #ifdef MODPLUG_TRACKER
 		if(IsRenderingToDisc())
@@ -341,7 +401,7 @@ BOOL CSoundFile::ProcessRow()
 		m_nCurrentOrder = m_nNextOrder;
 
 		// Modipulate!
-		modStream->on_row_changed(m_nRow);
+		if(m_pSoundHooks != nullptr) m_pSoundHooks->OnRowChanged(m_nRow);
 		//
 
 #ifdef MODPLUG_TRACKER
@@ -539,7 +599,7 @@ BOOL CSoundFile::ProcessRow()
 		}
 
 		// MODIPULATE
-		modStream->on_pattern_changed(m_nPattern);
+		if(m_pSoundHooks != nullptr) m_pSoundHooks->OnPatternChanged(m_nPattern);
 		// MODIPULATE
 
 		// Now that we know which pattern we're on, we can update time signatures (global or pattern-specific)
@@ -1253,7 +1313,7 @@ void CSoundFile::ProcessArpeggio(CHANNELINDEX nChn, int &period, CTuning::NOTEIN
 				if(note > 108 + NOTE_MIN && arpPos != 0)
 					note = 108 + NOTE_MIN; // FT2's note limit
 
-				period = GetPeriodFromNote(note + modStream->get_transposition(nChn), pChn->nFineTune, pChn->nC5Speed);
+				period = GetPeriodFromNote(note + GetChannelTranspose(nChn), pChn->nFineTune, pChn->nC5Speed);
 
 			}
 			// Other trackers
@@ -1273,7 +1333,7 @@ void CSoundFile::ProcessArpeggio(CHANNELINDEX nChn, int &period, CTuning::NOTEIN
 						// Test case: ArpWraparound.mod, and the snare sound in "Jim is dead" by doh.
 						note -= 37;
 					}
-					period = GetPeriodFromNote(note + modStream->get_transposition(nChn), pChn->nFineTune, pChn->nC5Speed);
+					period = GetPeriodFromNote(note + GetChannelTranspose(nChn), pChn->nFineTune, pChn->nC5Speed);
 
 					// The arpeggio note offset remains effective after the end of the current row in ScreamTracker 2.
 					// This fixes the flute lead in MORPH.STM by Skaven, pattern 27.
@@ -1563,8 +1623,10 @@ void CSoundFile::ProcessSampleAutoVibrato(ModChannel *pChn, int &period, CTuning
 }
 
 
-void CSoundFile::ProcessRamping(ModChannel *pChn)
-//-----------------------------------------------
+// fadeRampLength: If non-zero, ramp over exactly this many samples, which is how
+// far the channel fade got this tick.
+void CSoundFile::ProcessRamping(ModChannel *pChn, uint32 fadeRampLength)
+//----------------------------------------------------------------------
 {
 	pChn->leftRamp = pChn->rightRamp = 0;
 	if(pChn->dwFlags[CHN_VOLUMERAMP] && (pChn->leftVol != pChn->newLeftVol || pChn->rightVol != pChn->newRightVol))
@@ -1594,7 +1656,11 @@ void CSoundFile::ProcessRamping(ModChannel *pChn)
 
 		int32 leftDelta = ((pChn->newLeftVol - pChn->leftVol) << VOLUMERAMPPRECISION);
 		int32 rightDelta = ((pChn->newRightVol - pChn->rightVol) << VOLUMERAMPPRECISION);
-		if(!enableCustomRamp)
+		if(fadeRampLength)
+		{
+			// MODIPULATE: Channel fade, which has to arrive exactly where the fade is supposed to be.
+			rampLength = fadeRampLength;
+		} else if(!enableCustomRamp)
 		{
 			// Extra-smooth ramping, unless we're forced to use the default values
 			if((pChn->leftVol | pChn->rightVol) && (pChn->newLeftVol | pChn->newRightVol) && !pChn->dwFlags[CHN_FASTVOLRAMP])
@@ -1645,6 +1711,10 @@ BOOL CSoundFile::ReadNote()
 	} else
 #endif // MODPLUG_TRACKER
 	{
+		// MODIPULATE
+		if(m_pSoundHooks != nullptr) m_pSoundHooks->OnTickStarted();
+		// MODIPULATE
+
 		if(!ProcessRow())
 			return FALSE;
 	}
@@ -1697,17 +1767,31 @@ BOOL CSoundFile::ReadNote()
 	ModChannel *pChn = Chn;
 	for (CHANNELINDEX nChn = 0; nChn < MAX_CHANNELS; nChn++, pChn++)
 	{
+		// MODIPULATE: Advance the channel fade by one tick. ProcessRamping() plays the step
+		// sample by sample, ending where the fade ends if that's within this tick.
+		uint32 fadeRampLength = 0;
+		const double fadeFrom = pChn->fadeGain;
+		if(pChn->fadeSamplesLeft)
+		{
+			fadeRampLength = std::min<uint32>(pChn->fadeSamplesLeft, m_nBufferCount);
+			pChn->fadeSamplesLeft -= fadeRampLength;
+			if(pChn->fadeSamplesLeft)
+				pChn->fadeGain += (pChn->fadeTarget - pChn->fadeGain) * fadeRampLength / (pChn->fadeSamplesLeft + fadeRampLength);
+			else
+				pChn->fadeGain = pChn->fadeTarget;
+		}
+
 		// FT2 Compatibility: Prevent notes to be stopped after a fadeout. This way, a portamento effect can pick up a faded instrument which is long enough.
 		// This occours for example in the bassline (channel 11) of jt_burn.xm. I hope this won't break anything else...
 		// I also suppose this could decrease mixing performance a bit, but hey, which CPU can't handle 32 muted channels these days... :-)
 		if((pChn->dwFlags[CHN_NOTEFADE] && (!(pChn->nFadeOutVol|pChn->leftVol|pChn->rightVol)) && (!IsCompatibleMode(TRK_FASTTRACKER2)))
-            || !modStream->get_channel_enabled(nChn))// MODIPULATE
+            || !IsChannelEnabled(nChn))// MODIPULATE
 		{
 			pChn->nLength = 0;
 			pChn->nROfs = pChn->nLOfs = 0;
 		}
 		// Check for unused channel
-        if(pChn->dwFlags[CHN_MUTE] || (nChn >= m_nChannels && !pChn->nLength) || !modStream->get_channel_enabled(nChn)) // MODIPULATE
+        if(pChn->dwFlags[CHN_MUTE] || (nChn >= m_nChannels && !pChn->nLength) || !IsChannelEnabled(nChn)) // MODIPULATE
 		{
 			if(nChn < m_nChannels)
 			{
@@ -1803,7 +1887,7 @@ BOOL CSoundFile::ReadNote()
 			// TODO Glissando effect is reset after portamento! What would this sound like without the CHN_PORTAMENTO flag?
 			if((pChn->dwFlags & (CHN_GLISSANDO | CHN_PORTAMENTO)) == (CHN_GLISSANDO | CHN_PORTAMENTO))
 			{
-				period = GetPeriodFromNote(GetNoteFromPeriod(period)  + modStream->get_transposition(nChn), pChn->nFineTune, pChn->nC5Speed);
+				period = GetPeriodFromNote(GetNoteFromPeriod(period)  + GetChannelTranspose(nChn), pChn->nFineTune, pChn->nC5Speed);
 			}
 
 			ProcessArpeggio(nChn, period, arpeggioSteps);
@@ -1909,7 +1993,7 @@ BOOL CSoundFile::ReadNote()
 
 			uint32 ninc = Util::muldivr(freq, 0x10000, m_MixerSettings.gdwMixingFreq << FREQ_FRACBITS);
 #ifndef MODPLUG_TRACKER
-			ninc = Util::muldivr(ninc, m_nFreqFactor, 128);
+			ninc = Util::muldivr(ninc, m_nFreqFactor, PLAYBACK_FACTOR_UNITY);
 #endif // !MODPLUG_TRACKER
 			if(ninc == 0)
 			{
@@ -2041,17 +2125,29 @@ BOOL CSoundFile::ReadNote()
 			pChn->newLeftVol >>= extraAttenuation;
 			pChn->newRightVol >>= extraAttenuation;
 
+			// MODIPULATE: Channel fade
+			if(pChn->fadeGain != 1.0)
+			{
+				pChn->newLeftVol = Util::Round<int32>(pChn->newLeftVol * pChn->fadeGain);
+				pChn->newRightVol = Util::Round<int32>(pChn->newRightVol * pChn->fadeGain);
+			}
+
 			// Dolby Pro-Logic Surround
 			if(pChn->dwFlags[CHN_SURROUND] && m_MixerSettings.gnChannels == 2) pChn->newRightVol = - pChn->newRightVol;
 
 			// Checking Ping-Pong Loops
 			if(pChn->dwFlags[CHN_PINGPONGFLAG]) pChn->nInc = -pChn->nInc;
 
-			// Setting up volume ramp
-			ProcessRamping(pChn);
+			// Setting up volume ramp. Notes that start during a fade ramp in as usual,
+			// unless the fade is what brings them in from silence.
+			if(!(pChn->leftVol | pChn->rightVol) && fadeFrom != 0.0)
+			{
+				fadeRampLength = 0;
+			}
+			ProcessRamping(pChn, fadeRampLength);
 
 			// Adding the channel in the channel list
-            if (modStream->get_channel_enabled(nChn)) // MODIPULATE
+            if (IsChannelEnabled(nChn)) // MODIPULATE
 			    ChnMix[m_nMixChannels++] = nChn;
 		} else
 		{
@@ -2088,7 +2184,7 @@ BOOL CSoundFile::ReadNote()
 void CSoundFile::ProcessMacroOnChannel(CHANNELINDEX nChn)
 //-------------------------------------------------------
 {
-     if (!modStream->get_channel_enabled(nChn))
+     if (!IsChannelEnabled(nChn))
          return;
 
 	ModChannel *pChn = &Chn[nChn];
@@ -2212,8 +2308,20 @@ void CSoundFile::ProcessMidiOut(CHANNELINDEX nChn)
 #endif // MODPLUG_TRACKER
 
 
+// Scales a mix sampling point by num / den.
+static forceinline int32 ScaleMixSample(int32 sample, long num, long den)
+{
+	return Util::muldiv(sample, num, den);
+}
+
+static forceinline float ScaleMixSample(float sample, long num, long den)
+{
+	return sample * (static_cast<float>(num) / static_cast<float>(den));
+}
+
+
 template<int channels>
-forceinline void ApplyGlobalVolumeWithRamping(int *SoundBuffer, int *RearBuffer, long lCount, UINT m_nGlobalVolume, long step, UINT &m_nSamplesToGlobalVolRampDest, long &m_lHighResRampingGlobalVolume)
+forceinline void ApplyGlobalVolumeWithRamping(mixsample_t *SoundBuffer, mixsample_t *RearBuffer, long lCount, UINT m_nGlobalVolume, long step, UINT &m_nSamplesToGlobalVolRampDest, long &m_lHighResRampingGlobalVolume)
 {
 	const bool isStereo = (channels >= 2);
 	const bool hasRear = (channels >= 4);
@@ -2223,17 +2331,17 @@ forceinline void ApplyGlobalVolumeWithRamping(int *SoundBuffer, int *RearBuffer,
 		{
 			// Ramping required
 			m_lHighResRampingGlobalVolume += step;
-			             SoundBuffer[0] = Util::muldiv(SoundBuffer[0], m_lHighResRampingGlobalVolume, MAX_GLOBAL_VOLUME << VOLUMERAMPPRECISION);
-			if(isStereo) SoundBuffer[1] = Util::muldiv(SoundBuffer[1], m_lHighResRampingGlobalVolume, MAX_GLOBAL_VOLUME << VOLUMERAMPPRECISION);
-			if(hasRear)  RearBuffer[0]  = Util::muldiv(RearBuffer[0] , m_lHighResRampingGlobalVolume, MAX_GLOBAL_VOLUME << VOLUMERAMPPRECISION);
-			if(hasRear)  RearBuffer[1]  = Util::muldiv(RearBuffer[1] , m_lHighResRampingGlobalVolume, MAX_GLOBAL_VOLUME << VOLUMERAMPPRECISION);
+			             SoundBuffer[0] = ScaleMixSample(SoundBuffer[0], m_lHighResRampingGlobalVolume, MAX_GLOBAL_VOLUME << VOLUMERAMPPRECISION);
+			if(isStereo) SoundBuffer[1] = ScaleMixSample(SoundBuffer[1], m_lHighResRampingGlobalVolume, MAX_GLOBAL_VOLUME << VOLUMERAMPPRECISION);
+			if(hasRear)  RearBuffer[0]  = ScaleMixSample(RearBuffer[0] , m_lHighResRampingGlobalVolume, MAX_GLOBAL_VOLUME << VOLUMERAMPPRECISION);
+			if(hasRear)  RearBuffer[1]  = ScaleMixSample(RearBuffer[1] , m_lHighResRampingGlobalVolume, MAX_GLOBAL_VOLUME << VOLUMERAMPPRECISION);
 			m_nSamplesToGlobalVolRampDest--;
 		} else
 		{
-			             SoundBuffer[0] = Util::muldiv(SoundBuffer[0], m_nGlobalVolume, MAX_GLOBAL_VOLUME);
-			if(isStereo) SoundBuffer[1] = Util::muldiv(SoundBuffer[1], m_nGlobalVolume, MAX_GLOBAL_VOLUME);
-			if(hasRear)  RearBuffer[0]  = Util::muldiv(RearBuffer[0] , m_nGlobalVolume, MAX_GLOBAL_VOLUME);
-			if(hasRear)  RearBuffer[1]  = Util::muldiv(RearBuffer[1] , m_nGlobalVolume, MAX_GLOBAL_VOLUME);
+			             SoundBuffer[0] = ScaleMixSample(SoundBuffer[0], m_nGlobalVolume, MAX_GLOBAL_VOLUME);
+			if(isStereo) SoundBuffer[1] = ScaleMixSample(SoundBuffer[1], m_nGlobalVolume, MAX_GLOBAL_VOLUME);
+			if(hasRear)  RearBuffer[0]  = ScaleMixSample(RearBuffer[0] , m_nGlobalVolume, MAX_GLOBAL_VOLUME);
+			if(hasRear)  RearBuffer[1]  = ScaleMixSample(RearBuffer[1] , m_nGlobalVolume, MAX_GLOBAL_VOLUME);
 			m_lHighResRampingGlobalVolume = m_nGlobalVolume << VOLUMERAMPPRECISION;
 		}
 		SoundBuffer += isStereo ? 2 : 1;
@@ -2242,8 +2350,8 @@ forceinline void ApplyGlobalVolumeWithRamping(int *SoundBuffer, int *RearBuffer,
 }
 
 
-void CSoundFile::ApplyGlobalVolume(int *SoundBuffer, int *RearBuffer, long lCount)
-//--------------------------------------------------------------------------------
+void CSoundFile::ApplyGlobalVolume(mixsample_t *SoundBuffer, mixsample_t *RearBuffer, long lCount)
+//------------------------------------------------------------------------------------------------
 {
 
 	// should we ramp?
@@ -0,0 +1,53 @@
+/*
+ * SoundHooks.h
+ * ------------
+ * Purpose: Optional callbacks that let an embedding application observe and steer playback.
+ * Notes  : Modipulate. CSoundFile works without any hooks installed; per-channel overrides
+ *          are kept in CSoundFile itself so the mixer never has to call out to test them.
+ * Authors: Eric Gregory and Stevie Hryciw
+ * The OpenMPT source code is released under the BSD license. Read LICENSE for more details.
+ */
+
+
+#pragma once
+
+#include "Snd_defs.h"
+
+
+//=============
+class ISoundHooks
+//=============
+{
+public:
+	virtual ~ISoundHooks() { }
+
+	// A new row has started.
+	virtual void OnRowChanged(ROWINDEX row) = 0;
+
+	// Called once per row after OnRowChanged, with the pattern being played.
+	virtual void OnPatternChanged(PATTERNINDEX pattern) = 0;
+
+	// A note was triggered. instrument and sample are -1 if there is none. The
+	// commands are the ones on the channel's row, 0 if there are none.
+	virtual void OnNoteChange(CHANNELINDEX chn, int note, int instrument, int sample, int volume,
+		int volcmd, int vol, int cmd, int param) = 0;
+
+	// count sample frames have been rendered.
+	virtual void OnSamplesRendered(uint32 count) = 0;
+
+	// A tick is about to be processed, before any of the row hooks for it.
+	virtual void OnTickStarted() = 0;
+
+	// Called on the first tick of every row for every enabled channel, before the
+	// row's commands are processed. The hook may replace any of them. If it sets
+	// delay (0 on entry), the row's note is held back until that tick, like a
+	// note delay effect, and the replaced commands stay in effect for the row.
+	virtual void OnRowCommand(CHANNELINDEX chn, ROWINDEX row, UINT &note, UINT &instr,
+		UINT &volcmd, UINT &vol, UINT &cmd, UINT &param, UINT &delay) = 0;
+
+	// Called on every other tick of the row for every enabled channel, with the
+	// commands in effect. The hook may replace any of them and return true; they
+	// are then processed as if the row started on this tick. The row's note keeps
+	// its own timing: once it has played, the rest of the row goes on without it.
+	virtual bool OnTickCommand(CHANNELINDEX chn, UINT &volcmd, UINT &vol, UINT &cmd, UINT &param) = 0;
+};
@@ -17,6 +17,9 @@
 #include "Resampler.h"
 #include "WindowedFIR.h"
 
+#include <mutex>
+#include <vector>
+
 
 /////////////////////////////////////////////////////////////////////////////
 // Common Tables
@@ -894,55 +897,120 @@ static void getdownsample2x(short int *psinc)
 #endif
 
 
-#ifdef MODPLUG_TRACKER
-bool CResampler::StaticTablesInitialized = false;
 SINC_TYPE CResampler::gDownsample13x[SINC_PHASES*8];	// Downsample 1.333x
 SINC_TYPE CResampler::gDownsample2x[SINC_PHASES*8];		// Downsample 2x
 #ifndef MPT_INTMIXER
 mixsample_t CResampler::FastSincTablef[256 * 4];		// Cubic spline LUT
 mixsample_t CResampler::LinearTablef[256];				// Linear interpolation LUT
 #endif // !defined(MPT_INTMIXER)
-#endif // MODPLUG_TRACKER
 
+// Songs can be created on any thread.
+static std::mutex ResamplerTablesMutex;
+static bool StaticTablesInitialized = false;
 
-void CResampler::InitializeTables(bool force)
+// Tables for every cutoff and window type that is still in use.
+struct ResamplerTablesEntry
 {
-#ifdef MODPLUG_TRACKER
-	if((m_OldSettings == m_Settings) && !force && StaticTablesInitialized) return;
-	if(!StaticTablesInitialized)
-#else
-	if((m_OldSettings == m_Settings) && !force) return;
-#endif // MODPLUG_TRACKER
+	double cutoff;
+	uint8 type;
+	std::weak_ptr<const CResamplerTables> tables;
+};
+static std::vector<ResamplerTablesEntry> ResamplerTablesCache;
+
+// Almost every song uses the default settings. Their tables are kept even
+// while no song is loaded, so creating songs one after another (or probing
+// many files) doesn't build them over and over.
+static MPT_SHARED_PTR<const CResamplerTables> DefaultResamplerTables;
+
+
+// Called with ResamplerTablesMutex held.
+void CResampler::InitializeStaticTables()
+//---------------------------------------
+{
+	if(StaticTablesInitialized)
 	{
-		//ericus' downsampling improvement.
-		//getsinc(gDownsample13x, 8.5, 3.0/4.0);
-		//getdownsample2x(gDownsample2x);
-		getsinc(gDownsample13x, 8.5, 0.5);
-		getsinc(gDownsample2x, 2.7625, 0.425);
-		//end ericus' downsampling improvement.
+		return;
+	}
+
+	//ericus' downsampling improvement.
+	//getsinc(gDownsample13x, 8.5, 3.0/4.0);
+	//getdownsample2x(gDownsample2x);
+	getsinc(gDownsample13x, 8.5, 0.5);
+	getsinc(gDownsample2x, 2.7625, 0.425);
+	//end ericus' downsampling improvement.
 
 #ifndef MPT_INTMIXER
-		// Prepare fast sinc coefficients for floating point mixer
-		for(size_t i = 0; i < CountOf(FastSincTable); i++)
+	// Prepare fast sinc coefficients for floating point mixer
+	for(size_t i = 0; i < CountOf(FastSincTable); i++)
+	{
+		FastSincTablef[i] = static_cast<mixsample_t>(FastSincTable[i] * mixsample_t(1.0f / 16384.0f));
+	}
+
+	// Prepare linear interpolation coefficients for floating point mixer
+	for(size_t i = 0; i < CountOf(LinearTablef); i++)
+	{
+		LinearTablef[i] = static_cast<mixsample_t>(i * mixsample_t(1.0f / CountOf(LinearTablef)));
+	}
+#endif // !defined(MPT_INTMIXER)
+
+	StaticTablesInitialized = true;
+}
+
+
+void CResampler::InitializeTables(bool force)
+//-------------------------------------------
+{
+	if((m_OldSettings == m_Settings) && !force && m_Tables) return;
+
+	const double cutoff = m_Settings.gdWFIRCutoff;
+	const uint8 type = m_Settings.gbWFIRType;
+	if(m_Tables && m_OldSettings.gdWFIRCutoff == cutoff && m_OldSettings.gbWFIRType == type)
+	{
+		// Only the resampling mode changed.
+		m_OldSettings = m_Settings;
+		return;
+	}
+
+	std::lock_guard<std::mutex> guard(ResamplerTablesMutex);
+
+	InitializeStaticTables();
+
+	MPT_SHARED_PTR<const CResamplerTables> tables;
+	for(size_t i = 0; i < ResamplerTablesCache.size(); )
+	{
+		const ResamplerTablesEntry &entry = ResamplerTablesCache[i];
+		if(entry.tables.expired())
 		{
-			FastSincTablef[i] = static_cast<mixsample_t>(FastSincTable[i] * mixsample_t(1.0f / 16384.0f));
+			ResamplerTablesCache.erase(ResamplerTablesCache.begin() + i);
+			continue;
 		}
-
-		// Prepare linear interpolation coefficients for floating point mixer
-		for(size_t i = 0; i < CountOf(LinearTablef); i++)
+		if(entry.cutoff == cutoff && entry.type == type)
 		{
-			LinearTablef[i] = static_cast<mixsample_t>(i * mixsample_t(1.0f / CountOf(LinearTablef)));
+			tables = entry.tables.lock();
 		}
-#endif // !defined(MPT_INTMIXER)
+		i++;
 	}
 
-	m_WindowedFIR.InitTable(m_Settings.gdWFIRCutoff, m_Settings.gbWFIRType);
-	getsinc(gKaiserSinc, 9.6377, m_Settings.gdWFIRCutoff);
-
-#ifdef MODPLUG_TRACKER
-	StaticTablesInitialized = true;
-#endif // MODPLUG_TRACKER
+	if(!tables)
+	{
+		CResamplerTables *newTables = new CResamplerTables();
+		newTables->m_WindowedFIR.InitTable(cutoff, type);
+		getsinc(newTables->gKaiserSinc, 9.6377, cutoff);
+		tables.reset(newTables);
+
+		ResamplerTablesEntry entry;
+		entry.cutoff = cutoff;
+		entry.type = type;
+		entry.tables = tables;
+		ResamplerTablesCache.push_back(entry);
+
+		const CResamplerSettings defaultSettings;
+		if(cutoff == defaultSettings.gdWFIRCutoff && type == defaultSettings.gbWFIRType)
+		{
+			DefaultResamplerTables = tables;
+		}
+	}
 
+	m_Tables = tables;
 	m_OldSettings = m_Settings;
 }
-
@@ -21,16 +21,37 @@
 #include <string.h>
 #include <stdint.h>
 #include <math.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
 #include "decode_vorbis.h"
 
-#define BLOCK_SIZE 4096
+VorbisDecoder::VorbisDecoder()
+{
+    ogg_sync_init(&oy);
+}
+
+VorbisDecoder::~VorbisDecoder()
+{
+    ogg_sync_clear(&oy);
+}
+
+/* submit a 4k block to libvorbis' Ogg layer */
+std::size_t VorbisDecoder::Submit(const char*& bufpos, std::size_t& bufsize)
+{
+    char* buffer = ogg_sync_buffer(&oy, VORBIS_BLOCK_SIZE);
+    std::size_t bytes = VORBIS_BLOCK_SIZE > bufsize ? bufsize : VORBIS_BLOCK_SIZE;
+    memcpy(buffer, bufpos, bytes);
+    bufpos += bytes;
+    bufsize -= bytes;
+    ogg_sync_wrote(&oy, bytes);
+    return bytes;
+}
 
-int decode_vorbis(const char* const inbuf, std::size_t bufsize, int16_t* outbuf)
+int VorbisDecoder::Decode(const char* inbuf, std::size_t bufsize, int16_t* outbuf, std::size_t outcount)
 {
-    ogg_int16_t convbuffer[BLOCK_SIZE];
-    int convsize = BLOCK_SIZE;
+    int convsize = VORBIS_BLOCK_SIZE;
 
-    ogg_sync_state   oy; /* sync and verify incoming physical bitstream */
     ogg_stream_state os; /* take physical pages, weld into a logical stream of packets */
     ogg_page         og; /* one Ogg bitstream page. Vorbis packets are inside */
     ogg_packet       op; /* one raw packet of data for decode */
@@ -39,55 +60,52 @@ int decode_vorbis(const char* const inbuf, std::size_t bufsize, int16_t* outbuf)
     vorbis_dsp_state vd; /* central working state for the packet->PCM decoder */
     vorbis_block     vb; /* local working space for packet->PCM decode */
 
-    char* buffer;
-    int   bytes;
     const char* bufpos = inbuf;
+    int16_t* const outend = outbuf + outcount;
+    int error = 0;
 
     /********** Decode setup ************/
 
-    ogg_sync_init(&oy);
-    
-    while (1) {
+    /* The sync state keeps its buffer from the previous sample. */
+    ogg_sync_reset(&oy);
+
+    while (!error) {
         int eos = 0;
         int i;
 
-        /* submit a 4k block to libvorbis' Ogg layer */
-        buffer = ogg_sync_buffer(&oy, BLOCK_SIZE);
-        bytes = BLOCK_SIZE > bufsize ? bufsize : BLOCK_SIZE;
-        memcpy(buffer, bufpos, bytes);
-        bufpos += bytes;
-        bufsize -= bytes;
-        ogg_sync_wrote(&oy, bytes);
-        
+        std::size_t bytes = Submit(bufpos, bufsize);
+
         /* Get the first page. */
         if (ogg_sync_pageout(&oy, &og) != 1) {
-            if (bytes < BLOCK_SIZE)
+            if (bytes < VORBIS_BLOCK_SIZE)
                 break;
-            // fprintf(stderr,"Input does not appear to be an Ogg bitstream.\n");
-            exit(1);
+            /* Input does not appear to be an Ogg bitstream. */
+            return -1;
         }
-    
+
         /* Get the serial number and set up the rest of decode. */
         ogg_stream_init(&os, ogg_page_serialno(&og));
 
         vorbis_info_init(&vi);
         vorbis_comment_init(&vc);
-        if (ogg_stream_pagein(&os, &og) < 0) { 
-            // fprintf(stderr,"Error reading first page of Ogg bitstream data.\n");
-            exit(1);
+        if (ogg_stream_pagein(&os, &og) < 0) {
+            /* Error reading first page of Ogg bitstream data. */
+            error = 1;
+            goto stream_done;
         }
-        
-        if (ogg_stream_packetout(&os, &op) != 1) { 
-            // fprintf(stderr,"Error reading initial header packet.\n");
-            exit(1);
+
+        if (ogg_stream_packetout(&os, &op) != 1) {
+            /* Error reading initial header packet. */
+            error = 1;
+            goto stream_done;
         }
-        
-        if (vorbis_synthesis_headerin(&vi, &vc, &op) < 0) { 
-            // fprintf(stderr,"This Ogg bitstream does not contain Vorbis "
-                            // "audio data.\n");
-            exit(1);
+
+        if (vorbis_synthesis_headerin(&vi, &vc, &op) < 0) {
+            /* This Ogg bitstream does not contain Vorbis audio data. */
+            error = 1;
+            goto stream_done;
         }
-        
+
         i = 0;
         while (i < 2) {
             while(i < 2) {
@@ -100,42 +118,23 @@ int decode_vorbis(const char* const inbuf, std::size_t bufsize, int16_t* outbuf)
                         result = ogg_stream_packetout(&os, &op);
                         if (result == 0)
                             break;
-                        if (result < 0) {
-                            // fprintf(stderr,"Corrupt secondary header.  Exiting.\n");
-                            exit(1);
-                        }
-                        result = vorbis_synthesis_headerin(&vi, &vc, &op);
-                        if (result < 0) {
-                            // fprintf(stderr,"Corrupt secondary header.  Exiting.\n");
-                            exit(1);
+                        if (result < 0 || vorbis_synthesis_headerin(&vi, &vc, &op) < 0) {
+                            /* Corrupt secondary header. */
+                            error = 1;
+                            goto stream_done;
                         }
                         i++;
                     }
                 }
             }
-            buffer = ogg_sync_buffer(&oy, BLOCK_SIZE);
-            bytes = BLOCK_SIZE > bufsize ? bufsize : BLOCK_SIZE;
-            memcpy(buffer, bufpos, bytes);
-            bufpos += bytes;
-            bufsize -= bytes;
-            if (bytes == 0 && i < 2) {
-                // fprintf(stderr,"End of file before finding all Vorbis headers!\n");
-                exit(1);
+            if (Submit(bufpos, bufsize) == 0 && i < 2) {
+                /* End of file before finding all Vorbis headers! */
+                error = 1;
+                goto stream_done;
             }
-            ogg_sync_wrote(&oy, bytes);
         }
-        
-        {
-            char **ptr = vc.user_comments;
-            while (*ptr) {
-                // fprintf(stderr, "%s\n", *ptr);
-                ++ptr;
-            }
-            // fprintf(stderr, "\nBitstream is %d channel, %ldHz\n", vi.channels, vi.rate);
-            // fprintf(stderr, "Encoded by: %s\n\n", vc.vendor);
-        }
-        
-        convsize = BLOCK_SIZE / vi.channels;
+
+        convsize = VORBIS_BLOCK_SIZE / vi.channels;
 
         if (vorbis_synthesis_init(&vd, &vi) == 0) {
             vorbis_block_init(&vd, &vb);
@@ -147,8 +146,7 @@ int decode_vorbis(const char* const inbuf, std::size_t bufsize, int16_t* outbuf)
                     if (result == 0)
                         break;
                     if (result < 0) {
-                        // fprintf(stderr,"Corrupt or missing data in bitstream; "
-                        //                 "continuing...\n");
+                        /* Corrupt or missing data in bitstream; continuing... */
                     } else {
                         ogg_stream_pagein(&os, &og);
                         while(1) {
@@ -168,7 +166,6 @@ int decode_vorbis(const char* const inbuf, std::size_t bufsize, int16_t* outbuf)
 
                                 while ((samples = vorbis_synthesis_pcmout(&vd, &pcm)) > 0) {
                                     int j;
-                                    int clipflag = 0;
                                     int bout = (samples < convsize ? samples : convsize);
 
                                     for (i = 0; i < vi.channels; i++) {
@@ -177,24 +174,19 @@ int decode_vorbis(const char* const inbuf, std::size_t bufsize, int16_t* outbuf)
                                         for (j = 0; j < bout; j++) {
                                             int val = floor(mono[j] * 32767.f + .5f);
                                             /* guard against clipping */
-                                            if (val > 32767) {
+                                            if (val > 32767)
                                                 val = 32767;
-                                                clipflag = 1;
-                                            }
-                                            if (val < -32768) {
+                                            if (val < -32768)
                                                 val = -32768;
-                                                clipflag = 1;
-                                            }
                                             *ptr = val;
                                             ptr += vi.channels;
                                         }
                                     }
-                                    
-                                    // if (clipflag)
-                                    //     fprintf(stderr, "Clipping in frame %ld\n", (long)(vd.sequence));
 
-                                    memcpy(outbuf, convbuffer, vi.channels * bout * sizeof (int16_t));
-                                    outbuf += vi.channels * bout;
+                                    /* Streams longer than the sample are cut off. */
+                                    std::size_t count = std::min<std::size_t>(vi.channels * bout, outend - outbuf);
+                                    memcpy(outbuf, convbuffer, count * sizeof (int16_t));
+                                    outbuf += count;
 
                                     vorbis_synthesis_read(&vd, bout);
                                 }
@@ -205,13 +197,7 @@ int decode_vorbis(const char* const inbuf, std::size_t bufsize, int16_t* outbuf)
                     }
                 }
                 if (!eos) {
-                    buffer = ogg_sync_buffer(&oy, BLOCK_SIZE);
-                    bytes = BLOCK_SIZE > bufsize ? bufsize : BLOCK_SIZE;
-                    memcpy(buffer, bufpos, bytes);
-                    bufpos += bytes;
-                    bufsize -= bytes;
-                    ogg_sync_wrote(&oy, bytes);
-                    if (bytes == 0)
+                    if (Submit(bufpos, bufsize) == 0)
                         eos = 1;
                 }
             }
@@ -219,16 +205,81 @@ int decode_vorbis(const char* const inbuf, std::size_t bufsize, int16_t* outbuf)
             vorbis_block_clear(&vb);
             vorbis_dsp_clear(&vd);
         } else {
-            // fprintf(stderr,"Error: Corrupt header during playback initialization.\n");
+            /* Error: Corrupt header during playback initialization. */
         }
 
+    stream_done:
         ogg_stream_clear(&os);
         vorbis_comment_clear(&vc);
         vorbis_info_clear(&vi);
     }
 
-    ogg_sync_clear(&oy);
-    
-    // fprintf(stderr,"Done.\n");
-    return 0;
+    return error ? -1 : 0;
+}
+
+
+void VorbisDecodeQueue::Add(const char* inbuf, std::size_t bufsize, int16_t* outbuf, std::size_t outcount)
+{
+    Job job;
+    job.inbuf = inbuf;
+    job.bufsize = bufsize;
+    job.outbuf = outbuf;
+    job.outcount = outcount;
+    jobs.push_back(job);
+}
+
+void VorbisDecodeQueue::Run()
+{
+    if (jobs.empty())
+        return;
+
+    /* Biggest samples first, so no thread is left with a long one at the end. */
+    std::stable_sort(jobs.begin(), jobs.end(), LargerJob);
+
+    std::size_t threads = std::thread::hardware_concurrency();
+    threads = std::min<std::size_t>(threads, VORBIS_MAX_THREADS);
+    threads = std::min<std::size_t>(threads, jobs.size());
+
+    /* The calling thread decodes too. If a thread can't be started, the
+       ones that could will pick up its share. */
+    std::atomic<std::size_t> next(0);
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < threads; i++) {
+        try {
+            workers.push_back(std::thread(Work, &jobs, &next));
+        } catch (...) {
+            break;
+        }
+    }
+
+    Work(&jobs, &next);
+
+    for (std::size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+
+    jobs.clear();
+}
+
+bool VorbisDecodeQueue::LargerJob(const Job& a, const Job& b)
+{
+    return a.bufsize > b.bufsize;
+}
+
+void VorbisDecodeQueue::Work(const std::vector<Job>* jobs, std::atomic<std::size_t>* next)
+{
+    VorbisDecoder decoder;
+    for (;;) {
+        std::size_t i = next->fetch_add(1);
+        if (i >= jobs->size())
+            return;
+        const Job& job = (*jobs)[i];
+        decoder.Decode(job.inbuf, job.bufsize, job.outbuf, job.outcount);
+    }
+}
+
+
+int decode_vorbis(const char* const inbuf, std::size_t bufsize, int16_t* outbuf, std::size_t outcount)
+{
+    VorbisDecoder decoder;
+    return decoder.Decode(inbuf, bufsize, outbuf, outcount);
 }
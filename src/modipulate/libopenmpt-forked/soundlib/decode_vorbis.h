@@ -1,9 +1,72 @@
 #ifndef _DECODE_VORBIS_H
 #define _DECODE_VORBIS_H
 
+#include <vorbis/codec.h>
 #include <stdint.h>
 #include <cstddef>
+#include <vector>
+#include <atomic>
 
-int decode_vorbis(const char* const inbuf, std::size_t bufsize, int16_t* outbuf);
+#define VORBIS_BLOCK_SIZE 4096
+
+// Most threads VorbisDecodeQueue::Run() decodes on, however many cores there are.
+#define VORBIS_MAX_THREADS 8
+
+// Decodes Ogg Vorbis streams to interleaved 16-bit PCM.
+//
+// The Ogg sync buffer and the conversion buffer are kept between calls to
+// Decode(), so decoding many samples in a row doesn't reallocate them.
+// One decoder must not be used by two threads at once.
+class VorbisDecoder
+{
+public:
+    VorbisDecoder();
+    ~VorbisDecoder();
+
+    // Decodes bufsize bytes of Ogg data into outbuf, writing at most
+    // outcount values. Returns 0 on success, -1 if the data is corrupt.
+    int Decode(const char* inbuf, std::size_t bufsize, int16_t* outbuf, std::size_t outcount);
+
+private:
+    VorbisDecoder(const VorbisDecoder&);
+    VorbisDecoder& operator=(const VorbisDecoder&);
+
+    std::size_t Submit(const char*& bufpos, std::size_t& bufsize);
+
+    ogg_sync_state oy;
+    ogg_int16_t convbuffer[VORBIS_BLOCK_SIZE];
+};
+
+// Samples waiting to be decoded.
+//
+// Loaders add every Vorbis sample of a module while reading it, then call
+// Run() to decode them all at once on several threads. Each sample only
+// writes to its own buffer, so the result doesn't depend on the order the
+// threads get to them.
+class VorbisDecodeQueue
+{
+public:
+    void Add(const char* inbuf, std::size_t bufsize, int16_t* outbuf, std::size_t outcount);
+
+    // Decodes everything added so far and empties the queue.
+    void Run();
+
+private:
+    struct Job
+    {
+        const char* inbuf;
+        std::size_t bufsize;
+        int16_t* outbuf;
+        std::size_t outcount;
+    };
+
+    static bool LargerJob(const Job& a, const Job& b);
+    static void Work(const std::vector<Job>* jobs, std::atomic<std::size_t>* next);
+
+    std::vector<Job> jobs;
+};
+
+// Decodes a single stream. Returns 0 on success, -1 if the data is corrupt.
+int decode_vorbis(const char* const inbuf, std::size_t bufsize, int16_t* outbuf, std::size_t outcount);
 
 #endif
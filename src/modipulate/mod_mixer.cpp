@@ -0,0 +1,397 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include "mod_mixer.h"
+#include "mod_stream.h"
+
+#include <algorithm>
+#include <string>
+#include <sstream>
+#include <string.h>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+// Callback helper function.
+int mod_mixer_callback(const void *input, void *output, unsigned long frameCount,
+    const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void *userData) {
+    return ((ModMixer*) userData)->audio_callback(input, output, frameCount, timeInfo, statusFlags);
+}
+
+
+ModMixer::ModMixer(const ModipulateEngineOptions& options) :
+    streams(new ModMixerStreams()),
+    streams_in_use(NULL),
+    pool(options.render_threads, render_task),
+    stream(NULL),
+    options(options),
+    frames_rendered(0),
+    frames_rendered_shared(0),
+    dac_anchor(0.0),
+    output_latency(0.0),
+    callbacks(0),
+    render_total(0.0),
+    render_min(0.0),
+    render_max(0.0),
+    callback_load(0.0f),
+    callback_peak_load(0.0f),
+    deadline_misses(0),
+    output_underflows(0),
+    late_underflows(0),
+    output_overflows(0),
+    priming_output(0),
+    last_callback_late(false)
+{
+    for (int i = 0; i < MODIPULATE_STATS_LOAD_BUCKETS; i++) {
+        load_histogram[i] = 0;
+    }
+}
+
+
+ModMixer::~ModMixer()
+{
+    stop();
+    delete streams.load();
+}
+
+
+void ModMixer::start() {
+    if (stream) {
+        return;
+    }
+
+    PaStreamParameters outputParameters;
+    if (options.device < 0) {
+        outputParameters.device = Pa_GetDefaultOutputDevice(); /* default output device */
+        if (outputParameters.device == paNoDevice) {
+            throw string("Error: No default output device.");
+        }
+    } else {
+        if (options.device >= Pa_GetDeviceCount()) {
+            throw string("Error: Invalid output device.");
+        }
+        outputParameters.device = options.device;
+    }
+
+    const PaDeviceInfo* device_info = Pa_GetDeviceInfo(outputParameters.device);
+    if (device_info->maxOutputChannels < options.channels) {
+        throw string("Error: Output device doesn't have enough channels.");
+    }
+
+    outputParameters.channelCount = options.channels;
+    outputParameters.sampleFormat = paFloat32;
+    outputParameters.suggestedLatency = options.suggested_latency > 0.0 ?
+        options.suggested_latency : device_info->defaultLowOutputLatency;
+    outputParameters.hostApiSpecificStreamInfo = NULL;
+
+    // Clipping stays on: several songs summed together can exceed full scale.
+    check_error(__LINE__, Pa_OpenStream(
+              &stream,
+              NULL, /* no input */
+              &outputParameters,
+              options.sample_rate,
+              options.frames_per_buffer > 0 ? options.frames_per_buffer : paFramesPerBufferUnspecified,
+              paNoFlag,
+              mod_mixer_callback,
+              this));
+
+    const PaStreamInfo* info = Pa_GetStreamInfo(stream);
+    output_latency = info ? info->outputLatency : outputParameters.suggestedLatency;
+
+    frames_rendered = 0;
+    frames_rendered_shared = 0;
+    dac_anchor = 0.0;
+
+    PaError err = Pa_StartStream(stream);
+    if (err != paNoError) {
+        Pa_CloseStream(stream);
+        stream = NULL;
+        check_error(__LINE__, err);
+    }
+}
+
+
+void ModMixer::stop() {
+    if (!stream) {
+        return;
+    }
+
+    // Ignore errors, just exit.
+    Pa_StopStream(stream);
+    Pa_CloseStream(stream);
+    stream = NULL;
+    
+    pool.quiesce();
+}
+
+
+bool ModMixer::is_running() {
+    return stream != NULL && Pa_IsStreamActive(stream) == 1;
+}
+
+
+void ModMixer::add_stream(ModStream* mod_stream) {
+    lock_guard<mutex> lock(streams_lock);
+    const vector<ModStream*>& current = streams.load(memory_order_relaxed)->streams;
+    if (find(current.begin(), current.end(), mod_stream) != current.end()) {
+        return;
+    }
+    
+    ModMixerStreams* next = new ModMixerStreams();
+    next->streams = current;
+    next->streams.push_back(mod_stream);
+    next->active.reserve(next->streams.size());
+    publish_streams(next);
+}
+
+
+void ModMixer::remove_stream(ModStream* mod_stream) {
+    lock_guard<mutex> lock(streams_lock);
+    const vector<ModStream*>& current = streams.load(memory_order_relaxed)->streams;
+    if (find(current.begin(), current.end(), mod_stream) == current.end()) {
+        return;
+    }
+    
+    ModMixerStreams* next = new ModMixerStreams();
+    next->streams = current;
+    next->streams.erase(remove(next->streams.begin(), next->streams.end(), mod_stream), next->streams.end());
+    next->active.reserve(next->streams.size());
+    publish_streams(next);
+    
+    // The callback that last saw the song may have left it rendering on
+    // a worker.
+    pool.quiesce();
+}
+
+
+void ModMixer::publish_streams(ModMixerStreams* next) {
+    ModMixerStreams* old = streams.exchange(next, memory_order_seq_cst);
+    
+    // The callback checks the list is still current after announcing it,
+    // so once it isn't using the old one it never will again. Callbacks
+    // are short, so waiting here takes a buffer period at most.
+    while (streams_in_use.load(memory_order_seq_cst) == old) {
+        this_thread::yield();
+    }
+    delete old;
+}
+
+
+int ModMixer::get_sampling_rate() {
+    return options.sample_rate;
+}
+
+
+int ModMixer::get_channel_count() {
+    return options.channels;
+}
+
+
+unsigned long long ModMixer::get_playback_frame() {
+    if (!stream) {
+        return 0;
+    }
+
+    unsigned long long rendered = frames_rendered_shared.load(memory_order_acquire);
+    double seconds = Pa_GetStreamTime(stream) - dac_anchor.load(memory_order_acquire);
+    if (seconds <= 0.0) {
+        return 0;
+    }
+
+    // Never report a frame the device hasn't been given yet.
+    unsigned long long frame = (unsigned long long) (seconds * options.sample_rate);
+    return frame < rendered ? frame : rendered;
+}
+
+
+int ModMixer::audio_callback(const void *input, void *output, unsigned long frameCount,
+    const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags)
+{
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+
+    float* out = (float*) output;
+    const int channels = options.channels;
+    memset(out, 0, frameCount * channels * sizeof(float));
+
+    // Work out when this buffer will actually be heard. Some host APIs
+    // leave outputBufferDacTime at zero; fall back to the stream latency.
+    PaTime dac_time = timeInfo->outputBufferDacTime;
+    if (dac_time <= 0.0) {
+        dac_time = timeInfo->currentTime + output_latency;
+    }
+    dac_anchor.store(dac_time - (double) frames_rendered / options.sample_rate, memory_order_release);
+
+    // Announce the list before using it, and make sure it's still the
+    // current one, or the game thread may already have freed it.
+    ModMixerStreams* list;
+    do {
+        list = streams.load(memory_order_seq_cst);
+        streams_in_use.store(list, memory_order_seq_cst);
+    } while (list != streams.load(memory_order_seq_cst));
+    vector<ModStream*>& active = list->active;
+
+    // Each block gets its share of the time the buffer takes to play.
+    const double budget = MODMIXER_RENDER_DEADLINE * frameCount / options.sample_rate;
+
+    // Render in blocks, so no song needs more than one block of buffer.
+    unsigned long done = 0;
+    while (done < frameCount) {
+        unsigned long frames = min<unsigned long>(frameCount - done, MODMIXER_BLOCK_FRAMES);
+        chrono::steady_clock::time_point deadline = start + chrono::duration_cast<chrono::steady_clock::duration>(
+            chrono::duration<double>(budget * (done + frames) / frameCount));
+
+        // A song with a block that missed its deadline renders nothing new
+        // until that block has been mixed.
+        active.clear();
+        for (vector<ModStream*>::iterator it = list->streams.begin(); it != list->streams.end(); it++) {
+            if ((*it)->is_playing() && (*it)->queue_render(frames, frames_rendered + done)) {
+                active.push_back(*it);
+            }
+        }
+
+        unsigned queued = 0;
+        for (vector<ModStream*>::iterator it = active.begin(); it != active.end(); it++) {
+            if (pool.push(*it)) {
+                queued++;
+            }
+        }
+
+        // Nothing to gain from waking anybody up for a single song.
+        if (queued > 1) {
+            pool.wake(queued - 1);
+        }
+        while (pool.help()) {
+        }
+
+        // Whatever no worker got to, including songs a worker took off the
+        // queue but hasn't started, renders here.
+        for (vector<ModStream*>::iterator it = active.begin(); it != active.end(); it++) {
+            (*it)->run_render();
+        }
+
+        // Only the workers are left. Wait for them, but not past the deadline.
+        for (;;) {
+            bool rendering = false;
+            for (vector<ModStream*>::iterator it = active.begin(); it != active.end(); it++) {
+                if (!(*it)->is_rendered()) {
+                    rendering = true;
+                    break;
+                }
+            }
+            if (!rendering || chrono::steady_clock::now() >= deadline) {
+                break;
+            }
+            this_thread::yield();
+        }
+
+        // Late blocks that have finished since are mixed along with the
+        // rest, in list order so the sum always comes out the same.
+        for (vector<ModStream*>::iterator it = list->streams.begin(); it != list->streams.end(); it++) {
+            (*it)->mix(out + done * channels, frames);
+        }
+
+        done += frames;
+    }
+
+    streams_in_use.store(NULL, memory_order_seq_cst);
+
+    frames_rendered += frameCount;
+    frames_rendered_shared.store(frames_rendered, memory_order_release);
+
+    record_callback(chrono::duration<double>(chrono::steady_clock::now() - start).count(),
+        frameCount, statusFlags);
+
+    return paContinue;
+}
+
+
+void ModMixer::record_callback(double seconds, unsigned long frameCount, PaStreamCallbackFlags statusFlags) {
+    // An underflow is reported on the callback after the gap, so if the
+    // one before was late it's likely ours.
+    if (statusFlags & paOutputUnderflow) {
+        output_underflows.fetch_add(1, memory_order_relaxed);
+        if (last_callback_late) {
+            late_underflows.fetch_add(1, memory_order_relaxed);
+        }
+    }
+    if (statusFlags & paOutputOverflow) {
+        output_overflows.fetch_add(1, memory_order_relaxed);
+    }
+    if (statusFlags & paPrimingOutput) {
+        priming_output.fetch_add(1, memory_order_relaxed);
+    }
+
+    unsigned long long count = callbacks.load(memory_order_relaxed);
+    if (count == 0 || seconds < render_min.load(memory_order_relaxed)) {
+        render_min.store(seconds, memory_order_relaxed);
+    }
+    if (seconds > render_max.load(memory_order_relaxed)) {
+        render_max.store(seconds, memory_order_relaxed);
+    }
+    render_total.store(render_total.load(memory_order_relaxed) + seconds, memory_order_relaxed);
+
+    float load = frameCount > 0 ? (float) (seconds * options.sample_rate / frameCount) : 0.0f;
+    callback_load.store(load, memory_order_relaxed);
+    if (load > callback_peak_load.load(memory_order_relaxed)) {
+        callback_peak_load.store(load, memory_order_relaxed);
+    }
+
+    last_callback_late = load > 1.0f;
+    if (last_callback_late) {
+        deadline_misses.fetch_add(1, memory_order_relaxed);
+    }
+
+    // Tenths of the deadline, with everything over it in the last bucket.
+    int bucket = (int) (load * 10.0f);
+    if (bucket >= MODIPULATE_STATS_LOAD_BUCKETS - 1) {
+        bucket = last_callback_late ? MODIPULATE_STATS_LOAD_BUCKETS - 1 : MODIPULATE_STATS_LOAD_BUCKETS - 2;
+    }
+    load_histogram[bucket].fetch_add(1, memory_order_relaxed);
+
+    // Last, so a reader that sees the count sees the totals for it.
+    callbacks.store(count + 1, memory_order_release);
+}
+
+
+void ModMixer::get_stats(ModipulateEngineStats* stats) {
+    stats->callbacks = callbacks.load(memory_order_acquire);
+    stats->render_min = render_min.load(memory_order_relaxed);
+    stats->render_max = render_max.load(memory_order_relaxed);
+    stats->render_avg = stats->callbacks > 0 ?
+        render_total.load(memory_order_relaxed) / stats->callbacks : 0.0;
+    stats->load = callback_load.load(memory_order_relaxed);
+    stats->peak_load = callback_peak_load.load(memory_order_relaxed);
+    for (int i = 0; i < MODIPULATE_STATS_LOAD_BUCKETS; i++) {
+        stats->load_histogram[i] = load_histogram[i].load(memory_order_relaxed);
+    }
+    stats->deadline_misses = deadline_misses.load(memory_order_relaxed);
+    stats->output_underflows = output_underflows.load(memory_order_relaxed);
+    stats->late_underflows = late_underflows.load(memory_order_relaxed);
+    stats->output_overflows = output_overflows.load(memory_order_relaxed);
+    stats->priming_output = priming_output.load(memory_order_relaxed);
+}
+
+
+void ModMixer::render_task(void* item) {
+    ((ModStream*) item)->run_render();
+}
+
+
+void ModMixer::check_error(int line, PaError err) {
+    if (err != paNoError) {
+        stringstream ss;
+        ss << "PortAudio error #";
+        ss << err;
+        ss << " ";
+        ss << Pa_GetErrorText( err );
+        ss << " at line " << line;
+        DPRINT(ss.str().c_str());
+        throw string(ss.str());
+    }
+}
@@ -0,0 +1,151 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#ifndef MODMIXER_H
+#define MODMIXER_H
+
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include "modipulate_common.h"
+#include "render_pool.h"
+#include <portaudio.h>
+
+class ModStream;
+
+// Number of frames each song renders at a time before being summed
+// into the output buffer.
+#define MODMIXER_BLOCK_FRAMES 1024
+
+// Most output channels the mixer supports (quad).
+#define MODMIXER_MAX_CHANNELS 4
+
+// Share of the buffer period the audio callback waits for songs still
+// rendering on a worker. Songs not done by then are left out of the mix.
+#define MODMIXER_RENDER_DEADLINE 0.8
+
+// Songs registered with the mixer. A list is never changed once the
+// audio thread can see it; add_stream() and remove_stream() publish a new
+// one instead.
+struct ModMixerStreams {
+    std::vector<ModStream*> streams;
+    
+    // Songs playing in the block being rendered. Only the audio thread
+    // touches it; it's reserved up front, so filling it never allocates.
+    std::vector<ModStream*> active;
+};
+
+// Owns the one and only PortAudio output stream.  Every loaded ModStream
+// is registered here, and the audio callback sums all of the playing
+// songs into the device buffer.  Songs of the same block render in
+// parallel on a RenderPool; the sum is always taken in the same order.
+//
+// The audio callback never locks, allocates or waits unbounded. It picks
+// up the current list of songs through an atomic pointer, and announces
+// which list it's using, so the game thread knows when an old list can be
+// freed. It waits for songs on the workers only until the deadline (see
+// MODMIXER_RENDER_DEADLINE), and mixes the ones that are done; a block
+// that missed it is mixed into a later one.
+
+class ModMixer {
+
+public:
+    ModMixer(const ModipulateEngineOptions& options);
+    ~ModMixer();
+
+    // Opens and starts the output stream if it isn't running yet.
+    void start();
+
+    // Stops and closes the output stream. Renders a worker was still busy
+    // with are done once it returns.
+    void stop();
+
+    // True if the output stream is running.
+    bool is_running();
+
+    // Registers or unregisters a song with the mixer. Once remove_stream()
+    // returns neither the audio thread nor a render worker will touch the
+    // song again.
+    void add_stream(ModStream* mod_stream);
+    void remove_stream(ModStream* mod_stream);
+
+    // Output sampling rate in Hz.
+    int get_sampling_rate();
+
+    // Output channels, 2 or 4.
+    int get_channel_count();
+
+    // Device frame that is leaving the speaker right now, derived from
+    // the DAC timestamps PortAudio hands the audio callback.
+    unsigned long long get_playback_frame();
+
+    // Audio callback statistics, see modipulate_global_get_stats().
+    void get_stats(ModipulateEngineStats* stats);
+
+private:
+    void check_error(int line, PaError err);
+
+    int audio_callback(const void *input, void *output, unsigned long frameCount,
+        const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags);
+
+    // Makes next the current list of songs, and frees the old one once
+    // the audio thread has let go of it. Game thread, with streams_lock held.
+    void publish_streams(ModMixerStreams* next);
+
+    // Serializes add_stream() and remove_stream(). The audio thread never
+    // takes it.
+    std::mutex streams_lock;
+    
+    // Current list of songs.
+    std::atomic<ModMixerStreams*> streams;
+    
+    // List the audio callback is using, or NULL outside of it.
+    std::atomic<ModMixerStreams*> streams_in_use;
+
+    // Renders one song queued with ModStream::queue_render().
+    static void render_task(void* item);
+
+    RenderPool pool;
+
+    PaStream *stream;
+
+    ModipulateEngineOptions options;
+
+    // Frames handed to the device so far (audio thread).
+    unsigned long long frames_rendered;
+    std::atomic<unsigned long long> frames_rendered_shared;
+
+    // Stream time at which device frame 0 was (or would have been) heard.
+    std::atomic<double> dac_anchor;
+
+    // Used when the host API doesn't report outputBufferDacTime.
+    double output_latency;
+
+    // Updates the callback statistics after a callback (audio thread).
+    void record_callback(double seconds, unsigned long frameCount, PaStreamCallbackFlags statusFlags);
+
+    // Callback statistics, written by the audio thread only.
+    std::atomic<unsigned long long> callbacks;
+    std::atomic<double> render_total;
+    std::atomic<double> render_min;
+    std::atomic<double> render_max;
+    std::atomic<float> callback_load;
+    std::atomic<float> callback_peak_load;
+    std::atomic<unsigned long long> load_histogram[MODIPULATE_STATS_LOAD_BUCKETS];
+    std::atomic<unsigned> deadline_misses;
+    std::atomic<unsigned> output_underflows;
+    std::atomic<unsigned> late_underflows;
+    std::atomic<unsigned> output_overflows;
+    std::atomic<unsigned> priming_output;
+    bool last_callback_late;
+
+    friend int mod_mixer_callback(const void *input, void *output, unsigned long frameCount,
+        const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void *userData);
+};
+
+#endif // MODMIXER_H
@@ -1,4 +1,5 @@
 #include "mod_stream.h"
+#include "mod_mixer.h"
 
 #include <iostream>
 #include <stdlib.h>
@@ -8,81 +9,31 @@
 #include <math.h>
 #include <errno.h>
 #include <fstream>
-
-#include <portaudio.h>
+#include <chrono>
+#include <algorithm>
 
 #include "libopenmpt-forked/soundlib/modcommand.h"
 
 using namespace std;
 
 // Global volume.
-float ModStream::modipulate_global_volume = 1.0;
-
-// Callback helper functions.
-int mod_stream_callback(const void *input, void *output, unsigned long frameCount, 
-    const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void *userData) {
-    return ((ModStream*) userData)->audio_callback(input, output, frameCount, timeInfo, statusFlags);
-}
-
-void mod_stream_callback_finished(void* userData) {
-    ((ModStream*) userData)->stream_finished_callback();
-}
-
-ModStreamRow::ModStreamRow() :
-    samples_since_last(0),
-    change_tempo(-1),
-    change_pattern(-1)
-{}
-
-
-void ModStreamRow::add_note(ModStreamNote* n) {
-    notes.push_back(n);
-}
-
-
-ModStreamNote::ModStreamNote() :
-    channel(0),
-    note(-1),
-    instrument(-1),
-    sample(-1),
-    volume(-1)
-{}
-
-ModStreamPendingSample::ModStreamPendingSample() :
-	sample(0),
-	note(0),
-    channel(0),
-	modulus(0),
-	offset(0),
-	volume_command(0),
-	volume_value(0),
-	effect_command(0),
-	effect_value(0),
-	used(true)
-{}
-
-void ModStreamPendingSample::set(int sample, int note, unsigned channel, int modulus, 
-    unsigned offset, int volume_command, int volume_value, int effect_command, int effect_value) {
-    this->sample = sample;
-    this->note = note;
-    this->channel = channel;
-    this->modulus = modulus;
-    this->offset = offset;
-    this->volume_command = volume_command;
-    this->volume_value = volume_value;
-    this->effect_command = effect_command;
-    this->effect_value = effect_value;
-
-    this->used = false; // duh
-}
-
+std::atomic<float> ModStream::modipulate_global_volume(1.0f);
 
-ModStream::ModStream() :
+ModStream::ModStream(ModMixer* mixer) :
     mod(NULL),
+    mixer(mixer),
+    handle(NULL),
     file_length(0),
-    stream_started(false),
+    playing(false),
+    samples_rendered(0),
+    frame_offset(0),
     last_tempo_read(-1),
-    tempo_override(-1),
+    tempo_factor(1.0),
+    tempo_ramp_msec(0),
+    tempo_changed(false),
+    pitch_factor(1.0),
+    pitch_ramp_msec(0),
+    pitch_changed(false),
     
     pattern_cb(NULL),
     pattern_user_data(NULL),
@@ -93,11 +44,36 @@ ModStream::ModStream() :
     note_cb(NULL),
     note_user_data(NULL),
     
-    volume_command_enabled(MAX_CHANNELS, MAX_VOLCMDS),
-    effect_command_enabled(MAX_CHANNELS, MAX_EFFECTS),
+    rows_started(0),
+    ticks_started(0),
+    frames_rendered(0),
+    tick_start_frame(0),
+    tick_frames(0),
     
-    stream(NULL),
-	lastPattern(-1)
+    pending_row(-1),
+    dropped_events(0),
+    polling(false),
+    position_seconds(0.0),
+    rendering_offline(false),
+    callbacks_cancelled(false),
+    current_event_frame(0),
+	lastPattern(-1),
+    block_frames(0),
+    block_mixed(0),
+    render_state(RENDER_IDLE),
+    job_frames(0),
+    job_device_frame(0),
+    block_late(false),
+    late_blocks(0),
+    render_load(0.0f),
+    render_peak_load(0.0f),
+    deadline_misses(0),
+    voices(0),
+    peak_voices(0),
+    row_seconds(0.0),
+    mix_seconds(0.0),
+    last_row_seconds(0.0),
+    last_mix_seconds(0.0)
 {
 	resetInternal();
 }
@@ -116,56 +92,57 @@ void ModStream::open(string path) {
 
     DPRINT("Opening: %s", path.c_str());
     
-	std::ifstream file( path, std::ios::binary );
+    try {
+	    mod = new openmpt::module( path );
+    } catch(const openmpt::exception& e) {
+        throw string("Error reading file: " + path + ": " + e.what());
+    }
+
+    on_opened();
+}
+
 
-    if (file.fail() || !file.good()) {
-        throw string("Error reading file: " + path);
+void ModStream::open_memory(const void* data, std::size_t size) {
+    if (mod) {
+        throw string("File already loaded. Did you forget to call ModStream::close()?");
     }
-    
+
     try {
-	    mod = new openmpt::module( file );
+	    mod = new openmpt::module( data, size );
     } catch(const openmpt::exception& e) {
-        string err = e.what();
+        throw string(e.what());
+    }
 
-        delete mod;
-        mod = NULL;
+    on_opened();
+}
 
-        throw err;
-    }
 
-	mod->set_mod_stream(this);
-    
-    // Allocate the current row.
-    current_row = new ModStreamRow();
+void ModStream::on_opened() {
+	mod->set_sound_hooks(this);
     
-    samples_played = 0;
+    samples_rendered = 0;
+    pending_row = -1;
     
-    PaStreamParameters outputParameters;
-    outputParameters.device = Pa_GetDefaultOutputDevice(); /* default output device */
-    if (outputParameters.device == paNoDevice) {
-        delete mod;
-        mod = NULL;
+    rows_started = 0;
+    ticks_started = 0;
+    frames_rendered = 0;
+    tick_start_frame = 0;
+    tick_frames = 0;
 
-        throw string("Error: No default output device.");
-    }
-    outputParameters.channelCount = 2;
-    outputParameters.sampleFormat = paFloat32;
-    outputParameters.suggestedLatency = Pa_GetDeviceInfo(outputParameters.device)->defaultLowOutputLatency;
-    outputParameters.hostApiSpecificStreamInfo = NULL;
-    
-    check_error(__LINE__, Pa_OpenStream(
-              &stream,
-              NULL, /* no input */
-              &outputParameters,
-              sampling_rate,
-              paFramesPerBufferUnspecified,
-              paClipOff,      /* we won't output out of range samples so don't bother clipping them */
-              mod_stream_callback,
-              this));
+	default_tempo = mod->get_current_tempo();
+    position_seconds = 0.0;
     
-    check_error(__LINE__, Pa_SetStreamFinishedCallback(stream, &mod_stream_callback_finished));
+    seek_scanner = std::thread(&ModStream::scan_seek_points, this, mixer->get_sampling_rate());
+}
 
-	default_tempo = mod->get_current_tempo();
+
+void ModStream::scan_seek_points(int rate) {
+    try {
+        mod->build_seek_cache(rate);
+    } catch (const openmpt::exception& e) {
+        // Seeks still work, just without shortcuts.
+        DPRINT("Can't build seek cache: %s", e.what());
+    }
 }
 
 
@@ -174,12 +151,17 @@ void ModStream::close() {
         return;
     }
 
-    // Ignore errors, just exit.
-    Pa_StopStream(stream);
-    Pa_CloseStream(stream);
+    playing = false;
+    
+    if (seek_scanner.joinable()) {
+        seek_scanner.join();
+    }
     
     delete mod;
 	mod = NULL;
+    
+    samples.clear();
+    commands.clear();
 }
 
 
@@ -188,61 +170,172 @@ void ModStream::set_playing(bool play) {
         // Nothing to do.
         return;
     } else if (play) {
-        check_error(__LINE__, Pa_StartStream(stream));
-		timer.start();
-        stream_started = true;
+        if (!mod) {
+            throw string("No file loaded.");
+        }
+        
+        mixer->start();
+        playing = true;
     } else if (!play) {
-        check_error(__LINE__, Pa_StopStream(stream));
-        timer.stop();
+        // Events already rendered keep their device timestamps, so they
+        // still fire exactly when the last buffered audio is heard.
+        playing = false;
     }
 }
 
 bool ModStream::is_playing() {
-    if (!stream_started || !mod) {
-        return false;
+    return playing && mod;
+}
+
+
+void ModStream::render(unsigned long frameCount, unsigned long long device_frame) {
+    block_frames = 0;
+    block_mixed = 0;
+    
+    // Never wait on the game thread; it only holds this during an offline render.
+    unique_lock<mutex> lock(render_lock, try_to_lock);
+    if (!lock.owns_lock()) {
+        return;
+    }
+    
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    
+    // Events raised while rendering are stamped relative to this.
+    frame_offset = device_frame - samples_rendered;
+    
+    apply_playback_factors(mixer->get_sampling_rate());
+    
+    // Song and global volume are applied as libopenmpt writes the block.
+    mod->set_gain(modipulate_global_volume.load(memory_order_relaxed) * volume.load(memory_order_relaxed));
+    
+    const int channels = mixer->get_channel_count();
+    std::size_t count;
+    if (channels == 4) {
+        count = mod->read_interleaved_quad( mixer->get_sampling_rate(), frameCount, block );
+    } else {
+        count = mod->read_interleaved_stereo( mixer->get_sampling_rate(), frameCount, block );
+    }
+    if (0 == count) {
+        DPRINT("Song finished.");
+        playing = false; // End of stream
+        return;
+    }
+    block_frames = count;
+    position_seconds.store(mod->get_position_seconds(), memory_order_relaxed);
+    
+    // Compare the time spent against the time the block takes to play.
+    double elapsed = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    float load = (float) (elapsed * mixer->get_sampling_rate() / frameCount);
+    render_load.store(load, memory_order_relaxed);
+    if (load > render_peak_load.load(memory_order_relaxed)) {
+        render_peak_load.store(load, memory_order_relaxed);
+    }
+    if (load > 1.0f) {
+        deadline_misses.fetch_add(1, memory_order_relaxed);
+    }
+    
+    unsigned mixed = (unsigned) mod->get_current_playing_channels();
+    voices.store(mixed, memory_order_relaxed);
+    if (mixed > peak_voices.load(memory_order_relaxed)) {
+        peak_voices.store(mixed, memory_order_relaxed);
     }
     
-    return (Pa_IsStreamActive(stream) == 1);
+    double rows, mixing;
+    mod->get_render_times(rows, mixing);
+    last_row_seconds.store(rows - row_seconds.load(memory_order_relaxed), memory_order_relaxed);
+    last_mix_seconds.store(mixing - mix_seconds.load(memory_order_relaxed), memory_order_relaxed);
+    row_seconds.store(rows, memory_order_relaxed);
+    mix_seconds.store(mixing, memory_order_relaxed);
 }
 
 
-int ModStream::audio_callback(const void *input, void *output, unsigned long frameCount,
-    const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags) 
-{
-	std::size_t count = mod->read_interleaved_stereo( sampling_rate, frameCount, (float*) output );
-	if (0 == count) {
-		return paAbort; // End of stream
-	}
+bool ModStream::queue_render(unsigned long frameCount, unsigned long long device_frame) {
+    if (render_state.load(memory_order_acquire) != RENDER_IDLE) {
+        return false;
+    }
+    
+    block_late = false;
+    job_frames = frameCount;
+    job_device_frame = device_frame;
+    render_state.store(RENDER_QUEUED, memory_order_release);
+    return true;
+}
 
-    // Perform volume adjustment.
-    float* out = (float*) output;
-    for (int i = 0; i < frameCount * 2; i++) { // *2 because we're in stereo (just like KOFY)
-        (*out++) *= modipulate_global_volume * volume;
+
+void ModStream::run_render() {
+    int queued = RENDER_QUEUED;
+    if (!render_state.compare_exchange_strong(queued, RENDER_BUSY, memory_order_acquire)) {
+        return;
     }
+    
+    render(job_frames, job_device_frame);
+    render_state.store(RENDER_DONE, memory_order_release);
+}
 
-    return paContinue;
+
+bool ModStream::is_rendered() {
+    return render_state.load(memory_order_acquire) == RENDER_DONE;
 }
 
 
-void ModStream::stream_finished_callback() {
-    DPRINT("PA: Stream finished.");
+void ModStream::mix(float* output, unsigned long frames) {
+    int state = render_state.load(memory_order_acquire);
+    if (state == RENDER_BUSY && !block_late) {
+        block_late = true;
+        late_blocks.fetch_add(1, memory_order_relaxed);
+    }
+    if (state != RENDER_DONE) {
+        return;
+    }
+    
+    // Nobody's listening to a song that has stopped since.
+    if (is_playing()) {
+        const int channels = mixer->get_channel_count();
+        const unsigned long count = min(frames, block_frames - block_mixed);
+        const float* in = block + block_mixed * channels;
+        
+        // Already at the right volume, so this is only a sum.
+        const std::size_t samples = count * channels;
+        for (std::size_t i = 0; i < samples; i++) {
+            output[i] += in[i];
+        }
+        block_mixed += count;
+        if (block_mixed < block_frames) {
+            return;
+        }
+    }
+    render_state.store(RENDER_IDLE, memory_order_relaxed);
 }
 
 
-void ModStream::check_error(int line, PaError err) {
-    if (err != paNoError) {
-        stringstream ss;
-        ss << "PortAudio error #";
-        ss << err;
-        ss << " ";
-        ss << Pa_GetErrorText( err );
-        ss << " at line " << line;
-        DPRINT(ss.str().c_str());
-        throw string(ss.str());
+void ModStream::get_render_load(float* load, float* peak_load, unsigned* misses) {
+    if (load) {
+        *load = render_load.load(memory_order_relaxed);
+    }
+    if (peak_load) {
+        *peak_load = render_peak_load.load(memory_order_relaxed);
+    }
+    if (misses) {
+        *misses = deadline_misses.load(memory_order_relaxed);
     }
 }
 
 
+void ModStream::get_stats(ModipulateSongStats* stats) {
+    get_render_load(&stats->load, &stats->peak_load, &stats->deadline_misses);
+    stats->late_blocks = late_blocks.load(memory_order_relaxed);
+    
+    stats->voices = voices.load(memory_order_relaxed);
+    stats->peak_voices = peak_voices.load(memory_order_relaxed);
+    stats->pending_events = events.size();
+    stats->dropped_events = dropped_events.load(memory_order_relaxed);
+    stats->row_seconds = row_seconds.load(memory_order_relaxed);
+    stats->mix_seconds = mix_seconds.load(memory_order_relaxed);
+    stats->last_row_seconds = last_row_seconds.load(memory_order_relaxed);
+    stats->last_mix_seconds = last_mix_seconds.load(memory_order_relaxed);
+}
+
+
 void ModStream::get_info(ModipulateSongInfo** _info) {
     ModipulateSongInfo* song_info = new ModipulateSongInfo;
     
@@ -292,12 +385,16 @@ void ModStream::free_info(ModipulateSongInfo* info) {
 
 // Enable or disable channels.
 void ModStream::set_channel_enabled(int channel, bool is_enabled) {
-    enabled_channels[channel] = is_enabled;
+    try {
+        mod->set_channel_enabled(channel, is_enabled);
+    } catch (const openmpt::exception& e) {
+        throw string(e.what());
+    }
 }
 
 
 bool ModStream::get_channel_enabled(int channel) {
-	return enabled_channels[channel];
+	return mod->get_channel_enabled(channel);
 }
 
 
@@ -322,98 +419,354 @@ void ModStream::set_row_change_cb(modipulate_song_row_change_cb cb, void* user_d
 }
 
 
+void ModStream::set_handle(ModipulateSong handle) {
+    this->handle = handle;
+}
+
+
+ModipulateSong ModStream::get_handle() {
+    return handle;
+}
+
+
 void ModStream::set_note_change_cb(modipulate_song_note_cb cb, void* user_data) {
     note_cb = cb;
     note_user_data = user_data;
 }
 
 
-void ModStream::perform_callbacks() {
-    // Make sure there's something to do!
-    if (rows.empty() || !is_playing())
-        return;
-    
-    // Convert time to sample number.
-	// 1 second / one million = 1 micro second
-	unsigned long long samples_since_start = (timer.getElapsedTimeInMicroSec() * (((double) sampling_rate) / 1000000.0));
+unsigned long ModStream::render_offline(int rate, bool int16, void* buffer, unsigned long frameCount) {
+    if (!mod) {
+        throw string("No file loaded.");
+    }
+    if (is_playing()) {
+        throw string("Can't render a song offline while it's playing.");
+    }
     
-    while (!rows.empty()) {
-        // Process callbacks from row data.
-        ModStreamRow* r = rows.front();
-        
-        unsigned long long sample_counter = samples_played + r->samples_since_last;
-        if (sample_counter > samples_since_start)
-            break; // done (for now!)
-        
-        samples_played += r->samples_since_last;
+    // Render a block at a time, firing each block's callbacks before the
+    // next, so a long render can't overflow the event queue.
+    unsigned long done = 0;
+    bool first = true;
+    while (done < frameCount) {
+        unsigned long frames = min<unsigned long>(frameCount - done, MODMIXER_BLOCK_FRAMES);
+        std::size_t count;
+        {
+            lock_guard<mutex> lock(render_lock);
+            
+            if (first) {
+                // Whatever live playback left behind is stamped with the
+                // device clock, not with offsets into this buffer.
+                events.clear();
+                
+                // Stamp events with their offset into the caller's buffer.
+                frame_offset = 0 - samples_rendered;
+                first = false;
+            }
+            
+            try {
+                apply_playback_factors(rate);
+                // Offline renders ignore the song and global volume.
+                mod->set_gain(1.0f);
+                if (int16)
+                    count = mod->read_interleaved_stereo(rate, frames, (std::int16_t*) buffer + done * 2);
+                else
+                    count = mod->read_interleaved_stereo(rate, frames, (float*) buffer + done * 2);
+            } catch (const openmpt::exception& e) {
+                throw string(e.what());
+            }
+            position_seconds.store(mod->get_position_seconds(), memory_order_relaxed);
+        }
+        done += count;
         
-        rows.pop();
+        // Everything queued happened inside this block.
+        rendering_offline = true;
+        perform_callbacks(~0ULL);
+        rendering_offline = false;
         
-        // 1. Pattern change callback.
-        if (r->change_pattern != -1 && pattern_cb != NULL)
-            pattern_cb(this, r->change_pattern, pattern_user_data);
+        // Stop at the end of the song, or if a callback unloaded the song
+        // or started it playing.
+        if (count < frames || callbacks_cancelled || is_playing())
+            break;
+    }
+    
+    return done;
+}
+
+
+double ModStream::seek_seconds(double seconds) {
+    if (!mod) {
+        throw string("No file loaded.");
+    }
+    if (seconds < 0) {
+        throw string("Can't seek to a negative time.");
+    }
+    
+    // The audio thread skips this song's block rather than wait for us.
+    lock_guard<mutex> lock(render_lock);
+    double position = mod->set_position_seconds(seconds);
+    position_seconds.store(position, memory_order_relaxed);
+    return position;
+}
+
+
+double ModStream::seek_order_row(int order, int row) {
+    if (!mod) {
+        throw string("No file loaded.");
+    }
+    if (order < 0 || order >= mod->get_num_orders()) {
+        throw string("Invalid order.");
+    }
+    // "+++" and "---" orders have no rows; they're entered at row 0.
+    int rows = mod->get_pattern_num_rows(mod->get_order_pattern(order));
+    if (row < 0 || (rows > 0 && row >= rows)) {
+        throw string("Invalid row.");
+    }
+    
+    lock_guard<mutex> lock(render_lock);
+    double position = mod->set_position_order_row(order, row);
+    position_seconds.store(position, memory_order_relaxed);
+    return position;
+}
+
+
+double ModStream::get_position_seconds() {
+    return position_seconds.load(memory_order_relaxed);
+}
+
+
+bool ModStream::get_timeline(double start, double end, std::vector<openmpt::module::timeline_event>& events) {
+    if (!mod) {
+        return false;
+    }
+    return mod->get_timeline(start, end, events);
+}
+
+
+bool ModStream::get_event_offset(unsigned long* offset) {
+    if (!rendering_offline) {
+        return false;
+    }
+    
+    *offset = (unsigned long) current_event_frame;
+    
+    return true;
+}
+
+
+void ModStream::perform_callbacks(unsigned long long playback_frame) {
+    // Free the samples that have played.
+    samples.collect();
+    
+    const ModStreamEvent* e;
+    while (!callbacks_cancelled && (e = events.peek()) != NULL) {
+        if (e->frame > playback_frame)
+            break; // done (for now!)
         
-        // 2. Row change callback.
-        if (row_cb != NULL)
-            row_cb(this, r->row, row_user_data);
+        current_event_frame = e->frame;
         
-        // 3. Note change callbacks.
-        if (r->notes.size() > 0) {
-            list<ModStreamNote*>::iterator it;
+        switch (e->type) {
+        case MODSTREAM_EVENT_PATTERN:
+            if (pattern_cb != NULL)
+                pattern_cb(handle, e->value, pattern_user_data);
+            break;
             
-            for (it = r->notes.begin(); it != r->notes.end(); it++) {
-                ModStreamNote* n = (*it);
-                
-                if (note_cb != NULL)
-                    note_cb(this, n->channel, n->note, n->instrument, n->sample, 0, 0, 0, 0, note_user_data);
-                
-                // TODO: what is n->volume? do we need it?
-                //call_note_changed(n->channel, n->note, n->instrument, n->sample, n->volume);
-                
-                delete n;
+        case MODSTREAM_EVENT_ROW:
+            if (row_cb != NULL)
+                row_cb(handle, e->value, row_user_data);
+            break;
+            
+        case MODSTREAM_EVENT_NOTE:
+            // TODO: what is e->volume? do we need it?
+            if (note_cb != NULL)
+                note_cb(handle, e->channel, e->note, e->instrument, e->sample,
+                    e->volume_command ? e->volume_command : -1, e->volume_command ? e->volume_value : 0,
+                    e->effect_command ? e->effect_command : -1, e->effect_command ? e->effect_value : 0,
+                    note_user_data);
+            break;
+        }
+        
+        if (polling) {
+            // Nobody's keeping up; the oldest events matter least.
+            if (polled_events.size() >= MAX_PENDING_EVENTS) {
+                polled_events.pop_front();
+                dropped_events++;
             }
+            polled_events.push_back(*e);
         }
         
-        delete r;
+        ModStreamEvent done;
+        events.pop(done);
     }
 }
 
-void ModStream::on_note_change(unsigned channel, int note, int instrumentNumber, int sampleNumber, int volume) {
-    ModStreamNote* n = new ModStreamNote();
-    n->channel = channel;
-    n->note = note;
-	n->instrument = instrumentNumber;
-	n->sample =sampleNumber;
-    n->volume = volume;
+void ModStream::cancel_callbacks() {
+    callbacks_cancelled = true;
+}
+
+void ModStream::set_event_polling(bool enabled) {
+    polling = enabled;
+    if (!polling)
+        polled_events.clear();
+}
+
+bool ModStream::get_event_polling() {
+    return polling;
+}
+
+unsigned ModStream::poll_events(ModipulateEvent* buffer, unsigned capacity) {
+    unsigned count = 0;
+    while (count < capacity && !polled_events.empty()) {
+        const ModStreamEvent& e = polled_events.front();
+        ModipulateEvent& event = buffer[count++];
+        event.frame = e.sample_pos;
+        event.type = e.type;
+        event.channel = e.type == MODSTREAM_EVENT_NOTE ? (int) e.channel : -1;
+        event.value = e.type == MODSTREAM_EVENT_NOTE ? e.note : e.value;
+        event.instrument = e.instrument;
+        event.sample = e.sample;
+        event.volume = e.volume;
+        event.volume_command = e.volume_command ? e.volume_command : -1;
+        event.volume_value = e.volume_command ? e.volume_value : 0;
+        event.effect_command = e.effect_command ? e.effect_command : -1;
+        event.effect_value = e.effect_command ? e.effect_value : 0;
+        polled_events.pop_front();
+    }
+    
+    return count;
+}
+
+void ModStream::push_event(int type, int value, unsigned channel, int note, int instrument,
+    int sample, int volume, int volume_command, int volume_value, int effect_command,
+    int effect_value) {
+    ModStreamEvent e;
+    e.sample_pos = samples_rendered;
+    e.frame = samples_rendered + frame_offset;
+    e.type = type;
+    e.value = value;
+    e.channel = channel;
+    e.note = note;
+    e.instrument = instrument;
+    e.sample = sample;
+    e.volume = volume;
+    e.volume_command = volume_command;
+    e.volume_value = volume_value;
+    e.effect_command = effect_command;
+    e.effect_value = effect_value;
+    
+    if (!events.push(e))
+        dropped_events++;
+}
 
-    current_row->add_note(n);
+void ModStream::OnNoteChange(CHANNELINDEX channel, int note, int instrumentNumber, int sampleNumber, int volume,
+    int volcmd, int vol, int cmd, int param) {
+    push_event(MODSTREAM_EVENT_NOTE, 0, channel, note, instrumentNumber, sampleNumber, volume,
+        volcmd, vol, cmd, param);
 }
 
 
-void ModStream::on_pattern_changed(unsigned pattern) {
+void ModStream::OnPatternChanged(PATTERNINDEX pattern) {
 	if (pattern != lastPattern) {
-		current_row->change_pattern = (int) pattern;
+        push_event(MODSTREAM_EVENT_PATTERN, (int) pattern);
 		lastPattern = (int) pattern;
 	}
+    
+    // The row is settled by now, so it's time to see which samples and
+    // commands are due.
+    samples.start_row(mod->get_current_row(), mod->get_pattern_num_rows(pattern));
+    
+    unsigned long long row = rows_started.load(memory_order_relaxed);
+    commands.start_row(row);
+    
+    rows_started.store(row + 1, memory_order_relaxed);
+    
+    // Pattern goes first so callbacks see the new pattern before its row.
+    if (pending_row != -1) {
+        push_event(MODSTREAM_EVENT_ROW, pending_row);
+        pending_row = -1;
+    }
 }
 
 
-void ModStream::on_row_changed(int row) {
-    rows.push(current_row);
-    current_row = new ModStreamRow();
-    current_row->row = row;
+void ModStream::OnRowChanged(ROWINDEX row) {
+    pending_row = (int) row;
 }
 
 
 void ModStream::on_tempo_changed(int tempo) {
-    if (tempo != last_tempo_read) {
-        current_row->change_tempo = tempo;
-        last_tempo_read = tempo;
+    last_tempo_read = tempo;
+}
+
+void ModStream::OnSamplesRendered(uint32 count) {
+    samples_rendered += count;
+    frames_rendered.store(samples_rendered, memory_order_relaxed);
+}
+
+
+void ModStream::OnTickStarted() {
+    if (ticks_started.load(memory_order_relaxed) > 0) {
+        tick_frames = (unsigned long) (samples_rendered - tick_start_frame);
     }
+    tick_start_frame = samples_rendered;
+    ticks_started.store(ticks_started.load(memory_order_relaxed) + 1, memory_order_relaxed);
+    
+    TickClock clock;
+    clock.tick = ticks_started.load(memory_order_relaxed) - 1;
+    clock.frame = tick_start_frame;
+    clock.tick_frames = tick_frames;
+    commands.start_tick(clock);
 }
 
-void ModStream::increase_sample_count(int add) {
-    current_row->samples_since_last += add;
+
+void ModStream::OnRowCommand(CHANNELINDEX channel, ROWINDEX row, UINT &note, UINT &instr,
+    UINT &volcmd, UINT &vol, UINT &cmd, UINT &param, UINT &delay) {
+    // Check for pending samples.
+    const SampleTrigger* trigger = samples.take(channel);
+    if (trigger) {
+        instr = trigger->sample;
+        note = trigger->note;
+        
+        // -1 means no command.
+        volcmd = trigger->volume_command >= 0 ? trigger->volume_command : 0;
+        vol = trigger->volume_command >= 0 ? trigger->volume_value : 0;
+        cmd = trigger->effect_command >= 0 ? trigger->effect_command : 0;
+        param = trigger->effect_command >= 0 ? trigger->effect_value : 0;
+        delay = trigger->tick;
+        
+        // TODO:
+        // int velocity;
+    }
+    
+    // Queued commands go on top.
+    const QueuedCell* cell = commands.take(channel);
+    if (cell) {
+        if (cell->volume) {
+            volcmd = cell->volume_command;
+            vol = cell->volume_value;
+        }
+        if (cell->effect) {
+            cmd = cell->effect_command;
+            param = cell->effect_value;
+        }
+    }
+}
+
+
+bool ModStream::OnTickCommand(CHANNELINDEX channel, UINT &volcmd, UINT &vol, UINT &cmd, UINT &param) {
+    // Tick and frame targets later in the row.
+    const QueuedCell* cell = commands.take(channel);
+    if (!cell) {
+        return false;
+    }
+    
+    if (cell->volume) {
+        volcmd = cell->volume_command;
+        vol = cell->volume_value;
+    }
+    if (cell->effect) {
+        cmd = cell->effect_command;
+        param = cell->effect_value;
+    }
+    return true;
 }
 
 
@@ -428,7 +781,7 @@ std::string ModStream::get_message() {
 
 
 double ModStream::get_volume() {
-    return volume;
+    return volume.load(memory_order_relaxed);
 }
 
 
@@ -438,7 +791,7 @@ void ModStream::set_volume(double vol) {
     else if (vol > 1.)
         vol = 1.;
 
-    volume = vol;
+    volume.store((float) vol, memory_order_relaxed);
 }
 
 unsigned ModStream::get_num_instruments() {
@@ -471,170 +824,163 @@ int ModStream::get_rows_in_pattern(int pattern) {
 }
 
 
-void ModStream::set_tempo_override(int tempo) {
-    tempo_override = tempo;
+void ModStream::set_tempo_factor(double factor, unsigned msec) {
+    if (!mod) {
+        throw string("No file loaded.");
+    }
+    tempo_ramp_msec.store(msec, memory_order_relaxed);
+    tempo_factor.store(factor, memory_order_relaxed);
+    tempo_changed.store(true, memory_order_release);
 }
 
 
-int ModStream::get_tempo_override() {
-    return tempo_override;
+double ModStream::get_tempo_factor() {
+    return tempo_factor.load(memory_order_relaxed);
 }
 
 
-void ModStream::set_transposition(int channel, int offset) {
-    transposition_offset[channel] = offset;
+void ModStream::set_pitch_factor(double factor, unsigned msec) {
+    if (!mod) {
+        throw string("No file loaded.");
+    }
+    pitch_ramp_msec.store(msec, memory_order_relaxed);
+    pitch_factor.store(factor, memory_order_relaxed);
+    pitch_changed.store(true, memory_order_release);
 }
 
 
-int ModStream::get_transposition(int channel) {
-    return transposition_offset[channel];
+double ModStream::get_pitch_factor() {
+    return pitch_factor.load(memory_order_relaxed);
 }
 
 
-void ModStream::play_sample(int sample, int note, unsigned channel, int modulus,
-	unsigned offset, int volume_command, int volume_value, int effect_command, int effect_value) {
-    for (int i = 0; i < MAX_PENDING_SAMPLES; i++) {
-        if (pending_samples[i].used) {
-            pending_samples[i].set(sample, note, channel, modulus,
-		        offset, volume_command, volume_value, effect_command, effect_value);
-
-            break;
-        }
+void ModStream::apply_playback_factors(int rate) {
+    // A factor set twice between renders only ramps to the second value.
+    if (tempo_changed.exchange(false, memory_order_acquire)) {
+        unsigned long long frames = (unsigned long long) tempo_ramp_msec.load(memory_order_relaxed) * rate / 1000;
+        mod->set_tempo_factor(tempo_factor.load(memory_order_relaxed), (std::int32_t) std::min(frames, 0x7FFFFFFFULL));
+    }
+    if (pitch_changed.exchange(false, memory_order_acquire)) {
+        unsigned long long frames = (unsigned long long) pitch_ramp_msec.load(memory_order_relaxed) * rate / 1000;
+        mod->set_pitch_factor(pitch_factor.load(memory_order_relaxed), (std::int32_t) std::min(frames, 0x7FFFFFFFULL));
     }
 }
 
-void ModStream::fade_channel(unsigned msec, int channel, double destination) {
-    mod->fade_channel(msec, channel, destination);
+
+void ModStream::set_transposition(int channel, int offset) {
+    try {
+        mod->set_channel_transposition(channel, offset);
+    } catch (const openmpt::exception& e) {
+        throw string(e.what());
+    }
 }
 
 
-ModStreamPendingSample* ModStream::get_pending_for(unsigned channel, unsigned row) {
-	ModStreamPendingSample* ret = NULL;
+int ModStream::get_transposition(int channel) {
+    return mod->get_channel_transposition(channel);
+}
 
-    // Iterate over all pending samples.
-    for (int i = 0; i < MAX_PENDING_SAMPLES; i++) {
-        // Skip the ones we don't care about.
-        if (pending_samples[i].used || pending_samples[i].channel != channel) {
-            continue;
-        }
 
-        // We got one, bro!
-        ModStreamPendingSample* sample = &(pending_samples[i]);
-        if (sample->modulus > 0 && row % sample->modulus == 0) {
-			// Okay! We got one!  Clear the modulus, now the offset
-			// is what we're interested in.
-			sample->modulus = 0;
-		}
+ModipulateSampleHandle ModStream::play_sample(int sample, int note, unsigned channel, int modulus,
+	unsigned offset, unsigned tick, int volume_command, int volume_value, int effect_command, int effect_value) {
+    if (!mod) {
+        throw string("No file loaded.");
+    }
+    
+    SampleTrigger* trigger = new SampleTrigger();
+    trigger->sample = sample;
+    trigger->note = note;
+    trigger->channel = channel;
+    trigger->modulus = modulus;
+    trigger->offset = offset;
+    trigger->tick = tick;
+    trigger->volume_command = volume_command;
+    trigger->volume_value = volume_value;
+    trigger->effect_command = effect_command;
+    trigger->effect_value = effect_value;
+    
+    return samples.schedule(trigger);
+}
 
-		if (0 == sample->modulus) {
-			if (0 == sample->offset) {
-				if (ret) {
-					// Since we can only return one, mark the previous one as used.
-					ret->used = true;
-				}
 
-				// We got one!  Return the sample.
-				ret = sample;
-			} else {
-				// Decrement the offset until it's zero.
-				sample->offset--;
-			}
-		}
-    }
+bool ModStream::cancel_sample(ModipulateSampleHandle handle) {
+    return samples.cancel(handle);
+}
 
-	return ret;
+void ModStream::fade_channel(unsigned msec, int channel, double destination) {
+    mod->fade_channel(msec, channel, destination);
 }
 
 
 void ModStream::enable_volume_command(int channel, int volume_command, bool enable) {
-    volume_command_enabled.set(channel, volume_command, enable);
+    try {
+        mod->set_channel_volume_command_enabled(channel, volume_command, enable);
+    } catch (const openmpt::exception& e) {
+        throw string(e.what());
+    }
 }
 
 
 bool ModStream::is_volume_command_enabled(int channel, int volume_command) {
-    return volume_command_enabled.get(channel, volume_command);
+    return mod->get_channel_volume_command_enabled(channel, volume_command);
 }
 
 
 void ModStream::enable_effect_command(int channel, int effect_command, bool enable) {
-    effect_command_enabled.set(channel, effect_command, enable);
+    try {
+        mod->set_channel_effect_enabled(channel, effect_command, enable);
+    } catch (const openmpt::exception& e) {
+        throw string(e.what());
+    }
 }
 
 
 bool ModStream::is_effect_command_enabled(int channel, int effect_command) {
-    return effect_command_enabled.get(channel, effect_command);
+    return mod->get_channel_effect_enabled(channel, effect_command);
 }
 
 
-void ModStream::issue_effect_command(unsigned channel, unsigned effect_command, unsigned effect_param) {
-    effectCommand[channel] = effect_command;
-    effectParameter[channel] = effect_param;
-}
-
-bool ModStream::is_effect_command_pending(unsigned channel) {
-    return effectCommand[channel] != 0;
-}
-
-
-unsigned ModStream::pop_effect_command(unsigned channel) {
-    unsigned cmd = effectCommand[channel];
-    effectCommand[channel] = 0;
+bool ModStream::queue_command(unsigned channel, bool effect, int command, int value,
+    int when, unsigned long long at) {
+    if (!mod) {
+        throw string("No file loaded.");
+    }
+    if (channel >= MAX_CHANNELS) {
+        throw string("Invalid channel.");
+    }
+    if (command < 0 || value < 0) {
+        throw string("Invalid command.");
+    }
+    if (when < MODIPULATE_WHEN_NEXT_ROW || when > MODIPULATE_WHEN_FRAME) {
+        throw string("Invalid time.");
+    }
     
-    return cmd;
-}
-
-
-unsigned ModStream::pop_effect_parameter(unsigned channel) {
-    unsigned cmd = effectParameter[channel];
-    volParameter[channel] = 0;
+    QueuedCommand c;
+    c.channel = channel;
+    c.effect = effect;
+    c.command = command;
+    c.value = value;
+    c.when = when;
+    c.at = at;
     
-    return cmd;
-}
-
-
-void ModStream::issue_volume_command(unsigned channel, unsigned volume_command, unsigned volume_param) {
-    volCommand[channel] = volume_command;
-    volParameter[channel] = volume_param;
-}
-
-
-bool ModStream::is_volume_command_pending(unsigned channel) {
-    return volCommand[channel] != 0;
+    return commands.push(c);
 }
 
 
-unsigned ModStream::pop_volume_command(unsigned channel) {
-    unsigned cmd = volCommand[channel];
-    volCommand[channel] = 0;
-    
-    return cmd;
+void ModStream::get_clock(unsigned long long* rows, unsigned long long* ticks, unsigned long long* frames) {
+    if (rows) {
+        *rows = rows_started.load(memory_order_relaxed);
+    }
+    if (ticks) {
+        *ticks = ticks_started.load(memory_order_relaxed);
+    }
+    if (frames) {
+        *frames = frames_rendered.load(memory_order_relaxed);
+    }
 }
 
 
-unsigned ModStream::pop_volume_parameter(unsigned channel) {
-    unsigned cmd = volParameter[channel];
-    volParameter[channel] = 0;
-    
-    return cmd;
-}
-
 void ModStream::resetInternal()
 {
-	// Init vol and effect command enable/ignore arrays.
-	volume_command_enabled.setAll(true);
-	effect_command_enabled.setAll(true);
-
-	// Zero out our arrays.
-	memset(volCommand, 0, sizeof(volCommand));
-	memset(volParameter, 0, sizeof(volParameter));
-	memset(effectCommand, 0, sizeof(effectCommand));
-	memset(effectParameter, 0, sizeof(effectParameter));
-	memset(transposition_offset, 0, sizeof(transposition_offset));
-
-    // All channels enabled by default.
-    for (int i = 0; i < MAX_CHANNELS; i++) {
-        enabled_channels[i] = true;
-    }
-
-    volume = 1.0;
+    volume.store(1.0f, memory_order_relaxed);
 }
@@ -10,82 +10,74 @@
 #define MODSTREAM_H
 
 #include <string>
-#include <list>
-#include <queue>
 #include <map>
+#include <deque>
 #include <vector>
+#include <atomic>
+#include <mutex>
+#include <thread>
 #include "modipulate_common.h"
-#include <portaudio.h>
 #include "modipulate.h"
-#include "Array2D.h"
-#include "timer/Timer.h"
+#include "event_ring.h"
+#include "sample_scheduler.h"
+#include "command_queue.h"
+#include "mod_mixer.h"
 
 #include "libopenmpt-forked/libopenmpt/libopenmpt.hpp"
 
 #include "libopenmpt-forked/soundlib/Snd_defs.h"
+#include "libopenmpt-forked/soundlib/SoundHooks.h"
 
-#define MAX_PENDING_SAMPLES 20
+// Max number of events queued between the audio thread and
+// modipulate_global_update(). Must be a power of two.
+#define MAX_PENDING_EVENTS 4096
 
+enum ModStreamEventType {
+    MODSTREAM_EVENT_PATTERN,
+    MODSTREAM_EVENT_ROW,
+    MODSTREAM_EVENT_NOTE
+};
 
-class ModStreamNote {
-public:
-    ModStreamNote();
-    unsigned channel;
+// Plain data record handed from the audio thread to the game thread.
+struct ModStreamEvent {
+    unsigned long long sample_pos;   // Song sample position the event occurred at.
+    unsigned long long frame;        // Output device frame the event will be heard at.
+    int type;                        // ModStreamEventType
+    int value;                       // Pattern or row number.
+    unsigned channel;                // Note events only.
     int note;
     int instrument;
     int sample;
     int volume;
-};
-
-class ModStreamRow {
-public:
-    ModStreamRow();
-    void add_note(ModStreamNote* n);
-    
-    int row;                         // Row #
-    
-    unsigned samples_since_last;     // # samples since last row change.
-    
-    int change_tempo;                // Positive on tempo change: represents new tempo.
-    int change_pattern;              // Positive on pattern change: represents new pattern number.
-    
-    std::list<ModStreamNote*> notes;  // List of notes for this row.
-};
-
-class ModStreamPendingSample {
-public:
-	ModStreamPendingSample();
-
-    void set(int sample, int note, unsigned channel, int modulus, unsigned offset,
-		int volume_command, int volume_value, int effect_command, int effect_value);
-
-	int sample;
-	int note;
-    unsigned channel;
-	int modulus;
-	unsigned offset;
-	int volume_command;
-	int volume_value;
-	int effect_command;
-	int effect_value;
-
-	bool used; // Set to true when you want this cleaned up!
+    int volume_command;              // Commands on the note's row, 0 if none.
+    int volume_value;
+    int effect_command;
+    int effect_value;
 };
 
 
 
 // Similar design pattern as the ogg_stream class from: 
 //    http://www.devmaster.net/articles/openal-tutorials/lesson8.php
+//
+// Audio output is handled by ModMixer, which calls render() for every
+// playing song from a single shared output stream.
+//
+// The forked soundlib reports back through the ISoundHooks interface.
 
-class ModStream {
+class ModStream : public ISoundHooks {
 
 public:
-    ModStream();
+    ModStream(ModMixer* mixer);
     ~ModStream();
     
-    // Opens a file.
+    // Opens a file. The file is memory-mapped while it's parsed.
     void open(std::string path);
     
+    // Opens a file that is already in memory. data is parsed in place and
+    // can go away once this returns.
+    void open_memory(const void* data, std::size_t size);
+    
     // Closes the file.
     void close();
     
@@ -102,6 +94,74 @@ public:
     // Checks if we're supposed to be playing or not.
     bool is_playing();
     
+    // Renders up to MODMIXER_BLOCK_FRAMES frames in the mixer's channel
+    // layout (stereo or quad) into the song's own block buffer. Called by
+    // ModMixer from the audio thread or one of its render workers; songs
+    // render in parallel, but never two blocks of the same song at once.
+    // device_frame is the output device frame the first frame lands on.
+    void render(unsigned long frameCount, unsigned long long device_frame);
+    
+    // Hands a block from the audio thread to whichever thread claims it
+    // first with run_render(); the others find nothing to do. Returns false,
+    // and queues nothing, while a block that missed its deadline hasn't
+    // been mixed yet.
+    bool queue_render(unsigned long frameCount, unsigned long long device_frame);
+    void run_render();
+    
+    // True once the queued block has rendered and is ready for mix().
+    bool is_rendered();
+    
+    // Called from the audio thread at the end of every block of output.
+    // Adds up to frames frames of the rendered block, already scaled by
+    // the song and global volume, to output; the rest of it goes into the
+    // next one. A block still rendering is counted as late the first time,
+    // and mixed once it's done. Its events are stamped for the block it
+    // was meant for, so they fire a little early.
+    void mix(float* output, unsigned long frames);
+    
+    // How long the last block took to render as a fraction of its playback
+    // time, the highest such load so far, and how many blocks took longer
+    // to render than to play.
+    void get_render_load(float* load, float* peak_load, unsigned* misses);
+    
+    // Fills in everything but the song handle.
+    void get_stats(ModipulateSongStats* stats);
+    
+    // Renders frameCount stereo frames into buffer (float or int16) at any
+    // sampling rate, bypassing the mixer and the audio device. Renders a
+    // mixer block at a time, and fires the callbacks for each block's events
+    // before rendering the next. Returns the number of frames rendered, which
+    // is less than frameCount at the end of the song, or if a callback
+    // unloads the song or starts it playing.
+    unsigned long render_offline(int rate, bool int16, void* buffer, unsigned long frameCount);
+    
+    // Jumps to a time or to a row. Both return the new position in seconds.
+    // After a song is opened, a background thread walks it once and keeps
+    // snapshots of the player every few rows, so once that's done a seek
+    // only has to simulate the rows since the nearest snapshot.
+    double seek_seconds(double seconds);
+    double seek_order_row(int order, int row);
+    
+    // Position in seconds as of the last rendered block.
+    double get_position_seconds();
+    
+    // Appends the notes starting in [start, end) seconds, found by the same
+    // background walk. Returns false until it's done.
+    bool get_timeline(double start, double end, std::vector<openmpt::module::timeline_event>& events);
+    
+    // Offset within the render_offline() buffer of the event whose callback
+    // is currently running. Returns false outside of render_offline().
+    bool get_event_offset(unsigned long* offset);
+    
+    // Starts or stops keeping the events perform_callbacks() handles for
+    // poll_events(). Stopping drops the ones still waiting.
+    void set_event_polling(bool enabled);
+    bool get_event_polling();
+    
+    // Moves up to capacity of the kept events into buffer, oldest first,
+    // and returns how many it moved.
+    unsigned poll_events(ModipulateEvent* buffer, unsigned capacity);
+    
     // Enable or disable channels.
     void set_channel_enabled(int channel, bool enabled);
     bool get_channel_enabled(int channel);
@@ -138,9 +198,12 @@ public:
     // Gets the total rows in a given pattern.
     int get_rows_in_pattern(int pattern);
     
-    // Override the tempo.
-    void set_tempo_override(int tempo);
-    int get_tempo_override();
+    // Tempo and pitch multipliers, 1.0 being the song's own. The new factor
+    // glides in over msec of playback once the song renders again.
+    void set_tempo_factor(double factor, unsigned msec);
+    double get_tempo_factor();
+    void set_pitch_factor(double factor, unsigned msec);
+    double get_pitch_factor();
     
     // Enable or ignore a volume command on a given channel.
     void enable_volume_command(int channel, int volume_command, bool enable);
@@ -150,70 +213,100 @@ public:
     void enable_effect_command(int channel, int effect_command, bool enable);
     bool is_effect_command_enabled(int channel, int effect_command);
     
-    void issue_effect_command(unsigned channel, unsigned effect_command, unsigned effect_param);
-    bool is_effect_command_pending(unsigned channel);
-    unsigned pop_effect_command(unsigned channel);
-    unsigned pop_effect_parameter(unsigned channel);
+    // Queue a volume or effect command, see modipulate_song_queue_command().
+    // Returns false if the queue is full.
+    bool queue_command(unsigned channel, bool effect, int command, int value,
+        int when, unsigned long long at);
     
-    void issue_volume_command(unsigned channel, unsigned volume_command, unsigned volume_param);
-    bool is_volume_command_pending(unsigned channel);
-    unsigned pop_volume_command(unsigned channel);
-    unsigned pop_volume_parameter(unsigned channel);
+    // Rows, ticks and frames rendered since playback started.
+    void get_clock(unsigned long long* rows, unsigned long long* ticks, unsigned long long* frames);
     
     // Transposition offset.
     void set_transposition(int channel, int offset);
     int get_transposition(int channel);
 
-	// Play a sample.
-	void play_sample(int sample, int note, unsigned channel, int modulus, unsigned offset,
-		int volume_command, int volume_value, int effect_command, int effect_value);
+	// Schedule a sample, see modipulate_song_schedule_sample().
+	ModipulateSampleHandle play_sample(int sample, int note, unsigned channel, int modulus, unsigned offset,
+		unsigned tick, int volume_command, int volume_value, int effect_command, int effect_value);
+	
+	// Keeps a scheduled sample from playing. Returns false if it already has.
+	bool cancel_sample(ModipulateSampleHandle handle);
 
     // Fade a channel in or out.
     // Set channel to -1 for all channels
     void fade_channel(unsigned msec, int channel, double destination_amp);
 
-	// Check pending samples (used interally.)
-	// Returns null if none are pending.
-	ModStreamPendingSample* get_pending_for(unsigned channel, unsigned row);
-    
     void set_pattern_change_cb(modipulate_song_pattern_change_cb cb, void* user_data);
     
     void set_row_change_cb(modipulate_song_row_change_cb cb, void* user_data);
     
     void set_note_change_cb(modipulate_song_note_cb cb, void* user_data);
     
-    void perform_callbacks();
+    // Handle the song was registered under, passed to callbacks.
+    void set_handle(ModipulateSong handle);
+    ModipulateSong get_handle();
+    
+    // Fires callbacks for every event at or before the given output
+    // device frame (see ModMixer::get_playback_frame()).
+    void perform_callbacks(unsigned long long playback_frame);
+    
+    // Stops perform_callbacks() from firing any more callbacks, once the
+    // song has been unloaded from inside one.
+    void cancel_callbacks();
     
-    void on_note_change(unsigned channel, int note,int instrumentNumber, int sampleNumber, int volume);
-    void on_pattern_changed(unsigned pattern);
-    void on_row_changed(int row);
-    void increase_sample_count(int add);
     void on_tempo_changed(int tempo);
-
     
-    // Global volume, from 0.0 to 1.0
-    static float modipulate_global_volume;
+    // ISoundHooks, called by the soundlib while rendering.
+    void OnRowChanged(ROWINDEX row);
+    void OnPatternChanged(PATTERNINDEX pattern);
+    void OnNoteChange(CHANNELINDEX chn, int note, int instrument, int sample, int volume,
+        int volcmd, int vol, int cmd, int param);
+    void OnSamplesRendered(uint32 count);
+    void OnTickStarted();
+    void OnRowCommand(CHANNELINDEX chn, ROWINDEX row, UINT &note, UINT &instr,
+        UINT &volcmd, UINT &vol, UINT &cmd, UINT &param, UINT &delay);
+    bool OnTickCommand(CHANNELINDEX chn, UINT &volcmd, UINT &vol, UINT &cmd, UINT &param);
 
-private:
-    void check_error(int line, PaError err);
-    
-    int audio_callback(const void *input, void *output, unsigned long frameCount,
-        const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags);
     
-    void stream_finished_callback();
+    // Global volume, from 0.0 to 1.0. Read by the audio thread and render
+    // workers while the game thread sets it.
+    static std::atomic<float> modipulate_global_volume;
 
+private:
 	// Resets all state variables.
 	void resetInternal();
     
-    Timer timer;
+    // Hooks up a freshly loaded module.
+    void on_opened();
+    
+    // Builds the seek snapshots. Runs on seek_scanner.
+    void scan_seek_points(int rate);
+    
+    // Hands changed tempo and pitch factors to the module. Called with
+    // render_lock held, before rendering at the given rate.
+    void apply_playback_factors(int rate);
+    
+    // Queues an event for perform_callbacks(). Audio thread only.
+    void push_event(int type, int value, unsigned channel = 0, int note = -1,
+        int instrument = -1, int sample = -1, int volume = -1, int volume_command = 0,
+        int volume_value = 0, int effect_command = 0, int effect_value = 0);
     
 	openmpt::module* mod;
+    ModMixer* mixer;
+    ModipulateSong handle;
     unsigned long file_length;  // length of file
-    const static int sampling_rate = 44100; // don't change this directly, need to call modplug for that
-    bool stream_started;
-    unsigned long long samples_played; // Samples played thus far.
+    std::atomic<bool> playing; // Read by the audio thread.
+    unsigned long long samples_rendered; // Samples rendered thus far (audio thread.)
+    unsigned long long frame_offset;     // Device frame minus song sample for the current render.
     int last_tempo_read; // Last tempo we encountered.
-    int tempo_override; // tempo override (-1 means disabled)
+    
+    // Set by the game thread, picked up by apply_playback_factors().
+    std::atomic<double> tempo_factor;
+    std::atomic<unsigned> tempo_ramp_msec;
+    std::atomic<bool> tempo_changed;
+    std::atomic<double> pitch_factor;
+    std::atomic<unsigned> pitch_ramp_msec;
+    std::atomic<bool> pitch_changed;
     
     int default_tempo;
     
@@ -226,43 +319,85 @@ private:
     modipulate_song_note_cb note_cb;
     void* note_user_data;
     
-    unsigned volCommand[MAX_CHANNELS];
-    unsigned volParameter[MAX_CHANNELS];
+    // Volume and effect commands waiting for their row.
+    CommandQueue commands;
     
-    unsigned effectCommand[MAX_CHANNELS];
-    unsigned effectParameter[MAX_CHANNELS];
-
-	bool enabled_channels[MAX_CHANNELS];
-	int transposition_offset[MAX_CHANNELS];
+    // Playback clock, written by the audio thread.
+    std::atomic<unsigned long long> rows_started;
+    std::atomic<unsigned long long> ticks_started;
+    std::atomic<unsigned long long> frames_rendered;
+    unsigned long long tick_start_frame;  // Song sample the current tick started on.
+    unsigned long tick_frames;            // Length of the last full tick.
+    
+    // Row we've entered but not yet queued; sent along with the pattern change.
+    int pending_row;
+    
+    // Events waiting for their callbacks, filled by the audio thread.
+    EventRing<ModStreamEvent, MAX_PENDING_EVENTS> events;
     
-    // Volume commands to allow [channel][command] where command is 1..MAX_VOLCMDS - 1
-    Array2D<bool> volume_command_enabled;
+    // Events the audio thread had to drop because the ring was full, or
+    // that nobody polled before MAX_PENDING_EVENTS more came along.
+    std::atomic<unsigned> dropped_events;
     
-    // Effect commands to allow [channel][command] where command is 1..MAX_EFFECTS - 1
-    Array2D<bool> effect_command_enabled;
+    // Events handled by perform_callbacks() that poll_events() hasn't
+    // handed out yet. Game thread only.
+    std::deque<ModStreamEvent> polled_events;
+    bool polling;
     
-    PaStream *stream;
+    // Held while the song is rendering, so an offline render can't overlap
+    // with the mixer. The audio thread only ever try-locks it.
+    std::mutex render_lock;
     
-    // Current row for building data structures. 
-    ModStreamRow* current_row;
+    // Builds the seek snapshots of a freshly opened song.
+    std::thread seek_scanner;
     
-    // Cached data for upcoming callbacks.
-    std::queue<ModStreamRow*> rows;
+    // Song position, updated after every render and seek.
+    std::atomic<double> position_seconds;
+    
+    // Set while render_offline() is dispatching callbacks.
+    bool rendering_offline;
+    bool callbacks_cancelled;
+    unsigned long long current_event_frame;
 
 	// Samples to play at some future date.
-	ModStreamPendingSample pending_samples[MAX_PENDING_SAMPLES];
+	SampleScheduler samples;
 
 	// Last pattern # we saw.
 	int lastPattern;
 
-    // Per-song volume.
-    float volume;
-    
-    friend int mod_stream_callback(const void *input, void *output, unsigned long frameCount, 
-        const PaStreamCallbackTimeInfo* timeInfo, PaStreamCallbackFlags statusFlags, void *userData);
-    
-    friend void mod_stream_callback_finished(void* userData);
-
+    // Per-song volume, set by the game thread while the song renders.
+    std::atomic<float> volume;
+    
+    // Output of the last render(), the number of frames in it, and how
+    // many of them have been mixed.
+    float block[MODMIXER_BLOCK_FRAMES * MODMIXER_MAX_CHANNELS];
+    unsigned long block_frames;
+    unsigned long block_mixed;
+    
+    // Where the queued block stands. Only the audio thread moves a block
+    // to QUEUED, or from DONE back to IDLE; the job fields belong to
+    // whoever moved it last.
+    enum RenderState { RENDER_IDLE, RENDER_QUEUED, RENDER_BUSY, RENDER_DONE };
+    std::atomic<int> render_state;
+    unsigned long job_frames;
+    unsigned long long job_device_frame;
+    
+    // Set once the block in flight has missed its deadline. Audio thread only.
+    bool block_late;
+    std::atomic<unsigned> late_blocks;
+    
+    // Deadline accounting, written by whichever thread rendered the song.
+    std::atomic<float> render_load;
+    std::atomic<float> render_peak_load;
+    std::atomic<unsigned> deadline_misses;
+    
+    // Voices and where the render time went, as of the last block.
+    std::atomic<unsigned> voices;
+    std::atomic<unsigned> peak_voices;
+    std::atomic<double> row_seconds;
+    std::atomic<double> mix_seconds;
+    std::atomic<double> last_row_seconds;
+    std::atomic<double> last_mix_seconds;
 };
 
 #endif // MODSTREAM_H
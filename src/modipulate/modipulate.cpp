@@ -7,32 +7,91 @@
  */
 
 #include "mod_stream.h"
+#include "mod_mixer.h"
+#include "song_registry.h"
+#include "song_loader.h"
 #include "modipulate_common.h"
 #include "modipulate.h"
 
 #include <string>
+#include <vector>
 #include <string.h>
 #include "portaudio.h"
 
 // Last error string.
 char* last_error = NULL;
 
-// Table of all modules.
-#define MAX_MODSTREAMS 16
-ModStream* mods[MAX_MODSTREAMS];
+// All loaded songs, by handle.
+static SongRegistry songs;
+
+// Shared audio output for all songs.
+ModMixer* mixer = NULL;
+
+// Background thread for modipulate_song_load_async().
+static SongLoader* loader = NULL;
 
 // Check if we've initialized.
 static bool modipulateIsInitialized = false;
 
-ModipulateErr modipulate_global_init(void) {
+// Depth of calls into the song callbacks. A song unloaded from inside one
+// may be the very song firing it, so it's only freed once the outermost
+// call has returned.
+static int callback_depth = 0;
+static std::vector<ModStream*> unloaded_streams;
+
+// Range of modipulate_song_set_tempo_factor() and _set_pitch_factor().
+#define MIN_PLAYBACK_FACTOR 0.25
+#define MAX_PLAYBACK_FACTOR 4.0
+
+// Looks up the song behind a handle. Sets the error string and returns
+// NULL if the song has been unloaded or the handle was never valid.
+static ModStream* get_stream(ModipulateSong song) {
+    ModStream* stream = songs.get(song);
+    if (stream == NULL) {
+        modipulate_set_error_string_cpp("Invalid song handle");
+    }
+    return stream;
+}
+
+ModipulateErr modipulate_global_get_default_options(ModipulateEngineOptions* options) {
+    if (options == NULL) {
+        modipulate_set_error_string_cpp("Options must not be null");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    options->sample_rate = 44100;
+    options->frames_per_buffer = 0;
+    options->suggested_latency = 0.0;
+    options->channels = 2;
+    options->device = -1;
+    options->render_threads = 0;
+
+    return MODIPULATE_ERROR_NONE;
+}
+
+ModipulateErr modipulate_global_init(const ModipulateEngineOptions* options) {
     if (modipulateIsInitialized) {
         return MODIPULATE_ERROR_GENERAL;
     }
 
+    ModipulateEngineOptions opts;
+    if (options != NULL) {
+        opts = *options;
+    } else {
+        modipulate_global_get_default_options(&opts);
+    }
+
+    if (opts.sample_rate < 8000 || opts.sample_rate > 192000 ||
+        (opts.channels != 2 && opts.channels != 4) ||
+        opts.suggested_latency < 0.0 || opts.device < -1 || opts.render_threads < 0) {
+        modipulate_set_error_string_cpp("Invalid engine options");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
     DPRINT("Loading Modipulate!");
 
-	for (int i = 0; i < MAX_MODSTREAMS; i++)
-		mods[i] = NULL;
+    mixer = new ModMixer(opts);
+    loader = new SongLoader(mixer);
 
     modipulateIsInitialized = true;
 
@@ -50,20 +109,44 @@ ModipulateErr modipulate_global_deinit(void) {
     DPRINT("Quiting Modipulate");
     ModipulateErr ret = MODIPULATE_ERROR_NONE;
 
+    // Stop the audio thread before the songs go away.
+    mixer->stop();
+
+    // Wait for the loader thread and tell everybody still waiting on it
+    // that their song isn't coming.
+    std::vector<SongLoad*> loads;
+    loader->take_all(loads);
+    delete loader;
+    loader = NULL;
+    for (size_t i = 0; i < loads.size(); i++) {
+        delete loads[i]->stream;
+        loads[i]->cb(MODIPULATE_ERROR_CANCELLED, NULL, loads[i]->user_data);
+        delete loads[i];
+    }
+
     // Close mod players.
-	for (int i = 0; i < MAX_MODSTREAMS; i++) {
+    const std::vector<ModStream*>& streams = songs.get_streams();
+	for (size_t i = 0; i < streams.size(); i++) {
+		if (callback_depth > 0) {
+			streams[i]->cancel_callbacks();
+			unloaded_streams.push_back(streams[i]);
+			continue;
+		}
+
 		try {
-			if (mods[i] != NULL)
-				mods[i]->close();
+			streams[i]->close();
 		} catch (std::string e) {
 			modipulate_set_error_string_cpp(e);
 			ret = MODIPULATE_ERROR_GENERAL;
 		}
 
 		// Free memory!
-		delete mods[i];
-		mods[i] = NULL;
+		delete streams[i];
 	}
+    songs.clear();
+
+    delete mixer;
+    mixer = NULL;
 
     // Stop PortAudio.
     Pa_Terminate();
@@ -75,64 +158,187 @@ char* modipulate_global_get_last_error_string(void) {
     return last_error;
 }
 
+static void deliver_loads();
+
+// Marks a stretch of code that runs song callbacks, which may unload songs.
+// When the outermost one ends, even if a callback threw, it frees the songs
+// unloaded in the meantime.
+struct CallbackScope {
+    CallbackScope() {
+        callback_depth++;
+    }
+
+    ~CallbackScope() {
+        if (--callback_depth > 0) {
+            return;
+        }
+
+        for (size_t i = 0; i < unloaded_streams.size(); i++) {
+            try {
+                unloaded_streams[i]->close();
+            } catch (std::string e) {
+                // Gone anyway.
+            }
+            delete unloaded_streams[i];
+        }
+        unloaded_streams.clear();
+    }
+};
+
 ModipulateErr modipulate_global_update(void) {
     if (!modipulateIsInitialized) {
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
-    // Call all callbacks.
-	for (int i = 0; i < MAX_MODSTREAMS; i++) {
-		if (mods[i]) {
-			mods[i]->perform_callbacks();
+    // Hand out songs the loader thread has finished with.
+    deliver_loads();
+    if (!modipulateIsInitialized) {
+        // A load callback shut us down.
+        return MODIPULATE_ERROR_NONE;
+    }
+
+    // Call all callbacks for events that have reached the speakers. They
+    // may load and unload songs, so go by handle and look each one up again.
+    unsigned long long playback_frame = mixer->get_playback_frame();
+    const std::vector<ModStream*>& streams = songs.get_streams();
+    std::vector<ModipulateSong> handles;
+    handles.reserve(streams.size());
+	for (size_t i = 0; i < streams.size(); i++) {
+		handles.push_back(streams[i]->get_handle());
+	}
+
+    CallbackScope scope;
+	for (size_t i = 0; i < handles.size() && modipulateIsInitialized; i++) {
+		ModStream* stream = songs.get(handles[i]);
+		if (stream != NULL) {
+			stream->perform_callbacks(playback_frame);
 		}
 	}
 
     return MODIPULATE_ERROR_NONE;
 }
 
+// Registers a freshly opened song and hands out its handle.
+static ModipulateErr add_song(ModStream* stream, ModipulateSong* song) {
+	ModipulateSong handle = songs.add(stream);
+	if (handle == NULL) {
+		// Oh no!
+		modipulate_set_error_string_cpp("Max concurrent songs reached!");
+		delete stream;
+
+        return MODIPULATE_ERROR_GENERAL;
+	}
+
+    stream->set_handle(handle);
+    mixer->add_stream(stream);
+	*song = handle;
+
+    return MODIPULATE_ERROR_NONE;
+}
+
 ModipulateErr modipulate_song_load(const char* filename, ModipulateSong* song) {
     if (!modipulateIsInitialized) {
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
     DPRINT("Opening file: %s", filename);
-    ModipulateErr ret = MODIPULATE_ERROR_NONE;
 
-	ModStream* stream = NULL;
+	ModStream* stream = new ModStream(mixer);
 
-	// Find an empty slot.
-    int slot = -1;
-	for (int i = 0; i < MAX_MODSTREAMS; i++) {
-		if (mods[i] == NULL) {
-			// We got one!
-			stream = new ModStream();
-            slot = i;
-			mods[slot] = stream;
+    try {
+        stream->open(filename);
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
 
-			break;
-		}
-	}
+        // Cleanup.
+        delete stream;
+        return MODIPULATE_ERROR_GENERAL;
+    }
 
-	if (!stream) {
-		// Oh no!
-		modipulate_set_error_string_cpp("Max concurrent songs reached!");
+    return add_song(stream, song);
+}
 
-        return MODIPULATE_ERROR_GENERAL;
-	}
+ModipulateErr modipulate_song_load_memory(const void* data, size_t size, ModipulateSong* song) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+    if (data == NULL || size == 0 || song == NULL) {
+        modipulate_set_error_string_cpp("Invalid song data");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    DPRINT("Opening %lu bytes from memory", (unsigned long) size);
+
+	ModStream* stream = new ModStream(mixer);
 
     try {
-        stream->open(filename);
-		*song = stream;
+        stream->open_memory(data, size);
     } catch (std::string e) {
         modipulate_set_error_string_cpp(e);
-        ret = MODIPULATE_ERROR_GENERAL;
 
         // Cleanup.
         delete stream;
-        mods[slot] = NULL;
+        return MODIPULATE_ERROR_GENERAL;
     }
 
-    return ret;
+    return add_song(stream, song);
+}
+
+ModipulateErr modipulate_song_load_async(const char* filename, modipulate_song_load_cb cb,
+    void* user_data, ModipulateLoadToken* token) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+    if (filename == NULL || cb == NULL) {
+        modipulate_set_error_string_cpp("Filename and callback must not be null");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    DPRINT("Queueing file: %s", filename);
+
+    ModipulateLoadToken t = loader->load(filename, cb, user_data);
+    if (token != NULL) {
+        *token = t;
+    }
+
+    return MODIPULATE_ERROR_NONE;
+}
+
+ModipulateErr modipulate_song_load_cancel(ModipulateLoadToken token) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    if (!loader->cancel(token)) {
+        modipulate_set_error_string_cpp("Invalid load token");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    return MODIPULATE_ERROR_NONE;
+}
+
+// Registers the songs of finished loads and calls their callbacks.
+// Loads are taken one at a time, since a callback may cancel the next
+// one or shut Modipulate down.
+static void deliver_loads() {
+    SongLoad* load;
+    while (modipulateIsInitialized && (load = loader->take_finished()) != NULL) {
+        ModipulateErr err;
+        ModipulateSong song = NULL;
+
+        if (load->cancelled) {
+            delete load->stream;
+            err = MODIPULATE_ERROR_CANCELLED;
+        } else if (load->stream == NULL) {
+            modipulate_set_error_string_cpp(load->error);
+            err = MODIPULATE_ERROR_GENERAL;
+        } else {
+            err = add_song(load->stream, &song);
+        }
+
+        load->cb(err, song, load->user_data);
+        delete load;
+    }
 }
 
 
@@ -141,18 +347,27 @@ ModipulateErr modipulate_song_unload(ModipulateSong song) {
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
-    modipulate_song_play(song, false);
+    ModStream* stream = songs.remove(song);
+    if (stream == NULL) {
+        modipulate_set_error_string_cpp("Invalid song handle");
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
 
     // Destroy object.
-	for (int i = 0; i < MAX_MODSTREAMS; i++) {
-		if (mods[i] == song) {
-			mods[i]->close();
-			delete mods[i];
-			mods[i] = NULL;
+    try {
+        stream->set_playing(false);
+    } catch (std::string e) {
+        // Unloading anyway.
+    }
+    mixer->remove_stream(stream);
+    if (callback_depth > 0) {
+        stream->cancel_callbacks();
+        unloaded_streams.push_back(stream);
+        return MODIPULATE_ERROR_NONE;
+    }
 
-			break;
-		}
-	}
+    stream->close();
+    delete stream;
 
     return MODIPULATE_ERROR_NONE;
 }
@@ -162,10 +377,15 @@ ModipulateErr modipulate_song_play(ModipulateSong song, int play) {
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
     ModipulateErr ret = MODIPULATE_ERROR_NONE;
 
     try {
-        ((ModStream*) song)->set_playing((bool) play);
+        stream->set_playing((bool) play);
     } catch (std::string e) {
         modipulate_set_error_string_cpp(e);
         ret = MODIPULATE_ERROR_GENERAL;
@@ -179,10 +399,15 @@ ModipulateErr modipulate_song_get_info(ModipulateSong song, ModipulateSongInfo**
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
     ModipulateErr ret = MODIPULATE_ERROR_NONE;
 
     try {
-        ((ModStream*) song)->get_info(song_info);
+        stream->get_info(song_info);
     } catch (std::string e) {
         modipulate_set_error_string_cpp(e);
         ret = MODIPULATE_ERROR_GENERAL;
@@ -206,7 +431,12 @@ float modipulate_song_get_volume(ModipulateSong song) {
         return -1;
     }
 
-    return ((ModStream*) song)->get_volume();
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return -1;
+    }
+
+    return stream->get_volume();
 }
 
 void modipulate_song_set_volume(ModipulateSong song, float volume) {
@@ -214,7 +444,12 @@ void modipulate_song_set_volume(ModipulateSong song, float volume) {
         return;
     }
 
-    ((ModStream*) song)->set_volume(volume);
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return;
+    }
+
+    stream->set_volume(volume);
 }
 
 void modipulate_song_set_channel_enabled(ModipulateSong song, unsigned channel, int enabled) {
@@ -222,9 +457,18 @@ void modipulate_song_set_channel_enabled(ModipulateSong song, unsigned channel,
         return;
     }
 
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return;
+    }
+
     DPRINT("Channel %d is set to %s", channel, enabled ? "Enabled" : "Disabled");
 
-    ((ModStream*) song)->set_channel_enabled(channel, enabled);
+    try {
+        stream->set_channel_enabled(channel, enabled);
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
+    }
 }
 
 
@@ -233,7 +477,12 @@ int modipulate_song_get_channel_enabled(ModipulateSong song, unsigned channel) {
         return -1;
     }
 
-    return ((ModStream*) song)->get_channel_enabled(channel);
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return -1;
+    }
+
+    return stream->get_channel_enabled(channel);
 }
 
 
@@ -245,11 +494,16 @@ ModipulateErr modipulate_song_play_sample(ModipulateSong song, int sample, int n
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
     ModipulateErr ret = MODIPULATE_ERROR_NONE;
 
     try {
-        ((ModStream*) song)->play_sample(sample, note, channel,
-			modulus, offset, volume_command, volume_value,
+        stream->play_sample(sample, note, channel,
+			modulus, offset, 0, volume_command, volume_value,
 			effect_command, effect_value);
     } catch (std::string e) {
         modipulate_set_error_string_cpp(e);
@@ -260,15 +514,71 @@ ModipulateErr modipulate_song_play_sample(ModipulateSong song, int sample, int n
 }
 
 
+ModipulateErr modipulate_song_schedule_sample(ModipulateSong song, int sample, int note,
+	unsigned channel, int modulus, unsigned offset, unsigned tick, int volume_command,
+	int volume_value, int effect_command, int effect_value, ModipulateSampleHandle* handle) {
+
+	if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    ModipulateErr ret = MODIPULATE_ERROR_NONE;
+
+    try {
+        ModipulateSampleHandle h = stream->play_sample(sample, note, channel,
+			modulus, offset, tick, volume_command, volume_value,
+			effect_command, effect_value);
+        if (handle) {
+            *handle = h;
+        }
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
+        ret = MODIPULATE_ERROR_GENERAL;
+    }
+
+    return ret;
+}
+
+
+ModipulateErr modipulate_song_cancel_sample(ModipulateSong song, ModipulateSampleHandle handle) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    if (!stream->cancel_sample(handle)) {
+        modipulate_set_error_string_cpp("Sample already played or cancelled");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    return MODIPULATE_ERROR_NONE;
+}
+
+
 ModipulateErr modipulate_song_fade_channel(ModipulateSong song, unsigned msec, int channel, double destination_amp) {
     if (!modipulateIsInitialized) {
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
     if (destination_amp < 0.0 || destination_amp > 1.0) {
         modipulate_set_error_string_cpp("Mix volume must be between 0.0 and 1.0");
         return MODIPULATE_ERROR_INVALID_PARAMETERS;
     }
-    if (channel < -1 || channel >= ((ModStream*) song)->get_num_channels()) {
+    if (channel < -1 || channel >= stream->get_num_channels()) {
         modipulate_set_error_string_cpp("Invalid channel number");
         return MODIPULATE_ERROR_INVALID_PARAMETERS;
     }
@@ -276,7 +586,7 @@ ModipulateErr modipulate_song_fade_channel(ModipulateSong song, unsigned msec, i
     ModipulateErr ret = MODIPULATE_ERROR_NONE;
 
     try {
-        ((ModStream*) song)->fade_channel(msec, channel, destination_amp);
+        stream->fade_channel(msec, channel, destination_amp);
     } catch (std::string e) {
         modipulate_set_error_string_cpp(e);
         ret = MODIPULATE_ERROR_GENERAL;
@@ -291,7 +601,7 @@ float modipulate_global_get_volume(void) {
         return -1.0;
     }
 
-	return ModStream::modipulate_global_volume;
+	return ModStream::modipulate_global_volume.load(std::memory_order_relaxed);
 }
 
 
@@ -300,27 +610,71 @@ void modipulate_global_set_volume(float vol) {
         return;
     }
 
-    ModStream::modipulate_global_volume = vol;
+    ModStream::modipulate_global_volume.store(vol, std::memory_order_relaxed);
 }
 
 
-ModipulateErr modipulate_song_set_transposition(ModipulateSong song, unsigned channel, int offset) {
+ModipulateErr modipulate_global_get_stats(ModipulateEngineStats* engine,
+    ModipulateSongStats* song_stats, unsigned max_songs, unsigned* num_songs) {
     if (!modipulateIsInitialized) {
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
+    if (song_stats == NULL && max_songs > 0) {
+        modipulate_set_error_string_cpp("Song stats must not be null");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
 
-    ((ModStream*) song)->set_transposition(channel, offset);
+    if (engine) {
+        mixer->get_stats(engine);
+    }
+
+    const std::vector<ModStream*>& streams = songs.get_streams();
+    for (size_t i = 0; i < streams.size() && i < max_songs; i++) {
+        song_stats[i].song = streams[i]->get_handle();
+        streams[i]->get_stats(&song_stats[i]);
+    }
+    if (num_songs) {
+        *num_songs = (unsigned) streams.size();
+    }
 
     return MODIPULATE_ERROR_NONE;
 }
 
 
+ModipulateErr modipulate_song_set_transposition(ModipulateSong song, unsigned channel, int offset) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    ModipulateErr ret = MODIPULATE_ERROR_NONE;
+
+    try {
+        stream->set_transposition(channel, offset);
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
+        ret = MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    return ret;
+}
+
+
 ModipulateErr modipulate_song_get_transposition(ModipulateSong song, unsigned channel, int *offset) {
     if (!modipulateIsInitialized) {
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
-    *offset = ((ModStream*) song)->get_transposition(channel);
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    *offset = stream->get_transposition(channel);
 
     return MODIPULATE_ERROR_NONE;
 }
@@ -328,44 +682,410 @@ ModipulateErr modipulate_song_get_transposition(ModipulateSong song, unsigned ch
 
 ModipulateErr modipulate_song_volume_command(ModipulateSong song, unsigned channel,
     int volume_command, int volume_value) {
+    return modipulate_song_queue_command(song, channel, 0, volume_command, volume_value,
+        MODIPULATE_WHEN_NEXT_ROW, 0);
+}
+
+
+ModipulateErr modipulate_song_enable_volume(ModipulateSong song, unsigned channel,
+    int volume_command, int enable) {
     if (!modipulateIsInitialized) {
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
-    ((ModStream*) song)->issue_volume_command(channel, volume_command, volume_value);
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    ModipulateErr ret = MODIPULATE_ERROR_NONE;
+
+    try {
+        stream->enable_volume_command(channel, volume_command, (bool) enable);
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
+        ret = MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    return ret;
+}
+
+
+ModipulateErr modipulate_song_effect_command(ModipulateSong song, unsigned channel,
+    int effect_command, int effect_value) {
+    return modipulate_song_queue_command(song, channel, 1, effect_command, effect_value,
+        MODIPULATE_WHEN_NEXT_ROW, 0);
+}
+
+
+ModipulateErr modipulate_song_enable_effect(ModipulateSong song, unsigned channel,
+    int effect_command, int enable) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    ModipulateErr ret = MODIPULATE_ERROR_NONE;
+
+    try {
+        stream->enable_effect_command(channel, effect_command, (bool) enable);
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
+        ret = MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    return ret;
+}
+
+
+ModipulateErr modipulate_song_queue_command(ModipulateSong song, unsigned channel, int effect,
+    int command, int value, int when, unsigned long long at) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    try {
+        if (!stream->queue_command(channel, effect != 0, command, value, when, at)) {
+            modipulate_set_error_string_cpp("Too many commands queued");
+            return MODIPULATE_ERROR_GENERAL;
+        }
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
     return MODIPULATE_ERROR_NONE;
 }
 
 
-ModipulateErr modipulate_song_enable_volume(ModipulateSong song, unsigned channel,
-    int volume_command, int enable) {
+ModipulateErr modipulate_song_get_clock(ModipulateSong song, unsigned long long* rows,
+    unsigned long long* ticks, unsigned long long* frames) {
     if (!modipulateIsInitialized) {
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
-    ((ModStream*) song)->enable_volume_command(channel, volume_command, (bool) enable);
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    stream->get_clock(rows, ticks, frames);
     return MODIPULATE_ERROR_NONE;
 }
 
 
-ModipulateErr modipulate_song_effect_command(ModipulateSong song, unsigned channel,
-    int effect_command, int effect_value) {
+ModipulateErr modipulate_song_render(ModipulateSong song, int sample_rate, int format,
+    void* buffer, unsigned long frames, unsigned long* frames_rendered) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    if (buffer == NULL || sample_rate <= 0 ||
+        (format != MODIPULATE_FORMAT_FLOAT && format != MODIPULATE_FORMAT_INT16)) {
+        modipulate_set_error_string_cpp("Invalid render parameters");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    ModipulateErr ret = MODIPULATE_ERROR_NONE;
+    unsigned long count = 0;
+
+    try {
+        CallbackScope scope;
+        count = stream->render_offline(sample_rate,
+            format == MODIPULATE_FORMAT_INT16, buffer, frames);
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
+        ret = MODIPULATE_ERROR_GENERAL;
+    }
+
+    if (frames_rendered != NULL)
+        *frames_rendered = count;
+
+    return ret;
+}
+
+
+ModipulateErr modipulate_song_seek_seconds(ModipulateSong song, double seconds) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    ModipulateErr ret = MODIPULATE_ERROR_NONE;
+
+    try {
+        stream->seek_seconds(seconds);
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
+        ret = MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    return ret;
+}
+
+
+ModipulateErr modipulate_song_seek_order_row(ModipulateSong song, int order, int row) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    ModipulateErr ret = MODIPULATE_ERROR_NONE;
+
+    try {
+        stream->seek_order_row(order, row);
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
+        ret = MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    return ret;
+}
+
+
+double modipulate_song_get_position_seconds(ModipulateSong song) {
+    if (!modipulateIsInitialized) {
+        return -1;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return -1;
+    }
+
+    return stream->get_position_seconds();
+}
+
+
+ModipulateErr modipulate_song_set_tempo_factor(ModipulateSong song, double factor, unsigned msec) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    if (!(factor >= MIN_PLAYBACK_FACTOR && factor <= MAX_PLAYBACK_FACTOR)) {
+        modipulate_set_error_string_cpp("Invalid tempo factor");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    ModipulateErr ret = MODIPULATE_ERROR_NONE;
+
+    try {
+        stream->set_tempo_factor(factor, msec);
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
+        ret = MODIPULATE_ERROR_GENERAL;
+    }
+
+    return ret;
+}
+
+
+double modipulate_song_get_tempo_factor(ModipulateSong song) {
+    if (!modipulateIsInitialized) {
+        return -1;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return -1;
+    }
+
+    return stream->get_tempo_factor();
+}
+
+
+ModipulateErr modipulate_song_set_pitch_factor(ModipulateSong song, double factor, unsigned msec) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    if (!(factor >= MIN_PLAYBACK_FACTOR && factor <= MAX_PLAYBACK_FACTOR)) {
+        modipulate_set_error_string_cpp("Invalid pitch factor");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    ModipulateErr ret = MODIPULATE_ERROR_NONE;
+
+    try {
+        stream->set_pitch_factor(factor, msec);
+    } catch (std::string e) {
+        modipulate_set_error_string_cpp(e);
+        ret = MODIPULATE_ERROR_GENERAL;
+    }
+
+    return ret;
+}
+
+
+double modipulate_song_get_pitch_factor(ModipulateSong song) {
+    if (!modipulateIsInitialized) {
+        return -1;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return -1;
+    }
+
+    return stream->get_pitch_factor();
+}
+
+
+ModipulateErr modipulate_song_get_timeline(ModipulateSong song, double start, double end,
+    ModipulateTimelineEvent* events, unsigned capacity, unsigned* count) {
     if (!modipulateIsInitialized) {
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
-    ((ModStream*) song)->issue_effect_command(channel, effect_command, effect_value);
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    if (count == NULL || (events == NULL && capacity > 0)) {
+        modipulate_set_error_string_cpp("Invalid timeline parameters");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    std::vector<openmpt::module::timeline_event> notes;
+    if (!stream->get_timeline(start, end, notes)) {
+        modipulate_set_error_string_cpp("The song's timeline isn't ready yet");
+        return MODIPULATE_ERROR_NOT_READY;
+    }
+
+    *count = (unsigned) notes.size();
+    for (size_t i = 0; i < notes.size() && i < capacity; i++) {
+        const openmpt::module::timeline_event& note = notes[i];
+        ModipulateTimelineEvent& event = events[i];
+        event.time = note.seconds;
+        event.frame = (unsigned long long) note.frame;
+        event.order = note.order;
+        event.row = note.row;
+        event.channel = (unsigned) note.channel;
+        event.note = note.note;
+        event.instrument = note.instrument ? note.instrument : -1;
+        event.volume_command = note.volume_command ? note.volume_command : -1;
+        event.volume_value = note.volume_command ? note.volume : 0;
+        event.effect_command = note.effect_command ? note.effect_command : -1;
+        event.effect_value = note.effect_command ? note.effect_param : 0;
+    }
+
     return MODIPULATE_ERROR_NONE;
 }
 
 
-ModipulateErr modipulate_song_enable_effect(ModipulateSong song, unsigned channel,
-    int effect_command, int enable) {
+ModipulateErr modipulate_song_enable_event_polling(ModipulateSong song, int enable) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    stream->set_event_polling(enable != 0);
+
+    return MODIPULATE_ERROR_NONE;
+}
+
+
+ModipulateErr modipulate_song_poll_events(ModipulateSong song, ModipulateEvent* events,
+    unsigned capacity, unsigned* count) {
+    static_assert(sizeof(ModipulateEvent) == 48, "ModipulateEvent must stay 48 bytes");
+    static_assert(MODIPULATE_EVENT_PATTERN == MODSTREAM_EVENT_PATTERN
+        && MODIPULATE_EVENT_ROW == MODSTREAM_EVENT_ROW
+        && MODIPULATE_EVENT_NOTE == MODSTREAM_EVENT_NOTE, "Event types must match");
+
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    if (count == NULL || (events == NULL && capacity > 0)) {
+        modipulate_set_error_string_cpp("Invalid poll parameters");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    if (!stream->get_event_polling()) {
+        modipulate_set_error_string_cpp("Event polling isn't enabled for this song");
+        return MODIPULATE_ERROR_GENERAL;
+    }
+
+    *count = stream->poll_events(events, capacity);
+
+    return MODIPULATE_ERROR_NONE;
+}
+
+
+ModipulateErr modipulate_song_get_event_offset(ModipulateSong song, unsigned long* offset) {
     if (!modipulateIsInitialized) {
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
-    ((ModStream*) song)->enable_effect_command(channel, effect_command, (bool) enable);
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    if (offset == NULL || !stream->get_event_offset(offset)) {
+        modipulate_set_error_string_cpp("Event offsets are only available during modipulate_song_render()");
+        return MODIPULATE_ERROR_INVALID_PARAMETERS;
+    }
+
+    return MODIPULATE_ERROR_NONE;
+}
+
+
+ModipulateErr modipulate_song_get_render_load(ModipulateSong song, float* load,
+    float* peak_load, unsigned* deadline_misses) {
+    if (!modipulateIsInitialized) {
+        return MODIPULATE_ERROR_NOT_INITIALIZED;
+    }
+
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    stream->get_render_load(load, peak_load, deadline_misses);
+
     return MODIPULATE_ERROR_NONE;
 }
 
@@ -376,7 +1096,12 @@ ModipulateErr modipulate_song_on_pattern_change(ModipulateSong song,
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
-    ((ModStream*) song)->set_pattern_change_cb(cb, user_data);
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    stream->set_pattern_change_cb(cb, user_data);
 
     return MODIPULATE_ERROR_NONE;
 }
@@ -388,7 +1113,12 @@ ModipulateErr modipulate_song_on_row_change(ModipulateSong song,
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
-    ((ModStream*) song)->set_row_change_cb(cb, user_data);
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    stream->set_row_change_cb(cb, user_data);
 
     return MODIPULATE_ERROR_NONE;
 }
@@ -400,7 +1130,12 @@ ModipulateErr modipulate_song_on_note(ModipulateSong song,
         return MODIPULATE_ERROR_NOT_INITIALIZED;
     }
 
-    ((ModStream*) song)->set_note_change_cb(cb, user_data);
+    ModStream* stream = get_stream(song);
+    if (stream == NULL) {
+        return MODIPULATE_ERROR_INVALID_SONG;
+    }
+
+    stream->set_note_change_cb(cb, user_data);
 
     return MODIPULATE_ERROR_NONE;
 }
@@ -18,6 +18,8 @@
 #ifndef MODIPULATE_H
 #define MODIPULATE_H
 
+#include <stddef.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif 
@@ -27,6 +29,23 @@ extern "C" {
 #define MODIPULATE_ERROR_INVALID_PARAMETERS     2
 #define MODIPULATE_ERROR_NOT_IMPLEMENTED        3
 #define MODIPULATE_ERROR_NOT_INITIALIZED        4
+#define MODIPULATE_ERROR_INVALID_SONG           5
+#define MODIPULATE_ERROR_CANCELLED              6
+#define MODIPULATE_ERROR_NOT_READY              7
+
+/** \ingroup song
+Sample formats for modipulate_song_render().
+*/
+#define MODIPULATE_FORMAT_FLOAT                 0   //!< 32-bit float, -1.0 to 1.0
+#define MODIPULATE_FORMAT_INT16                 1   //!< Signed 16-bit integer
+
+/** \ingroup song
+When a command queued with modipulate_song_queue_command() is applied.
+*/
+#define MODIPULATE_WHEN_NEXT_ROW                0   //!< On the next row
+#define MODIPULATE_WHEN_ROWS                    1   //!< That many rows after the next one
+#define MODIPULATE_WHEN_TICK                    2   //!< On that tick, see modipulate_song_get_clock()
+#define MODIPULATE_WHEN_FRAME                   3   //!< On the tick holding that frame, see modipulate_song_get_clock()
 
 /** \ingroup global 
 Error checking macro. Returns 0 for error, 1 for no error.
@@ -40,9 +59,26 @@ typedef unsigned ModipulateErr;
 
 /** \ingroup song
 ID (or "handle") of a song loaded by Modipulate.
+
+This is an opaque value, not a pointer.  Once a song has been unloaded its handle
+stays invalid, even if another song is loaded later, and functions given it return
+MODIPULATE_ERROR_INVALID_SONG.  There is no limit on the number of loaded songs.
 */
 typedef void* ModipulateSong;
 
+/** \ingroup song
+Token for a load started with modipulate_song_load_async(), used to cancel it.
+Never 0.
+*/
+typedef unsigned long ModipulateLoadToken;
+
+
+/** \ingroup song
+Handle for a sample scheduled with modipulate_song_schedule_sample(), used to cancel it.
+Never 0.
+*/
+typedef unsigned long ModipulateSampleHandle;
+
 
 /** \ingroup song
 Pattern change callback.
@@ -85,6 +121,19 @@ Row change callback
 */
 typedef void (*modipulate_song_row_change_cb) (ModipulateSong song, int row, void* user_data);
 
+/** \ingroup song
+Song load callback.
+
+Called from modipulate_global_update() once a load started with
+modipulate_song_load_async() is over.
+
+@param err            MODIPULATE_ERROR_NONE if the song is ready, MODIPULATE_ERROR_CANCELLED
+                      if the load was cancelled, or another error if it failed.
+@param song           The loaded song, or null if err is not MODIPULATE_ERROR_NONE.
+@param user_data      Arbitrary callback data.
+*/
+typedef void (*modipulate_song_load_cb) (ModipulateErr err, ModipulateSong song, void* user_data);
+
 /** \ingroup song
 Song information struct.  Contains metadata for a song.
 */
@@ -102,19 +151,142 @@ typedef struct {
 } ModipulateSongInfo;
 
 
+/** \ingroup song
+A note in a song's timeline, see modipulate_song_get_timeline().
+
+The command fields hold what the pattern says, before any commands issued
+with modipulate_song_effect_command() and friends.
+*/
+typedef struct {
+    double time;              //!< Seconds from the start of the song, as in modipulate_song_get_position_seconds()
+    unsigned long long frame; //!< The same time in frames at the engine's sampling rate
+    int order;                //!< Position in the order list
+    int row;                  //!< Row in the pattern
+    unsigned channel;         //!< Channel the note is on
+    int note;                 //!< Note number, where each step is a semitone
+    int instrument;           //!< Instrument number, or -1 if none
+    int volume_command;       //!< Identifier for the volume command type, or -1 if none
+    int volume_value;         //!< Value of the command.  Zero if volume_command is -1
+    int effect_command;       //!< Identifier for the effect command type, or -1 if none
+    int effect_value;         //!< Value of the command.  Zero if effect_command is -1
+} ModipulateTimelineEvent;
+
+
+/** \ingroup song
+Event types for ModipulateEvent::type.
+*/
+#define MODIPULATE_EVENT_PATTERN                0   //!< A pattern started
+#define MODIPULATE_EVENT_ROW                    1   //!< A row started
+#define MODIPULATE_EVENT_NOTE                   2   //!< A note was triggered
+
+/** \ingroup song
+An event handed out by modipulate_song_poll_events(), for hosts that can't take
+callbacks.
+
+Records are 48 bytes with no padding and the fields at fixed offsets, so a host
+can read them straight out of a byte buffer: the frame at offset 0 as an
+unsigned 64-bit integer, then the rest as signed 32-bit integers starting at
+offset 8, in the order below.
+*/
+typedef struct {
+    unsigned long long frame; //!< Frame the event happened at, counted as in modipulate_song_get_clock()
+    int type;                 //!< MODIPULATE_EVENT_PATTERN, MODIPULATE_EVENT_ROW or MODIPULATE_EVENT_NOTE
+    int channel;              //!< Channel the note is on, or -1 for pattern and row events
+    int value;                //!< Pattern number, row number, or note number where each step is a semitone
+    int instrument;           //!< Instrument number, or -1 if none
+    int sample;               //!< Sample number, or -1 if none
+    int volume;               //!< The note's volume, or -1 for pattern and row events
+    int volume_command;       //!< Identifier for the volume command type, or -1 if none
+    int volume_value;         //!< Value of the command.  Zero if volume_command is -1
+    int effect_command;       //!< Identifier for the effect command type, or -1 if none
+    int effect_value;         //!< Value of the command.  Zero if effect_command is -1
+} ModipulateEvent;
+
+
+/** \ingroup global
+Audio engine options for modipulate_global_init().
+
+Fill this in with modipulate_global_get_default_options() and then change the
+fields you care about.
+*/
+typedef struct {
+    int sample_rate;                  //!< Output sampling rate in Hz.  Default 44100
+    unsigned long frames_per_buffer;  //!< Frames per device buffer, or 0 to let the host API choose. Default 0
+    double suggested_latency;         //!< Output latency in seconds, or 0 for the device's low latency default. Default 0
+    int channels;                     //!< Output channels, 2 (stereo) or 4 (quad).  Default 2
+    int device;                       //!< PortAudio output device index, or -1 for the default device.  Default -1
+    int render_threads;               //!< Threads that render songs in parallel, including the audio thread, or 0 for one per core.  Default 0
+} ModipulateEngineOptions;
+
+
+/** \ingroup global
+Number of buckets in ModipulateEngineStats::load_histogram.
+*/
+#define MODIPULATE_STATS_LOAD_BUCKETS           11
+
+/** \ingroup global
+Audio callback statistics, see modipulate_global_get_stats().
+
+Load is the time a callback took as a fraction of the time its buffer takes to play.
+*/
+typedef struct {
+    unsigned long long callbacks;     //!< Audio callbacks so far
+    double render_min;                //!< Shortest callback in seconds
+    double render_avg;                //!< Average callback in seconds
+    double render_max;                //!< Longest callback in seconds
+    float load;                       //!< Load of the last callback
+    float peak_load;                  //!< Highest load so far
+    unsigned long long load_histogram[MODIPULATE_STATS_LOAD_BUCKETS]; //!< Callbacks by load: bucket i counts loads from i/10 up to (i+1)/10, and the last one everything from 1.0 up
+    unsigned deadline_misses;         //!< Callbacks with a load above 1.0
+    unsigned output_underflows;       //!< Callbacks PortAudio flagged with paOutputUnderflow
+    unsigned late_underflows;         //!< Of those, how many followed a missed deadline.  The others were the host's doing
+    unsigned output_overflows;        //!< Callbacks flagged with paOutputOverflow
+    unsigned priming_output;          //!< Callbacks flagged with paPrimingOutput
+} ModipulateEngineStats;
+
+/** \ingroup global
+Rendering statistics for one song, see modipulate_global_get_stats().
+*/
+typedef struct {
+    ModipulateSong song;              //!< The song
+    float load;                       //!< Load of the last block, as in modipulate_song_get_render_load()
+    float peak_load;                  //!< Highest load since the song was loaded
+    unsigned deadline_misses;         //!< Blocks that took longer to render than to play
+    unsigned late_blocks;             //!< Blocks still rendering when the audio callback had to return.  They're mixed into a later block, so the song falls behind by a block each time
+    unsigned voices;                  //!< Voices mixed in the last block, including those of new note actions
+    unsigned peak_voices;             //!< Most voices mixed in one block
+    unsigned pending_events;          //!< Events waiting for modipulate_global_update()
+    unsigned dropped_events;          //!< Events dropped because too many were waiting
+    double row_seconds;               //!< Time spent processing rows and effects since the song was loaded
+    double mix_seconds;               //!< Time spent mixing voices since the song was loaded
+    double last_row_seconds;          //!< Time the last block spent processing rows and effects
+    double last_mix_seconds;          //!< Time the last block spent mixing voices
+} ModipulateSongStats;
+
+
 /** \addtogroup global Global functions in Modipulate.
 @{
 */
 
 
+/**
+Fills in the default engine options.
+
+@param options [out] Options to initialize.
+@return Error
+*/
+ModipulateErr modipulate_global_get_default_options(ModipulateEngineOptions* options);
+
+
 /**
 Initialize Modipulate.
 
 Call this function when you're ready to start audio processing so Modipulate can get set up.
 
+@param options Audio engine options, or null for the defaults.
 @return Error
 */
-ModipulateErr modipulate_global_init(void);
+ModipulateErr modipulate_global_init(const ModipulateEngineOptions* options);
 
 
 /**
@@ -161,6 +333,24 @@ Sets the current global volume.
 */
 void modipulate_global_set_volume(float vol);
 
+/**
+Gets engine and per-song rendering statistics.
+
+The audio thread keeps the counters without locks, so this can be called at any time
+from the game thread.  Each counter is read on its own, so they may be a block apart.
+Together they tell a dropout caused by mixing (mix_seconds), by effect processing
+(row_seconds) or by the host (underflows that didn't follow a missed deadline).
+
+@param engine    [out] Audio callback statistics.  May be null.
+@param songs     [out] Statistics of up to max_songs loaded songs.  May be null if
+                 max_songs is 0.
+@param max_songs Room in songs.
+@param num_songs [out] Number of loaded songs, which may be more than max_songs.  May be null.
+@return Error
+*/
+ModipulateErr modipulate_global_get_stats(ModipulateEngineStats* engine,
+    ModipulateSongStats* songs, unsigned max_songs, unsigned* num_songs);
+
 /**@}*/
 
 
@@ -173,19 +363,68 @@ Loads a song into Modipulate.
 
 Loads a song into memory. To play the song or pause it once it's started, call modipulate_song_play()
 
+The file is memory-mapped while it is parsed rather than read through a buffer.
+
 @param filename Name of a MOD-style file to open (MOD, IT, XM, S3M, and many more). String must be null terminated.
 @param song     [out] Song handle. Must not be null.
 @return Error
 */
 ModipulateErr modipulate_song_load(const char* filename, ModipulateSong* song);
 
+/**
+Loads a song from a file that is already in memory.
+
+The data is parsed in place, without being copied first, and only needs to stay valid
+until this function returns.  Useful for songs inside an asset pack that is already
+loaded or mapped.
+
+@param data Contents of a MOD-style file (MOD, IT, XM, S3M, and many more).
+@param size Size of data in bytes.
+@param song [out] Song handle. Must not be null.
+@return Error
+*/
+ModipulateErr modipulate_song_load_memory(const void* data, size_t size, ModipulateSong* song);
+
+/**
+Loads a song on a background thread.
+
+Returns right away.  The file is opened and parsed, and its samples decoded, on a
+loader thread, one song at a time in the order they were requested.  Once that's over
+the callback is called from modipulate_global_update() with the new song, just as if
+modipulate_song_load() had returned it.
+
+The callback is called exactly once for every load that was started, so it's safe to
+free user_data in it.  Loads still pending at modipulate_global_deinit() get their
+callback from there, with MODIPULATE_ERROR_CANCELLED.
+
+@param filename  Name of a MOD-style file to open. String must be null terminated.
+@param cb        Called when the load is over. Must not be null.
+@param user_data Arbitrary callback data.
+@param token     [out] Token for modipulate_song_load_cancel(), or null.
+@return Error
+*/
+ModipulateErr modipulate_song_load_async(const char* filename, modipulate_song_load_cb cb,
+    void* user_data, ModipulateLoadToken* token);
+
+/**
+Cancels a load started with modipulate_song_load_async().
+
+Its callback is still called from the next modipulate_global_update(), with
+MODIPULATE_ERROR_CANCELLED.  A load that is already running is allowed to finish in the
+background and the song is thrown away.
+
+@param token Token of the load.
+@return Error, MODIPULATE_ERROR_INVALID_PARAMETERS if the load's callback has already been called.
+*/
+ModipulateErr modipulate_song_load_cancel(ModipulateLoadToken token);
+
 /**
 Unloads a song from Modipulate.
 
 Frees a song from memory. Song will be stopped if playing.
 
 @param song Song to stop.  The song ID is no longer valid after this call.
-@param Error
+@return Error, MODIPULATE_ERROR_INVALID_SONG if the song was already unloaded.
 */
 ModipulateErr modipulate_song_unload(ModipulateSong song);
 
@@ -237,7 +476,9 @@ Sets a song's volume.
 void modipulate_song_set_volume(ModipulateSong song, float volume);
 
 /**
-Issues a volume command.
+Issues a volume command on the next row.
+
+Same as modipulate_song_queue_command() with MODIPULATE_WHEN_NEXT_ROW.
 
 @param song           Song to act on.
 @param channel        Channel number to issue the command on.
@@ -261,7 +502,9 @@ ModipulateErr modipulate_song_enable_volume(ModipulateSong song, unsigned channe
     int volume_command, int enable);
 
 /**
-Issues an effect command.
+Issues an effect command on the next row.
+
+Same as modipulate_song_queue_command() with MODIPULATE_WHEN_NEXT_ROW.
 
 @param song     Song to act on.
 @param channel  Channel number to issue the command on.
@@ -287,6 +530,46 @@ Note that commands issued by the user
 ModipulateErr modipulate_song_enable_effect(ModipulateSong song, unsigned channel,
     int effect_command, int enable);
 
+/**
+Queues a volume or effect command to replace the channel's own at a given point.
+
+Commands are applied in the order they were queued and none replaces another.  A
+channel takes one volume command and one effect command at a time, like a pattern cell;
+one whose column is taken is applied on the next tick instead, or the next row for
+MODIPULATE_WHEN_NEXT_ROW and MODIPULATE_WHEN_ROWS.  Commands after a row's first tick
+replace the channel's own from their tick on, as if the row started there, without
+moving the row's note.  A frame target goes on the tick it falls in, taking the tick
+to be as long as the one before.
+
+@param song    Song to act on.
+@param channel Channel number to issue the command on.
+@param effect  1 for an effect command, 0 for a volume command.
+@param command Command ID to issue
+@param value   Command value
+@param when    MODIPULATE_WHEN_NEXT_ROW, MODIPULATE_WHEN_ROWS, MODIPULATE_WHEN_TICK or
+               MODIPULATE_WHEN_FRAME
+@param at      Number of rows for MODIPULATE_WHEN_ROWS, or the tick or frame, ignored for
+               MODIPULATE_WHEN_NEXT_ROW.  Ticks and frames that have passed mean the next tick.
+@return Error, MODIPULATE_ERROR_GENERAL if too many commands are waiting.
+*/
+ModipulateErr modipulate_song_queue_command(ModipulateSong song, unsigned channel, int effect,
+    int command, int value, int when, unsigned long long at);
+
+/**
+Gets how far a song has been rendered, counted from when it started playing.
+
+The counts carry on across loops and seeks.  Audio that has been rendered is still to be
+heard for as long as the output latency.
+
+@param song   Song to query.
+@param rows   [out] Rows started.  May be null.
+@param ticks  [out] Ticks started.  May be null.
+@param frames [out] Frames rendered.  May be null.
+@return Error
+*/
+ModipulateErr modipulate_song_get_clock(ModipulateSong song, unsigned long long* rows,
+    unsigned long long* ticks, unsigned long long* frames);
+
 /**
 Sets a transposition offset for a given channel.
 
@@ -317,6 +600,8 @@ int modipulate_song_get_channel_enabled(ModipulateSong song, unsigned channel);
 /**
 Triggers a sample, either now, at an offset from now, or quantized to a row.
 
+Same as modipulate_song_schedule_sample() on the row's first tick, without a handle.
+
 @param song The song to act on.
 @param sample The sample to play.
 @param note The note to play.
@@ -333,6 +618,45 @@ ModipulateErr modipulate_song_play_sample(ModipulateSong song, int sample, int n
 	unsigned channel, int modulus, unsigned offset, int volume_command, int volume_value,
 	int effect_command, int effect_value);
 
+/**
+Schedules a sample on a row and tick, and returns a handle to cancel it with.
+
+The row is picked when the song starts its next row: that row if modulus and
+offset are 0, else the next row with rowNum % modulus == 0 (or the start of
+the next pattern, whichever comes first), plus offset rows.  Pattern breaks
+and jumps after that don't move it.  If several samples land on the same row
+and channel, the one scheduled last plays.  There is no limit on the number
+of scheduled samples.
+
+@param song The song to act on.
+@param sample The sample to play.
+@param note The note to play.
+@param channel The channel to issue the note on.
+@param modulus If > 0, quantize to rows where rowNum % modulus == 0.
+@param offset Number of rows to wait after that.
+@param tick Tick within the row to play the note on, 0 being the start of the row.  Delays
+            past the row's last tick play on the last tick.
+@param volume_command Identifier for the volume command type, or -1 if none
+@param volume_value   Value of the command.  Will be set to zero if volume_command is -1
+@param effect_command Identifier for the effect command type, or -1 if none
+@param effect_value   Value of the command.  Will be set to zero if effect_command is -1
+@param handle [out] Handle for modipulate_song_cancel_sample().  May be null.
+@return Error
+*/
+ModipulateErr modipulate_song_schedule_sample(ModipulateSong song, int sample, int note,
+	unsigned channel, int modulus, unsigned offset, unsigned tick, int volume_command,
+	int volume_value, int effect_command, int effect_value, ModipulateSampleHandle* handle);
+
+/**
+Keeps a sample scheduled with modipulate_song_schedule_sample() from playing.
+
+@param song   The song the sample was scheduled on.
+@param handle The sample's handle.
+@return Error, MODIPULATE_ERROR_INVALID_PARAMETERS if the sample has already played or
+        was cancelled.
+*/
+ModipulateErr modipulate_song_cancel_sample(ModipulateSong song, ModipulateSampleHandle handle);
+
 /**
 Fades a channel (or channels).
 
@@ -343,6 +667,138 @@ Fades a channel (or channels).
 */
 ModipulateErr modipulate_song_fade_channel(ModipulateSong song, unsigned msec, int channel, double destination_amp);
 
+/**
+Jumps to a point in time.
+
+Right after a song is loaded, seeking has to simulate the song from the
+beginning.  A background thread walks each newly loaded song once, and from
+then on seeks are fast.
+
+@param song    Song to seek in.
+@param seconds Time from the start of the song.
+@return Error
+*/
+ModipulateErr modipulate_song_seek_seconds(ModipulateSong song, double seconds);
+
+/**
+Jumps to a row.
+
+@param song  Song to seek in.
+@param order Position in the order list.
+@param row   Row in the pattern at that order.
+@return Error
+*/
+ModipulateErr modipulate_song_seek_order_row(ModipulateSong song, int order, int row);
+
+/**
+Gets how far into a song playback is, as of the last block rendered.
+
+@param song Song to query.
+@return     Position in seconds, or -1 on error.
+*/
+double modipulate_song_get_position_seconds(ModipulateSong song);
+
+/**
+Speeds a song up or slows it down without changing its pitch.
+
+The new tempo glides in over msec milliseconds of playback, starting with the
+next block rendered, and the song picks it up tick by tick.  Positions, seeks
+and the timeline stay in the song's own time, so a song at double tempo
+reaches 10 seconds after 5 seconds of playback.
+
+@param song   Song to act on.
+@param factor Tempo multiplier, from 0.25 to 4.0.  1.0 is the song's own tempo.
+@param msec   Length of the transition, or 0 to switch at once.
+@return Error
+*/
+ModipulateErr modipulate_song_set_tempo_factor(ModipulateSong song, double factor, unsigned msec);
+
+/**
+Gets the tempo multiplier last set with modipulate_song_set_tempo_factor().
+
+@param song Song to query.
+@return     The multiplier, even if the song is still gliding towards it, or -1 on error.
+*/
+double modipulate_song_get_tempo_factor(ModipulateSong song);
+
+/**
+Shifts the pitch of every note in a song without changing its tempo.
+
+Like the tempo factor, the new pitch glides in over msec milliseconds, but it
+follows the glide smoothly rather than tick by tick.
+
+@param song   Song to act on.
+@param factor Frequency multiplier, from 0.25 to 4.0.  2.0 is an octave up.
+@param msec   Length of the transition, or 0 to switch at once.
+@return Error
+*/
+ModipulateErr modipulate_song_set_pitch_factor(ModipulateSong song, double factor, unsigned msec);
+
+/**
+Gets the pitch multiplier last set with modipulate_song_set_pitch_factor().
+
+@param song Song to query.
+@return     The multiplier, or -1 on error.
+*/
+double modipulate_song_get_pitch_factor(ModipulateSong song);
+
+/**
+Looks up which notes will play in a stretch of a song.
+
+Each song is walked once on a background thread after it's loaded, the same
+walk that speeds up seeking.  Every song gets a timeline, whatever its tempo
+mode.  The timeline covers one pass through the song as it plays after loading,
+with pattern loops played out; a song that loops back to its start doesn't
+have its notes repeated.  Notes are reported at the time they start,
+including note delays.
+
+@param song     Song to query.
+@param start    Start of the stretch in seconds.
+@param end      End of the stretch in seconds, not included.
+@param events   [out] Notes starting in [start, end), in the order they play.  May be
+                null if capacity is 0.
+@param capacity Number of events that fit into events.
+@param count    [out] Number of notes in the stretch.  Only the first capacity of them
+                are written if there are more.
+@return Error, MODIPULATE_ERROR_NOT_READY if the song hasn't been walked yet.
+*/
+ModipulateErr modipulate_song_get_timeline(ModipulateSong song, double start, double end,
+    ModipulateTimelineEvent* events, unsigned capacity, unsigned* count);
+
+/**
+Starts or stops keeping a song's events for modipulate_song_poll_events().
+
+Songs don't keep events until this is called.  Call it right after loading the
+song, before it plays, to get every event from the start.  Stopping throws away
+the events that haven't been polled.
+
+@param song   Song to act on.
+@param enable 1 to keep events, 0 to stop.
+@return Error
+*/
+ModipulateErr modipulate_song_enable_event_polling(ModipulateSong song, int enable);
+
+/**
+Takes the pattern, row and note events that have played, for hosts that can't
+take callbacks.
+
+Events are handed over by modipulate_global_update(), at the same time the
+callbacks for them run, and kept until they're polled.  Songs only keep events
+once modipulate_song_enable_event_polling() has been called for them; polling
+any other song is an error.  If events aren't polled, the oldest are dropped
+once 4096 are waiting, and counted in ModipulateSongStats::dropped_events.
+
+@param song     Song to poll.
+@param events   [out] The oldest waiting events, in the order they played.  May be
+                null if capacity is 0.
+@param capacity Number of events that fit into events.
+@param count    [out] Number of events written.  Events that didn't fit stay for the
+                next call.
+@return Error.
+*/
+ModipulateErr modipulate_song_poll_events(ModipulateSong song, ModipulateEvent* events,
+    unsigned capacity, unsigned* count);
+
 /**
 Sets a callback to be triggered on a pattern change.
 
@@ -372,6 +828,59 @@ Sets a callback to be triggered on a note event.
 ModipulateErr modipulate_song_on_note(ModipulateSong song,
     modipulate_song_note_cb cb, void* user_data);
 
+/**
+Renders a song straight into a buffer, without an audio device.
+
+Renders as fast as the CPU allows, so it can be used to bake audio to disk or on
+machines without a sound card.  The song must not be playing.  Song and global
+volume are not applied.
+
+Pattern, row and note callbacks for events inside the buffer fire as the render
+goes, all of them before this function returns, however long the buffer.  Call
+modipulate_song_get_event_offset() from a callback to find where in the buffer the
+event occurred.  Rendering stops early if a callback unloads the song or starts it
+playing.  Call this from the same thread as modipulate_global_update().
+
+@param song            Song to render.
+@param sample_rate     Sampling rate in Hz, for example 44100 or 48000.
+@param format          MODIPULATE_FORMAT_FLOAT or MODIPULATE_FORMAT_INT16
+@param buffer          Interleaved stereo output with room for frames * 2 samples.
+@param frames          Number of frames to render.
+@param frames_rendered [out] Number of frames written.  Less than frames once the
+                       song has ended.  May be null.
+@return Error
+*/
+ModipulateErr modipulate_song_render(ModipulateSong song, int sample_rate, int format,
+    void* buffer, unsigned long frames, unsigned long* frames_rendered);
+
+/**
+Gets the position of the event currently being reported.
+
+Only valid inside a pattern, row or note callback fired by modipulate_song_render().
+
+@param song   Song that triggered the callback.
+@param offset [out] Frame offset of the event from the start of the render buffer.
+@return Error
+*/
+ModipulateErr modipulate_song_get_event_offset(ModipulateSong song, unsigned long* offset);
+
+/**
+Gets how much of the audio deadline rendering this song takes up.
+
+Songs render in parallel, one per thread (see ModipulateEngineOptions::render_threads),
+so a song only causes dropouts on its own once its load goes above 1.0.
+
+@param song            Song to query.
+@param load            [out] Time the last block took to render, as a fraction of the
+                       time it takes to play.  May be null.
+@param peak_load       [out] Highest load since the song was loaded.  May be null.
+@param deadline_misses [out] Number of blocks that took longer to render than to play.
+                       May be null.
+@return Error
+*/
+ModipulateErr modipulate_song_get_render_load(ModipulateSong song, float* load,
+    float* peak_load, unsigned* deadline_misses);
+
 /**@}*/
 
 
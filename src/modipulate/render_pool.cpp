@@ -0,0 +1,248 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include "render_pool.h"
+
+#include <algorithm>
+
+#if defined(_WIN32)
+#include <windows.h>
+#elif defined(__APPLE__)
+#include <dispatch/dispatch.h>
+#else
+#include <semaphore.h>
+#endif
+
+using namespace std;
+
+#if defined(_WIN32)
+
+RenderSemaphore::RenderSemaphore() :
+    handle(CreateSemaphore(NULL, 0, 0x7fffffff, NULL))
+{
+}
+
+
+RenderSemaphore::~RenderSemaphore()
+{
+    CloseHandle((HANDLE) handle);
+}
+
+
+void RenderSemaphore::post(unsigned count) {
+    ReleaseSemaphore((HANDLE) handle, (LONG) count, NULL);
+}
+
+
+void RenderSemaphore::wait() {
+    WaitForSingleObject((HANDLE) handle, INFINITE);
+}
+
+#elif defined(__APPLE__)
+
+RenderSemaphore::RenderSemaphore() :
+    handle((void*) dispatch_semaphore_create(0))
+{
+}
+
+
+RenderSemaphore::~RenderSemaphore()
+{
+    dispatch_release((dispatch_semaphore_t) handle);
+}
+
+
+void RenderSemaphore::post(unsigned count) {
+    for (unsigned i = 0; i < count; i++) {
+        dispatch_semaphore_signal((dispatch_semaphore_t) handle);
+    }
+}
+
+
+void RenderSemaphore::wait() {
+    dispatch_semaphore_wait((dispatch_semaphore_t) handle, DISPATCH_TIME_FOREVER);
+}
+
+#else
+
+RenderSemaphore::RenderSemaphore() :
+    handle(new sem_t)
+{
+    sem_init((sem_t*) handle, 0, 0);
+}
+
+
+RenderSemaphore::~RenderSemaphore()
+{
+    sem_destroy((sem_t*) handle);
+    delete (sem_t*) handle;
+}
+
+
+void RenderSemaphore::post(unsigned count) {
+    for (unsigned i = 0; i < count; i++) {
+        sem_post((sem_t*) handle);
+    }
+}
+
+
+void RenderSemaphore::wait() {
+    // Retry when a signal handler interrupts the wait.
+    while (sem_wait((sem_t*) handle) != 0) {
+    }
+}
+
+#endif
+
+
+RenderPool::RenderPool(int threads, RenderPoolTask task) :
+    task(task),
+    quit(false),
+    head(0),
+    tail(0)
+{
+    for (unsigned long i = 0; i < RENDERPOOL_QUEUE_SIZE; i++) {
+        cells[i].sequence.store(i, memory_order_relaxed);
+        cells[i].item = NULL;
+    }
+
+    if (threads <= 0) {
+        threads = (int) thread::hardware_concurrency();
+    }
+    threads = max(1, min(threads, RENDERPOOL_MAX_THREADS));
+
+    // The thread pushing items is one of them.
+    for (int i = 1; i < threads; i++) {
+        working[i - 1].store(0, memory_order_relaxed);
+        workers.push_back(thread(&RenderPool::worker_main, this, i - 1));
+    }
+}
+
+
+RenderPool::~RenderPool()
+{
+    quit.store(true, memory_order_release);
+    wakeup.post((unsigned) workers.size());
+
+    for (vector<thread>::iterator it = workers.begin(); it != workers.end(); it++) {
+        it->join();
+    }
+}
+
+
+int RenderPool::get_thread_count() {
+    return (int) workers.size() + 1;
+}
+
+
+bool RenderPool::push(void* item) {
+    if (workers.empty()) {
+        return false;
+    }
+
+    unsigned long pos = tail.load(memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &cells[pos & (RENDERPOOL_QUEUE_SIZE - 1)];
+        long diff = (long) (cell->sequence.load(memory_order_acquire) - pos);
+        if (diff == 0) {
+            if (tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Full.
+            return false;
+        } else {
+            pos = tail.load(memory_order_relaxed);
+        }
+    }
+
+    cell->item = item;
+    cell->sequence.store(pos + 1, memory_order_release);
+    return true;
+}
+
+
+bool RenderPool::pop(void*& item) {
+    unsigned long pos = head.load(memory_order_relaxed);
+    Cell* cell;
+    for (;;) {
+        cell = &cells[pos & (RENDERPOOL_QUEUE_SIZE - 1)];
+        long diff = (long) (cell->sequence.load(memory_order_acquire) - (pos + 1));
+        if (diff == 0) {
+            if (head.compare_exchange_weak(pos, pos + 1, memory_order_relaxed)) {
+                break;
+            }
+        } else if (diff < 0) {
+            // Empty.
+            return false;
+        } else {
+            pos = head.load(memory_order_relaxed);
+        }
+    }
+
+    item = cell->item;
+    cell->sequence.store(pos + RENDERPOOL_QUEUE_SIZE, memory_order_release);
+    return true;
+}
+
+
+void RenderPool::wake(unsigned count) {
+    count = min(count, (unsigned) workers.size());
+    if (count > 0) {
+        wakeup.post(count);
+    }
+}
+
+
+bool RenderPool::help() {
+    void* item;
+    if (!pop(item)) {
+        return false;
+    }
+    task(item);
+    return true;
+}
+
+
+void RenderPool::quiesce() {
+    for (size_t i = 0; i < workers.size(); i++) {
+        unsigned long state = working[i].load(memory_order_seq_cst);
+        if (state & 1) {
+            while (working[i].load(memory_order_seq_cst) == state) {
+                this_thread::yield();
+            }
+        }
+    }
+}
+
+
+void RenderPool::worker_main(int index) {
+    atomic<unsigned long>& state = working[index];
+    for (;;) {
+        wakeup.wait();
+        if (quit.load(memory_order_acquire)) {
+            return;
+        }
+
+        // Marked as working before the pop, so quiesce() can't miss an
+        // item on its way out of the queue.
+        for (;;) {
+            state.fetch_add(1, memory_order_seq_cst);
+            void* item;
+            bool got = pop(item);
+            if (got) {
+                task(item);
+            }
+            state.fetch_add(1, memory_order_seq_cst);
+            if (!got) {
+                break;
+            }
+        }
+    }
+}
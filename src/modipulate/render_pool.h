@@ -0,0 +1,105 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#ifndef RENDERPOOL_H
+#define RENDERPOOL_H
+
+#include <vector>
+#include <thread>
+#include <atomic>
+
+// Most worker threads the pool will start, however many cores there are.
+#define RENDERPOOL_MAX_THREADS 16
+
+// Most items that can be queued at once. Must be a power of two.
+#define RENDERPOOL_QUEUE_SIZE 256
+
+// Task run by the pool, once for every item pushed.
+typedef void (*RenderPoolTask)(void* item);
+
+// Counting semaphore of the OS. Posting never blocks or takes a lock the
+// waiting side could be holding, so the audio thread can wake workers.
+class RenderSemaphore {
+
+public:
+    RenderSemaphore();
+    ~RenderSemaphore();
+
+    void post(unsigned count);
+    void wait();
+
+private:
+    // Whatever the platform's semaphore is, kept out of this header.
+    void* handle;
+};
+
+// Fixed set of worker threads the mixer hands its per-song render calls to.
+//
+// The audio thread push()es the items of a block, wake()s as many workers
+// as can help, and then help()s itself until the queue is empty. Nothing
+// on that side locks or waits: the queue is lock free and workers sleep
+// on a semaphore.
+//
+// The pool doesn't wait for the items to finish. A worker may take an item
+// and get to it late, after the caller has moved on, so the task has to
+// find out for itself whether the item is still wanted, and whoever frees
+// an item that was ever pushed has to quiesce() first.
+
+class RenderPool {
+
+public:
+    // threads is the total number of threads that render, including the
+    // one pushing items. 0 picks one per core. 1 starts no workers, and
+    // push() always fails.
+    RenderPool(int threads, RenderPoolTask task);
+    ~RenderPool();
+
+    // Queues an item for the workers. False if there are none, or the
+    // queue is full; the caller has to run the item itself then.
+    bool push(void* item);
+
+    // Wakes up to count workers to take queued items.
+    void wake(unsigned count);
+
+    // Takes one queued item and runs it on the calling thread. False if
+    // the queue was empty.
+    bool help();
+
+    // Waits until every worker that was running an item when this was
+    // called is done with it. Not for the audio thread.
+    void quiesce();
+
+    // Threads rendering, including the one pushing items.
+    int get_thread_count();
+
+private:
+    void worker_main(int index);
+
+    bool pop(void*& item);
+
+    RenderPoolTask task;
+
+    std::vector<std::thread> workers;
+    RenderSemaphore wakeup;
+    std::atomic<bool> quit;
+
+    // Odd while the worker is taking or running an item.
+    std::atomic<unsigned long> working[RENDERPOOL_MAX_THREADS];
+
+    // Bounded queue after Dmitry Vyukov's. Each cell's sequence number
+    // says whether it's ready for the next push or the next pop.
+    struct Cell {
+        std::atomic<unsigned long> sequence;
+        void* item;
+    };
+    Cell cells[RENDERPOOL_QUEUE_SIZE];
+    std::atomic<unsigned long> head;  // Next cell to pop.
+    std::atomic<unsigned long> tail;  // Next cell to push.
+};
+
+#endif // RENDERPOOL_H
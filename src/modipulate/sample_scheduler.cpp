@@ -0,0 +1,242 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include <string.h>
+#include "sample_scheduler.h"
+
+using namespace std;
+
+// Pushes one trigger onto a lock-free list.  Each list has one thread
+// pushing and the other one taking everything at once with exchange(),
+// so there is no ABA problem.
+static void push(atomic<SampleTrigger*>& list, SampleTrigger* trigger) {
+    SampleTrigger* head = list.load(memory_order_relaxed);
+    do {
+        trigger->next = head;
+    } while (!list.compare_exchange_weak(head, trigger, memory_order_release, memory_order_relaxed));
+}
+
+
+SampleScheduler::SampleScheduler() :
+    next_handle(0),
+    incoming(NULL),
+    retired(NULL),
+    started(false),
+    current_row(0),
+    overflow(NULL),
+    due(NULL)
+{
+    memset(level0, 0, sizeof(level0));
+    memset(level1, 0, sizeof(level1));
+    memset(due_by_channel, 0, sizeof(due_by_channel));
+}
+
+
+SampleScheduler::~SampleScheduler()
+{
+    clear();
+}
+
+
+ModipulateSampleHandle SampleScheduler::schedule(SampleTrigger* trigger) {
+    collect();
+
+    // 0 is never handed out.
+    if (++next_handle == 0) {
+        next_handle = 1;
+    }
+    trigger->handle = next_handle;
+    trigger->cancelled = false;
+    trigger->fired = false;
+    triggers[trigger->handle] = trigger;
+
+    push(incoming, trigger);
+    return trigger->handle;
+}
+
+
+bool SampleScheduler::cancel(ModipulateSampleHandle handle) {
+    collect();
+
+    unordered_map<ModipulateSampleHandle, SampleTrigger*>::iterator it = triggers.find(handle);
+    if (it == triggers.end() || it->second->fired.load(memory_order_relaxed)) {
+        return false;
+    }
+
+    // The audio thread drops it when its row comes up.
+    return !it->second->cancelled.exchange(true, memory_order_relaxed);
+}
+
+
+void SampleScheduler::collect() {
+    SampleTrigger* trigger = retired.exchange(NULL, memory_order_acquire);
+    while (trigger) {
+        SampleTrigger* next = trigger->next;
+        triggers.erase(trigger->handle);
+        delete trigger;
+        trigger = next;
+    }
+}
+
+
+void SampleScheduler::clear() {
+    // Every trigger is in the map until it's collected.
+    for (unordered_map<ModipulateSampleHandle, SampleTrigger*>::iterator it = triggers.begin();
+        it != triggers.end(); it++) {
+        delete it->second;
+    }
+    triggers.clear();
+
+    incoming = NULL;
+    retired = NULL;
+    started = false;
+    current_row = 0;
+    memset(level0, 0, sizeof(level0));
+    memset(level1, 0, sizeof(level1));
+    overflow = NULL;
+    due = NULL;
+    memset(due_by_channel, 0, sizeof(due_by_channel));
+}
+
+
+void SampleScheduler::start_row(unsigned row, unsigned rows) {
+    // Whatever was due on the last row has had its chance.
+    while (due) {
+        SampleTrigger* next = due->next;
+        due_by_channel[due->channel] = NULL;
+        retire(due);
+        due = next;
+    }
+
+    SampleTrigger* bucket = NULL;
+    if (started) {
+        current_row++;
+
+        if ((current_row & (LEVEL0_SIZE - 1)) == 0) {
+            // Entering a new block of rows: spread out the triggers waiting
+            // for it, after bringing in any from the overflow list that are
+            // now close enough.
+            unsigned block = (unsigned) (current_row >> LEVEL0_BITS) & (LEVEL1_SIZE - 1);
+            if (block == 0) {
+                SampleTrigger* far = overflow;
+                overflow = NULL;
+                while (far) {
+                    SampleTrigger* next = far->next;
+                    insert(far);
+                    far = next;
+                }
+            }
+
+            SampleTrigger* near = level1[block];
+            level1[block] = NULL;
+            while (near) {
+                SampleTrigger* next = near->next;
+                insert(near);
+                near = next;
+            }
+        }
+
+        SampleTrigger*& slot = level0[current_row & (LEVEL0_SIZE - 1)];
+        bucket = slot;
+        slot = NULL;
+    }
+    started = true;
+
+    while (bucket) {
+        SampleTrigger* next = bucket->next;
+        make_due(bucket);
+        bucket = next;
+    }
+
+    // New triggers came in newest first; place them oldest first.
+    SampleTrigger* queued = incoming.exchange(NULL, memory_order_acquire);
+    SampleTrigger* oldest = NULL;
+    while (queued) {
+        SampleTrigger* next = queued->next;
+        queued->next = oldest;
+        oldest = queued;
+        queued = next;
+    }
+
+    while (oldest) {
+        SampleTrigger* trigger = oldest;
+        oldest = oldest->next;
+
+        // Wait for the next row that's a multiple of the modulus, taking
+        // this pattern's end as one, then for offset more rows.
+        unsigned long long wait = 0;
+        if (trigger->modulus > 0 && row % trigger->modulus != 0) {
+            unsigned next_multiple = row + trigger->modulus - row % trigger->modulus;
+            wait = (rows > 0 && next_multiple >= rows) ? rows - row : next_multiple - row;
+        }
+        trigger->row = current_row + wait + trigger->offset;
+
+        if (trigger->row == current_row) {
+            make_due(trigger);
+        } else {
+            insert(trigger);
+        }
+    }
+}
+
+
+const SampleTrigger* SampleScheduler::take(unsigned channel) {
+    if (channel >= MAX_CHANNELS) {
+        return NULL;
+    }
+
+    SampleTrigger* trigger = due_by_channel[channel];
+    if (trigger == NULL) {
+        return NULL;
+    }
+
+    // Stays on the due list until the next row retires it.
+    due_by_channel[channel] = NULL;
+    trigger->fired.store(true, memory_order_relaxed);
+    return trigger;
+}
+
+
+void SampleScheduler::insert(SampleTrigger* trigger) {
+    unsigned long long distance = trigger->row ^ current_row;
+    if (distance < LEVEL0_SIZE) {
+        SampleTrigger*& slot = level0[trigger->row & (LEVEL0_SIZE - 1)];
+        trigger->next = slot;
+        slot = trigger;
+    } else if (distance < (LEVEL0_SIZE << LEVEL1_BITS)) {
+        SampleTrigger*& slot = level1[(trigger->row >> LEVEL0_BITS) & (LEVEL1_SIZE - 1)];
+        trigger->next = slot;
+        slot = trigger;
+    } else {
+        trigger->next = overflow;
+        overflow = trigger;
+    }
+}
+
+
+void SampleScheduler::make_due(SampleTrigger* trigger) {
+    if (trigger->cancelled.load(memory_order_relaxed) || trigger->channel >= MAX_CHANNELS) {
+        retire(trigger);
+        return;
+    }
+
+    trigger->next = due;
+    due = trigger;
+
+    // Handles count up, so the larger one was scheduled last.  The loser
+    // stays on the due list and is retired with the rest.
+    SampleTrigger*& current = due_by_channel[trigger->channel];
+    if (current == NULL || current->handle < trigger->handle) {
+        current = trigger;
+    }
+}
+
+
+void SampleScheduler::retire(SampleTrigger* trigger) {
+    push(retired, trigger);
+}
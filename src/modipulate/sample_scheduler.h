@@ -0,0 +1,117 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#ifndef SAMPLESCHEDULER_H
+#define SAMPLESCHEDULER_H
+
+#include <atomic>
+#include <unordered_map>
+#include "modipulate.h"
+#include "libopenmpt-forked/soundlib/Snd_defs.h"
+
+// A sample trigger waiting for its row, see modipulate_song_schedule_sample().
+struct SampleTrigger {
+    ModipulateSampleHandle handle;
+    int sample;
+    int note;
+    unsigned channel;
+    int modulus;
+    unsigned offset;
+    unsigned tick;
+    int volume_command;
+    int volume_value;
+    int effect_command;
+    int effect_value;
+
+    std::atomic<bool> cancelled;  // Set by the game thread.
+    std::atomic<bool> fired;      // Set by the audio thread.
+
+    unsigned long long row;       // Row count it's due on.
+    SampleTrigger* next;          // Whichever list it's on.
+};
+
+// Schedules sample triggers by row, for one song.
+//
+// Rows are counted from the start of playback, across pattern changes,
+// loops and seeks.  Triggers wait in a hierarchical timing wheel: the
+// next 256 rows have a bucket each, the 64 blocks of 256 rows after that
+// have a bucket each, and anything further out waits on an overflow list
+// that is looked at every 16384 rows.  Scheduling, cancelling and
+// dispatching are O(1) and there is no limit on pending triggers.
+//
+// The game thread owns the triggers.  schedule() hands new ones over
+// through a lock-free list, and the audio thread hands them back the
+// same way once they've fired or been dropped; collect() deletes them.
+// Neither side ever waits for the other.
+
+class SampleScheduler {
+
+public:
+    SampleScheduler();
+    ~SampleScheduler();
+
+    // Game thread: queues a trigger, to be placed on the wheel at the start
+    // of the next row.  Takes ownership and fills in trigger->handle.
+    ModipulateSampleHandle schedule(SampleTrigger* trigger);
+
+    // Game thread: keeps a trigger from firing.  Returns false if the
+    // handle is unknown or the trigger has already fired.
+    bool cancel(ModipulateSampleHandle handle);
+
+    // Game thread: deletes the triggers the audio thread is done with.
+    void collect();
+
+    // Game thread: deletes every trigger.  The audio thread must not be
+    // using the scheduler.
+    void clear();
+
+    // Audio thread: a new row has started, at row in a pattern of rows
+    // rows.  Places the queued triggers and finds the ones due now.
+    void start_row(unsigned row, unsigned rows);
+
+    // Audio thread: the trigger due on a channel this row, or NULL.  Marks
+    // it as fired.  If several are due, the last one scheduled wins.
+    const SampleTrigger* take(unsigned channel);
+
+private:
+    enum {
+        LEVEL0_BITS = 8,
+        LEVEL1_BITS = 6,
+        LEVEL0_SIZE = 1 << LEVEL0_BITS,
+        LEVEL1_SIZE = 1 << LEVEL1_BITS
+    };
+
+    SampleScheduler(const SampleScheduler&);
+    SampleScheduler& operator=(const SampleScheduler&);
+
+    // Audio thread.
+    void insert(SampleTrigger* trigger);
+    void make_due(SampleTrigger* trigger);
+    void retire(SampleTrigger* trigger);
+
+    // Game thread.
+    std::unordered_map<ModipulateSampleHandle, SampleTrigger*> triggers;
+    ModipulateSampleHandle next_handle;
+
+    // Newest first.
+    std::atomic<SampleTrigger*> incoming;
+    std::atomic<SampleTrigger*> retired;
+
+    // Audio thread.
+    bool started;
+    unsigned long long current_row;
+    SampleTrigger* level0[LEVEL0_SIZE];
+    SampleTrigger* level1[LEVEL1_SIZE];
+    SampleTrigger* overflow;
+
+    // Due on the current row, and the one to play per channel.
+    SampleTrigger* due;
+    SampleTrigger* due_by_channel[MAX_CHANNELS];
+};
+
+#endif // SAMPLESCHEDULER_H
@@ -0,0 +1,171 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include "song_loader.h"
+#include "mod_stream.h"
+
+#include <exception>
+
+using namespace std;
+
+SongLoader::SongLoader(ModMixer* mixer) :
+    mixer(mixer),
+    quit(false),
+    next_token(0),
+    current(NULL)
+{
+}
+
+
+SongLoader::~SongLoader()
+{
+    vector<SongLoad*> done;
+    take_all(done);
+    for (size_t i = 0; i < done.size(); i++) {
+        delete done[i]->stream;
+        delete done[i];
+    }
+}
+
+
+ModipulateLoadToken SongLoader::load(const string& path, modipulate_song_load_cb cb, void* user_data) {
+    SongLoad* load = new SongLoad();
+    load->path = path;
+    load->cb = cb;
+    load->user_data = user_data;
+    load->cancelled = false;
+    load->stream = NULL;
+
+    {
+        lock_guard<mutex> guard(lock);
+
+        // 0 is never handed out.
+        if (++next_token == 0) {
+            next_token = 1;
+        }
+        load->token = next_token;
+        queued.push_back(load);
+
+        if (!thread.joinable()) {
+            thread = std::thread(&SongLoader::thread_main, this);
+        }
+    }
+    wake.notify_one();
+
+    return load->token;
+}
+
+
+bool SongLoader::cancel(ModipulateLoadToken token) {
+    lock_guard<mutex> guard(lock);
+
+    if (current != NULL && current->token == token) {
+        current->cancelled = true;
+        return true;
+    }
+    for (deque<SongLoad*>::iterator it = queued.begin(); it != queued.end(); it++) {
+        if ((*it)->token == token) {
+            (*it)->cancelled = true;
+            return true;
+        }
+    }
+    for (vector<SongLoad*>::iterator it = finished.begin(); it != finished.end(); it++) {
+        if ((*it)->token == token) {
+            (*it)->cancelled = true;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+
+SongLoad* SongLoader::take_finished() {
+    lock_guard<mutex> guard(lock);
+
+    if (finished.empty()) {
+        return NULL;
+    }
+    SongLoad* load = finished.front();
+    finished.erase(finished.begin());
+    return load;
+}
+
+
+void SongLoader::take_all(vector<SongLoad*>& done) {
+    stop();
+
+    // The thread is gone, so there's nobody to race with.
+    done.insert(done.end(), finished.begin(), finished.end());
+    finished.clear();
+    for (deque<SongLoad*>::iterator it = queued.begin(); it != queued.end(); it++) {
+        (*it)->cancelled = true;
+        done.push_back(*it);
+    }
+    queued.clear();
+}
+
+
+void SongLoader::stop() {
+    {
+        lock_guard<mutex> guard(lock);
+        quit = true;
+    }
+    wake.notify_one();
+
+    if (thread.joinable()) {
+        thread.join();
+    }
+}
+
+
+void SongLoader::thread_main() {
+    unique_lock<mutex> guard(lock);
+
+    for (;;) {
+        while (!quit && queued.empty()) {
+            wake.wait(guard);
+        }
+        if (quit) {
+            return;
+        }
+
+        SongLoad* load = queued.front();
+        queued.pop_front();
+
+        if (!load->cancelled) {
+            current = load;
+            guard.unlock();
+
+            // Nothing may escape this thread, or the whole program goes down.
+            ModStream* stream = NULL;
+            bool failed = true;
+            try {
+                stream = new ModStream(mixer);
+                stream->open(load->path);
+                failed = false;
+            } catch (const string& e) {
+                load->error = e;
+            } catch (const exception& e) {
+                load->error = string("Error loading song: ") + e.what();
+            } catch (...) {
+                load->error = "Error loading song.";
+            }
+            if (failed) {
+                delete stream;
+                stream = NULL;
+            }
+
+            guard.lock();
+            current = NULL;
+            load->stream = stream;
+        }
+
+        finished.push_back(load);
+    }
+}
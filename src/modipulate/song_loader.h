@@ -0,0 +1,86 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#ifndef SONGLOADER_H
+#define SONGLOADER_H
+
+#include <string>
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include "modipulate.h"
+
+class ModStream;
+class ModMixer;
+
+// A song load requested with SongLoader::load().
+struct SongLoad {
+    ModipulateLoadToken token;
+    std::string path;
+    modipulate_song_load_cb cb;
+    void* user_data;
+
+    bool cancelled;
+    ModStream* stream;  // The opened song, or NULL if it failed or was cancelled.
+    std::string error;  // Why it failed.
+};
+
+// Opens songs on a background thread, one at a time in the order they
+// were requested.
+//
+// The game thread collects finished loads with take_finished() and
+// registers the songs itself, so the loader never touches the song
+// registry or the mixer.  The thread is started on the first load.
+
+class SongLoader {
+
+public:
+    SongLoader(ModMixer* mixer);
+
+    // Waits for the load in progress, if any, and frees every load that
+    // hasn't been collected without calling its callback.
+    ~SongLoader();
+
+    // Queues a song and returns its token.
+    ModipulateLoadToken load(const std::string& path, modipulate_song_load_cb cb, void* user_data);
+
+    // Marks a load as cancelled.  A load that is still queued is skipped;
+    // one that is in progress runs to the end and its song is thrown away.
+    // Returns false if the token is unknown or the load was collected.
+    bool cancel(ModipulateLoadToken token);
+
+    // Returns the oldest load that is done, cancelled or not, or NULL if
+    // there is none.  The caller owns it and its song.
+    SongLoad* take_finished();
+
+    // Stops the thread and moves every load into done, whether it's done
+    // or not.  Loads that never ran are marked cancelled.
+    void take_all(std::vector<SongLoad*>& done);
+
+private:
+    void thread_main();
+
+    // Stops and joins the thread.
+    void stop();
+
+    ModMixer* mixer;
+    std::thread thread;
+
+    std::mutex lock;
+    std::condition_variable wake;
+    bool quit;
+
+    ModipulateLoadToken next_token;
+    std::deque<SongLoad*> queued;
+    SongLoad* current;              // Being opened by the thread.
+    std::vector<SongLoad*> finished;
+};
+
+#endif // SONGLOADER_H
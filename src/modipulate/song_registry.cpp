@@ -0,0 +1,121 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include "song_registry.h"
+
+using namespace std;
+
+// Handle layout: the low bits hold the slot index plus one, so that no
+// handle is ever NULL, and the high bits hold the slot's generation.
+// 32-bit builds make do with 20 index bits (a million songs at once) and
+// 12 generation bits.
+static const unsigned INDEX_BITS = sizeof(uintptr_t) >= 8 ? 32 : 20;
+static const uintptr_t INDEX_MASK = ((uintptr_t) 1 << INDEX_BITS) - 1;
+static const uint32_t GENERATION_MASK = sizeof(uintptr_t) >= 8 ? 0xFFFFFFFFu : 0xFFFu;
+static const uint32_t NO_SLOT = 0xFFFFFFFFu;
+
+
+SongRegistry::SongRegistry() :
+    free_head(NO_SLOT)
+{
+}
+
+
+ModipulateSong SongRegistry::add(ModStream* stream) {
+    uint32_t index;
+    if (free_head != NO_SLOT) {
+        index = free_head;
+        free_head = slots[index].next_free;
+    } else {
+        if (slots.size() >= INDEX_MASK) {
+            return NULL;
+        }
+        index = (uint32_t) slots.size();
+        Slot slot;
+        slot.generation = 0;
+        slots.push_back(slot);
+    }
+
+    Slot& slot = slots[index];
+    slot.stream = stream;
+    slot.next_free = NO_SLOT;
+    slot.dense = streams.size();
+    streams.push_back(stream);
+    stream_slots.push_back(index);
+
+    uintptr_t handle = ((uintptr_t) (slot.generation & GENERATION_MASK) << INDEX_BITS) | (index + 1);
+    return (ModipulateSong) handle;
+}
+
+
+bool SongRegistry::decode(ModipulateSong song, uint32_t* index) {
+    uintptr_t handle = (uintptr_t) song;
+    uintptr_t slot_plus_one = handle & INDEX_MASK;
+    if (slot_plus_one == 0 || slot_plus_one > slots.size()) {
+        return false;
+    }
+
+    const Slot& slot = slots[slot_plus_one - 1];
+    if (slot.stream == NULL || (uint32_t) (handle >> INDEX_BITS) != (slot.generation & GENERATION_MASK)) {
+        return false;
+    }
+
+    *index = (uint32_t) (slot_plus_one - 1);
+    return true;
+}
+
+
+ModStream* SongRegistry::get(ModipulateSong song) {
+    uint32_t index;
+    return decode(song, &index) ? slots[index].stream : NULL;
+}
+
+
+ModStream* SongRegistry::remove(ModipulateSong song) {
+    uint32_t index;
+    if (!decode(song, &index)) {
+        return NULL;
+    }
+
+    Slot& slot = slots[index];
+    ModStream* stream = slot.stream;
+
+    // Move the last song into the hole.
+    size_t dense = slot.dense;
+    streams[dense] = streams.back();
+    stream_slots[dense] = stream_slots.back();
+    slots[stream_slots[dense]].dense = dense;
+    streams.pop_back();
+    stream_slots.pop_back();
+
+    slot.stream = NULL;
+    slot.generation++;
+    slot.next_free = free_head;
+    free_head = index;
+
+    return stream;
+}
+
+
+const vector<ModStream*>& SongRegistry::get_streams() {
+    return streams;
+}
+
+
+void SongRegistry::clear() {
+    while (!stream_slots.empty()) {
+        Slot& slot = slots[stream_slots.back()];
+        slot.stream = NULL;
+        slot.generation++;
+        slot.next_free = free_head;
+        free_head = stream_slots.back();
+
+        streams.pop_back();
+        stream_slots.pop_back();
+    }
+}
@@ -0,0 +1,68 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#ifndef SONGREGISTRY_H
+#define SONGREGISTRY_H
+
+#include <vector>
+#include <stddef.h>
+#include <stdint.h>
+#include "modipulate.h"
+
+class ModStream;
+
+// Maps ModipulateSong handles to the loaded songs.
+//
+// A handle is a slot index plus the slot's generation, packed into the
+// pointer-sized ModipulateSong.  Removing a song bumps the generation of
+// its slot, so handles of unloaded songs are recognized as stale even
+// after the slot has been reused.  Lookups are O(1) and there is no limit
+// on the number of songs.  Not thread safe; the game thread owns it.
+
+class SongRegistry {
+
+public:
+    SongRegistry();
+
+    // Adds a song and returns its new handle.
+    ModipulateSong add(ModStream* stream);
+
+    // Returns the song behind a handle, or NULL if the handle is stale or
+    // was never valid.
+    ModStream* get(ModipulateSong song);
+
+    // Removes a song and returns it, or returns NULL if the handle is
+    // stale.  The caller deletes the song.
+    ModStream* remove(ModipulateSong song);
+
+    // Every loaded song, in no particular order.
+    const std::vector<ModStream*>& get_streams();
+
+    // Forgets all songs without deleting them.  Outstanding handles
+    // stay stale.
+    void clear();
+
+private:
+    struct Slot {
+        ModStream* stream;
+        uint32_t generation;
+        uint32_t next_free;  // Next slot on the free list, while unused.
+        size_t dense;        // Position in streams, while used.
+    };
+
+    bool decode(ModipulateSong song, uint32_t* index);
+
+    std::vector<Slot> slots;
+    uint32_t free_head;
+
+    // Loaded songs, packed so iterating doesn't have to skip empty slots.
+    std::vector<ModStream*> streams;
+    std::vector<uint32_t> stream_slots;
+};
+
+#endif // SONGREGISTRY_H
@@ -0,0 +1,63 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "test.h"
+
+struct TestSuite {
+    const char* name;
+    void (*run)(const char* data_path);
+};
+
+static const TestSuite suites[] = {
+    { "dsp", test_dsp },
+    { "sample_scheduler", test_sample_scheduler },
+    { "command_queue", test_command_queue },
+    { "render", test_render },
+    { "seek", test_seek },
+    { "timeline", test_timeline },
+    { "polling", test_polling },
+};
+
+static int failures = 0;
+
+void test_check(bool ok, const char* what, const char* file, int line) {
+    if (!ok) {
+        fprintf(stderr, "%s:%d: check failed: %s\n", file, line, what);
+        failures++;
+    }
+}
+
+// Usage: modipulate-test suite data_path
+int main(int argc, char** argv) {
+    if (argc < 3) {
+        fprintf(stderr, "Usage: %s suite data_path\n", argv[0]);
+        return 2;
+    }
+
+    const TestSuite* suite = NULL;
+    for (size_t i = 0; i < sizeof(suites) / sizeof(suites[0]); i++) {
+        if (strcmp(suites[i].name, argv[1]) == 0) {
+            suite = &suites[i];
+        }
+    }
+    if (suite == NULL) {
+        fprintf(stderr, "Unknown test suite: %s\n", argv[1]);
+        return 2;
+    }
+
+    suite->run(argv[2]);
+
+    if (failures > 0) {
+        fprintf(stderr, "%s: %d check(s) failed\n", suite->name, failures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", suite->name);
+    return 0;
+}
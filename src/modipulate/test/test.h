@@ -0,0 +1,58 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#ifndef MODIPULATE_TEST_H
+#define MODIPULATE_TEST_H
+
+// Unit tests for Modipulate.  Each suite is run by name, see test.cpp.
+
+// Reports a failed check; the suite carries on, and the test program
+// fails at the end.
+#define TEST_CHECK(cond) test_check((cond), #cond, __FILE__, __LINE__)
+
+void test_check(bool ok, const char* what, const char* file, int line);
+
+// Steps a play position (a row, tick or frame count) from position on,
+// calling step(position) for each, until found() is true.  Returns the
+// position that happened on, leaving position just past it, or -1 if it
+// didn't happen within count steps.
+template <class Step, class Found>
+long long test_run_until(unsigned long long& position, unsigned long long count, Step step, Found found) {
+    for (unsigned long long end = position + count; position < end; position++) {
+        step(position);
+        if (found()) {
+            return (long long) position++;
+        }
+    }
+    return -1;
+}
+
+// Test suites.  data_path is the directory with the test songs.
+
+// Built-in DSP effects.
+void test_dsp(const char* data_path);
+
+// SampleScheduler's timing wheel.
+void test_sample_scheduler(const char* data_path);
+
+// CommandQueue timing: rows, ticks, frames and limits.
+void test_command_queue(const char* data_path);
+
+// Offline rendering through the C API.
+void test_render(const char* data_path);
+
+// Seeks with the seek cache land and sound the same as without it.
+void test_seek(const char* data_path);
+
+// The note timeline matches the notes that play.
+void test_timeline(const char* data_path);
+
+// Polling events in place of callbacks.
+void test_polling(const char* data_path);
+
+#endif // MODIPULATE_TEST_H
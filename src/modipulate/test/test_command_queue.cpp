@@ -0,0 +1,202 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include "command_queue.h"
+#include "test.h"
+
+// Song shape while driving the queue.
+#define TEST_TICKS_PER_ROW 6
+#define TEST_TICK_FRAMES 100
+
+static QueuedCommand make_command(unsigned channel, bool effect, unsigned value, int when,
+    unsigned long long at) {
+    QueuedCommand command;
+    command.channel = channel;
+    command.effect = effect;
+    command.command = effect ? 1 : 2;
+    command.value = value;
+    command.when = when;
+    command.at = at;
+    return command;
+}
+
+
+// Plays tick number tick, counted from the start of playback, the way
+// ModStream does: the tick first, then the row if it starts one.
+static void start_tick(CommandQueue& queue, unsigned long long tick) {
+    TickClock clock;
+    clock.tick = tick;
+    clock.frame = tick * TEST_TICK_FRAMES;
+    clock.tick_frames = TEST_TICK_FRAMES;
+    queue.start_tick(clock);
+
+    if (tick % TEST_TICKS_PER_ROW == 0) {
+        queue.start_row(tick / TEST_TICKS_PER_ROW);
+    }
+}
+
+
+// Plays ticks until a cell turns up on channel, and returns the tick it
+// came on, or -1 if none did within ticks ticks.
+static long long run_until_taken(CommandQueue& queue, unsigned long long& tick,
+    unsigned long long ticks, unsigned channel, QueuedCell* cell) {
+    return test_run_until(tick, ticks,
+        [&](unsigned long long t) { start_tick(queue, t); },
+        [&]() {
+            const QueuedCell* taken = queue.take(channel);
+            if (taken != NULL) {
+                *cell = *taken;
+            }
+            return taken != NULL;
+        });
+}
+
+
+// Row targets go on the first tick of their row.
+static void test_rows() {
+    CommandQueue queue;
+    unsigned long long tick = 0;
+    QueuedCell cell;
+
+    TEST_CHECK(queue.push(make_command(0, true, 7, MODIPULATE_WHEN_NEXT_ROW, 0)));
+    TEST_CHECK(run_until_taken(queue, tick, 100, 0, &cell) == 0);
+    TEST_CHECK(cell.effect && !cell.volume && cell.effect_value == 7);
+
+    // Queued mid-row: the next row, and two rows after that.
+    while (tick < TEST_TICKS_PER_ROW + 3) {
+        start_tick(queue, tick++);
+    }
+    TEST_CHECK(queue.push(make_command(1, false, 8, MODIPULATE_WHEN_NEXT_ROW, 0)));
+    TEST_CHECK(queue.push(make_command(2, false, 9, MODIPULATE_WHEN_ROWS, 2)));
+    TEST_CHECK(run_until_taken(queue, tick, 100, 1, &cell) == 2 * TEST_TICKS_PER_ROW);
+    TEST_CHECK(cell.volume && cell.volume_value == 8);
+    TEST_CHECK(run_until_taken(queue, tick, 100, 2, &cell) == 4 * TEST_TICKS_PER_ROW);
+    TEST_CHECK(cell.volume && cell.volume_value == 9);
+}
+
+
+// Tick and frame targets go on their own tick, each one, even when
+// several fall within a row.
+static void test_ticks() {
+    CommandQueue queue;
+    TEST_CHECK(queue.push(make_command(0, true, 1, MODIPULATE_WHEN_TICK, 8)));
+    TEST_CHECK(queue.push(make_command(0, true, 2, MODIPULATE_WHEN_TICK, 10)));
+    TEST_CHECK(queue.push(make_command(0, false, 3, MODIPULATE_WHEN_FRAME, 9 * TEST_TICK_FRAMES + 50)));
+    TEST_CHECK(queue.push(make_command(1, true, 4, MODIPULATE_WHEN_FRAME, 3 * TEST_TICK_FRAMES)));
+
+    unsigned seen = 0;
+    for (unsigned long long tick = 0; tick < 20; tick++) {
+        start_tick(queue, tick);
+        const QueuedCell* cell = queue.take(0);
+        const QueuedCell* other = queue.take(1);
+        switch (tick) {
+        case 3:
+            TEST_CHECK(cell == NULL);
+            TEST_CHECK(other != NULL && other->effect && other->effect_value == 4);
+            seen++;
+            break;
+        case 8:
+            TEST_CHECK(cell != NULL && cell->effect && !cell->volume && cell->effect_value == 1);
+            TEST_CHECK(other == NULL);
+            seen++;
+            break;
+        case 9:
+            TEST_CHECK(cell != NULL && cell->volume && !cell->effect && cell->volume_value == 3);
+            TEST_CHECK(other == NULL);
+            seen++;
+            break;
+        case 10:
+            TEST_CHECK(cell != NULL && cell->effect && !cell->volume && cell->effect_value == 2);
+            TEST_CHECK(other == NULL);
+            seen++;
+            break;
+        default:
+            TEST_CHECK(cell == NULL);
+            TEST_CHECK(other == NULL);
+            break;
+        }
+    }
+    TEST_CHECK(seen == 4);
+
+    // Ticks that have passed mean the next one.
+    unsigned long long tick = 20;
+    QueuedCell cell;
+    TEST_CHECK(queue.push(make_command(0, true, 5, MODIPULATE_WHEN_TICK, 2)));
+    TEST_CHECK(run_until_taken(queue, tick, 10, 0, &cell) == 20);
+}
+
+
+// A channel takes one volume and one effect command per tick; the rest
+// wait their turn, in order.
+static void test_columns() {
+    CommandQueue queue;
+    for (unsigned i = 0; i < 3; i++) {
+        TEST_CHECK(queue.push(make_command(4, true, 10 + i, MODIPULATE_WHEN_TICK, 1)));
+    }
+    TEST_CHECK(queue.push(make_command(4, false, 20, MODIPULATE_WHEN_TICK, 1)));
+
+    unsigned long long tick = 0;
+    QueuedCell cell;
+    TEST_CHECK(run_until_taken(queue, tick, 10, 4, &cell) == 1);
+    TEST_CHECK(cell.effect && cell.effect_value == 10);
+    TEST_CHECK(cell.volume && cell.volume_value == 20);
+    TEST_CHECK(run_until_taken(queue, tick, 10, 4, &cell) == 2);
+    TEST_CHECK(cell.effect && cell.effect_value == 11 && !cell.volume);
+    TEST_CHECK(run_until_taken(queue, tick, 10, 4, &cell) == 3);
+    TEST_CHECK(cell.effect && cell.effect_value == 12 && !cell.volume);
+    TEST_CHECK(run_until_taken(queue, tick, 10, 4, &cell) == -1);
+
+    // Row targets whose column is taken wait for the next row, not tick.
+    CommandQueue rows;
+    rows.push(make_command(5, true, 30, MODIPULATE_WHEN_NEXT_ROW, 0));
+    rows.push(make_command(5, true, 31, MODIPULATE_WHEN_NEXT_ROW, 0));
+    tick = 0;
+    TEST_CHECK(run_until_taken(rows, tick, 20, 5, &cell) == 0);
+    TEST_CHECK(cell.effect_value == 30);
+    TEST_CHECK(run_until_taken(rows, tick, 20, 5, &cell) == TEST_TICKS_PER_ROW);
+    TEST_CHECK(cell.effect_value == 31);
+}
+
+
+// push() turns away commands once the queue is full, or for channels out
+// of range.  Far-off commands don't hold up ones due sooner.
+static void test_limits() {
+    CommandQueue queue;
+    TEST_CHECK(!queue.push(make_command(MAX_CHANNELS, true, 1, MODIPULATE_WHEN_NEXT_ROW, 0)));
+
+    for (unsigned i = 0; i < MAX_QUEUED_COMMANDS - 1; i++) {
+        TEST_CHECK(queue.push(make_command(i % 8, true, i, MODIPULATE_WHEN_TICK, 1000000)));
+    }
+    TEST_CHECK(queue.push(make_command(9, true, 1, MODIPULATE_WHEN_TICK, 5)));
+    TEST_CHECK(!queue.push(make_command(9, true, 2, MODIPULATE_WHEN_TICK, 5)));
+
+    unsigned long long tick = 0;
+    QueuedCell cell;
+    TEST_CHECK(run_until_taken(queue, tick, 10, 9, &cell) == 5);
+    TEST_CHECK(cell.effect_value == 1);
+
+    // Room again once it's placed.
+    TEST_CHECK(queue.push(make_command(9, true, 3, MODIPULATE_WHEN_TICK, 0)));
+    TEST_CHECK(!queue.push(make_command(9, true, 4, MODIPULATE_WHEN_TICK, 0)));
+    TEST_CHECK(run_until_taken(queue, tick, 10, 9, &cell) == 6);
+    TEST_CHECK(cell.effect_value == 3);
+
+    queue.clear();
+    for (unsigned i = 0; i < MAX_QUEUED_COMMANDS; i++) {
+        TEST_CHECK(queue.push(make_command(0, true, i, MODIPULATE_WHEN_TICK, 1000000)));
+    }
+    TEST_CHECK(!queue.push(make_command(0, true, 0, MODIPULATE_WHEN_TICK, 0)));
+}
+
+
+void test_command_queue(const char* data_path) {
+    test_rows();
+    test_ticks();
+    test_columns();
+    test_limits();
+}
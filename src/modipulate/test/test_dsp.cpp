@@ -0,0 +1,135 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include <cmath>
+#include <fstream>
+#include <string>
+#include <vector>
+#include "libopenmpt-forked/libopenmpt/libopenmpt.hpp"
+#include "test.h"
+
+// Test songs.  The first is quiet, and mixed in the center, which leaves
+// the surround effect nothing to work with; the second isn't.
+#define DSP_TEST_SONG "cerror_-_pigs_go_oink.xm"
+#define DSP_TEST_STEREO_SONG "gem-pivi.it"
+#define DSP_TEST_RATE 44100
+#define DSP_TEST_FRAMES (DSP_TEST_RATE * 4)
+
+// Loudest sample an effect may produce.  The float output isn't clipped,
+// so this only catches effects that blow up.
+#define DSP_TEST_MAX_LEVEL 2.0f
+
+// Renders the start of the test song with the given ctls set, name and
+// value in turn.  Returns false if the song can't be rendered.
+static bool render(const std::string& path, const char* const* ctls, int num_ctls, std::vector<float>& out) {
+    std::ifstream file(path.c_str(), std::ios::binary);
+    if (!file) {
+        return false;
+    }
+
+    try {
+        openmpt::module mod(file);
+        for (int i = 0; i < num_ctls; i++) {
+            mod.ctl_set(ctls[i * 2], ctls[i * 2 + 1]);
+        }
+
+        out.assign(DSP_TEST_FRAMES * 2, 0.0f);
+        std::size_t done = 0;
+        while (done < DSP_TEST_FRAMES) {
+            std::size_t count = mod.read_interleaved_stereo(DSP_TEST_RATE, DSP_TEST_FRAMES - done, &out[done * 2]);
+            if (count == 0) {
+                break;
+            }
+            done += count;
+        }
+        out.resize(done * 2);
+    } catch (const openmpt::exception&) {
+        return false;
+    }
+    return true;
+}
+
+
+// Renders with an effect on and compares against the dry render.
+static void check_effect(const std::string& path, const char* const* ctls, int num_ctls) {
+    std::vector<float> dry;
+    TEST_CHECK(render(path, NULL, 0, dry));
+    TEST_CHECK(dry.size() == DSP_TEST_FRAMES * 2);
+
+    std::vector<float> wet;
+    TEST_CHECK(render(path, ctls, num_ctls, wet));
+    TEST_CHECK(wet.size() == dry.size());
+    if (wet.size() != dry.size()) {
+        return;
+    }
+
+    bool changed = false;
+    bool finite = true;
+    float peak = 0.0f;
+    for (size_t i = 0; i < wet.size(); i++) {
+        if (wet[i] != dry[i]) {
+            changed = true;
+        }
+        if (!std::isfinite(wet[i])) {
+            finite = false;
+        } else if (std::fabs(wet[i]) > peak) {
+            peak = std::fabs(wet[i]);
+        }
+    }
+
+    TEST_CHECK(changed);
+    TEST_CHECK(finite);
+    TEST_CHECK(peak <= DSP_TEST_MAX_LEVEL);
+}
+
+
+void test_dsp(const char* data_path) {
+    const std::string path = std::string(data_path) + "/" + DSP_TEST_SONG;
+    const std::string stereo_path = std::string(data_path) + "/" + DSP_TEST_STEREO_SONG;
+
+    // Switching an effect off again leaves the output alone.
+    const char* off[] = { "dsp.reverb", "1", "dsp.reverb", "0" };
+    std::vector<float> dry;
+    std::vector<float> same;
+    TEST_CHECK(render(path, NULL, 0, dry));
+    TEST_CHECK(render(path, off, 2, same));
+    TEST_CHECK(same == dry);
+
+    const char* reverb[] = { "dsp.reverb", "1" };
+    check_effect(path, reverb, 1);
+
+    const char* reverb_hall[] = { "dsp.reverb", "1", "dsp.reverb.type", "28", "dsp.reverb.depth", "16" };
+    check_effect(path, reverb_hall, 3);
+
+    const char* megabass[] = { "dsp.megabass", "1" };
+    check_effect(path, megabass, 1);
+
+    const char* surround[] = { "dsp.surround", "1" };
+    check_effect(stereo_path, surround, 1);
+
+    const char* noise_reduction[] = { "dsp.noisereduction", "1" };
+    check_effect(path, noise_reduction, 1);
+
+    const char* eq[] = { "dsp.eq", "1", "dsp.eq.gain.0", "32", "dsp.eq.gain.4", "0" };
+    check_effect(path, eq, 3);
+
+    const char* agc[] = { "dsp.agc", "1" };
+    check_effect(path, agc, 1);
+
+    const char* all[] = { "dsp.reverb", "1", "dsp.megabass", "1", "dsp.surround", "1",
+        "dsp.noisereduction", "1", "dsp.eq", "1", "dsp.eq.gain.1", "32", "dsp.agc", "1" };
+    check_effect(path, all, 7);
+    check_effect(stereo_path, all, 7);
+
+    // The EQ gains read back as set.
+    std::ifstream file(path.c_str(), std::ios::binary);
+    openmpt::module mod(file);
+    mod.ctl_set("dsp.eq.gain.3", "20");
+    TEST_CHECK(mod.ctl_get("dsp.eq.gain.3") == "20");
+    TEST_CHECK(mod.ctl_get("dsp.eq.gain.2") == "16");
+}
@@ -0,0 +1,86 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include "modipulate.h"
+#include "test.h"
+
+#define POLLING_TEST_SONG "v-cf.it"
+
+// Rows to play before checking.
+#define POLLING_TEST_ROWS 64
+
+// Longest wait for them, in milliseconds.
+#define POLLING_TEST_WAIT_MSEC 30000
+
+static void on_row(ModipulateSong song, int row, void* user_data) {
+    std::vector<int>* rows = (std::vector<int>*) user_data;
+    rows->push_back(row);
+}
+
+
+void test_polling(const char* data_path) {
+    const std::string path = std::string(data_path) + "/" + POLLING_TEST_SONG;
+    TEST_CHECK(MODIPULATE_OK(modipulate_global_init(NULL)));
+
+    ModipulateSong song;
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_load(path.c_str(), &song)));
+
+    // Polling is off until asked for.
+    ModipulateEvent events[256];
+    unsigned count = 0;
+    TEST_CHECK(modipulate_song_poll_events(song, events, 256, &count) == MODIPULATE_ERROR_GENERAL);
+
+    // Turned on before playing, it gets every event from the start, the same
+    // ones the callbacks get.
+    std::vector<int> callback_rows;
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_enable_event_polling(song, 1)));
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_on_row_change(song, on_row, &callback_rows)));
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_play(song, 1)));
+
+    std::vector<ModipulateEvent> polled;
+    for (int msec = 0; msec < POLLING_TEST_WAIT_MSEC && callback_rows.size() < POLLING_TEST_ROWS; msec++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        TEST_CHECK(MODIPULATE_OK(modipulate_global_update()));
+        do {
+            TEST_CHECK(MODIPULATE_OK(modipulate_song_poll_events(song, events, 256, &count)));
+            polled.insert(polled.end(), events, events + count);
+        } while (count == 256);
+    }
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_play(song, 0)));
+
+    std::vector<int> polled_rows;
+    for (size_t i = 0; i < polled.size(); i++) {
+        if (polled[i].type == MODIPULATE_EVENT_ROW) {
+            polled_rows.push_back(polled[i].value);
+        }
+        TEST_CHECK(i == 0 || polled[i].frame >= polled[i - 1].frame);
+    }
+    TEST_CHECK(callback_rows.size() >= POLLING_TEST_ROWS);
+    TEST_CHECK(polled_rows == callback_rows);
+    TEST_CHECK(!polled.empty() && polled[0].type == MODIPULATE_EVENT_PATTERN);
+    TEST_CHECK(!polled_rows.empty() && polled_rows[0] == 0);
+
+    // Turning it off drops what's waiting.
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_play(song, 1)));
+    for (int msec = 0; msec < POLLING_TEST_WAIT_MSEC && callback_rows.size() < POLLING_TEST_ROWS * 2; msec++) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        TEST_CHECK(MODIPULATE_OK(modipulate_global_update()));
+    }
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_play(song, 0)));
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_enable_event_polling(song, 0)));
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_enable_event_polling(song, 1)));
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_poll_events(song, events, 256, &count)));
+    TEST_CHECK(count == 0);
+
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_unload(song)));
+    TEST_CHECK(MODIPULATE_OK(modipulate_global_deinit()));
+}
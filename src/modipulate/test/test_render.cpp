@@ -0,0 +1,96 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include <string>
+#include <vector>
+#include "modipulate.h"
+#include "test.h"
+
+// A song with many rows to the minute, rendered for long enough to queue
+// far more events than the event queue holds.
+#define RENDER_TEST_SONG "v-cf.it"
+#define RENDER_TEST_RATE 44100
+#define RENDER_TEST_SECONDS 600
+#define RENDER_TEST_FRAMES (RENDER_TEST_RATE * RENDER_TEST_SECONDS)
+
+// Small enough that each render queues only a few events.
+#define RENDER_TEST_STEP_FRAMES 4096
+
+struct RowCount {
+    unsigned long rows;
+    unsigned long frames;       // Frames rendered before the current call
+    unsigned long last_frame;   // Where the last row fell, from the start
+    bool in_order;
+    bool in_buffer;
+};
+
+static void on_row(ModipulateSong song, int row, void* user_data) {
+    RowCount* count = (RowCount*) user_data;
+    unsigned long offset = 0;
+    if (!MODIPULATE_OK(modipulate_song_get_event_offset(song, &offset))) {
+        count->in_buffer = false;
+        return;
+    }
+
+    unsigned long frame = count->frames + offset;
+    if (count->rows > 0 && frame < count->last_frame) {
+        count->in_order = false;
+    }
+    count->last_frame = frame;
+    count->rows++;
+}
+
+
+// Renders RENDER_TEST_FRAMES frames, step frames per call, and counts the
+// row callbacks.
+static RowCount render_rows(const std::string& path, unsigned long step) {
+    RowCount count = { 0, 0, 0, true, true };
+
+    ModipulateSong song;
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_load(path.c_str(), &song)));
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_on_row_change(song, on_row, &count)));
+
+    std::vector<float> buffer(step * 2);
+    while (count.frames < RENDER_TEST_FRAMES) {
+        unsigned long frames = RENDER_TEST_FRAMES - count.frames;
+        if (frames > step) {
+            frames = step;
+        }
+        unsigned long rendered = 0;
+        TEST_CHECK(MODIPULATE_OK(modipulate_song_render(song, RENDER_TEST_RATE,
+            MODIPULATE_FORMAT_FLOAT, &buffer[0], frames, &rendered)));
+        TEST_CHECK(count.rows == 0 || count.last_frame < count.frames + rendered);
+        count.frames += rendered;
+        if (rendered < frames) {
+            break;
+        }
+    }
+
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_unload(song)));
+    return count;
+}
+
+
+void test_render(const char* data_path) {
+    const std::string path = std::string(data_path) + "/" + RENDER_TEST_SONG;
+
+    TEST_CHECK(MODIPULATE_OK(modipulate_global_init(NULL)));
+
+    // One long render fires a callback for every row, the same as many
+    // short ones.
+    RowCount whole = render_rows(path, RENDER_TEST_FRAMES);
+    RowCount steps = render_rows(path, RENDER_TEST_STEP_FRAMES);
+    TEST_CHECK(whole.frames == RENDER_TEST_FRAMES);
+    TEST_CHECK(steps.frames == whole.frames);
+    TEST_CHECK(whole.rows > 4096);
+    TEST_CHECK(whole.rows == steps.rows);
+    TEST_CHECK(whole.in_order && whole.in_buffer);
+    TEST_CHECK(steps.in_order && steps.in_buffer);
+
+    TEST_CHECK(MODIPULATE_OK(modipulate_global_deinit()));
+}
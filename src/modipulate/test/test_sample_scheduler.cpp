@@ -0,0 +1,199 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include "sample_scheduler.h"
+#include "test.h"
+
+// Rows per pattern while driving the scheduler.
+#define TEST_PATTERN_ROWS 64
+
+static SampleTrigger* make_trigger(unsigned channel, int sample, int modulus, unsigned offset) {
+    SampleTrigger* trigger = new SampleTrigger();
+    trigger->sample = sample;
+    trigger->channel = channel;
+    trigger->modulus = modulus;
+    trigger->offset = offset;
+    return trigger;
+}
+
+
+// Plays row number row, counted from the start of playback.
+static void start_row(SampleScheduler& scheduler, unsigned long long row) {
+    scheduler.start_row((unsigned) (row % TEST_PATTERN_ROWS), TEST_PATTERN_ROWS);
+}
+
+
+// Plays rows until a trigger is taken from channel, and returns the row it
+// came on, or -1 if none did within rows rows.
+static long long run_until_taken(SampleScheduler& scheduler, unsigned long long& row,
+    unsigned long long rows, unsigned channel, int* sample) {
+    return test_run_until(row, rows,
+        [&](unsigned long long r) { start_row(scheduler, r); },
+        [&]() {
+            const SampleTrigger* trigger = scheduler.take(channel);
+            if (trigger != NULL) {
+                *sample = trigger->sample;
+            }
+            return trigger != NULL;
+        });
+}
+
+
+// Triggers fire on their own row, whatever order they're scheduled in.
+static void test_ordering() {
+    SampleScheduler scheduler;
+    scheduler.schedule(make_trigger(0, 3, 0, 3));
+    scheduler.schedule(make_trigger(1, 1, 0, 1));
+    scheduler.schedule(make_trigger(2, 0, 0, 0));
+    scheduler.schedule(make_trigger(3, 2, 0, 2));
+
+    for (unsigned long long row = 0; row < 8; row++) {
+        start_row(scheduler, row);
+        for (unsigned channel = 0; channel < 4; channel++) {
+            const SampleTrigger* trigger = scheduler.take(channel);
+            bool expected = (channel == 0 && row == 3) || (channel == 1 && row == 1) ||
+                (channel == 2 && row == 0) || (channel == 3 && row == 2);
+            TEST_CHECK((trigger != NULL) == expected);
+            if (trigger != NULL) {
+                TEST_CHECK(trigger->sample == (int) row);
+            }
+        }
+        // Taken once only.
+        TEST_CHECK(scheduler.take(0) == NULL);
+    }
+
+    // Two on the same channel and row: the last one scheduled wins.
+    unsigned long long row = 8;
+    scheduler.schedule(make_trigger(5, 10, 0, 2));
+    scheduler.schedule(make_trigger(5, 11, 0, 2));
+    int sample = -1;
+    TEST_CHECK(run_until_taken(scheduler, row, 8, 5, &sample) == 10);
+    TEST_CHECK(sample == 11);
+
+    // Modulus: the next row that's a multiple of it, then the offset.
+    row = 0;
+    while (row % TEST_PATTERN_ROWS != 5) {
+        start_row(scheduler, row++);
+    }
+    unsigned long long base = row;
+    scheduler.schedule(make_trigger(6, 20, 4, 1));
+    TEST_CHECK(run_until_taken(scheduler, row, 16, 6, &sample) == (long long) (base + 3 + 1));
+
+    // A modulus past the pattern's end waits for the next pattern.
+    while (row % TEST_PATTERN_ROWS != 50) {
+        start_row(scheduler, row++);
+    }
+    base = row;
+    scheduler.schedule(make_trigger(6, 21, 32, 0));
+    TEST_CHECK(run_until_taken(scheduler, row, 32, 6, &sample) == (long long) (base + 14));
+
+    scheduler.collect();
+}
+
+
+// Triggers far enough out to wait on the second level or the overflow list
+// cascade down and still fire on their own row.
+static void test_cascade() {
+    const unsigned offsets[] = { 255, 256, 257, 1000, 16383, 16384, 20000, 40000 };
+    const unsigned num_offsets = sizeof(offsets) / sizeof(offsets[0]);
+
+    for (unsigned i = 0; i < num_offsets; i++) {
+        // Start at rows on either side of a block boundary.
+        const unsigned long long starts[] = { 0, 200, 255, 16380 };
+        for (unsigned s = 0; s < sizeof(starts) / sizeof(starts[0]); s++) {
+            SampleScheduler scheduler;
+            unsigned long long row = 0;
+            while (row < starts[s]) {
+                start_row(scheduler, row++);
+            }
+
+            scheduler.schedule(make_trigger(7, (int) i, 0, offsets[i]));
+            int sample = -1;
+            long long fired = run_until_taken(scheduler, row, offsets[i] + 2, 7, &sample);
+            TEST_CHECK(fired == (long long) (starts[s] + offsets[i]));
+            TEST_CHECK(sample == (int) i);
+        }
+    }
+
+    // Many at once, in every bucket.
+    SampleScheduler scheduler;
+    for (unsigned i = 0; i < 20000; i += 7) {
+        scheduler.schedule(make_trigger(i % 4, (int) i, 0, i));
+    }
+    unsigned taken = 0;
+    bool in_order = true;
+    for (unsigned long long row = 0; row < 20001; row++) {
+        start_row(scheduler, row);
+        for (unsigned channel = 0; channel < 4; channel++) {
+            const SampleTrigger* trigger = scheduler.take(channel);
+            if (trigger != NULL) {
+                taken++;
+                if ((unsigned long long) trigger->sample != row) {
+                    in_order = false;
+                }
+            }
+        }
+        if (row % 1000 == 0) {
+            scheduler.collect();
+        }
+    }
+    TEST_CHECK(taken == (20000 + 6) / 7);
+    TEST_CHECK(in_order);
+}
+
+
+// Cancelled triggers never fire, and can only be cancelled while pending.
+static void test_cancel() {
+    SampleScheduler scheduler;
+    ModipulateSampleHandle near = scheduler.schedule(make_trigger(0, 1, 0, 2));
+    ModipulateSampleHandle far = scheduler.schedule(make_trigger(1, 2, 0, 1000));
+    ModipulateSampleHandle kept = scheduler.schedule(make_trigger(2, 3, 0, 2));
+    TEST_CHECK(near != 0 && far != 0 && kept != 0);
+    TEST_CHECK(near != far && far != kept);
+
+    // Before the audio thread has seen them.
+    TEST_CHECK(scheduler.cancel(near));
+    TEST_CHECK(!scheduler.cancel(near));
+    TEST_CHECK(!scheduler.cancel(12345));
+
+    unsigned long long row = 0;
+    start_row(scheduler, row++);
+
+    // Waiting on the wheel.
+    TEST_CHECK(scheduler.cancel(far));
+
+    bool near_fired = false;
+    bool far_fired = false;
+    bool kept_fired = false;
+    for (; row < 1100; row++) {
+        start_row(scheduler, row);
+        near_fired = near_fired || scheduler.take(0) != NULL;
+        far_fired = far_fired || scheduler.take(1) != NULL;
+        kept_fired = kept_fired || scheduler.take(2) != NULL;
+    }
+    TEST_CHECK(!near_fired);
+    TEST_CHECK(!far_fired);
+    TEST_CHECK(kept_fired);
+
+    // Fired and collected.
+    scheduler.collect();
+    TEST_CHECK(!scheduler.cancel(kept));
+
+    // Fired, not collected yet: cancel() collects first, and it's too late.
+    ModipulateSampleHandle now = scheduler.schedule(make_trigger(3, 4, 0, 0));
+    start_row(scheduler, row++);
+    TEST_CHECK(scheduler.take(3) != NULL);
+    TEST_CHECK(!scheduler.cancel(now));
+}
+
+
+void test_sample_scheduler(const char* data_path) {
+    test_ordering();
+    test_cascade();
+    test_cancel();
+}
@@ -0,0 +1,79 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include <fstream>
+#include <string>
+#include <vector>
+#include "libopenmpt-forked/libopenmpt/libopenmpt.hpp"
+#include "test.h"
+
+#define SEEK_TEST_RATE 44100
+
+// Audio compared after each seek.
+#define SEEK_TEST_FRAMES 8192
+
+// Seeks per song, spread over its length.
+#define SEEK_TEST_STEPS 12
+
+static const char* const seek_test_songs[] = {
+    "v-cf.it",
+    "gem-pivi.it",
+    "sponge1.it",
+    "cerror_-_pigs_go_oink.xm",
+};
+
+
+static std::vector<float> render(openmpt::module& mod) {
+    std::vector<float> out(SEEK_TEST_FRAMES * 2, 0.0f);
+    std::size_t count = mod.read_interleaved_stereo(SEEK_TEST_RATE, SEEK_TEST_FRAMES, &out[0]);
+    out.resize(count * 2);
+    return out;
+}
+
+
+// Seeks a song with the seek cache and a copy without it the same way, and
+// checks both land in the same place and sound the same from there.
+static void check_song(const std::string& path) {
+    std::ifstream cached_file(path.c_str(), std::ios::binary);
+    std::ifstream plain_file(path.c_str(), std::ios::binary);
+    TEST_CHECK(cached_file && plain_file);
+    if (!cached_file || !plain_file) {
+        return;
+    }
+
+    openmpt::module cached(cached_file);
+    openmpt::module plain(plain_file);
+    cached.build_seek_cache(SEEK_TEST_RATE);
+
+    const double duration = plain.get_duration_seconds();
+    const int orders = plain.get_num_orders();
+
+    // Every other seek goes backwards.
+    for (int i = 0; i < SEEK_TEST_STEPS; i++) {
+        int step = (i % 2 == 0) ? i : SEEK_TEST_STEPS - i;
+        double seconds = duration * step / SEEK_TEST_STEPS;
+        TEST_CHECK(cached.set_position_seconds(seconds) == plain.set_position_seconds(seconds));
+        TEST_CHECK(render(cached) == render(plain));
+    }
+
+    for (int order = 0; order < orders; order += 1 + orders / SEEK_TEST_STEPS) {
+        int rows = plain.get_pattern_num_rows(plain.get_order_pattern(order));
+        int row = rows / 2;
+        TEST_CHECK(cached.set_position_order_row(order, row) == plain.set_position_order_row(order, row));
+        TEST_CHECK(cached.get_current_order() == plain.get_current_order());
+        TEST_CHECK(cached.get_current_row() == plain.get_current_row());
+        TEST_CHECK(render(cached) == render(plain));
+    }
+}
+
+
+void test_seek(const char* data_path) {
+    for (size_t i = 0; i < sizeof(seek_test_songs) / sizeof(seek_test_songs[0]); i++) {
+        check_song(std::string(data_path) + "/" + seek_test_songs[i]);
+    }
+}
@@ -0,0 +1,150 @@
+/* Copyright 2011-2015 Eric Gregory and Stevie Hryciw
+ *
+ * Modipulate.
+ * https://github.com/MrEricSir/Modipulate/
+ *
+ * Modipulate is released under the BSD license.  See LICENSE for details.
+ */
+
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+#include "modipulate.h"
+#include "test.h"
+
+// Engine rate, which the timeline's frames are counted in.
+#define TIMELINE_TEST_RATE 44100
+
+// Longest wait for the background walk, in milliseconds.
+#define TIMELINE_TEST_WAIT_MSEC 10000
+
+// Note numbers of notes that play; the rest are note offs, cuts and fades.
+#define TIMELINE_TEST_FIRST_NOTE 1
+#define TIMELINE_TEST_LAST_NOTE 120
+
+static const char* const timeline_test_songs[] = {
+    "v-cf.it",
+    "gem-pivi.it",
+    "cerror_-_pigs_go_oink.xm",
+};
+
+// When and on which channel each note played.
+struct PlayedNotes {
+    std::set<std::pair<unsigned long long, unsigned> > notes;
+    unsigned long long frames;  // Frames rendered before the current call
+};
+
+static void on_note(ModipulateSong song, unsigned channel, int note, int instrument, int sample,
+    int volume_command, int volume_value, int effect_command, int effect_value, void* user_data) {
+    PlayedNotes* played = (PlayedNotes*) user_data;
+    unsigned long offset = 0;
+    modipulate_song_get_event_offset(song, &offset);
+
+    played->notes.insert(std::make_pair(played->frames + offset, channel));
+}
+
+
+// Renders a song up to frame end, and lists the notes its callbacks report.
+static void play_song(ModipulateSong song, unsigned long long end, PlayedNotes& played) {
+    played.frames = 0;
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_on_note(song, on_note, &played)));
+
+    std::vector<float> buffer(TIMELINE_TEST_RATE * 2);
+    while (played.frames < end) {
+        unsigned long rendered = 0;
+        TEST_CHECK(MODIPULATE_OK(modipulate_song_render(song, TIMELINE_TEST_RATE,
+            MODIPULATE_FORMAT_FLOAT, &buffer[0], TIMELINE_TEST_RATE, &rendered)));
+        if (rendered == 0) {
+            break;
+        }
+        played.frames += rendered;
+    }
+
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_on_note(song, NULL, NULL)));
+}
+
+
+// Waits for the background walk, and gets the timeline from start to end.
+static bool get_timeline(ModipulateSong song, double start, double end,
+    std::vector<ModipulateTimelineEvent>& events) {
+    unsigned count = 0;
+    ModipulateErr err = MODIPULATE_ERROR_NOT_READY;
+    for (int msec = 0; msec < TIMELINE_TEST_WAIT_MSEC; msec++) {
+        err = modipulate_song_get_timeline(song, start, end, NULL, 0, &count);
+        if (err != MODIPULATE_ERROR_NOT_READY) {
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    if (!MODIPULATE_OK(err)) {
+        return false;
+    }
+
+    events.resize(count);
+    if (count == 0) {
+        return true;
+    }
+    unsigned written = 0;
+    err = modipulate_song_get_timeline(song, start, end, &events[0], count, &written);
+    return MODIPULATE_OK(err) && written == count;
+}
+
+
+static void check_song(const std::string& path) {
+    ModipulateSong song;
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_load(path.c_str(), &song)));
+
+    std::vector<ModipulateTimelineEvent> timeline;
+    TEST_CHECK(get_timeline(song, 0.0, 1e9, timeline));
+    TEST_CHECK(!timeline.empty());
+
+    // Every note in the timeline plays when it says, on its channel.  The
+    // callbacks report a few more, from retrigger effects.
+    PlayedNotes played;
+    if (!timeline.empty()) {
+        play_song(song, timeline.back().frame + 1, played);
+    }
+    unsigned missing = 0;
+    for (size_t i = 0; i < timeline.size(); i++) {
+        const ModipulateTimelineEvent& e = timeline[i];
+        TEST_CHECK(i == 0 || e.time >= timeline[i - 1].time);
+        if (e.note >= TIMELINE_TEST_FIRST_NOTE && e.note <= TIMELINE_TEST_LAST_NOTE &&
+            played.notes.count(std::make_pair(e.frame, e.channel)) == 0) {
+            missing++;
+        }
+    }
+    TEST_CHECK(missing == 0);
+
+    // A stretch holds just the notes starting in it.
+    if (timeline.size() > 2) {
+        double start = timeline[timeline.size() / 3].time;
+        double end = timeline[timeline.size() * 2 / 3].time;
+        std::vector<ModipulateTimelineEvent> stretch;
+        TEST_CHECK(get_timeline(song, start, end, stretch));
+        size_t expected = 0;
+        for (size_t i = 0; i < timeline.size(); i++) {
+            if (timeline[i].time >= start && timeline[i].time < end) {
+                expected++;
+            }
+        }
+        TEST_CHECK(stretch.size() == expected);
+        for (size_t i = 0; i < stretch.size(); i++) {
+            TEST_CHECK(stretch[i].time >= start && stretch[i].time < end);
+        }
+    }
+
+    TEST_CHECK(MODIPULATE_OK(modipulate_song_unload(song)));
+}
+
+
+void test_timeline(const char* data_path) {
+    TEST_CHECK(MODIPULATE_OK(modipulate_global_init(NULL)));
+
+    for (size_t i = 0; i < sizeof(timeline_test_songs) / sizeof(timeline_test_songs[0]); i++) {
+        check_song(std::string(data_path) + "/" + timeline_test_songs[i]);
+    }
+
+    TEST_CHECK(MODIPULATE_OK(modipulate_global_deinit()));
+}
@@ -9,6 +9,9 @@
 #include <modipulate.h>
 #include <string>
 #include <cstring>
+#include <vector>
+#include <algorithm>
+#include <cmath>
 #include "utils.h"
 
 extern "C" {
@@ -24,6 +27,8 @@ extern "C" {
     static int modipulateLua_getVolume(lua_State *L);
     static int modipulateLua_setVolume(lua_State *L);
     static int modipulateLua_loadSong(lua_State *L);
+    static int modipulateLua_loadSongAsync(lua_State *L);
+    static int modipulateLua_cancelLoad(lua_State *L);
 }
 
 // Max length of our strings.
@@ -36,6 +41,32 @@ extern "C" {
 // Name of our song type in Lua.
 #define MODIPULATE_SONG_T "ModipulateLuaSongClass"
 
+// Event types, for setEventFilter() and onEvents().  Same numbers as the C API's.
+#define MODIPULATE_LUA_EVENT_PATTERN    MODIPULATE_EVENT_PATTERN
+#define MODIPULATE_LUA_EVENT_ROW        MODIPULATE_EVENT_ROW
+#define MODIPULATE_LUA_EVENT_NOTE       MODIPULATE_EVENT_NOTE
+#define MODIPULATE_LUA_EVENT_BIT(type)  (1u << (type))
+#define MODIPULATE_LUA_EVENT_ALL        (MODIPULATE_LUA_EVENT_BIT(MODIPULATE_LUA_EVENT_PATTERN) | \
+                                         MODIPULATE_LUA_EVENT_BIT(MODIPULATE_LUA_EVENT_ROW) | \
+                                         MODIPULATE_LUA_EVENT_BIT(MODIPULATE_LUA_EVENT_NOTE))
+
+// Numbers per event in the table handed to an onEvents() callback: type,
+// channel, pattern/row/note, instrument, sample, volume command, volume
+// value, effect command and effect value.
+#define MODIPULATE_LUA_EVENT_FIELDS     9
+
+// Channels an event filter can pick from.
+#define MODIPULATE_LUA_MAX_CHANNELS     256
+
+// Events waiting for an onEvents() callback, which gets them all at once
+// from update().
+typedef struct {
+    int                 on_events;
+    lua_State*          on_events_state;
+    int                 table;      // Reused for every batch.
+    std::vector<lua_Number> values; // MODIPULATE_LUA_EVENT_FIELDS per event.
+} modipulate_batch_t;
+
 // Struc to hold our song data in Lua.
 typedef struct {
     ModipulateSong      song;
@@ -53,8 +84,28 @@ typedef struct {
     lua_State*          on_row_changed_state;
     int                 on_note;
     lua_State*          on_note_state;
+    modipulate_batch_t* batch;          // NULL unless onEvents() is set.
+    unsigned            event_types;    // MODIPULATE_LUA_EVENT_BIT() of each type reported.
+    bool                all_channels;   // Otherwise notes only on channels[].
+    bool                channels[MODIPULATE_LUA_MAX_CHANNELS];
 } modipulate_song_t;
 
+// Callback of a loadSongAsync() call that hasn't finished yet.
+typedef struct {
+    int                 on_loaded;
+    lua_State*          on_loaded_state;
+} modipulate_load_t;
+
+// Songs with an onEvents() callback, for update() to deliver to.
+static std::vector<modipulate_song_t*> batched_songs;
+
+// First error raised by a callback during update(), as a registry
+// reference, or LUA_NOREF. Callbacks run inside modipulate_global_update(),
+// which an error mustn't unwind, so update() raises it once that's returned.
+static int callback_error = LUA_NOREF;
+
+static ModipulateErr update_song_callbacks(modipulate_song_t* lua_song);
+
 
 ////////////////////////////////////////////////////////////
 
@@ -83,9 +134,26 @@ static modipulate_song_t *push_modipulate_song_t(lua_State *L) {
 }
 
 
+// Drops a song's onEvents() callback and any events waiting for it.
+static void free_batch(modipulate_song_t* lua_song) {
+    modipulate_batch_t* batch = lua_song->batch;
+    if (batch == NULL)
+        return;
+    
+    luaL_unref(batch->on_events_state, LUA_REGISTRYINDEX, batch->on_events);
+    luaL_unref(batch->on_events_state, LUA_REGISTRYINDEX, batch->table);
+    delete batch;
+    lua_song->batch = NULL;
+    
+    batched_songs.erase(std::find(batched_songs.begin(), batched_songs.end(), lua_song));
+}
+
+
 static int modipulateLua_song_destroy(lua_State *L) {
     modipulate_song_t* lua_song = (modipulate_song_t*) lua_touserdata(L, 1);
     
+    free_batch(lua_song);
+    
     // Attempt to free the song and song info.
     MODIPULATE_LUA_ERROR(L, modipulate_song_info_free(lua_song->song_info));
     MODIPULATE_LUA_ERROR(L, modipulate_song_unload(lua_song->song));
@@ -304,15 +372,69 @@ static int modipulateLua_song_play_sample(lua_State *L) {
 }
 
 
+// Calls the function on the stack of L below its nargs arguments, and keeps
+// the first error it raises for update().
+static void call_callback(lua_State* L, int nargs) {
+    if (lua_pcall(L, nargs, 0, 0) == 0)
+        return;
+    
+    if (callback_error == LUA_NOREF)
+        callback_error = luaL_ref(L, LUA_REGISTRYINDEX);
+    else
+        lua_pop(L, 1);
+}
+
+
+// Adds an event to a song's batch for its onEvents() callback.
+static void batch_event(modipulate_song_t* lua_song, int type, int channel, int value,
+    int instrument, int sample, int volume_command, int volume_value,
+    int effect_command, int effect_value) {
+    const lua_Number event[MODIPULATE_LUA_EVENT_FIELDS] = { (lua_Number) type, (lua_Number) channel,
+        (lua_Number) value, (lua_Number) instrument, (lua_Number) sample, (lua_Number) volume_command,
+        (lua_Number) volume_value, (lua_Number) effect_command, (lua_Number) effect_value };
+    
+    std::vector<lua_Number>& values = lua_song->batch->values;
+    values.insert(values.end(), event, event + MODIPULATE_LUA_EVENT_FIELDS);
+}
+
+
+// Hands every event batched since the last update() to the song's
+// onEvents() callback in one call.
+static void deliver_batch(modipulate_song_t* lua_song) {
+    modipulate_batch_t* batch = lua_song->batch;
+    std::size_t size = batch->values.size();
+    if (size == 0)
+        return;
+    
+    lua_State* L = batch->on_events_state;
+    lua_rawgeti(L, LUA_REGISTRYINDEX, batch->on_events);
+    lua_rawgeti(L, LUA_REGISTRYINDEX, batch->table);
+    for (std::size_t i = 0; i < size; i++) {
+        lua_pushnumber(L, batch->values[i]);
+        lua_rawseti(L, -2, (int) i + 1);
+    }
+    lua_pushnumber(L, (lua_Number) (size / MODIPULATE_LUA_EVENT_FIELDS));
+    
+    // Emptied first: the callback may switch batching off.
+    batch->values.clear();
+    
+    call_callback(L, 2);
+}
+
+
 // Dispatch function for pattern change.
 void on_modipulate_song_pattern_change(ModipulateSong song, int pattern_number, void* user_data) {
     modipulate_song_t* lua_song = (modipulate_song_t*) user_data;
     
+    if (lua_song->batch != NULL) {
+        batch_event(lua_song, MODIPULATE_LUA_EVENT_PATTERN, -1, pattern_number, 0, 0, 0, 0, 0, 0);
+        return;
+    }
     
     lua_rawgeti(lua_song->on_pattern_changed_state, LUA_REGISTRYINDEX, lua_song->on_pattern_changed);
     lua_pushnumber(lua_song->on_pattern_changed_state, pattern_number);
 
-    lua_call(lua_song->on_pattern_changed_state, 1, 0);
+    call_callback(lua_song->on_pattern_changed_state, 1);
 }
 
 
@@ -324,20 +446,20 @@ static int modipulateLua_song_on_pattern_change(lua_State *L) {
     modipulate_song_t* lua_song = check_modipulate_song_t(L, 1);
     luaL_argcheck(L, lua_isfunction(L, 2) || lua_isnumber(L, 2), 2, usage);
     
-    // Disable callback.  This takes care of clearing any existing callback.
-    MODIPULATE_LUA_ERROR(L, modipulate_song_on_pattern_change(lua_song->song, 0, 0)); 
+    // Clear any existing callback.
+    if (lua_song->on_pattern_changed != -1)
+        luaL_unref(lua_song->on_pattern_changed_state, LUA_REGISTRYINDEX, lua_song->on_pattern_changed);
     lua_song->on_pattern_changed = -1;
     lua_song->on_pattern_changed_state = 0;
     
     // If the user handed us a function, create a new callback.
     if (lua_isfunction(L, 2)) {
-        MODIPULATE_LUA_ERROR(L, modipulate_song_on_pattern_change(lua_song->song, 
-            on_modipulate_song_pattern_change, lua_song));
-        
         lua_song->on_pattern_changed = luaL_ref(L, LUA_REGISTRYINDEX);
         lua_song->on_pattern_changed_state = L;
     }
     
+    MODIPULATE_LUA_ERROR(L, update_song_callbacks(lua_song));
+    
     return 0;
 }
 
@@ -346,11 +468,15 @@ static int modipulateLua_song_on_pattern_change(lua_State *L) {
 void on_modipulate_song_row_change(ModipulateSong song, int row_number, void* user_data) {
     modipulate_song_t* lua_song = (modipulate_song_t*) user_data;
     
+    if (lua_song->batch != NULL) {
+        batch_event(lua_song, MODIPULATE_LUA_EVENT_ROW, -1, row_number, 0, 0, 0, 0, 0, 0);
+        return;
+    }
     
     lua_rawgeti(lua_song->on_row_changed_state, LUA_REGISTRYINDEX, lua_song->on_row_changed);
     lua_pushnumber(lua_song->on_row_changed_state, row_number);
 
-    lua_call(lua_song->on_row_changed_state, 1, 0);
+    call_callback(lua_song->on_row_changed_state, 1);
 }
 
 
@@ -362,20 +488,20 @@ static int modipulateLua_song_on_row_change(lua_State *L) {
     modipulate_song_t* lua_song = check_modipulate_song_t(L, 1);
     luaL_argcheck(L, lua_isfunction(L, 2) || lua_isnumber(L, 2), 2, usage);
     
-    // Disable callback.  This takes care of clearing any existing callback.
-    MODIPULATE_LUA_ERROR(L, modipulate_song_on_row_change(lua_song->song, 0, 0)); 
+    // Clear any existing callback.
+    if (lua_song->on_row_changed != -1)
+        luaL_unref(lua_song->on_row_changed_state, LUA_REGISTRYINDEX, lua_song->on_row_changed);
     lua_song->on_row_changed = -1;
     lua_song->on_row_changed_state = 0;
     
     // If the user handed us a function, create a new callback.
     if (lua_isfunction(L, 2)) {
-        MODIPULATE_LUA_ERROR(L, modipulate_song_on_row_change(lua_song->song, 
-            on_modipulate_song_row_change, lua_song));
-        
         lua_song->on_row_changed = luaL_ref(L, LUA_REGISTRYINDEX);
         lua_song->on_row_changed_state = L;
     }
     
+    MODIPULATE_LUA_ERROR(L, update_song_callbacks(lua_song));
+    
     return 0;
 }
 
@@ -386,6 +512,15 @@ void on_modipulate_song_note(ModipulateSong song, unsigned channel, int note,
     int effect_command, int effect_value, void* user_data) {
     modipulate_song_t* lua_song = (modipulate_song_t*) user_data;
     
+    // Notes on channels nobody subscribed to go no further.
+    if (!lua_song->all_channels && (channel >= MODIPULATE_LUA_MAX_CHANNELS || !lua_song->channels[channel]))
+        return;
+    
+    if (lua_song->batch != NULL) {
+        batch_event(lua_song, MODIPULATE_LUA_EVENT_NOTE, (int) channel, note, instrument, sample,
+            volume_command, volume_value, effect_command, effect_value);
+        return;
+    }
     
     lua_rawgeti(lua_song->on_note_state, LUA_REGISTRYINDEX, lua_song->on_note);
     lua_pushnumber(lua_song->on_note_state, channel);
@@ -397,7 +532,7 @@ void on_modipulate_song_note(ModipulateSong song, unsigned channel, int note,
     lua_pushnumber(lua_song->on_note_state, effect_command);
     lua_pushnumber(lua_song->on_note_state, effect_value);
 
-    lua_call(lua_song->on_note_state, 8, 0);
+    call_callback(lua_song->on_note_state, 8);
 }
 
 
@@ -410,24 +545,143 @@ static int modipulateLua_song_on_note(lua_State *L) {
     modipulate_song_t* lua_song = check_modipulate_song_t(L, 1);
     luaL_argcheck(L, lua_isfunction(L, 2) || lua_isnumber(L, 2), 2, usage);
     
-    // Disable callback.  This takes care of clearing any existing callback.
-    MODIPULATE_LUA_ERROR(L, modipulate_song_on_note(lua_song->song, 0, 0)); 
+    // Clear any existing callback.
+    if (lua_song->on_note != -1)
+        luaL_unref(lua_song->on_note_state, LUA_REGISTRYINDEX, lua_song->on_note);
     lua_song->on_note = -1;
     lua_song->on_note_state = 0;
     
     // If the user handed us a function, create a new callback.
     if (lua_isfunction(L, 2)) {
-        MODIPULATE_LUA_ERROR(L, modipulate_song_on_note(lua_song->song, 
-            on_modipulate_song_note, lua_song));
-        
         lua_song->on_note = luaL_ref(L, LUA_REGISTRYINDEX);
         lua_song->on_note_state = L;
     }
     
+    MODIPULATE_LUA_ERROR(L, update_song_callbacks(lua_song));
+    
+    return 0;
+}
+
+
+static int modipulateLua_song_on_events(lua_State *L) {
+    const char* usage = "Usage: onEvents(func) where func is a function with the signature: \n"
+                        "function yourFunc(events, count)\n"
+                        "It is called from update() with all the events since the last update, in "
+                        "place of the onPatternChange, onRowChange and onNote callbacks.  Event i, "
+                        "counting from 0, is events[i * modipulate.EVENT_FIELDS + 1] onwards: type, "
+                        "channel, pattern, row or note, instrument, sample, volumeCommand, "
+                        "volumeValue, effectCommand, effectValue.  The table is reused, so only "
+                        "the first count events are valid.\n"
+                        "Or pass 0 to disable.";
+    luaL_argcheck(L, lua_gettop(L) == 2, 0, usage);
+    modipulate_song_t* lua_song = check_modipulate_song_t(L, 1);
+    luaL_argcheck(L, lua_isfunction(L, 2) || lua_isnumber(L, 2), 2, usage);
+    
+    // Clear any existing callback, and the events it didn't get yet.
+    free_batch(lua_song);
+    
+    // If the user handed us a function, batch from now on.
+    if (lua_isfunction(L, 2)) {
+        modipulate_batch_t* batch = new modipulate_batch_t;
+        lua_newtable(L);
+        batch->table = luaL_ref(L, LUA_REGISTRYINDEX);
+        batch->on_events = luaL_ref(L, LUA_REGISTRYINDEX);
+        batch->on_events_state = L;
+        
+        lua_song->batch = batch;
+        batched_songs.push_back(lua_song);
+    }
+    
+    MODIPULATE_LUA_ERROR(L, update_song_callbacks(lua_song));
+    
+    return 0;
+}
+
+
+// Reads an array of whole numbers from the table at index into out, which
+// must be big enough for numbers up to max - 1.  Raises an error for
+// anything else, including fractions, strings that aren't numbers and nil.
+static void read_number_set(lua_State *L, int index, bool* out, int min, int max, const char* what) {
+    int n = (int) lua_objlen(L, index);
+    for (int i = 1; i <= n; i++) {
+        lua_rawgeti(L, index, i);
+        lua_Number number = lua_tonumber(L, -1);
+        if (!lua_isnumber(L, -1) || number != std::floor(number) || number < min || number >= max) {
+            luaL_error(L, "Not a valid %s: %s", what,
+                lua_isstring(L, -1) ? lua_tostring(L, -1) : luaL_typename(L, -1));
+        }
+        lua_pop(L, 1);
+        out[(int) number] = true;
+    }
+}
+
+
+static int modipulateLua_song_set_event_filter(lua_State *L) {
+    const char* usage = "Usage: setEventFilter([types [, channels]]) where types is a table of the "
+                        "event types to report (modipulate.EVENT_PATTERN, modipulate.EVENT_ROW and "
+                        "modipulate.EVENT_NOTE) and channels is a table of the channels to report "
+                        "notes on.  Leave either out or pass nil for all of them.";
+    const int top = lua_gettop(L);
+    luaL_argcheck(L, top >= 1 && top <= 3, 0, usage);
+    modipulate_song_t* lua_song = check_modipulate_song_t(L, 1);
+    luaL_argcheck(L, top < 2 || lua_isnil(L, 2) || lua_istable(L, 2), 2, usage);
+    luaL_argcheck(L, top < 3 || lua_isnil(L, 3) || lua_istable(L, 3), 3, usage);
+    
+    unsigned event_types = MODIPULATE_LUA_EVENT_ALL;
+    if (top >= 2 && lua_istable(L, 2)) {
+        bool types[MODIPULATE_LUA_EVENT_NOTE + 1] = { false };
+        read_number_set(L, 2, types, MODIPULATE_LUA_EVENT_PATTERN, MODIPULATE_LUA_EVENT_NOTE + 1, "event type");
+        
+        event_types = 0;
+        for (int type = MODIPULATE_LUA_EVENT_PATTERN; type <= MODIPULATE_LUA_EVENT_NOTE; type++) {
+            if (types[type])
+                event_types |= MODIPULATE_LUA_EVENT_BIT(type);
+        }
+    }
+    
+    bool all_channels = true;
+    bool channels[MODIPULATE_LUA_MAX_CHANNELS] = { false };
+    if (top >= 3 && lua_istable(L, 3)) {
+        all_channels = false;
+        read_number_set(L, 3, channels, 0, MODIPULATE_LUA_MAX_CHANNELS, "channel");
+    }
+    
+    lua_song->event_types = event_types;
+    lua_song->all_channels = all_channels;
+    memcpy(lua_song->channels, channels, sizeof(channels));
+    
+    MODIPULATE_LUA_ERROR(L, update_song_callbacks(lua_song));
+    
     return 0;
 }
 
 
+// Hooks up the callbacks for the event types that are subscribed to and
+// have somewhere to go.  Modipulate doesn't report the others at all.
+static ModipulateErr update_song_callbacks(modipulate_song_t* lua_song) {
+    const bool batched = lua_song->batch != NULL;
+    const bool patterns = (lua_song->event_types & MODIPULATE_LUA_EVENT_BIT(MODIPULATE_LUA_EVENT_PATTERN))
+        && (batched || lua_song->on_pattern_changed != -1);
+    const bool rows = (lua_song->event_types & MODIPULATE_LUA_EVENT_BIT(MODIPULATE_LUA_EVENT_ROW))
+        && (batched || lua_song->on_row_changed != -1);
+    const bool notes = (lua_song->event_types & MODIPULATE_LUA_EVENT_BIT(MODIPULATE_LUA_EVENT_NOTE))
+        && (batched || lua_song->on_note != -1);
+    
+    ModipulateErr err = modipulate_song_on_pattern_change(lua_song->song,
+        patterns ? on_modipulate_song_pattern_change : NULL, lua_song);
+    if (!MODIPULATE_OK(err))
+        return err;
+    
+    err = modipulate_song_on_row_change(lua_song->song,
+        rows ? on_modipulate_song_row_change : NULL, lua_song);
+    if (!MODIPULATE_OK(err))
+        return err;
+    
+    return modipulate_song_on_note(lua_song->song,
+        notes ? on_modipulate_song_note : NULL, lua_song);
+}
+
+
 static const luaL_reg modipulate_song_meta_methods[] = {
     {"__gc", modipulateLua_song_destroy },
     {0,0}
@@ -452,6 +706,8 @@ static const luaL_reg modipulate_song_methods[] = {
 {"onPatternChange",        modipulateLua_song_on_pattern_change},
 {"onRowChange",            modipulateLua_song_on_row_change},
 {"onNote",                 modipulateLua_song_on_note},
+{"onEvents",               modipulateLua_song_on_events},
+{"setEventFilter",         modipulateLua_song_set_event_filter},
 {0,0}
 };
 
@@ -514,11 +770,32 @@ int modipulateLua_song_register(lua_State *L) {
 
 
 // Initalizes Modipulate.
+// Optionally takes a table of engine options, for example:
+//    init{sample_rate = 48000, frames_per_buffer = 256}
 static int modipulateLua_init(lua_State *L) {
-    const char* usage = "Usage: init()";
-    luaL_argcheck(L, lua_gettop(L) == 0, 0, usage);
+    const char* usage = "Usage: init([options])";
+    luaL_argcheck(L, lua_gettop(L) == 0 || (lua_gettop(L) == 1 && lua_istable(L, 1)), 0, usage);
+    
+    ModipulateEngineOptions options;
+    modipulate_global_get_default_options(&options);
+    
+    if (lua_gettop(L) == 1) {
+        lua_getfield(L, 1, "sample_rate");
+        options.sample_rate = luaL_optinteger(L, -1, options.sample_rate);
+        lua_getfield(L, 1, "frames_per_buffer");
+        options.frames_per_buffer = luaL_optinteger(L, -1, options.frames_per_buffer);
+        lua_getfield(L, 1, "suggested_latency");
+        options.suggested_latency = luaL_optnumber(L, -1, options.suggested_latency);
+        lua_getfield(L, 1, "channels");
+        options.channels = luaL_optinteger(L, -1, options.channels);
+        lua_getfield(L, 1, "device");
+        options.device = luaL_optinteger(L, -1, options.device);
+        lua_getfield(L, 1, "render_threads");
+        options.render_threads = luaL_optinteger(L, -1, options.render_threads);
+        lua_pop(L, 6);
+    }
     
-    MODIPULATE_LUA_ERROR(L, modipulate_global_init());
+    MODIPULATE_LUA_ERROR(L, modipulate_global_init(&options));
     
     return 0;
 }
@@ -540,6 +817,20 @@ static int modipulateLua_deinit(lua_State *L) {
 static int modipulateLua_update(lua_State *L) {
     modipulate_global_update();
     
+    // A callback that switches batching off for a song still waiting here
+    // only delays that song's events to the next update.
+    for (std::size_t i = 0; i < batched_songs.size(); i++) {
+        deliver_batch(batched_songs[i]);
+    }
+    
+    // Now it's safe to raise whatever a callback raised.
+    if (callback_error != LUA_NOREF) {
+        lua_rawgeti(L, LUA_REGISTRYINDEX, callback_error);
+        luaL_unref(L, LUA_REGISTRYINDEX, callback_error);
+        callback_error = LUA_NOREF;
+        return lua_error(L);
+    }
+    
     return 0;
 }
 
@@ -565,18 +856,15 @@ static int modipulateLua_getVolume(lua_State *L) {
 }
 
 
-static int modipulateLua_loadSong(lua_State *L) {
-    const char* usage = "Usage: loadSong(filename) where filename is a path of a MOD, S3M, IT, etc. file";
-    luaL_argcheck(L, lua_gettop(L) == 1, 0, usage);
-    luaL_argcheck(L, lua_isstring(L, 1), 1, usage);
-    
-    ModipulateSong song = NULL;
+// Pushes a new Lua song for a loaded song onto the stack. Pushes nothing
+// if the song info can't be read.
+static ModipulateErr push_loaded_song(lua_State *L, ModipulateSong song) {
     ModipulateSongInfo* song_info;
     modipulate_song_t* lua_song = NULL;
     
-    // Load song and song info.
-    MODIPULATE_LUA_ERROR(L, modipulate_song_load(lua_tostring(L, 1), &song));
-    MODIPULATE_LUA_ERROR(L, modipulate_song_get_info(song, &song_info));
+    ModipulateErr err = modipulate_song_get_info(song, &song_info);
+    if (!MODIPULATE_OK(err))
+        return err;
     
     // Push a new song onto the stack and set it up.
     lua_song = push_modipulate_song_t(L);
@@ -597,11 +885,103 @@ static int modipulateLua_loadSong(lua_State *L) {
     lua_song->on_row_changed_state = NULL;
     lua_song->on_note = - 1;
     lua_song->on_note_state = NULL;
+    lua_song->batch = NULL;
+    lua_song->event_types = MODIPULATE_LUA_EVENT_ALL;
+    lua_song->all_channels = true;
+    memset(lua_song->channels, 0, sizeof(lua_song->channels));
+    
+    return MODIPULATE_ERROR_NONE;
+}
+
+
+static int modipulateLua_loadSong(lua_State *L) {
+    const char* usage = "Usage: loadSong(filename) where filename is a path of a MOD, S3M, IT, etc. file";
+    luaL_argcheck(L, lua_gettop(L) == 1, 0, usage);
+    luaL_argcheck(L, lua_isstring(L, 1), 1, usage);
+    
+    ModipulateSong song = NULL;
+    
+    // Load song and song info.
+    MODIPULATE_LUA_ERROR(L, modipulate_song_load(lua_tostring(L, 1), &song));
+    MODIPULATE_LUA_ERROR(L, push_loaded_song(L, song));
+    
+    return 1;
+}
+
+
+// Dispatch function for loadSongAsync(). Cancelled loads are dropped
+// without calling back into Lua.
+void on_modipulate_song_loaded(ModipulateErr err, ModipulateSong song, void* user_data) {
+    modipulate_load_t* load = (modipulate_load_t*) user_data;
+    lua_State* L = load->on_loaded_state;
+    
+    // Let go of the function before calling it; the load is over either way.
+    lua_rawgeti(L, LUA_REGISTRYINDEX, load->on_loaded);
+    luaL_unref(L, LUA_REGISTRYINDEX, load->on_loaded);
+    delete load;
+    
+    if (err == MODIPULATE_ERROR_CANCELLED) {
+        lua_pop(L, 1);
+        return;
+    }
+    
+    if (MODIPULATE_OK(err)) {
+        err = push_loaded_song(L, song);
+        if (!MODIPULATE_OK(err))
+            modipulate_song_unload(song);
+    }
+    
+    if (MODIPULATE_OK(err)) {
+        call_callback(L, 1);
+    } else {
+        lua_pushnil(L);
+        lua_pushstring(L, modipulate_global_get_last_error_string());
+        call_callback(L, 2);
+    }
+}
+
+
+// Loads a song in the background. The function is called from update()
+// with the song once it's ready, or with nil and an error message.
+// Returns a token for cancelLoad().
+static int modipulateLua_loadSongAsync(lua_State *L) {
+    const char* usage = "Usage: loadSongAsync(filename, func) where filename is a path of a MOD, S3M, IT, etc. file\n"
+                        "and func is a function with the signature: \n"
+                        "function yourFunc(song, errorMessage)";
+    luaL_argcheck(L, lua_gettop(L) == 2, 0, usage);
+    luaL_argcheck(L, lua_isstring(L, 1), 1, usage);
+    luaL_argcheck(L, lua_isfunction(L, 2), 2, usage);
+    
+    std::string filename = lua_tostring(L, 1);
+    modipulate_load_t* load = new modipulate_load_t;
+    load->on_loaded = luaL_ref(L, LUA_REGISTRYINDEX);
+    load->on_loaded_state = L;
+    
+    ModipulateLoadToken token = 0;
+    ModipulateErr err = modipulate_song_load_async(filename.c_str(), on_modipulate_song_loaded, load, &token);
+    if (!MODIPULATE_OK(err)) {
+        luaL_unref(L, LUA_REGISTRYINDEX, load->on_loaded);
+        delete load;
+    }
+    MODIPULATE_LUA_ERROR(L, err);
+    
+    lua_pushnumber(L, (lua_Number) token);
     
     return 1;
 }
 
 
+static int modipulateLua_cancelLoad(lua_State *L) {
+    const char* usage = "Usage: cancelLoad(token) where token was returned by loadSongAsync()";
+    luaL_argcheck(L, lua_gettop(L) == 1, 0, usage);
+    luaL_argcheck(L, lua_isnumber(L, 1), 1, usage);
+    
+    MODIPULATE_LUA_ERROR(L, modipulate_song_load_cancel((ModipulateLoadToken) lua_tonumber(L, 1)));
+    
+    return 0;
+}
+
+
 ////////////////////////////////////////////////////////////
 
 // Luaopen Function.
@@ -617,10 +997,22 @@ int LUA_API luaopen_libmodipulatelua(lua_State *L) {
         { "setVolume", modipulateLua_setVolume },
         { "getVolume", modipulateLua_getVolume },
         { "loadSong", modipulateLua_loadSong },
+        { "loadSongAsync", modipulateLua_loadSongAsync },
+        { "cancelLoad", modipulateLua_cancelLoad },
         { NULL, NULL }
     };
     luaL_openlib (L, "modipulate", driver, 0);
     
+    // Event types and layout, for setEventFilter() and onEvents().
+    lua_pushnumber(L, MODIPULATE_LUA_EVENT_PATTERN);
+    lua_setfield(L, -2, "EVENT_PATTERN");
+    lua_pushnumber(L, MODIPULATE_LUA_EVENT_ROW);
+    lua_setfield(L, -2, "EVENT_ROW");
+    lua_pushnumber(L, MODIPULATE_LUA_EVENT_NOTE);
+    lua_setfield(L, -2, "EVENT_NOTE");
+    lua_pushnumber(L, MODIPULATE_LUA_EVENT_FIELDS);
+    lua_setfield(L, -2, "EVENT_FIELDS");
+    
     modipulateLua_song_register(L); // TODO: does this go here? I have no idea.
     
     return 1;